@@ -20,6 +20,7 @@
 #include <netgroup.h>
 #include <random.h>
 #include <streams.h>
+#include <sync.h>
 #include <tinyformat.h>
 #include <univalue.h>
 #include <util/fs.h>
@@ -126,6 +127,88 @@ void DeserializeFileDB(const fs::path& path, Data&& data)
     }
     DeserializeDB(filein, data);
 }
+
+/** The journal is compacted into peers.dat once it is larger than peers.dat, or than this. */
+constexpr uint64_t MIN_PEERS_JOURNAL_COMPACT_SIZE{1 << 20};
+
+/** Serializes writes to peers.dat and its journal. */
+GlobalMutex g_peers_db_mutex;
+
+fs::path PeersJournalPath(const ArgsManager& args)
+{
+    return args.GetDataDirNet() / "peers_journal.dat";
+}
+
+uint64_t FileSizeOrZero(const fs::path& path)
+{
+    std::error_code ec;
+    const auto size{fs::file_size(path, ec)};
+    return ec ? 0 : size;
+}
+
+/**
+ * Append a batch of addrman changes to the journal. Every batch is framed with the network magic,
+ * its size and a checksum, so that a torn write at the end of the journal is detected when reading.
+ */
+bool AppendToJournal(const fs::path& path, const DataStream& batch)
+{
+    AutoFile file{fsbridge::fopen(path, "ab")};
+    if (file.IsNull()) {
+        LogError("%s: Failed to open file %s\n", __func__, fs::PathToString(path));
+        return false;
+    }
+    try {
+        HashedSourceWriter hashwriter{file};
+        hashwriter << Params().MessageStart();
+        WriteCompactSize(hashwriter, batch.size());
+        hashwriter << std::span<const std::byte>{batch};
+        file << hashwriter.GetHash();
+    } catch (const std::exception& e) {
+        LogError("%s: Serialize or I/O error - %s\n", __func__, e.what());
+        return false;
+    }
+    if (!file.Commit()) {
+        LogError("%s: Failed to flush file %s\n", __func__, fs::PathToString(path));
+        return false;
+    }
+    return file.fclose() == 0;
+}
+
+/**
+ * Read all batches from the journal.
+ * @param[out] complete  Whether the whole file was read, i.e. it does not end with a torn or corrupt batch.
+ */
+std::vector<DataStream> ReadJournal(const fs::path& path, bool& complete)
+{
+    std::vector<DataStream> batches;
+    complete = true;
+    const uint64_t size{FileSizeOrZero(path)};
+    AutoFile file{fsbridge::fopen(path, "rb")};
+    if (file.IsNull()) return batches;
+    try {
+        while (uint64_t(file.tell()) < size) {
+            HashVerifier verifier{file};
+            MessageStartChars magic;
+            verifier >> magic;
+            if (magic != Params().MessageStart()) {
+                throw std::runtime_error{"Invalid network magic number"};
+            }
+            DataStream batch{};
+            batch.resize(ReadCompactSize(verifier));
+            verifier.read(MakeWritableByteSpan(batch));
+            uint256 hash;
+            file >> hash;
+            if (hash != verifier.GetHash()) {
+                throw std::runtime_error{"Checksum mismatch, data corrupted"};
+            }
+            batches.push_back(std::move(batch));
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Ignoring the end of %s after %u batches of address changes (%s)\n", fs::quoted(fs::PathToString(path)), batches.size(), e.what());
+        complete = false;
+    }
+    return batches;
+}
 } // namespace
 
 CBanDB::CBanDB(fs::path ban_list_path)
@@ -177,10 +260,46 @@ bool CBanDB::Read(banmap_t& banSet)
     return true;
 }
 
-bool DumpPeerAddresses(const ArgsManager& args, const AddrMan& addr)
+bool DumpPeerAddresses(const ArgsManager& args, AddrMan& addr)
 {
+    LOCK(g_peers_db_mutex);
+
+    // Serialize to memory first, so that addrman is not locked while writing to disk. Changes
+    // made from the mark on go to the journal, which is started afresh below. If the write fails,
+    // all changes are still tracked and the journal is left as it is.
+    const uint64_t mark{addr.GetChangesMark()};
+    DataStream ssPeers{};
+    ssPeers << addr;
+
     const auto pathAddr = args.GetDataDirNet() / "peers.dat";
-    return SerializeFileDB("peers", pathAddr, addr);
+    if (!SerializeFileDB("peers", pathAddr, std::span<const std::byte>{ssPeers})) {
+        return false;
+    }
+    std::error_code ec;
+    fs::remove(PeersJournalPath(args), ec);
+    addr.ForgetChanges(mark);
+    return true;
+}
+
+bool FlushPeerAddresses(const ArgsManager& args, AddrMan& addr)
+{
+    {
+        LOCK(g_peers_db_mutex);
+        const auto path_journal{PeersJournalPath(args)};
+        const uint64_t max_journal_size{std::max(FileSizeOrZero(args.GetDataDirNet() / "peers.dat"), MIN_PEERS_JOURNAL_COMPACT_SIZE)};
+        if (FileSizeOrZero(path_journal) < max_journal_size) {
+            const uint64_t mark{addr.GetChangesMark()};
+            DataStream batch{};
+            const auto changed{addr.WriteChanges(batch)};
+            if (changed == 0u) return true;
+            // If appending fails, the changes are persisted by the full dump instead.
+            if (changed && AppendToJournal(path_journal, batch)) {
+                addr.ForgetChanges(mark);
+                return true;
+            }
+        }
+    }
+    return DumpPeerAddresses(args, addr);
 }
 
 void ReadFromStream(AddrMan& addr, DataStream& ssPeers)
@@ -197,9 +316,11 @@ util::Result<std::unique_ptr<AddrMan>> LoadAddrman(const NetGroupManager& netgro
 
     const auto start{SteadyClock::now()};
     const auto path_addr{args.GetDataDirNet() / "peers.dat"};
+    bool loaded{false};
     try {
         DeserializeFileDB(path_addr, *addrman);
         LogPrintf("Loaded %i addresses from peers.dat  %dms\n", addrman->Size(), Ticks<std::chrono::milliseconds>(SteadyClock::now() - start));
+        loaded = true;
     } catch (const DbNotFoundError&) {
         // Addrman can be in an inconsistent state after failure, reset it
         addrman = std::make_unique<AddrMan>(netgroupman, deterministic, /*consistency_check_ratio=*/check_addrman);
@@ -217,6 +338,32 @@ util::Result<std::unique_ptr<AddrMan>> LoadAddrman(const NetGroupManager& netgro
         return util::Error{strprintf(_("Invalid or corrupt peers.dat (%s). If you believe this is a bug, please report it to %s. As a workaround, you can move the file (%s) out of the way (rename, move, or delete) to have a new one created on the next start."),
                                      e.what(), CLIENT_BUGREPORT, fs::quoted(fs::PathToString(path_addr)))};
     }
+
+    // Apply the changes made since peers.dat was written.
+    const auto path_journal{PeersJournalPath(args)};
+    if (loaded && fs::exists(path_journal)) {
+        const auto journal_start{SteadyClock::now()};
+        bool complete;
+        std::vector<DataStream> batches{ReadJournal(path_journal, complete)};
+        try {
+            const size_t applied{addrman->ApplyChanges(batches)};
+            LogPrintf("Applied %i of %i batches of address changes from %s  %dms\n", applied, batches.size(),
+                      fs::quoted(fs::PathToString(path_journal.filename())), Ticks<std::chrono::milliseconds>(SteadyClock::now() - journal_start));
+            // Batches appended after unusable data would be ignored on the next start, so start
+            // a new journal right away.
+            if (!complete || applied < batches.size()) DumpPeerAddresses(args, *addrman);
+        } catch (const std::exception& e) {
+            LogPrintf("Ignoring invalid %s (%s)\n", fs::quoted(fs::PathToString(path_journal)), e.what());
+            // Addrman can be in an inconsistent state after failure, load peers.dat again
+            addrman = std::make_unique<AddrMan>(netgroupman, deterministic, /*consistency_check_ratio=*/check_addrman);
+            try {
+                DeserializeFileDB(path_addr, *addrman);
+            } catch (const std::exception&) {
+                addrman = std::make_unique<AddrMan>(netgroupman, deterministic, /*consistency_check_ratio=*/check_addrman);
+            }
+            DumpPeerAddresses(args, *addrman);
+        }
+    }
     return addrman;
 }
 
@@ -22,7 +22,18 @@ class NetGroupManager;
 /** Only used by tests. */
 void ReadFromStream(AddrMan& addr, DataStream& ssPeers);
 
-bool DumpPeerAddresses(const ArgsManager& args, const AddrMan& addr);
+/**
+ * Write the full address database (peers.dat) and drop the journal of changes (peers_journal.dat),
+ * which peers.dat includes from then on.
+ */
+bool DumpPeerAddresses(const ArgsManager& args, AddrMan& addr);
+
+/**
+ * Append the addresses that changed since the last dump to the journal (peers_journal.dat), which
+ * is applied on top of peers.dat when loading. Falls back to DumpPeerAddresses() once the journal
+ * grows larger than peers.dat, or when addrman lost track of its changes.
+ */
+bool FlushPeerAddresses(const ArgsManager& args, AddrMan& addr);
 
 /** Access to the banlist database (banlist.json) */
 class CBanDB
@@ -390,6 +390,10 @@ void AddrManImpl::Unserialize(Stream& s_)
         LogDebug(BCLog::ADDRMAN, "addrman lost %i new and %i tried addresses due to collisions or invalid addresses\n", nLostUnk, nLost);
     }
 
+    // Everything loaded so far is already persisted.
+    m_changed.clear();
+    m_changes_overflow = false;
+
     const int check_code{CheckAddrman()};
     if (check_code != 0) {
         throw std::ios_base::failure(strprintf(
@@ -420,6 +424,7 @@ AddrInfo* AddrManImpl::Create(const CAddress& addr, const CNetAddr& addrSource,
     nid_type nId = nIdCount++;
     mapInfo[nId] = AddrInfo(addr, addrSource);
     mapAddr[addr] = nId;
+    MarkChanged(addr);
     mapInfo[nId].nRandomPos = vRandom.size();
     vRandom.push_back(nId);
     nNew++;
@@ -465,6 +470,7 @@ void AddrManImpl::Delete(nid_type nId)
     SwapRandom(info.nRandomPos, vRandom.size() - 1);
     m_network_counts[info.GetNetwork()].n_new--;
     vRandom.pop_back();
+    MarkChanged(info);
     mapAddr.erase(info);
     mapInfo.erase(nId);
     nNew--;
@@ -481,6 +487,7 @@ void AddrManImpl::ClearNew(int nUBucket, int nUBucketPos)
         assert(infoDelete.nRefCount > 0);
         infoDelete.nRefCount--;
         vvNew[nUBucket][nUBucketPos] = -1;
+        MarkChanged(infoDelete);
         LogDebug(BCLog::ADDRMAN, "Removed %s from new[%i][%i]\n", infoDelete.ToStringAddrPort(), nUBucket, nUBucketPos);
         if (infoDelete.nRefCount == 0) {
             Delete(nIdDelete);
@@ -534,6 +541,7 @@ void AddrManImpl::MakeTried(AddrInfo& info, nid_type nId)
         // Enter it into the new set again.
         infoOld.nRefCount = 1;
         vvNew[nUBucket][nUBucketPos] = nIdEvict;
+        MarkChanged(infoOld);
         nNew++;
         m_network_counts[infoOld.GetNetwork()].n_new++;
         LogDebug(BCLog::ADDRMAN, "Moved %s from tried[%i][%i] to new[%i][%i] to make space\n",
@@ -544,6 +552,7 @@ void AddrManImpl::MakeTried(AddrInfo& info, nid_type nId)
     vvTried[nKBucket][nKBucketPos] = nId;
     nTried++;
     info.fInTried = true;
+    MarkChanged(info);
     m_network_counts[info.GetNetwork()].n_tried++;
 }
 
@@ -568,10 +577,14 @@ bool AddrManImpl::AddSingle(const CAddress& addr, const CNetAddr& source, std::c
         const auto update_interval{currently_online ? 1h : 24h};
         if (pinfo->nTime < addr.nTime - update_interval - time_penalty) {
             pinfo->nTime = std::max(NodeSeconds{0s}, addr.nTime - time_penalty);
+            MarkChanged(addr);
         }
 
         // add services
-        pinfo->nServices = ServiceFlags(pinfo->nServices | addr.nServices);
+        if ((pinfo->nServices | addr.nServices) != pinfo->nServices) {
+            pinfo->nServices = ServiceFlags(pinfo->nServices | addr.nServices);
+            MarkChanged(addr);
+        }
 
         // do not update if no new information is present
         if (addr.nTime <= pinfo->nTime) {
@@ -611,6 +624,7 @@ bool AddrManImpl::AddSingle(const CAddress& addr, const CNetAddr& source, std::c
             ClearNew(nUBucket, nUBucketPos);
             pinfo->nRefCount++;
             vvNew[nUBucket][nUBucketPos] = nId;
+            MarkChanged(addr);
             const auto mapped_as{m_netgroupman.GetMappedAS(addr)};
             LogDebug(BCLog::ADDRMAN, "Added %s%s to new[%i][%i]\n",
                      addr.ToStringAddrPort(), (mapped_as ? strprintf(" mapped to AS%i", mapped_as) : ""), nUBucket, nUBucketPos);
@@ -642,6 +656,7 @@ bool AddrManImpl::Good_(const CService& addr, bool test_before_evict, NodeSecond
     info.m_last_success = time;
     info.m_last_try = time;
     info.nAttempts = 0;
+    MarkChanged(addr);
     // nTime is not updated here, to avoid leaking information about
     // currently-connected peers.
 
@@ -707,6 +722,7 @@ void AddrManImpl::Attempt_(const CService& addr, bool fCountFailure, NodeSeconds
     if (fCountFailure && info.m_last_count_attempt < m_last_good) {
         info.m_last_count_attempt = time;
         info.nAttempts++;
+        MarkChanged(addr);
     }
 }
 
@@ -890,6 +906,7 @@ void AddrManImpl::Connected_(const CService& addr, NodeSeconds time)
     const auto update_interval{20min};
     if (time - info.nTime > update_interval) {
         info.nTime = time;
+        MarkChanged(addr);
     }
 }
 
@@ -907,6 +924,7 @@ void AddrManImpl::SetServices_(const CService& addr, ServiceFlags nServices)
 
     // update info
     info.nServices = nServices;
+    MarkChanged(addr);
 }
 
 void AddrManImpl::ResolveCollisions_()
@@ -1045,6 +1063,207 @@ size_t AddrManImpl::Size_(std::optional<Network> net, std::optional<bool> in_new
     return 0;
 }
 
+void AddrManImpl::MarkChanged(const CService& addr)
+{
+    AssertLockHeld(cs);
+
+    ++m_change_count;
+    if (m_changes_overflow) return;
+    m_changed.insert_or_assign(addr, m_change_count);
+    if (m_changed.size() > MAX_TRACKED_CHANGES) {
+        m_changed.clear();
+        m_changes_overflow = true;
+    }
+}
+
+std::optional<size_t> AddrManImpl::WriteChanges_(DataStream& s_)
+{
+    AssertLockHeld(cs);
+
+    if (m_changes_overflow) return std::nullopt;
+    if (m_changed.empty()) return 0;
+
+    /**
+     * Format of a batch of changes.
+     * * format version byte (@see CHANGES_FORMAT)
+     * * hash of nKey, so that batches are never applied to an addrman they were not written by
+     * * asmap checksum, as positions in the tables depend on it
+     * * number of records
+     * * for each changed entry, one record:
+     *   * CHANGE_DELETED and the address, or
+     *   * CHANGE_TRIED and the entry, or
+     *   * CHANGE_NEW, the entry and the new buckets it is in
+     *
+     * Positions within buckets are not encoded, they are derived from nKey when the batch is
+     * applied.
+     */
+    ParamsStream s{s_, CAddress::V2_DISK};
+    s << CHANGES_FORMAT;
+    s << (HashWriter{} << nKey).GetHash();
+    s << m_netgroupman.GetAsmapChecksum();
+    WriteCompactSize(s, m_changed.size());
+
+    // Collect the buckets of the changed new entries in a single pass over the new table,
+    // instead of computing a bucket position for every bucket of every entry.
+    std::unordered_map<nid_type, std::vector<uint16_t>> new_buckets;
+    for (const auto& [addr, _] : m_changed) {
+        if (const auto it{mapAddr.find(addr)}; it != mapAddr.end() && !mapInfo[it->second].fInTried) {
+            new_buckets[it->second];
+        }
+    }
+    if (!new_buckets.empty()) {
+        for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; ++bucket) {
+            for (int i = 0; i < ADDRMAN_BUCKET_SIZE; ++i) {
+                if (const auto it{new_buckets.find(vvNew[bucket][i])}; it != new_buckets.end()) {
+                    it->second.push_back(bucket);
+                }
+            }
+        }
+    }
+
+    for (const auto& [addr, _] : m_changed) {
+        nid_type nId;
+        const AddrInfo* pinfo{Find(addr, &nId)};
+        if (!pinfo) {
+            s << uint8_t{CHANGE_DELETED} << addr;
+        } else if (pinfo->fInTried) {
+            s << uint8_t{CHANGE_TRIED} << *pinfo;
+        } else {
+            s << uint8_t{CHANGE_NEW} << *pinfo << new_buckets[nId];
+        }
+    }
+
+    return m_changed.size();
+}
+
+size_t AddrManImpl::ApplyChanges_(std::vector<DataStream>& batches)
+{
+    AssertLockHeld(cs);
+
+    struct Change {
+        CService addr;
+        std::optional<AddrInfo> info;
+        bool tried{false};
+        std::vector<uint16_t> buckets;
+    };
+
+    const uint256 key_hash{(HashWriter{} << nKey).GetHash()};
+    size_t applied{0};
+    for (DataStream& batch : batches) {
+        // Parse the whole batch first, so that a corrupt one is not applied partially.
+        std::vector<Change> changes;
+        try {
+            ParamsStream s{batch, CAddress::V2_DISK};
+            uint8_t format;
+            uint256 batch_key_hash, asmap_checksum;
+            s >> format;
+            if (format != CHANGES_FORMAT) break;
+            s >> batch_key_hash >> asmap_checksum;
+            if (batch_key_hash != key_hash || asmap_checksum != m_netgroupman.GetAsmapChecksum()) break;
+            const uint64_t count{ReadCompactSize(s)};
+            for (uint64_t i = 0; i < count; ++i) {
+                Change& change{changes.emplace_back()};
+                uint8_t type;
+                s >> type;
+                if (type == CHANGE_DELETED) {
+                    s >> change.addr;
+                } else if (type == CHANGE_NEW || type == CHANGE_TRIED) {
+                    AddrInfo& info{change.info.emplace()};
+                    s >> info;
+                    if (type == CHANGE_NEW) s >> change.buckets;
+                    change.addr = info;
+                    change.tried = type == CHANGE_TRIED;
+                } else {
+                    throw std::ios_base::failure(strprintf("Unknown addrman change record type %u", type));
+                }
+            }
+        } catch (const std::ios_base::failure& e) {
+            LogDebug(BCLog::ADDRMAN, "Stop applying addrman changes at batch %u: %s\n", applied, e.what());
+            break;
+        }
+
+        // Remove every entry the batch mentions from the tables first, so that their old places
+        // are free for the changed entries they may have been taken by...
+        for (const Change& change : changes) {
+            if (const auto it{mapAddr.find(change.addr)}; it != mapAddr.end()) RemoveEntry(it->second);
+        }
+
+        // ... and put the ones that still exist back at their recorded places.
+        for (Change& change : changes) {
+            if (!change.info || !change.info->IsValid() || mapAddr.count(change.addr)) continue;
+            AddrInfo& info{*change.info};
+            info.fInTried = false;
+            info.nRefCount = 0;
+            const nid_type nId{nIdCount++};
+            std::vector<std::pair<int, int>> new_positions;
+            if (change.tried) {
+                const int bucket{info.GetTriedBucket(nKey, m_netgroupman)};
+                const int pos{info.GetBucketPosition(nKey, false, bucket)};
+                if (vvTried[bucket][pos] != -1) continue;
+                vvTried[bucket][pos] = nId;
+                info.fInTried = true;
+            } else {
+                for (const uint16_t bucket : change.buckets) {
+                    if (bucket >= ADDRMAN_NEW_BUCKET_COUNT || info.nRefCount == ADDRMAN_NEW_BUCKETS_PER_ADDRESS) continue;
+                    const int pos{info.GetBucketPosition(nKey, true, bucket)};
+                    if (vvNew[bucket][pos] != -1) continue;
+                    vvNew[bucket][pos] = nId;
+                    ++info.nRefCount;
+                }
+                if (info.nRefCount == 0) continue;
+            }
+            info.nRandomPos = vRandom.size();
+            vRandom.push_back(nId);
+            if (info.fInTried) {
+                ++nTried;
+                m_network_counts[info.GetNetwork()].n_tried++;
+            } else {
+                ++nNew;
+                m_network_counts[info.GetNetwork()].n_new++;
+            }
+            mapAddr[info] = nId;
+            mapInfo.emplace(nId, std::move(info));
+        }
+        ++applied;
+    }
+
+    // Applying the batches only restores state that was persisted already.
+    m_changed.clear();
+    return applied;
+}
+
+void AddrManImpl::RemoveEntry(nid_type nId)
+{
+    AssertLockHeld(cs);
+
+    AddrInfo& info{mapInfo[nId]};
+    if (info.fInTried) {
+        const int bucket{info.GetTriedBucket(nKey, m_netgroupman)};
+        const int pos{info.GetBucketPosition(nKey, false, bucket)};
+        if (vvTried[bucket][pos] == nId) vvTried[bucket][pos] = -1;
+        nTried--;
+        m_network_counts[info.GetNetwork()].n_tried--;
+    } else {
+        // Like in MakeTried(), start at the bucket the entry was most likely added to.
+        const int start_bucket{info.GetNewBucket(nKey, m_netgroupman)};
+        for (int n = 0; n < ADDRMAN_NEW_BUCKET_COUNT && info.nRefCount > 0; ++n) {
+            const int bucket{(start_bucket + n) % ADDRMAN_NEW_BUCKET_COUNT};
+            const int pos{info.GetBucketPosition(nKey, true, bucket)};
+            if (vvNew[bucket][pos] == nId) {
+                vvNew[bucket][pos] = -1;
+                info.nRefCount--;
+            }
+        }
+        nNew--;
+        m_network_counts[info.GetNetwork()].n_new--;
+    }
+    m_tried_collisions.erase(nId);
+    SwapRandom(info.nRandomPos, vRandom.size() - 1);
+    vRandom.pop_back();
+    mapAddr.erase(info);
+    mapInfo.erase(nId);
+}
+
 void AddrManImpl::Check() const
 {
     AssertLockHeld(cs);
@@ -1269,6 +1488,38 @@ std::optional<AddressPosition> AddrManImpl::FindAddressEntry(const CAddress& add
     return entry;
 }
 
+std::optional<size_t> AddrManImpl::WriteChanges(DataStream& s)
+{
+    LOCK(cs);
+    Check();
+    auto ret = WriteChanges_(s);
+    Check();
+    return ret;
+}
+
+size_t AddrManImpl::ApplyChanges(std::vector<DataStream>& batches)
+{
+    LOCK(cs);
+    Check();
+    auto ret = ApplyChanges_(batches);
+    Check();
+    return ret;
+}
+
+uint64_t AddrManImpl::GetChangesMark()
+{
+    LOCK(cs);
+    return m_change_count;
+}
+
+void AddrManImpl::ForgetChanges(uint64_t mark)
+{
+    LOCK(cs);
+    std::erase_if(m_changed, [&](const auto& entry) { return entry.second <= mark; });
+    // Untracked changes made after the mark still need a full serialization.
+    if (m_change_count <= mark) m_changes_overflow = false;
+}
+
 AddrMan::AddrMan(const NetGroupManager& netgroupman, bool deterministic, int32_t consistency_check_ratio)
     : m_impl(std::make_unique<AddrManImpl>(netgroupman, deterministic, consistency_check_ratio)) {}
 
@@ -1353,3 +1604,23 @@ std::optional<AddressPosition> AddrMan::FindAddressEntry(const CAddress& addr)
 {
     return m_impl->FindAddressEntry(addr);
 }
+
+std::optional<size_t> AddrMan::WriteChanges(DataStream& s)
+{
+    return m_impl->WriteChanges(s);
+}
+
+size_t AddrMan::ApplyChanges(std::vector<DataStream>& batches)
+{
+    return m_impl->ApplyChanges(batches);
+}
+
+uint64_t AddrMan::GetChangesMark()
+{
+    return m_impl->GetChangesMark();
+}
+
+void AddrMan::ForgetChanges(uint64_t mark)
+{
+    m_impl->ForgetChanges(mark);
+}
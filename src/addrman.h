@@ -209,6 +209,32 @@ public:
      *                       or nullopt if address is not found.
      */
     std::optional<AddressPosition> FindAddressEntry(const CAddress& addr);
+
+    /**
+     * Write the entries that changed since the last ForgetChanges() as one batch, to be applied on
+     * top of a full serialization with ApplyChanges(). The changes are still tracked afterwards.
+     *
+     * @param[out] s   The stream to write the batch to.
+     * @return         The number of changed entries written, or std::nullopt if too many entries
+     *                 changed to keep track of them and only a full serialization persists them.
+     */
+    std::optional<size_t> WriteChanges(DataStream& s);
+
+    /**
+     * Apply batches written by WriteChanges(), in order, after unserializing. Application stops at
+     * the first batch that is corrupt or was written for a different key or asmap.
+     *
+     * @param[in] batches   The batches to apply.
+     * @return              The number of batches applied.
+     */
+    size_t ApplyChanges(std::vector<DataStream>& batches);
+
+    //! Mark to pass to ForgetChanges(), taken before writing a batch or a full serialization.
+    uint64_t GetChangesMark();
+
+    //! Forget about the changes made up to the mark, once a batch or full serialization written
+    //! after taking it has been persisted.
+    void ForgetChanges(uint64_t mark);
 };
 
 #endif // QTC_ADDRMAN_H
@@ -150,6 +150,14 @@ public:
     std::optional<AddressPosition> FindAddressEntry(const CAddress& addr)
         EXCLUSIVE_LOCKS_REQUIRED(!cs);
 
+    std::optional<size_t> WriteChanges(DataStream& s) EXCLUSIVE_LOCKS_REQUIRED(!cs);
+
+    size_t ApplyChanges(std::vector<DataStream>& batches) EXCLUSIVE_LOCKS_REQUIRED(!cs);
+
+    uint64_t GetChangesMark() EXCLUSIVE_LOCKS_REQUIRED(!cs);
+
+    void ForgetChanges(uint64_t mark) EXCLUSIVE_LOCKS_REQUIRED(!cs);
+
     friend class AddrManDeterministic;
 
 private:
@@ -185,6 +193,19 @@ private:
     //! @note Don't increment this. Increment `lowest_compatible` in `Serialize()` instead.
     static constexpr uint8_t INCOMPATIBILITY_BASE = 32;
 
+    //! Format of the batches written by WriteChanges(). Batches in any other format are not applied.
+    static constexpr uint8_t CHANGES_FORMAT{1};
+
+    //! Kinds of records in a batch of changes.
+    enum ChangeRecord : uint8_t {
+        CHANGE_DELETED = 0, //!< the entry is no longer in addrman
+        CHANGE_NEW = 1,     //!< the entry is in the new table, followed by the buckets it is in
+        CHANGE_TRIED = 2,   //!< the entry is in the tried table
+    };
+
+    //! How many changed entries are tracked before giving up and requiring a full serialization.
+    static constexpr size_t MAX_TRACKED_CHANGES{ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE};
+
     //! last used nId
     nid_type nIdCount GUARDED_BY(cs){0};
 
@@ -231,6 +252,16 @@ private:
     /** Number of entries in addrman per network and new/tried table. */
     std::unordered_map<Network, NewTriedCount> m_network_counts GUARDED_BY(cs);
 
+    //! Number of changes made so far, see GetChangesMark().
+    uint64_t m_change_count GUARDED_BY(cs){0};
+
+    //! Entries whose serialized state changed (including ones that were removed) and have not been
+    //! forgotten by ForgetChanges() yet, with the value of m_change_count after their latest change.
+    std::unordered_map<CService, uint64_t, CServiceHash> m_changed GUARDED_BY(cs);
+
+    //! Whether more than MAX_TRACKED_CHANGES entries changed, so that m_changed is incomplete.
+    bool m_changes_overflow GUARDED_BY(cs){false};
+
     //! Find an entry.
     AddrInfo* Find(const CService& addr, nid_type* pnId = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -283,6 +314,16 @@ private:
 
     size_t Size_(std::optional<Network> net, std::optional<bool> in_new) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    //! Remember that an entry has to be included in the next batch of changes.
+    void MarkChanged(const CService& addr) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    std::optional<size_t> WriteChanges_(DataStream& s) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    size_t ApplyChanges_(std::vector<DataStream>& batches) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! Remove an entry from the tables and indexes without tracking it as changed, wherever it is.
+    void RemoveEntry(nid_type nId) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     //! Consistency check, taking into account m_consistency_check_ratio.
     //! Will std::abort if an inconsistency is detected.
     void Check() const EXCLUSIVE_LOCKS_REQUIRED(cs);
@@ -0,0 +1,74 @@
+// Copyright (c) 2026-present The QTC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <addresstype.h>
+#include <bench/bench.h>
+#include <coins.h>
+#include <consensus/amount.h>
+#include <kernel/cs_main.h>
+#include <node/blockstorage.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <sync.h>
+#include <test/util/setup_common.h>
+#include <validation.h>
+
+#include <cassert>
+#include <vector>
+
+static constexpr int NUM_BLOCKS{10};
+static constexpr int TXS_PER_BLOCK{10};
+static constexpr int INPUTS_PER_TX{20};
+
+/*
+ * Connects NUM_BLOCKS blocks whose transactions spend many outputs paying to
+ * the same script, and measures disconnecting all of them into a cache on
+ * top of the tip, as during a reorg. Block data is read beforehand, so this
+ * covers reading the undo data and restoring the spent coins.
+ */
+static void DisconnectBlocks(benchmark::Bench& bench)
+{
+    const auto test_setup{MakeNoLogFileContext<TestChain100Setup>()};
+    Chainstate& chainstate{test_setup->m_node.chainman->ActiveChainstate()};
+    const std::vector<CKey> keys{test_setup->coinbaseKey};
+    const CScript script{GetScriptForDestination(WitnessV0KeyHash{test_setup->coinbaseKey.GetPubKey()})};
+
+    // Split a coinbase into all the outputs spent by the blocks below.
+    constexpr int num_outputs{NUM_BLOCKS * TXS_PER_BLOCK * INPUTS_PER_TX};
+    const CTransactionRef& coinbase{test_setup->m_coinbase_txns[0]};
+    const std::vector<CTxOut> split_outputs(num_outputs, CTxOut{coinbase->vout[0].nValue / (num_outputs + 1), script});
+    const auto [split, _]{test_setup->CreateValidTransaction(
+        {coinbase}, {COutPoint{coinbase->GetHash(), 0}}, /*input_height=*/1, keys, split_outputs, {}, {})};
+    test_setup->CreateAndProcessBlock({split}, script, &chainstate);
+    const CTransactionRef split_tx{MakeTransactionRef(split)};
+    const int split_height{WITH_LOCK(cs_main, return chainstate.m_chain.Height())};
+
+    std::vector<CBlock> blocks;
+    for (int b{0}; b < NUM_BLOCKS; ++b) {
+        std::vector<CMutableTransaction> txs;
+        for (int t{0}; t < TXS_PER_BLOCK; ++t) {
+            std::vector<COutPoint> inputs;
+            for (int i{0}; i < INPUTS_PER_TX; ++i) {
+                inputs.emplace_back(split_tx->GetHash(), (b * TXS_PER_BLOCK + t) * INPUTS_PER_TX + i);
+            }
+            const CAmount amount{split_outputs[0].nValue * (INPUTS_PER_TX - 1)};
+            txs.push_back(test_setup->CreateValidTransaction(
+                {split_tx}, inputs, split_height, keys, {CTxOut{amount, script}}, {}, {}).first);
+        }
+        blocks.push_back(test_setup->CreateAndProcessBlock(txs, script, &chainstate));
+    }
+
+    bench.unit("block").batch(NUM_BLOCKS).run([&] {
+        LOCK(cs_main);
+        CCoinsViewCache view{&chainstate.CoinsTip()};
+        const CBlockIndex* pindex{chainstate.m_chain.Tip()};
+        for (auto block{blocks.rbegin()}; block != blocks.rend(); ++block) {
+            assert(chainstate.DisconnectBlock(*block, pindex, view) == DISCONNECT_OK);
+            pindex = pindex->pprev;
+        }
+    });
+}
+
+BENCHMARK(DisconnectBlocks, benchmark::PriorityLevel::HIGH);
@@ -17,15 +17,34 @@
 
 #include <unordered_map>
 
-CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, const uint64_t nonce) :
-        nonce(nonce),
-        shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block) {
+CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, const uint64_t nonce, const CTxMemPool* pool) :
+        nonce(nonce), header(block) {
     FillShortTxIDSelector();
-    //TODO: Use our mempool prior to block acceptance to predictively fill more than just the coinbase
-    prefilledtxn[0] = {0, block.vtx[0]};
+    // The coinbase is always missing at the receiver. Transactions we didn't have in our own mempool
+    // before the block arrived are likely missing there too, so prefill those while they fit the budget.
+    std::vector<bool> predicted_missing(block.vtx.size());
+    if (pool) {
+        LOCK(pool->cs);
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            predicted_missing[i] = !pool->exists(GenTxid::Wtxid(block.vtx[i]->GetWitnessHash()));
+        }
+    }
+    prefilledtxn.push_back({0, block.vtx[0]});
+    shorttxids.reserve(block.vtx.size() - 1);
+    size_t prefilled_bytes{0};
+    size_t last_prefilled{0};
     for (size_t i = 1; i < block.vtx.size(); i++) {
         const CTransaction& tx = *block.vtx[i];
-        shorttxids[i - 1] = GetShortID(tx.GetWitnessHash());
+        if (predicted_missing[i]) {
+            const size_t tx_size{tx.GetTotalSize()};
+            if (prefilled_bytes + tx_size <= MAX_PREDICTED_PREFILL_BYTES) {
+                prefilled_bytes += tx_size;
+                prefilledtxn.push_back({static_cast<uint16_t>(i - last_prefilled - 1), block.vtx[i]});
+                last_prefilled = i;
+                continue;
+            }
+        }
+        shorttxids.push_back(GetShortID(tx.GetWitnessHash()));
     }
 }
 
@@ -45,6 +64,14 @@ uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const Wtxid& wtxid) const {
     return SipHashUint256(shorttxidk0, shorttxidk1, wtxid) & 0xffffffffffffL;
 }
 
+void PartiallyDownloadedBlock::ComputeShortIDs(const CBlockHeaderAndShortTxIDs& cmpctblock, std::span<const Wtxid> wtxids, std::vector<uint64_t>& shortids)
+{
+    shortids.resize(wtxids.size());
+    for (size_t i = 0; i < wtxids.size(); i++) {
+        shortids[i] = cmpctblock.GetShortID(wtxids[i]);
+    }
+}
+
 ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<CTransactionRef>& extra_txn) {
     LogDebug(BCLog::CMPCTBLOCK, "Initializing PartiallyDownloadedBlock for block %s using a cmpctblock of %u bytes\n", cmpctblock.header.GetHash().ToString(), GetSerializeSize(cmpctblock));
     if (cmpctblock.header.IsNull() || (cmpctblock.shorttxids.empty() && cmpctblock.prefilledtxn.empty()))
@@ -106,12 +133,15 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     std::vector<bool> have_txn(txn_available.size());
     {
     LOCK(pool->cs);
-    for (const auto& tx : pool->txns_randomized) {
-        uint64_t shortid = cmpctblock.GetShortID(tx->GetWitnessHash());
-        std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
+    // Short IDs are keyed per block, so they can't be cached in the mempool. Hash the mempool's flat
+    // witness hash index instead, and only touch the transactions that match.
+    std::vector<uint64_t> pool_shortids;
+    ComputeShortIDs(cmpctblock, pool->wtxids_randomized, pool_shortids);
+    for (size_t i = 0; i < pool_shortids.size(); i++) {
+        std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(pool_shortids[i]);
         if (idit != shorttxids.end()) {
             if (!have_txn[idit->second]) {
-                txn_available[idit->second] = tx;
+                txn_available[idit->second] = pool->txns_randomized[i];
                 have_txn[idit->second]  = true;
                 mempool_count++;
             } else {
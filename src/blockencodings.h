@@ -8,6 +8,7 @@
 #include <primitives/block.h>
 
 #include <functional>
+#include <span>
 
 class CTxMemPool;
 class BlockValidationState;
@@ -103,6 +104,10 @@ protected:
 
 public:
     static constexpr int SHORTTXIDS_LENGTH = 6;
+    //! Upper bound on the serialized size of transactions prefilled because we predict the receiver lacks them.
+    //! PQ transactions are several KB each, so this trades a few extra bytes per high-bandwidth peer
+    //! against a getblocktxn round-trip.
+    static constexpr size_t MAX_PREDICTED_PREFILL_BYTES = 100000;
 
     CBlockHeader header;
 
@@ -113,8 +118,12 @@ public:
 
     /**
      * @param[in]  nonce  This should be randomly generated, and is used for the siphash secret key
+     * @param[in]  pool   If provided, transactions missing from this mempool are predicted to be missing
+     *                    at the receiver as well and are prefilled, up to MAX_PREDICTED_PREFILL_BYTES.
+     *                    Only useful before the block is connected, while its transactions are still
+     *                    in the mempool.
      */
-    CBlockHeaderAndShortTxIDs(const CBlock& block, const uint64_t nonce);
+    CBlockHeaderAndShortTxIDs(const CBlock& block, const uint64_t nonce, const CTxMemPool* pool = nullptr);
 
     uint64_t GetShortID(const Wtxid& wtxid) const;
 
@@ -137,6 +146,9 @@ protected:
     std::vector<CTransactionRef> txn_available;
     size_t prefilled_count = 0, mempool_count = 0, extra_count = 0;
     const CTxMemPool* pool;
+
+    //! Compute the short IDs of wtxids under cmpctblock's key.
+    static void ComputeShortIDs(const CBlockHeaderAndShortTxIDs& cmpctblock, std::span<const Wtxid> wtxids, std::vector<uint64_t>& shortids);
 public:
     CBlockHeader header;
 
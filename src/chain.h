@@ -130,6 +130,8 @@ enum BlockStatus : uint32_t {
 
     BLOCK_STATUS_RESERVED    =   256, //!< Unused flag that was previously set on assumeutxo snapshot blocks and their
                                       //!< ancestors before they were validated, and unset when they were validated.
+
+    BLOCK_UNDO_COLUMNAR      =   512, //!< undo data in rev*.dat is stored as CBlockUndoColumns rather than CBlockUndo
 };
 
 /** The block chain is a tree shaped structure starting with the
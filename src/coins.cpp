@@ -9,6 +9,12 @@
 #include <random.h>
 #include <util/trace.h>
 
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
 TRACEPOINT_SEMAPHORE(utxocache, add);
 TRACEPOINT_SEMAPHORE(utxocache, spent);
 TRACEPOINT_SEMAPHORE(utxocache, uncache);
@@ -34,31 +40,144 @@ bool CCoinsViewBacked::BatchWrite(CoinsViewCacheCursor& cursor, const uint256 &h
 std::unique_ptr<CCoinsViewCursor> CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
+CCoinsMap::~CCoinsMap()
+{
+    if (!m_ctrl) return;
+    DestroyEntries();
+    ::operator delete(m_ctrl, std::align_val_t{ALLOC_ALIGNMENT});
+}
+
+void CCoinsMap::DestroyEntries() noexcept
+{
+    if (m_size == 0) return;
+    for (size_t i{0}; i < m_capacity; ++i) {
+        if (m_ctrl[i] >= 0) m_slots[i].~CoinsCachePair();
+    }
+}
+
+void CCoinsMap::clear() noexcept
+{
+    if (!m_ctrl) return;
+    DestroyEntries();
+    std::memset(m_ctrl, CTRL_EMPTY, m_capacity);
+    m_size = 0;
+    m_growth_left = CapacityToGrowth(m_capacity);
+    m_flagged.clear();
+}
+
+void CCoinsMap::reserve(size_t count)
+{
+    if (count <= m_size + m_growth_left) return;
+    size_t capacity{std::max(RoundUpToGroup(count + count / 7), MIN_CAPACITY)};
+    while (CapacityToGrowth(capacity) < count) capacity += GROUP_WIDTH;
+    Rehash(std::max(capacity, m_capacity));
+}
+
+void CCoinsMap::SetMaxMemory(size_t bytes) noexcept
+{
+    if (bytes == 0) {
+        m_max_capacity = 0;
+        return;
+    }
+    // One control byte and one slot per entry.
+    m_max_capacity = std::max((bytes / (1 + sizeof(CoinsCachePair))) & ~(GROUP_WIDTH - 1), MIN_CAPACITY);
+}
+
+void CCoinsMap::Grow()
+{
+    if (m_capacity && m_size <= CapacityToGrowth(m_capacity) / 2) {
+        // Most of the used-up growth is tombstones; reclaim them without growing.
+        Rehash(m_capacity);
+        return;
+    }
+    size_t capacity{std::max(RoundUpToGroup(m_capacity + m_capacity / 2), MIN_CAPACITY)};
+    // Only go past the budget once the table is full at that size. The cache is flushed soon after.
+    if (m_max_capacity > m_capacity) capacity = std::min(capacity, m_max_capacity);
+    Rehash(capacity);
+}
+
+void CCoinsMap::Allocate(size_t capacity)
+{
+    assert(capacity >= MIN_CAPACITY && capacity % GROUP_WIDTH == 0);
+    assert(capacity <= std::numeric_limits<uint32_t>::max());
+    auto* const mem{static_cast<std::byte*>(::operator new(AllocSize(capacity), std::align_val_t{ALLOC_ALIGNMENT}))};
+    m_ctrl = reinterpret_cast<ctrl_t*>(mem);
+    m_slots = reinterpret_cast<CoinsCachePair*>(mem + SlotsOffset(capacity));
+    m_capacity = capacity;
+    std::memset(m_ctrl, CTRL_EMPTY, capacity);
+    m_ctrl[capacity] = CTRL_SENTINEL;
+    m_growth_left = CapacityToGrowth(capacity) - m_size;
+}
+
+void CCoinsMap::Rehash(size_t new_capacity)
+{
+    ctrl_t* const old_ctrl{m_ctrl};
+    CoinsCachePair* const old_slots{m_slots};
+    const size_t old_capacity{m_capacity};
+    Allocate(new_capacity);
+    for (size_t i{0}; i < old_capacity; ++i) {
+        if (old_ctrl[i] < 0) continue;
+        CoinsCachePair& old_pair{old_slots[i]};
+        const size_t hash{m_hasher(old_pair.first)};
+        const size_t idx{FindInsertIndex(hash)};
+        CoinsCachePair& pair{*::new (static_cast<void*>(m_slots + idx)) CoinsCachePair(std::move(old_pair))};
+        old_pair.~CoinsCachePair();
+        m_ctrl[idx] = H2(hash);
+        if (pair.second.m_flags) m_flagged[pair.second.m_flagged_pos] = idx;
+    }
+    if (old_ctrl) ::operator delete(old_ctrl, std::align_val_t{ALLOC_ALIGNMENT});
+}
+
+void CCoinsMap::SanityCheck() const
+{
+    size_t count_full{0};
+    size_t count_empty{0};
+    for (size_t i{0}; i < m_capacity; ++i) {
+        if (m_ctrl[i] >= 0) {
+            // Each entry must be reachable through its own probe sequence.
+            assert(FindIndex(m_slots[i].first, m_hasher(m_slots[i].first)) == i);
+            assert(m_ctrl[i] == H2(m_hasher(m_slots[i].first)));
+            const CCoinsCacheEntry& entry{m_slots[i].second};
+            if (entry.m_flags) assert(entry.m_flagged_pos < m_flagged.size() && m_flagged[entry.m_flagged_pos] == i);
+            ++count_full;
+        } else if (m_ctrl[i] == CTRL_EMPTY) {
+            ++count_empty;
+        } else {
+            assert(m_ctrl[i] == CTRL_DELETED);
+        }
+    }
+    assert(m_capacity == 0 || m_ctrl[m_capacity] == CTRL_SENTINEL);
+    assert(count_full == m_size);
+    assert(m_capacity - count_empty <= CapacityToGrowth(m_capacity));
+    assert(m_growth_left == CapacityToGrowth(m_capacity) - (m_capacity - count_empty));
+    for (size_t pos{0}; pos < m_flagged.size(); ++pos) {
+        const uint32_t idx{m_flagged[pos]};
+        assert(idx < m_capacity && m_ctrl[idx] >= 0);
+        assert(m_slots[idx].second.m_flags && m_slots[idx].second.m_flagged_pos == pos);
+    }
+}
+
 CCoinsViewCache::CCoinsViewCache(CCoinsView* baseIn, bool deterministic) :
     CCoinsViewBacked(baseIn), m_deterministic(deterministic),
-    cacheCoins(0, SaltedOutpointHasher(/*deterministic=*/deterministic), CCoinsMap::key_equal{}, &m_cache_coins_memory_resource)
+    cacheCoins(SaltedOutpointHasher(/*deterministic=*/deterministic))
 {
-    m_sentinel.second.SelfRef(m_sentinel);
 }
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
-    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
+    return cacheCoins.DynamicMemoryUsage() + cachedCoinsUsage;
 }
 
 CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
-    const auto [ret, inserted] = cacheCoins.try_emplace(outpoint);
-    if (inserted) {
-        if (auto coin{base->GetCoin(outpoint)}) {
-            ret->second.coin = std::move(*coin);
-            cachedCoinsUsage += ret->second.coin.DynamicMemoryUsage();
-            if (ret->second.coin.IsSpent()) { // TODO GetCoin cannot return spent coins
-                // The parent only has an empty entry for this outpoint; we can consider our version as fresh.
-                CCoinsCacheEntry::SetFresh(*ret, m_sentinel);
-            }
-        } else {
-            cacheCoins.erase(ret);
-            return cacheCoins.end();
-        }
+    if (auto it{cacheCoins.find(outpoint)}; it != cacheCoins.end()) return it;
+    // Only insert once the parent returned a coin, so that misses do not leave
+    // tombstones behind in the map.
+    auto coin{base->GetCoin(outpoint)};
+    if (!coin) return cacheCoins.end();
+    const auto ret{cacheCoins.try_emplace(outpoint, std::move(*coin)).first};
+    cachedCoinsUsage += ret->second.coin.DynamicMemoryUsage();
+    if (ret->second.coin.IsSpent()) { // TODO GetCoin cannot return spent coins
+        // The parent only has an empty entry for this outpoint; we can consider our version as fresh.
+        cacheCoins.SetFresh(*ret);
     }
     return ret;
 }
@@ -72,9 +191,7 @@ std::optional<Coin> CCoinsViewCache::GetCoin(const COutPoint& outpoint) const
 void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possible_overwrite) {
     assert(!coin.IsSpent());
     if (coin.out.scriptPubKey.IsUnspendable()) return;
-    CCoinsMap::iterator it;
-    bool inserted;
-    std::tie(it, inserted) = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::tuple<>());
+    auto [it, inserted] = cacheCoins.try_emplace(outpoint);
     bool fresh = false;
     if (!inserted) {
         cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
@@ -99,8 +216,8 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
         fresh = !it->second.IsDirty();
     }
     it->second.coin = std::move(coin);
-    CCoinsCacheEntry::SetDirty(*it, m_sentinel);
-    if (fresh) CCoinsCacheEntry::SetFresh(*it, m_sentinel);
+    cacheCoins.SetDirty(*it);
+    if (fresh) cacheCoins.SetFresh(*it);
     cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
     TRACEPOINT(utxocache, add,
            outpoint.hash.data(),
@@ -113,7 +230,14 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
 void CCoinsViewCache::EmplaceCoinInternalDANGER(COutPoint&& outpoint, Coin&& coin) {
     cachedCoinsUsage += coin.DynamicMemoryUsage();
     auto [it, inserted] = cacheCoins.try_emplace(std::move(outpoint), std::move(coin));
-    if (inserted) CCoinsCacheEntry::SetDirty(*it, m_sentinel);
+    if (inserted) cacheCoins.SetDirty(*it);
+}
+
+void CCoinsViewCache::CacheFetchedCoin(const COutPoint& outpoint, Coin&& coin)
+{
+    assert(!coin.IsSpent());
+    const auto [it, inserted]{cacheCoins.try_emplace(outpoint, std::move(coin))};
+    if (inserted) cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
 }
 
 void AddCoins(CCoinsViewCache& cache, const CTransaction &tx, int nHeight, bool check_for_overwrite) {
@@ -143,7 +267,7 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
     if (it->second.IsFresh()) {
         cacheCoins.erase(it);
     } else {
-        CCoinsCacheEntry::SetDirty(*it, m_sentinel);
+        cacheCoins.SetDirty(*it);
         it->second.coin.Clear();
     }
     return true;
@@ -180,75 +304,88 @@ void CCoinsViewCache::SetBestBlock(const uint256 &hashBlockIn) {
     hashBlock = hashBlockIn;
 }
 
+/**
+ * Apply a dirty entry of a child cache to the map of its parent cache.
+ *
+ * @param[in] will_erase  Whether the child entry is erased afterwards, so its coin can be moved.
+ * @returns whether an entry of the parent map was removed.
+ */
+static bool WriteChildEntry(CCoinsMap& map, size_t& usage, CoinsCachePair& child, bool will_erase)
+{
+    CCoinsMap::iterator itUs = map.find(child.first);
+    if (itUs == map.end()) {
+        // The parent cache does not have an entry, while the child cache does.
+        // We can ignore it if it's both spent and FRESH in the child
+        if (!(child.second.IsFresh() && child.second.coin.IsSpent())) {
+            // Create the coin in the parent cache, move the data up
+            // and mark it as dirty.
+            itUs = map.try_emplace(child.first).first;
+            CCoinsCacheEntry& entry{itUs->second};
+            if (will_erase) {
+                // Since this entry will be erased,
+                // we can move the coin into us instead of copying it
+                entry.coin = std::move(child.second.coin);
+            } else {
+                entry.coin = child.second.coin;
+            }
+            usage += entry.coin.DynamicMemoryUsage();
+            map.SetDirty(*itUs);
+            // We can mark it FRESH in the parent if it was FRESH in the child
+            // Otherwise it might have just been flushed from the parent's cache
+            // and already exist in the grandparent
+            if (child.second.IsFresh()) map.SetFresh(*itUs);
+        }
+    } else {
+        // Found the entry in the parent cache
+        if (child.second.IsFresh() && !itUs->second.coin.IsSpent()) {
+            // The coin was marked FRESH in the child cache, but the coin
+            // exists in the parent cache. If this ever happens, it means
+            // the FRESH flag was misapplied and there is a logic error in
+            // the calling code.
+            throw std::logic_error("FRESH flag misapplied to coin that exists in parent cache");
+        }
+
+        if (itUs->second.IsFresh() && child.second.coin.IsSpent()) {
+            // The grandparent cache does not have an entry, and the coin
+            // has been spent. We can just delete it from the parent cache.
+            usage -= itUs->second.coin.DynamicMemoryUsage();
+            map.erase(itUs);
+            return true;
+        } else {
+            // A normal modification.
+            usage -= itUs->second.coin.DynamicMemoryUsage();
+            if (will_erase) {
+                // Since this entry will be erased,
+                // we can move the coin into us instead of copying it
+                itUs->second.coin = std::move(child.second.coin);
+            } else {
+                itUs->second.coin = child.second.coin;
+            }
+            usage += itUs->second.coin.DynamicMemoryUsage();
+            map.SetDirty(*itUs);
+            // NOTE: It isn't safe to mark the coin as FRESH in the parent
+            // cache. If it already existed and was spent in the parent
+            // cache then marking it FRESH would prevent that spentness
+            // from being flushed to the grandparent.
+        }
+    }
+    return false;
+}
+
 bool CCoinsViewCache::BatchWrite(CoinsViewCacheCursor& cursor, const uint256 &hashBlockIn) {
     for (auto it{cursor.Begin()}; it != cursor.End(); it = cursor.NextAndMaybeErase(*it)) {
         // Ignore non-dirty entries (optimization).
         if (!it->second.IsDirty()) {
             continue;
         }
-        CCoinsMap::iterator itUs = cacheCoins.find(it->first);
-        if (itUs == cacheCoins.end()) {
-            // The parent cache does not have an entry, while the child cache does.
-            // We can ignore it if it's both spent and FRESH in the child
-            if (!(it->second.IsFresh() && it->second.coin.IsSpent())) {
-                // Create the coin in the parent cache, move the data up
-                // and mark it as dirty.
-                itUs = cacheCoins.try_emplace(it->first).first;
-                CCoinsCacheEntry& entry{itUs->second};
-                if (cursor.WillErase(*it)) {
-                    // Since this entry will be erased,
-                    // we can move the coin into us instead of copying it
-                    entry.coin = std::move(it->second.coin);
-                } else {
-                    entry.coin = it->second.coin;
-                }
-                cachedCoinsUsage += entry.coin.DynamicMemoryUsage();
-                CCoinsCacheEntry::SetDirty(*itUs, m_sentinel);
-                // We can mark it FRESH in the parent if it was FRESH in the child
-                // Otherwise it might have just been flushed from the parent's cache
-                // and already exist in the grandparent
-                if (it->second.IsFresh()) CCoinsCacheEntry::SetFresh(*itUs, m_sentinel);
-            }
-        } else {
-            // Found the entry in the parent cache
-            if (it->second.IsFresh() && !itUs->second.coin.IsSpent()) {
-                // The coin was marked FRESH in the child cache, but the coin
-                // exists in the parent cache. If this ever happens, it means
-                // the FRESH flag was misapplied and there is a logic error in
-                // the calling code.
-                throw std::logic_error("FRESH flag misapplied to coin that exists in parent cache");
-            }
-
-            if (itUs->second.IsFresh() && it->second.coin.IsSpent()) {
-                // The grandparent cache does not have an entry, and the coin
-                // has been spent. We can just delete it from the parent cache.
-                cachedCoinsUsage -= itUs->second.coin.DynamicMemoryUsage();
-                cacheCoins.erase(itUs);
-            } else {
-                // A normal modification.
-                cachedCoinsUsage -= itUs->second.coin.DynamicMemoryUsage();
-                if (cursor.WillErase(*it)) {
-                    // Since this entry will be erased,
-                    // we can move the coin into us instead of copying it
-                    itUs->second.coin = std::move(it->second.coin);
-                } else {
-                    itUs->second.coin = it->second.coin;
-                }
-                cachedCoinsUsage += itUs->second.coin.DynamicMemoryUsage();
-                CCoinsCacheEntry::SetDirty(*itUs, m_sentinel);
-                // NOTE: It isn't safe to mark the coin as FRESH in the parent
-                // cache. If it already existed and was spent in the parent
-                // cache then marking it FRESH would prevent that spentness
-                // from being flushed to the grandparent.
-            }
-        }
+        WriteChildEntry(cacheCoins, cachedCoinsUsage, *it, cursor.WillErase(*it));
     }
     hashBlock = hashBlockIn;
     return true;
 }
 
 bool CCoinsViewCache::Flush() {
-    auto cursor{CoinsViewCacheCursor(cachedCoinsUsage, m_sentinel, cacheCoins, /*will_erase=*/true)};
+    auto cursor{CoinsViewCacheCursor(cachedCoinsUsage, cacheCoins, /*will_erase=*/true)};
     bool fOk = base->BatchWrite(cursor, hashBlock);
     if (fOk) {
         cacheCoins.clear();
@@ -260,10 +397,10 @@ bool CCoinsViewCache::Flush() {
 
 bool CCoinsViewCache::Sync()
 {
-    auto cursor{CoinsViewCacheCursor(cachedCoinsUsage, m_sentinel, cacheCoins, /*will_erase=*/false)};
+    auto cursor{CoinsViewCacheCursor(cachedCoinsUsage, cacheCoins, /*will_erase=*/false)};
     bool fOk = base->BatchWrite(cursor, hashBlock);
     if (fOk) {
-        if (m_sentinel.second.Next() != &m_sentinel) {
+        if (cacheCoins.FlaggedCount() != 0) {
             /* BatchWrite must clear flags of all entries */
             throw std::logic_error("Not all unspent flagged entries were cleared");
         }
@@ -307,9 +444,8 @@ void CCoinsViewCache::ReallocateCache()
     // Cache should be empty when we're calling this.
     assert(cacheCoins.size() == 0);
     cacheCoins.~CCoinsMap();
-    m_cache_coins_memory_resource.~CCoinsMapMemoryResource();
-    ::new (&m_cache_coins_memory_resource) CCoinsMapMemoryResource{};
-    ::new (&cacheCoins) CCoinsMap{0, SaltedOutpointHasher{/*deterministic=*/m_deterministic}, CCoinsMap::key_equal{}, &m_cache_coins_memory_resource};
+    ::new (&cacheCoins) CCoinsMap{SaltedOutpointHasher{/*deterministic=*/m_deterministic}};
+    cacheCoins.SetMaxMemory(m_max_memory);
 }
 
 void CCoinsViewCache::SanityCheck() const
@@ -327,21 +463,12 @@ void CCoinsViewCache::SanityCheck() const
         // Recompute cachedCoinsUsage.
         recomputed_usage += entry.coin.DynamicMemoryUsage();
 
-        // Count the number of entries we expect in the linked list.
+        // Count the number of entries we expect in the flagged entry list.
         if (entry.IsDirty() || entry.IsFresh()) ++count_flagged;
     }
-    // Iterate over the linked list of flagged entries.
-    size_t count_linked = 0;
-    for (auto it = m_sentinel.second.Next(); it != &m_sentinel; it = it->second.Next()) {
-        // Verify linked list integrity.
-        assert(it->second.Next()->second.Prev() == it);
-        assert(it->second.Prev()->second.Next() == it);
-        // Verify they are actually flagged.
-        assert(it->second.IsDirty() || it->second.IsFresh());
-        // Count the number of entries actually in the list.
-        ++count_linked;
-    }
-    assert(count_linked == count_flagged);
+    // Verify the table and the flagged entry list.
+    cacheCoins.SanityCheck();
+    assert(cacheCoins.FlaggedCount() == count_flagged);
     assert(recomputed_usage == cachedCoinsUsage);
 }
 
@@ -386,3 +513,256 @@ bool CCoinsViewErrorCatcher::HaveCoin(const COutPoint& outpoint) const
 {
     return ExecuteBackedWrapper<bool>([&]() { return CCoinsViewBacked::HaveCoin(outpoint); }, m_err_callbacks);
 }
+
+CCoinsViewShardedCache::CCoinsViewShardedCache(CCoinsView* base, bool deterministic)
+    : CCoinsViewBacked(base), m_deterministic(deterministic), m_hasher(/*deterministic=*/deterministic)
+{
+    if (m_deterministic) {
+        for (Shard& shard : m_shards) ClearShard(shard);
+    }
+}
+
+void CCoinsViewShardedCache::ClearShard(Shard& shard) const
+{
+    // Destroy and reconstruct the map, which releases its table.
+    shard.coins.~CCoinsMap();
+    ::new (&shard.coins) CCoinsMap{SaltedOutpointHasher{/*deterministic=*/m_deterministic}};
+    shard.coins.SetMaxMemory(m_max_shard_memory);
+    shard.coins_usage = 0;
+}
+
+std::optional<Coin> CCoinsViewShardedCache::FetchCoin(const COutPoint& outpoint, bool cache) const
+{
+    Shard& shard{ShardFor(outpoint)};
+    uint64_t generation;
+    {
+        std::shared_lock lock{shard.mutex};
+        if (const auto it{shard.coins.find(outpoint)}; it != shard.coins.end()) {
+            if (it->second.coin.IsSpent()) return std::nullopt;
+            return it->second.coin;
+        }
+        generation = shard.generation;
+    }
+    std::optional<Coin> coin;
+    {
+        std::shared_lock base_lock{m_base_mutex};
+        coin = base->GetCoin(outpoint);
+    }
+    if (cache && coin) {
+        std::unique_lock lock{shard.mutex};
+        // If an entry was inserted meanwhile, it is at least as recent as the
+        // coin read here, so leave it alone.
+        if (shard.generation == generation) {
+            const auto [it, inserted]{shard.coins.try_emplace(outpoint, Coin{*coin})};
+            if (inserted) shard.coins_usage += it->second.coin.DynamicMemoryUsage();
+        }
+    }
+    return coin;
+}
+
+std::optional<Coin> CCoinsViewShardedCache::GetCoin(const COutPoint& outpoint) const
+{
+    return FetchCoin(outpoint, /*cache=*/true);
+}
+
+std::optional<Coin> CCoinsViewShardedCache::PeekCoin(const COutPoint& outpoint) const
+{
+    return FetchCoin(outpoint, /*cache=*/false);
+}
+
+bool CCoinsViewShardedCache::HaveCoin(const COutPoint& outpoint) const
+{
+    return GetCoin(outpoint).has_value();
+}
+
+bool CCoinsViewShardedCache::HaveCoinInCache(const COutPoint& outpoint) const
+{
+    const Shard& shard{ShardFor(outpoint)};
+    std::shared_lock lock{shard.mutex};
+    const auto it{shard.coins.find(outpoint)};
+    return it != shard.coins.end() && !it->second.coin.IsSpent();
+}
+
+uint256 CCoinsViewShardedCache::GetBestBlock() const
+{
+    LOCK(m_best_block_mutex);
+    if (m_best_block.IsNull()) {
+        std::shared_lock base_lock{m_base_mutex};
+        m_best_block = base->GetBestBlock();
+    }
+    return m_best_block;
+}
+
+std::pair<std::optional<Coin>, uint256> CCoinsViewShardedCache::GetCoinAtBestBlock(const COutPoint& outpoint) const
+{
+    while (true) {
+        const uint64_t sequence{m_sequence.load()};
+        if (sequence % 2 == 0) {
+            auto coin{GetCoin(outpoint)};
+            auto best_block{GetBestBlock()};
+            if (m_sequence.load() == sequence) return {std::move(coin), best_block};
+        }
+        std::this_thread::yield();
+    }
+}
+
+bool CCoinsViewShardedCache::BatchWrite(CoinsViewCacheCursor& cursor, const uint256& hashBlock)
+{
+    ++m_sequence;
+    for (auto it{cursor.Begin()}; it != cursor.End(); it = cursor.NextAndMaybeErase(*it)) {
+        if (!it->second.IsDirty()) continue;
+        Shard& shard{ShardFor(it->first)};
+        std::unique_lock lock{shard.mutex};
+        if (WriteChildEntry(shard.coins, shard.coins_usage, *it, cursor.WillErase(*it))) ++shard.generation;
+    }
+    WITH_LOCK(m_best_block_mutex, m_best_block = hashBlock);
+    ++m_sequence;
+    return true;
+}
+
+bool CCoinsViewShardedCache::WriteToBase(bool erase)
+{
+    if (erase) return FlushToBase();
+
+    // Copy the modified coins of all shards, so that they are written to the
+    // base view in a single batch. The shards are only locked while copying:
+    // they keep their entries, so readers find the modified coins here until
+    // the base view has them. All shards are held at once so that the copy is
+    // a consistent snapshot.
+    CCoinsMap flagged{SaltedOutpointHasher{/*deterministic=*/m_deterministic}};
+    size_t flagged_usage{0};
+    {
+        std::vector<std::shared_lock<std::shared_mutex>> locks;
+        locks.reserve(SHARD_COUNT);
+        size_t flagged_count{0};
+        for (Shard& shard : m_shards) {
+            locks.emplace_back(shard.mutex);
+            flagged_count += shard.coins.FlaggedCount();
+        }
+        flagged.reserve(flagged_count);
+        for (Shard& shard : m_shards) {
+            // With will_erase set, the cursor leaves the shard untouched.
+            auto cursor{CoinsViewCacheCursor(shard.coins_usage, shard.coins, /*will_erase=*/true)};
+            for (auto it{cursor.Begin()}; it != cursor.End(); it = cursor.NextAndMaybeErase(*it)) {
+                if (!it->second.IsDirty()) continue;
+                auto& entry{*flagged.try_emplace(it->first).first};
+                entry.second.coin = it->second.coin;
+                flagged_usage += entry.second.coin.DynamicMemoryUsage();
+                flagged.SetDirty(entry);
+                if (it->second.IsFresh()) flagged.SetFresh(entry);
+            }
+        }
+    }
+
+    auto cursor{CoinsViewCacheCursor(flagged_usage, flagged, /*will_erase=*/true)};
+    if (!base->BatchWrite(cursor, GetBestBlock())) return false;
+
+    // The base view has the coins now. As writers are serialized with this
+    // call, the shards were not modified meanwhile, except for unmodified
+    // coins that readers cached, so every shard can have its entries marked
+    // unmodified and its spent ones dropped, one at a time.
+    for (Shard& shard : m_shards) {
+        std::unique_lock lock{shard.mutex};
+        auto shard_cursor{CoinsViewCacheCursor(shard.coins_usage, shard.coins, /*will_erase=*/false)};
+        for (auto it{shard_cursor.Begin()}; it != shard_cursor.End(); it = shard_cursor.NextAndMaybeErase(*it)) {}
+        ++shard.generation;
+    }
+    return true;
+}
+
+bool CCoinsViewShardedCache::FlushToBase()
+{
+    // The cache is emptied anyway, so move the modified coins out of the
+    // shards instead of copying them. Readers must not miss them until the
+    // base view has them, so the shards stay locked until the write returns.
+    // When the base view writes in the background, that is only as long as
+    // it takes to hand the coins over.
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    locks.reserve(SHARD_COUNT);
+    size_t flagged_count{0};
+    for (Shard& shard : m_shards) {
+        locks.emplace_back(shard.mutex);
+        flagged_count += shard.coins.FlaggedCount();
+    }
+    CCoinsMap flagged{SaltedOutpointHasher{/*deterministic=*/m_deterministic}};
+    size_t flagged_usage{0};
+    flagged.reserve(flagged_count);
+    for (Shard& shard : m_shards) {
+        auto cursor{CoinsViewCacheCursor(shard.coins_usage, shard.coins, /*will_erase=*/true)};
+        for (auto it{cursor.Begin()}; it != cursor.End(); it = cursor.NextAndMaybeErase(*it)) {
+            if (!it->second.IsDirty()) continue;
+            auto& entry{*flagged.try_emplace(it->first).first};
+            entry.second.coin = std::move(it->second.coin);
+            flagged_usage += entry.second.coin.DynamicMemoryUsage();
+            flagged.SetDirty(entry);
+            if (it->second.IsFresh()) flagged.SetFresh(entry);
+        }
+        // Release each shard's table as soon as its coins are moved out.
+        ClearShard(shard);
+        ++shard.generation;
+    }
+
+    auto cursor{CoinsViewCacheCursor(flagged_usage, flagged, /*will_erase=*/true)};
+    if (base->BatchWrite(cursor, GetBestBlock())) return true;
+
+    // A base view that fails without throwing has not taken the coins, e.g.
+    // the background flush view reports an earlier failed write before
+    // reading the cursor, so put them back to keep the cache consistent.
+    for (auto it{cursor.Begin()}; it != cursor.End(); it = cursor.NextAndMaybeErase(*it)) {
+        if (!it->second.IsDirty()) continue;
+        Shard& shard{ShardFor(it->first)};
+        WriteChildEntry(shard.coins, shard.coins_usage, *it, /*will_erase=*/true);
+    }
+    return false;
+}
+
+bool CCoinsViewShardedCache::Flush()
+{
+    return WriteToBase(/*erase=*/true);
+}
+
+bool CCoinsViewShardedCache::Sync()
+{
+    return WriteToBase(/*erase=*/false);
+}
+
+void CCoinsViewShardedCache::Uncache(const COutPoint& outpoint)
+{
+    Shard& shard{ShardFor(outpoint)};
+    std::unique_lock lock{shard.mutex};
+    const auto it{shard.coins.find(outpoint)};
+    if (it != shard.coins.end() && !it->second.IsDirty() && !it->second.IsFresh()) {
+        shard.coins_usage -= it->second.coin.DynamicMemoryUsage();
+        shard.coins.erase(it);
+        ++shard.generation;
+    }
+}
+
+size_t CCoinsViewShardedCache::GetCacheSize() const
+{
+    size_t size{0};
+    for (const Shard& shard : m_shards) {
+        std::shared_lock lock{shard.mutex};
+        size += shard.coins.size();
+    }
+    return size;
+}
+
+void CCoinsViewShardedCache::SetMaxMemory(size_t bytes)
+{
+    m_max_shard_memory = bytes / SHARD_COUNT;
+    for (Shard& shard : m_shards) {
+        std::unique_lock lock{shard.mutex};
+        shard.coins.SetMaxMemory(m_max_shard_memory);
+    }
+}
+
+size_t CCoinsViewShardedCache::DynamicMemoryUsage() const
+{
+    size_t usage{0};
+    for (const Shard& shard : m_shards) {
+        std::shared_lock lock{shard.mutex};
+        usage += shard.coins.DynamicMemoryUsage() + shard.coins_usage;
+    }
+    return usage;
+}
@@ -11,16 +11,34 @@
 #include <memusage.h>
 #include <primitives/transaction.h>
 #include <serialize.h>
-#include <support/allocators/pool.h>
+#include <sync.h>
 #include <uint256.h>
 #include <util/check.h>
+#include <util/fastrange.h>
 #include <util/hasher.h>
 
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
-
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /**
  * A UTXO entry.
@@ -108,10 +126,14 @@ using CoinsCachePair = std::pair<const COutPoint, CCoinsCacheEntry>;
 struct CCoinsCacheEntry
 {
 private:
+    friend class CCoinsMap;
+    friend struct CoinsViewCacheCursor;
+
     /**
-     * These are used to create a doubly linked list of flagged entries.
-     * They are set in SetDirty, SetFresh, and unset in SetClean.
-     * A flagged entry is any entry that is either DIRTY, FRESH, or both.
+     * Position of this entry in the flagged entry list of the CCoinsMap it
+     * lives in. Only meaningful while the entry is flagged, i.e. DIRTY, FRESH,
+     * or both. Flags are set and cleared through CCoinsMap::SetDirty,
+     * CCoinsMap::SetFresh and CCoinsMap::SetClean, which keep the list in sync.
      *
      * DIRTY entries are tracked so that only modified entries can be passed to
      * the parent cache for batch writing. This is a performance optimization
@@ -121,28 +143,12 @@ private:
      * FRESH-but-not-DIRTY coins can not occur in practice, since that would
      * mean a spent coin exists in the parent CCoinsView and not in the child
      * CCoinsViewCache. Nevertheless, if a spent coin is retrieved from the
-     * parent cache, the FRESH-but-not-DIRTY coin will be tracked by the linked
-     * list and deleted when Sync or Flush is called on the CCoinsViewCache.
+     * parent cache, the FRESH-but-not-DIRTY coin will be tracked by the flagged
+     * entry list and deleted when Sync or Flush is called on the CCoinsViewCache.
      */
-    CoinsCachePair* m_prev{nullptr};
-    CoinsCachePair* m_next{nullptr};
+    uint32_t m_flagged_pos{0};
     uint8_t m_flags{0};
 
-    //! Adding a flag requires a reference to the sentinel of the flagged pair linked list.
-    static void AddFlags(uint8_t flags, CoinsCachePair& pair, CoinsCachePair& sentinel) noexcept
-    {
-        Assume(flags & (DIRTY | FRESH));
-        if (!pair.second.m_flags) {
-            Assume(!pair.second.m_prev && !pair.second.m_next);
-            pair.second.m_prev = sentinel.second.m_prev;
-            pair.second.m_next = &sentinel;
-            sentinel.second.m_prev = &pair;
-            pair.second.m_prev->second.m_next = &pair;
-        }
-        Assume(pair.second.m_prev && pair.second.m_next);
-        pair.second.m_flags |= flags;
-    }
-
 public:
     Coin coin; // The actual cached data.
 
@@ -169,66 +175,360 @@ public:
 
     CCoinsCacheEntry() noexcept = default;
     explicit CCoinsCacheEntry(Coin&& coin_) noexcept : coin(std::move(coin_)) {}
-    ~CCoinsCacheEntry()
+
+    bool IsDirty() const noexcept { return m_flags & DIRTY; }
+    bool IsFresh() const noexcept { return m_flags & FRESH; }
+};
+
+/**
+ * Open addressing hash map from COutPoint to CCoinsCacheEntry, used as the
+ * in-memory store of CCoinsViewCache.
+ *
+ * Entries are stored inline in a single flat slot array, preceded by one
+ * control byte per slot holding either 7 bits of the entry's hash or an
+ * empty/deleted marker. A lookup hashes the outpoint once and compares those
+ * bits against a group of 16 control bytes at a time (with SSE2 where
+ * available), so it usually touches one control cache line and one slot,
+ * instead of chasing the bucket and node pointers of a std::unordered_map.
+ * Groups are probed linearly, so the table can have any multiple of the group
+ * width as capacity. It grows by half its size at a time rather than doubling,
+ * which keeps the memory held while rehashing and the steps in memory usage
+ * small, and stops growing at the budget set with SetMaxMemory() for as long as
+ * the load factor allows. Erased slots become tombstones unless their group
+ * still has an empty slot, and are reclaimed on the next rehash.
+ *
+ * Because the map owns the slots, it also tracks which entries are flagged
+ * (DIRTY and/or FRESH) in a dense vector of slot indices, so flushing only
+ * visits modified entries.
+ *
+ * Inserting may rehash the table, which invalidates all iterators, pointers
+ * and references into it. Erasing only invalidates the erased entry.
+ */
+class CCoinsMap
+{
+public:
+    using key_type = COutPoint;
+    using mapped_type = CCoinsCacheEntry;
+    using value_type = CoinsCachePair;
+    using hasher = SaltedOutpointHasher;
+    using key_equal = std::equal_to<COutPoint>;
+    using size_type = size_t;
+
+private:
+    using ctrl_t = int8_t;
+
+    //! Control byte values. Full slots hold the low 7 bits of their hash (0..127).
+    static constexpr ctrl_t CTRL_EMPTY{-128};
+    static constexpr ctrl_t CTRL_DELETED{-2};
+    //! Stored one past the last slot, so that iteration stops without a bounds check.
+    static constexpr ctrl_t CTRL_SENTINEL{-1};
+
+    static constexpr size_t GROUP_WIDTH{16};
+    static constexpr size_t MIN_CAPACITY{GROUP_WIDTH};
+    static constexpr size_t ALLOC_ALIGNMENT{64};
+    static constexpr size_t NPOS{std::numeric_limits<size_t>::max()};
+
+    /** A group of GROUP_WIDTH consecutive control bytes, matched in parallel. */
+    struct Group
+    {
+#ifdef __SSE2__
+        __m128i ctrl;
+
+        explicit Group(const ctrl_t* pos) noexcept : ctrl{_mm_load_si128(reinterpret_cast<const __m128i*>(pos))} {}
+
+        uint32_t Match(ctrl_t value) const noexcept
+        {
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(value), ctrl)));
+        }
+        uint32_t MaskEmptyOrDeleted() const noexcept
+        {
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(CTRL_SENTINEL), ctrl)));
+        }
+#else
+        const ctrl_t* ctrl;
+
+        explicit Group(const ctrl_t* pos) noexcept : ctrl{pos} {}
+
+        uint32_t Match(ctrl_t value) const noexcept
+        {
+            uint32_t mask{0};
+            for (size_t i{0}; i < GROUP_WIDTH; ++i) mask |= uint32_t{ctrl[i] == value} << i;
+            return mask;
+        }
+        uint32_t MaskEmptyOrDeleted() const noexcept
+        {
+            uint32_t mask{0};
+            for (size_t i{0}; i < GROUP_WIDTH; ++i) mask |= uint32_t{ctrl[i] < CTRL_SENTINEL} << i;
+            return mask;
+        }
+#endif
+        uint32_t MaskEmpty() const noexcept { return Match(CTRL_EMPTY); }
+    };
+
+    template <bool IsConst>
+    class Iterator
     {
-        SetClean();
+        friend class CCoinsMap;
+        template <bool>
+        friend class Iterator;
+        using Pair = std::conditional_t<IsConst, const CoinsCachePair, CoinsCachePair>;
+
+        const ctrl_t* m_ctrl{nullptr};
+        Pair* m_slot{nullptr};
+
+        Iterator(const ctrl_t* ctrl, Pair* slot) noexcept : m_ctrl{ctrl}, m_slot{slot} {}
+
+        void SkipFree() noexcept
+        {
+            while (*m_ctrl < CTRL_SENTINEL) {
+                ++m_ctrl;
+                ++m_slot;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = CoinsCachePair;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Pair*;
+        using reference = Pair&;
+
+        Iterator() noexcept = default;
+        template <bool C = IsConst>
+            requires C
+        Iterator(const Iterator<false>& other) noexcept : m_ctrl{other.m_ctrl}, m_slot{other.m_slot} {}
+
+        reference operator*() const noexcept { return *m_slot; }
+        pointer operator->() const noexcept { return m_slot; }
+
+        Iterator& operator++() noexcept
+        {
+            ++m_ctrl;
+            ++m_slot;
+            SkipFree();
+            return *this;
+        }
+        Iterator operator++(int) noexcept
+        {
+            Iterator prev{*this};
+            ++*this;
+            return prev;
+        }
+
+        friend bool operator==(const Iterator& a, const Iterator& b) noexcept { return a.m_slot == b.m_slot; }
+    };
+
+public:
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    explicit CCoinsMap(const hasher& hash = hasher{}) noexcept : m_hasher{hash} {}
+    ~CCoinsMap();
+
+    CCoinsMap(const CCoinsMap&) = delete;
+    CCoinsMap& operator=(const CCoinsMap&) = delete;
+
+    size_t size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+    //! Number of slots, including free ones.
+    size_t capacity() const noexcept { return m_capacity; }
+
+    iterator begin() noexcept
+    {
+        if (m_size == 0) return end();
+        iterator it{m_ctrl, m_slots};
+        it.SkipFree();
+        return it;
+    }
+    iterator end() noexcept { return {m_ctrl + m_capacity, m_slots + m_capacity}; }
+    const_iterator begin() const noexcept { return const_cast<CCoinsMap&>(*this).begin(); }
+    const_iterator end() const noexcept { return const_cast<CCoinsMap&>(*this).end(); }
+
+    iterator find(const COutPoint& key) noexcept
+    {
+        const size_t idx{FindIndex(key, m_hasher(key))};
+        return idx == NPOS ? end() : IteratorAt(idx);
     }
+    const_iterator find(const COutPoint& key) const noexcept { return const_cast<CCoinsMap&>(*this).find(key); }
 
-    static void SetDirty(CoinsCachePair& pair, CoinsCachePair& sentinel) noexcept { AddFlags(DIRTY, pair, sentinel); }
-    static void SetFresh(CoinsCachePair& pair, CoinsCachePair& sentinel) noexcept { AddFlags(FRESH, pair, sentinel); }
+    /**
+     * Insert an entry constructed from args for key, unless key is already
+     * present. Returns an iterator to the entry for key, and whether it was
+     * inserted.
+     */
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args)
+    {
+        const size_t hash{m_hasher(key)};
+        if (const size_t idx{FindIndex(key, hash)}; idx != NPOS) return {IteratorAt(idx), false};
+        size_t idx{m_capacity ? FindInsertIndex(hash) : NPOS};
+        if (idx == NPOS || (m_growth_left == 0 && m_ctrl[idx] != CTRL_DELETED)) {
+            Grow();
+            idx = FindInsertIndex(hash);
+        }
+        ::new (static_cast<void*>(m_slots + idx)) CoinsCachePair(std::piecewise_construct,
+                                                                 std::forward_as_tuple(std::forward<K>(key)),
+                                                                 std::forward_as_tuple(std::forward<Args>(args)...));
+        m_growth_left -= (m_ctrl[idx] == CTRL_EMPTY);
+        m_ctrl[idx] = H2(hash);
+        ++m_size;
+        return {IteratorAt(idx), true};
+    }
 
-    void SetClean() noexcept
+    //! Erase the entry at it, clearing its flags first.
+    void erase(const_iterator it) noexcept
     {
-        if (!m_flags) return;
-        m_next->second.m_prev = m_prev;
-        m_prev->second.m_next = m_next;
-        m_flags = 0;
-        m_prev = m_next = nullptr;
+        const size_t idx{IndexOf(*it)};
+        SetClean(m_slots[idx]);
+        EraseIndex(idx);
     }
-    bool IsDirty() const noexcept { return m_flags & DIRTY; }
-    bool IsFresh() const noexcept { return m_flags & FRESH; }
 
-    //! Only call Next when this entry is DIRTY, FRESH, or both
-    CoinsCachePair* Next() const noexcept
+    //! Erase all entries, keeping the allocated table.
+    void clear() noexcept;
+
+    //! Make room for at least count entries without rehashing.
+    void reserve(size_t count);
+
+    //! Do not grow the table past this many bytes, unless it is full at that size. 0 means no limit.
+    void SetMaxMemory(size_t bytes) noexcept;
+
+    //! Mark an entry of this map DIRTY, adding it to the flagged entry list if needed.
+    void SetDirty(CoinsCachePair& pair) { AddFlags(CCoinsCacheEntry::DIRTY, pair); }
+    //! Mark an entry of this map FRESH, adding it to the flagged entry list if needed.
+    void SetFresh(CoinsCachePair& pair) { AddFlags(CCoinsCacheEntry::FRESH, pair); }
+    //! Clear the flags of an entry of this map, removing it from the flagged entry list.
+    void SetClean(CoinsCachePair& pair) noexcept
     {
-        Assume(m_flags);
-        return m_next;
+        CCoinsCacheEntry& entry{pair.second};
+        if (!entry.m_flags) return;
+        const uint32_t last{m_flagged.back()};
+        m_flagged[entry.m_flagged_pos] = last;
+        m_slots[last].second.m_flagged_pos = entry.m_flagged_pos;
+        m_flagged.pop_back();
+        entry.m_flags = 0;
     }
 
-    //! Only call Prev when this entry is DIRTY, FRESH, or both
-    CoinsCachePair* Prev() const noexcept
+    //! Number of entries that are DIRTY, FRESH, or both.
+    size_t FlaggedCount() const noexcept { return m_flagged.size(); }
+
+    //! Heap memory used by the table and the flagged entry list.
+    size_t DynamicMemoryUsage() const noexcept
     {
-        Assume(m_flags);
-        return m_prev;
+        return (m_capacity ? memusage::MallocUsage(AllocSize(m_capacity)) : 0) + memusage::DynamicUsage(m_flagged);
     }
 
-    //! Only use this for initializing the linked list sentinel
-    void SelfRef(CoinsCachePair& pair) noexcept
+    //! Check the consistency of the control bytes, counters and flagged entry list.
+    void SanityCheck() const;
+
+private:
+    friend struct CoinsViewCacheCursor;
+
+    //! Beginning of the allocation: m_capacity control bytes, followed by the sentinel.
+    ctrl_t* m_ctrl{nullptr};
+    //! m_capacity slots, in the same allocation as m_ctrl.
+    CoinsCachePair* m_slots{nullptr};
+    size_t m_capacity{0};
+    size_t m_size{0};
+    //! Number of EMPTY slots that can still be filled before the maximum load factor is hit.
+    size_t m_growth_left{0};
+    //! Capacity that Grow() does not go past while the table has room, or 0 for no limit.
+    size_t m_max_capacity{0};
+    //! Slot indices of flagged entries, in no particular order.
+    std::vector<uint32_t> m_flagged;
+    hasher m_hasher;
+
+    //! First group on the probe sequence of hash, from its high bits.
+    static size_t H1(size_t hash, size_t groups) noexcept
     {
-        Assume(&pair.second == this);
-        m_prev = &pair;
-        m_next = &pair;
-        // Set sentinel to DIRTY so we can call Next on it
-        m_flags = DIRTY;
+        return FastRange64(uint64_t{hash} << (64 - std::numeric_limits<size_t>::digits), groups);
     }
-};
+    static ctrl_t H2(size_t hash) noexcept { return static_cast<ctrl_t>(hash & 0x7f); }
 
-/**
- * PoolAllocator's MAX_BLOCK_SIZE_BYTES parameter here uses sizeof the data, and adds the size
- * of 4 pointers. We do not know the exact node size used in the std::unordered_node implementation
- * because it is implementation defined. Most implementations have an overhead of 1 or 2 pointers,
- * so nodes can be connected in a linked list, and in some cases the hash value is stored as well.
- * Using an additional sizeof(void*)*4 for MAX_BLOCK_SIZE_BYTES should thus be sufficient so that
- * all implementations can allocate the nodes from the PoolAllocator.
- */
-using CCoinsMap = std::unordered_map<COutPoint,
-                                     CCoinsCacheEntry,
-                                     SaltedOutpointHasher,
-                                     std::equal_to<COutPoint>,
-                                     PoolAllocator<CoinsCachePair,
-                                                   sizeof(CoinsCachePair) + sizeof(void*) * 4>>;
+    //! Maximum number of entries for a given capacity (a load factor of 7/8).
+    static size_t CapacityToGrowth(size_t capacity) noexcept { return capacity - capacity / 8; }
+    static size_t RoundUpToGroup(size_t capacity) noexcept { return (capacity + GROUP_WIDTH - 1) & ~(GROUP_WIDTH - 1); }
+    static size_t SlotsOffset(size_t capacity) noexcept
+    {
+        return (capacity + 1 + alignof(CoinsCachePair) - 1) & ~(alignof(CoinsCachePair) - 1);
+    }
+    static size_t AllocSize(size_t capacity) noexcept { return SlotsOffset(capacity) + capacity * sizeof(CoinsCachePair); }
+
+    size_t IndexOf(const CoinsCachePair& pair) const noexcept { return &pair - m_slots; }
+    iterator IteratorAt(size_t idx) noexcept { return {m_ctrl + idx, m_slots + idx}; }
+
+    size_t FindIndex(const COutPoint& key, size_t hash) const noexcept
+    {
+        if (m_size == 0) return NPOS;
+        const size_t groups{m_capacity / GROUP_WIDTH};
+        const ctrl_t h2{H2(hash)};
+        size_t group{H1(hash, groups)};
+        while (true) {
+            const size_t base{group * GROUP_WIDTH};
+            const Group g{m_ctrl + base};
+            for (uint32_t match{g.Match(h2)}; match; match &= match - 1) {
+                const size_t idx{base + std::countr_zero(match)};
+                if (m_slots[idx].first == key) [[likely]] return idx;
+            }
+            if (g.MaskEmpty()) [[likely]] return NPOS;
+            if (++group == groups) group = 0;
+        }
+    }
 
-using CCoinsMapMemoryResource = CCoinsMap::allocator_type::ResourceType;
+    //! Find the first EMPTY or DELETED slot on the probe sequence of hash.
+    size_t FindInsertIndex(size_t hash) const noexcept
+    {
+        const size_t groups{m_capacity / GROUP_WIDTH};
+        size_t group{H1(hash, groups)};
+        while (true) {
+            const size_t base{group * GROUP_WIDTH};
+            if (const uint32_t free{Group{m_ctrl + base}.MaskEmptyOrDeleted()}) [[likely]] {
+                return base + std::countr_zero(free);
+            }
+            if (++group == groups) group = 0;
+        }
+    }
+
+    void EraseIndex(size_t idx) noexcept
+    {
+        m_slots[idx].~CoinsCachePair();
+        --m_size;
+        // A probe sequence only continues past a group that has no EMPTY slot,
+        // so if this group still has one, nothing can have been placed beyond
+        // it on account of this slot and it can become EMPTY again.
+        if (Group{m_ctrl + (idx & ~(GROUP_WIDTH - 1))}.MaskEmpty()) {
+            m_ctrl[idx] = CTRL_EMPTY;
+            ++m_growth_left;
+        } else {
+            m_ctrl[idx] = CTRL_DELETED;
+        }
+    }
+
+    void AddFlags(uint8_t flags, CoinsCachePair& pair)
+    {
+        Assume(flags & (CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH));
+        CCoinsCacheEntry& entry{pair.second};
+        if (!entry.m_flags) {
+            entry.m_flagged_pos = m_flagged.size();
+            m_flagged.push_back(IndexOf(pair));
+        }
+        entry.m_flags |= flags;
+    }
+
+    //! Remove the first count entries from the flagged entry list.
+    void DropFlagged(size_t count) noexcept
+    {
+        count = std::min(count, m_flagged.size());
+        if (count == 0) return;
+        m_flagged.erase(m_flagged.begin(), m_flagged.begin() + count);
+        for (size_t pos{0}; pos < m_flagged.size(); ++pos) m_slots[m_flagged[pos]].second.m_flagged_pos = pos;
+    }
+
+    //! Grow the table, or rehash it in place if it is mostly filled with tombstones.
+    void Grow();
+    void Rehash(size_t new_capacity);
+    void Allocate(size_t capacity);
+    void DestroyEntries() noexcept;
+};
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -250,7 +550,7 @@ private:
 };
 
 /**
- * Cursor for iterating over the linked list of flagged entries in CCoinsViewCache.
+ * Cursor for iterating over the flagged entries of a CCoinsViewCache.
  *
  * This is a helper struct to encapsulate the diverging logic between a non-erasing
  * CCoinsViewCache::Sync and an erasing CCoinsViewCache::Flush. This allows the receiver
@@ -265,43 +565,57 @@ private:
 struct CoinsViewCacheCursor
 {
     //! If will_erase is not set, iterating through the cursor will erase spent coins from the map,
-    //! and other coins will be unflagged (removing them from the linked list).
-    //! If will_erase is set, the underlying map and linked list will not be modified,
+    //! and other coins will be unflagged. The flagged entry list itself is only emptied once the
+    //! last entry has been visited, so that entries do not move within it during iteration.
+    //! If will_erase is set, the underlying map and flagged entry list will not be modified,
     //! as the caller is expected to wipe the entire map anyway.
     //! This is an optimization compared to erasing all entries as the cursor iterates them when will_erase is set.
-    //! Calling CCoinsMap::clear() afterwards is faster because a CoinsCachePair cannot be coerced back into a
-    //! CCoinsMap::iterator to be erased, and must therefore be looked up again by key in the CCoinsMap before being erased.
     CoinsViewCacheCursor(size_t& usage LIFETIMEBOUND,
-                        CoinsCachePair& sentinel LIFETIMEBOUND,
                         CCoinsMap& map LIFETIMEBOUND,
                         bool will_erase) noexcept
-        : m_usage(usage), m_sentinel(sentinel), m_map(map), m_will_erase(will_erase) {}
+        : m_usage(usage), m_map(map), m_will_erase(will_erase) {}
+
+    //! If the receiver stopped before the last entry, e.g. because BatchWrite threw, the entries it
+    //! visited are no longer flagged (or were erased) but are still in the flagged entry list.
+    //! Drop them, so that the list only holds the entries that are still flagged.
+    ~CoinsViewCacheCursor()
+    {
+        if (!m_will_erase) m_map.DropFlagged(m_pos);
+    }
+
+    CoinsViewCacheCursor(const CoinsViewCacheCursor&) = delete;
+    CoinsViewCacheCursor& operator=(const CoinsViewCacheCursor&) = delete;
 
-    inline CoinsCachePair* Begin() const noexcept { return m_sentinel.second.Next(); }
-    inline CoinsCachePair* End() const noexcept { return &m_sentinel; }
+    inline CoinsCachePair* Begin() const noexcept { return Flagged(0); }
+    inline CoinsCachePair* End() const noexcept { return nullptr; }
 
     //! Return the next entry after current, possibly erasing current
     inline CoinsCachePair* NextAndMaybeErase(CoinsCachePair& current) noexcept
     {
-        const auto next_entry{current.second.Next()};
+        const auto next_entry{Flagged(++m_pos)};
         // If we are not going to erase the cache, we must still erase spent entries.
         // Otherwise, clear the state of the entry.
         if (!m_will_erase) {
+            current.second.m_flags = 0;
             if (current.second.coin.IsSpent()) {
                 m_usage -= current.second.coin.DynamicMemoryUsage();
-                m_map.erase(current.first);
-            } else {
-                current.second.SetClean();
+                m_map.EraseIndex(m_map.IndexOf(current));
             }
+            if (!next_entry) m_map.m_flagged.clear();
         }
         return next_entry;
     }
 
     inline bool WillErase(CoinsCachePair& current) const noexcept { return m_will_erase || current.second.coin.IsSpent(); }
 private:
+    CoinsCachePair* Flagged(size_t pos) const noexcept
+    {
+        return pos < m_map.m_flagged.size() ? &m_map.m_slots[m_map.m_flagged[pos]] : nullptr;
+    }
+
     size_t& m_usage;
-    CoinsCachePair& m_sentinel;
     CCoinsMap& m_map;
+    size_t m_pos{0};
     bool m_will_erase;
 };
 
@@ -370,14 +684,14 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
-    mutable CCoinsMapMemoryResource m_cache_coins_memory_resource{};
-    /* The starting sentinel of the flagged entry circular doubly linked list. */
-    mutable CoinsCachePair m_sentinel;
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage{0};
 
+    /* Memory budget of cacheCoins' table, see CCoinsMap::SetMaxMemory. */
+    size_t m_max_memory{0};
+
 public:
     CCoinsViewCache(CCoinsView *baseIn, bool deterministic = false);
 
@@ -408,10 +722,9 @@ public:
      * more efficient than GetCoin.
      *
      * Generally, do not hold the reference returned for more than a short scope.
-     * While the current implementation allows for modifications to the contents
-     * of the cache while holding the reference, this behavior should not be relied
-     * on! To be safe, best to not hold the returned reference through any other
-     * calls to this cache.
+     * Any call that adds an entry to this cache may rehash it and invalidate the
+     * reference, so do not hold the returned reference through any other calls
+     * to this cache.
      */
     const Coin& AccessCoin(const COutPoint &output) const;
 
@@ -430,6 +743,16 @@ public:
      */
     void EmplaceCoinInternalDANGER(COutPoint&& outpoint, Coin&& coin);
 
+    /**
+     * Cache an unspent coin that was looked up in the backing view by the
+     * caller, as if FetchCoin had retrieved it. The entry is left unflagged,
+     * and nothing happens if the outpoint is already cached.
+     *
+     * Used to load block inputs that were read from the database in parallel.
+     * @sa Chainstate::PrefetchBlockInputs()
+     */
+    void CacheFetchedCoin(const COutPoint& outpoint, Coin&& coin);
+
     /**
      * Spend a coin. Pass moveto in order to get the deleted data.
      * If no unspent output exists for the passed outpoint, this call
@@ -460,6 +783,17 @@ public:
      */
     void Uncache(const COutPoint &outpoint);
 
+    //! Make room for count more coins without rehashing, e.g. before adding
+    //! back the coins spent by a block.
+    void Reserve(size_t count) { cacheCoins.reserve(cacheCoins.size() + count); }
+
+    //! Do not grow the table of the cache past this many bytes while it has room. 0 means no limit.
+    void SetMaxMemory(size_t bytes)
+    {
+        m_max_memory = bytes;
+        cacheCoins.SetMaxMemory(bytes);
+    }
+
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
@@ -470,10 +804,7 @@ public:
     bool HaveInputs(const CTransaction& tx) const;
 
     //! Force a reallocation of the cache map. This is required when downsizing
-    //! the cache because the map's allocator may be hanging onto a lot of
-    //! memory despite having called .clear().
-    //!
-    //! See: https://stackoverflow.com/questions/42114044/how-to-release-unordered-map-memory
+    //! the cache because the map keeps its table allocated after .clear().
     void ReallocateCache();
 
     //! Run an internal sanity check on the cache data structure. */
@@ -526,4 +857,103 @@ private:
 
 };
 
+/**
+ * Coins cache split into shards with a lock each, so that it can be read from
+ * any thread while a single writer modifies it.
+ *
+ * It sits below the coins tip cache of a chainstate, which moves its changes
+ * here after every block, so that mempool acceptance and RPC can look up coins
+ * without cs_main. Coins read from the base view are cached in their shard.
+ *
+ * BatchWrite, Flush, Sync and Uncache are only called by the writer, which
+ * holds cs_main. All other methods may be called from any thread.
+ */
+class CCoinsViewShardedCache final : public CCoinsViewBacked
+{
+public:
+    static constexpr int SHARD_BITS{5};
+    static constexpr size_t SHARD_COUNT{size_t{1} << SHARD_BITS};
+
+    explicit CCoinsViewShardedCache(CCoinsView* base, bool deterministic = false);
+
+    std::optional<Coin> GetCoin(const COutPoint& outpoint) const override;
+    bool HaveCoin(const COutPoint& outpoint) const override;
+    uint256 GetBestBlock() const override EXCLUSIVE_LOCKS_REQUIRED(!m_best_block_mutex);
+    bool BatchWrite(CoinsViewCacheCursor& cursor, const uint256& hashBlock) override EXCLUSIVE_LOCKS_REQUIRED(!m_best_block_mutex);
+    std::unique_ptr<CCoinsViewCursor> Cursor() const override {
+        throw std::logic_error("CCoinsViewShardedCache cursor iteration not supported.");
+    }
+
+    //! Look up a coin, along with the best block of the state it was found in.
+    std::pair<std::optional<Coin>, uint256> GetCoinAtBestBlock(const COutPoint& outpoint) const EXCLUSIVE_LOCKS_REQUIRED(!m_best_block_mutex);
+
+    //! Like GetCoin, but a coin read from the base view is not cached.
+    std::optional<Coin> PeekCoin(const COutPoint& outpoint) const;
+
+    //! Check if the given utxo is cached, without reading from the base view.
+    bool HaveCoinInCache(const COutPoint& outpoint) const;
+
+    //! Write the modified coins to the base view and empty the cache. The coins
+    //! are moved rather than copied, so readers wait until the base view has
+    //! taken them. Other writes (BatchWrite, Flush, Sync) must not run
+    //! concurrently; validation serializes them with cs_main.
+    bool Flush() EXCLUSIVE_LOCKS_REQUIRED(!m_best_block_mutex);
+
+    //! Write the modified coins to the base view, keeping the unspent ones cached.
+    //! Readers are not blocked during the write, but the same restriction on
+    //! concurrent writes as for Flush applies.
+    bool Sync() EXCLUSIVE_LOCKS_REQUIRED(!m_best_block_mutex);
+
+    //! Remove the UTXO with the given outpoint from the cache, if it is not modified.
+    void Uncache(const COutPoint& outpoint);
+
+    //! Calculate the size of the cache (in number of transaction outputs)
+    size_t GetCacheSize() const;
+
+    //! Calculate the size of the cache (in bytes)
+    size_t DynamicMemoryUsage() const;
+
+    //! Do not grow the tables of the shards past this many bytes in total while they have room.
+    //! Only called by the writer. 0 means no limit.
+    void SetMaxMemory(size_t bytes);
+
+    //! Block reads from the base view for as long as the returned lock is held,
+    //! e.g. while the database below is reopened.
+    [[nodiscard]] std::unique_lock<std::shared_mutex> LockBase() const { return std::unique_lock{m_base_mutex}; }
+
+private:
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        CCoinsMap coins;
+        //! Dynamic memory usage of the Coin objects in this shard.
+        size_t coins_usage{0};
+        //! Incremented whenever an entry is removed, so that a coin read from
+        //! the base view meanwhile is not cached after a newer version of it
+        //! was written there and dropped from here.
+        uint64_t generation{0};
+    };
+
+    const bool m_deterministic;
+    const SaltedOutpointHasher m_hasher;
+    mutable std::array<Shard, SHARD_COUNT> m_shards;
+    //! Held shared while reading from the base view.
+    mutable std::shared_mutex m_base_mutex;
+    mutable Mutex m_best_block_mutex;
+    mutable uint256 m_best_block GUARDED_BY(m_best_block_mutex);
+    //! Odd while a BatchWrite is in progress.
+    std::atomic<uint64_t> m_sequence{0};
+    //! Memory budget of the table of each shard, only accessed by the writer.
+    size_t m_max_shard_memory{0};
+
+    Shard& ShardFor(const COutPoint& outpoint) const
+    {
+        return m_shards[m_hasher(outpoint) >> (std::numeric_limits<size_t>::digits - SHARD_BITS)];
+    }
+    std::optional<Coin> FetchCoin(const COutPoint& outpoint, bool cache) const;
+    //! Remove all entries of a shard and release its memory.
+    void ClearShard(Shard& shard) const;
+    bool WriteToBase(bool erase) EXCLUSIVE_LOCKS_REQUIRED(!m_best_block_mutex);
+    bool FlushToBase() EXCLUSIVE_LOCKS_REQUIRED(!m_best_block_mutex);
+};
+
 #endif // QTC_COINS_H
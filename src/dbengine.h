@@ -0,0 +1,84 @@
+// Copyright (c) 2026-present The QTC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef QTC_DBENGINE_H
+#define QTC_DBENGINE_H
+
+#include <dbwrapper.h>
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+
+/**
+ * Interface to the storage engines behind CDBWrapper.
+ *
+ * Keys are compared bytewise. Engines report unrecoverable errors by throwing
+ * dbwrapper_error. Values are stored as given; obfuscation is applied by
+ * CDBWrapper on top of the engine.
+ */
+
+/** Changes to be applied atomically by DBEngine::Write. */
+class DBEngineBatch
+{
+public:
+    virtual ~DBEngineBatch() = default;
+
+    virtual void Put(std::span<const std::byte> key, std::span<const std::byte> value) = 0;
+    virtual void Delete(std::span<const std::byte> key) = 0;
+    virtual void Clear() = 0;
+    //! Approximate number of bytes queued, used to split large writes.
+    virtual size_t ApproximateSize() const = 0;
+};
+
+/**
+ * Iterator over a consistent snapshot of the database, taken when the iterator
+ * was created. Key and Value are only valid until the iterator moves.
+ */
+class DBEngineIterator
+{
+public:
+    virtual ~DBEngineIterator() = default;
+
+    virtual bool Valid() const = 0;
+    virtual void SeekToFirst() = 0;
+    //! Position at the first key not less than key.
+    virtual void Seek(std::span<const std::byte> key) = 0;
+    virtual void Next() = 0;
+    virtual std::span<const std::byte> Key() const = 0;
+    virtual std::span<const std::byte> Value() const = 0;
+};
+
+/**
+ * A key-value store. Reads and iterators may be used from several threads at
+ * once, also while a write is in progress. Writes must not be concurrent.
+ */
+class DBEngine
+{
+public:
+    virtual ~DBEngine() = default;
+
+    virtual std::optional<std::string> Read(std::span<const std::byte> key) const = 0;
+    virtual bool Exists(std::span<const std::byte> key) const = 0;
+    virtual std::unique_ptr<DBEngineBatch> NewBatch() const = 0;
+    //! Apply a batch obtained from NewBatch. If sync is set, the batch is
+    //! durable once this returns.
+    virtual void Write(DBEngineBatch& batch, bool sync) = 0;
+    virtual std::unique_ptr<DBEngineIterator> NewIterator() const = 0;
+    //! Approximate number of bytes of storage used by keys in [begin, end).
+    virtual size_t EstimateSize(std::span<const std::byte> begin, std::span<const std::byte> end) const = 0;
+    virtual size_t DynamicMemoryUsage() const = 0;
+    //! Reclaim space held by overwritten and deleted data, if the engine needs to.
+    virtual void Compact() = 0;
+    //! Like Compact, but only for keys between begin and end.
+    virtual void CompactRange(std::span<const std::byte> begin, std::span<const std::byte> end) = 0;
+    virtual DBWriteStalls WriteStalls() const = 0;
+};
+
+/** Open the engine selected by params.options.backend. */
+std::unique_ptr<DBEngine> MakeDBEngine(const DBParams& params);
+
+#endif // QTC_DBENGINE_H
@@ -0,0 +1,964 @@
+// Copyright (c) 2026-present The QTC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <qtc-build-config.h> // IWYU pragma: keep
+
+#include <dbmmap.h>
+
+#include <crypto/common.h>
+#include <crypto/siphash.h>
+#include <logging.h>
+#include <memusage.h>
+#include <tinyformat.h>
+#include <util/check.h>
+#include <util/fs_helpers.h>
+#include <util/syserror.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <system_error>
+#include <thread>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using Pgno = MmapDBEngine::Pgno;
+
+namespace {
+constexpr size_t PAGE_SIZE{MmapDBEngine::PAGE_SIZE};
+
+constexpr uint64_t MMAPDB_MAGIC{0x3142444d4d435451}; // "QTCMMDB1"
+constexpr uint32_t MMAPDB_VERSION{1};
+//! Pages 0 and 1 are the meta pages, written alternately.
+constexpr Pgno FIRST_DATA_PAGE{2};
+
+//! Page header: type, number of entries, bytes used by the entries.
+constexpr size_t PAGE_HEADER_SIZE{8};
+constexpr uint16_t PAGE_LEAF{1};
+constexpr uint16_t PAGE_BRANCH{2};
+//! Space for entries and their 2-byte offsets in a page.
+constexpr size_t PAGE_CAPACITY{PAGE_SIZE - PAGE_HEADER_SIZE};
+//! Pages of new trees filled less than this are merged with a neighbour.
+constexpr size_t MIN_FILL{PAGE_CAPACITY / 4};
+//! Set in the value size of a leaf entry whose value is in a run of pages.
+constexpr uint32_t OVERFLOW_FLAG{uint32_t{1} << 31};
+
+//! The file grows by at least this much at a time.
+constexpr size_t MIN_GROWTH{32 << 20};
+//! Dirty pages at most this many pages apart are synced together.
+constexpr Pgno MAX_SYNC_GAP{256};
+
+//! Address range reserved for the mapping, which bounds the size of the database.
+constexpr size_t MapSize(bool memory_only)
+{
+    if constexpr (sizeof(void*) < 8) return memory_only ? size_t{256} << 20 : size_t{1} << 30;
+    return memory_only ? size_t{1} << 33 : size_t{1} << 40;
+}
+
+int CompareKeys(std::span<const std::byte> a, std::span<const std::byte> b)
+{
+    const size_t len{std::min(a.size(), b.size())};
+    if (len > 0) {
+        if (const int cmp{std::memcmp(a.data(), b.data(), len)}; cmp != 0) return cmp;
+    }
+    return a.size() < b.size() ? -1 : a.size() > b.size();
+}
+
+std::span<const std::byte> KeySpan(const std::string& key) { return MakeByteSpan(key); }
+
+/** Read-only view of a leaf or branch page. */
+class NodeView
+{
+    const std::byte* m_page;
+
+    const std::byte* Entry(size_t i) const { return m_page + ReadLE16(m_page + PAGE_HEADER_SIZE + 2 * i); }
+
+public:
+    explicit NodeView(const std::byte* page) : m_page{page}
+    {
+        if (Type() != PAGE_LEAF && Type() != PAGE_BRANCH) throw dbwrapper_error("Corrupted mmap database: invalid page type");
+    }
+
+    uint16_t Type() const { return ReadLE16(m_page); }
+    bool IsLeaf() const { return Type() == PAGE_LEAF; }
+    size_t Count() const { return ReadLE16(m_page + 2); }
+
+    // Leaf entry: key size (2), value size (4), key, then the value or the
+    // first page of its run (4).
+    std::span<const std::byte> LeafKey(size_t i) const
+    {
+        const std::byte* entry{Entry(i)};
+        return {entry + 6, ReadLE16(entry)};
+    }
+    uint32_t RawValueSize(size_t i) const { return ReadLE32(Entry(i) + 2); }
+    const std::byte* ValueData(size_t i) const { return Entry(i) + 6 + ReadLE16(Entry(i)); }
+
+    // Branch entry: child page (4), key size (2), key. The key of the first
+    // child is not used for searching, as the parent bounds it.
+    Pgno ChildPage(size_t i) const { return ReadLE32(Entry(i)); }
+    std::span<const std::byte> BranchKey(size_t i) const
+    {
+        const std::byte* entry{Entry(i)};
+        return {entry + 6, ReadLE16(entry + 4)};
+    }
+
+    //! Index of the child whose range includes key.
+    size_t FindChild(std::span<const std::byte> key) const
+    {
+        size_t lo{1}, hi{Count()};
+        while (lo < hi) {
+            const size_t mid{lo + (hi - lo) / 2};
+            if (CompareKeys(BranchKey(mid), key) <= 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo - 1;
+    }
+
+    //! Index of the first entry not less than key.
+    size_t LowerBound(std::span<const std::byte> key) const
+    {
+        size_t lo{0}, hi{Count()};
+        while (lo < hi) {
+            const size_t mid{lo + (hi - lo) / 2};
+            if (CompareKeys(LeafKey(mid), key) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+};
+
+std::span<const std::byte> LeafValue(const MmapDBEngine& engine, const NodeView& leaf, size_t i)
+{
+    const uint32_t raw_size{leaf.RawValueSize(i)};
+    if (raw_size & OVERFLOW_FLAG) return {engine.Page(ReadLE32(leaf.ValueData(i))), raw_size & ~OVERFLOW_FLAG};
+    return {leaf.ValueData(i), raw_size};
+}
+
+//! Shortest key that is greater than prev and not greater than next.
+std::string Separator(std::span<const std::byte> prev, std::span<const std::byte> next)
+{
+    size_t common{0};
+    while (common < prev.size() && prev[common] == next[common]) ++common;
+    return std::string{reinterpret_cast<const char*>(next.data()), common + 1};
+}
+
+//! Split entries into consecutive groups that each fit in a page, of about
+//! equal size. Returns the index one past the end of each group.
+template <typename T>
+std::vector<size_t> SplitIntoPages(std::span<const T> entries)
+{
+    size_t total{0};
+    for (const T& entry : entries) total += entry.EncodedSize();
+    const size_t pages{(total + PAGE_CAPACITY - 1) / PAGE_CAPACITY};
+    const size_t target{(total + pages - 1) / pages};
+    std::vector<size_t> ends;
+    size_t fill{0};
+    for (size_t i{0}; i < entries.size(); ++i) {
+        const size_t size{entries[i].EncodedSize()};
+        if (fill > 0 && fill + size > target) {
+            ends.push_back(i);
+            fill = 0;
+        }
+        fill += size;
+    }
+    ends.push_back(entries.size());
+    return ends;
+}
+
+void WriteMeta(std::byte* page, const MmapDBEngine::Meta& meta)
+{
+    std::memset(page, 0, PAGE_SIZE);
+    WriteLE64(page, MMAPDB_MAGIC);
+    WriteLE32(page + 8, MMAPDB_VERSION);
+    WriteLE32(page + 12, PAGE_SIZE);
+    WriteLE64(page + 16, meta.txn);
+    WriteLE32(page + 24, meta.root);
+    WriteLE32(page + 28, meta.next_pgno);
+    WriteLE32(page + 32, meta.freelist);
+    WriteLE32(page + 36, meta.freelist_pages);
+    WriteLE64(page + 48, CSipHasher{0, 0}.Write(UCharSpanCast(std::span{page, 48})).Finalize());
+}
+
+std::optional<MmapDBEngine::Meta> ReadMeta(const std::byte* page)
+{
+    if (ReadLE64(page) != MMAPDB_MAGIC || ReadLE32(page + 8) != MMAPDB_VERSION || ReadLE32(page + 12) != PAGE_SIZE) return std::nullopt;
+    if (ReadLE64(page + 48) != CSipHasher{0, 0}.Write(UCharSpanCast(std::span{page, 48})).Finalize()) return std::nullopt;
+    return MmapDBEngine::Meta{
+        .txn = ReadLE64(page + 16),
+        .root = ReadLE32(page + 24),
+        .next_pgno = ReadLE32(page + 28),
+        .freelist = ReadLE32(page + 32),
+        .freelist_pages = ReadLE32(page + 36),
+    };
+}
+
+class MmapBatch final : public DBEngineBatch
+{
+public:
+    //! Changes in the order they were made. A missing value is a deletion.
+    std::vector<std::pair<std::string, std::optional<std::string>>> m_ops;
+    size_t m_size{0};
+
+    void Put(std::span<const std::byte> key, std::span<const std::byte> value) override
+    {
+        if (key.size() > MmapDBEngine::MAX_KEY_SIZE) throw dbwrapper_error(strprintf("Key of %u bytes is too large for the mmap database", key.size()));
+        m_ops.emplace_back(std::string{reinterpret_cast<const char*>(key.data()), key.size()},
+                           std::string{reinterpret_cast<const char*>(value.data()), value.size()});
+        m_size += key.size() + value.size() + 16;
+    }
+    void Delete(std::span<const std::byte> key) override
+    {
+        m_ops.emplace_back(std::string{reinterpret_cast<const char*>(key.data()), key.size()}, std::nullopt);
+        m_size += key.size() + 16;
+    }
+    void Clear() override
+    {
+        m_ops.clear();
+        m_size = 0;
+    }
+    size_t ApproximateSize() const override { return m_size; }
+};
+
+class MmapIterator final : public DBEngineIterator
+{
+    const MmapDBEngine::ReadTxn m_txn;
+    //! Path from the root to the current leaf entry.
+    std::vector<std::pair<NodeView, size_t>> m_path;
+
+    NodeView Node(Pgno pgno) const { return NodeView{m_txn.Engine().Page(pgno)}; }
+
+    void DescendFirst(Pgno pgno)
+    {
+        while (true) {
+            const NodeView node{Node(pgno)};
+            m_path.emplace_back(node, 0);
+            if (node.IsLeaf()) return;
+            pgno = node.ChildPage(0);
+        }
+    }
+
+    //! Move to the next leaf, once the current one is exhausted.
+    void NextLeaf()
+    {
+        m_path.pop_back();
+        while (!m_path.empty()) {
+            auto& [node, index]{m_path.back()};
+            if (++index < node.Count()) {
+                DescendFirst(node.ChildPage(index));
+                return;
+            }
+            m_path.pop_back();
+        }
+    }
+
+public:
+    explicit MmapIterator(const MmapDBEngine& engine) : m_txn{engine} {}
+
+    bool Valid() const override { return !m_path.empty(); }
+
+    void SeekToFirst() override
+    {
+        m_path.clear();
+        if (m_txn.Root() != 0) DescendFirst(m_txn.Root());
+    }
+
+    void Seek(std::span<const std::byte> key) override
+    {
+        m_path.clear();
+        if (m_txn.Root() == 0) return;
+        NodeView node{Node(m_txn.Root())};
+        while (!node.IsLeaf()) {
+            const size_t index{node.FindChild(key)};
+            m_path.emplace_back(node, index);
+            node = Node(node.ChildPage(index));
+        }
+        const size_t index{node.LowerBound(key)};
+        m_path.emplace_back(node, index);
+        if (index == node.Count()) NextLeaf();
+    }
+
+    void Next() override
+    {
+        auto& [leaf, index]{m_path.back()};
+        if (++index == leaf.Count()) NextLeaf();
+    }
+
+    std::span<const std::byte> Key() const override
+    {
+        const auto& [leaf, index]{m_path.back()};
+        return leaf.LeafKey(index);
+    }
+
+    std::span<const std::byte> Value() const override
+    {
+        const auto& [leaf, index]{m_path.back()};
+        return LeafValue(m_txn.Engine(), leaf, index);
+    }
+};
+} // namespace
+
+struct MmapDBEngine::LeafEntry {
+    std::span<const std::byte> key{};
+    //! The value, if stored in the leaf.
+    std::span<const std::byte> value{};
+    //! First page of the value's run, if not stored in the leaf.
+    Pgno overflow{0};
+    uint32_t overflow_size{0};
+
+    size_t EncodedSize() const { return 2 + 6 + key.size() + (overflow ? 4 : value.size()); }
+};
+
+struct MmapDBEngine::Child {
+    std::string key;
+    Pgno pgno;
+    //! Bytes used in the child page, if it was written by the current write.
+    size_t fill{std::numeric_limits<size_t>::max()};
+
+    size_t EncodedSize() const { return 2 + 6 + key.size(); }
+};
+
+struct MmapDBEngine::Op {
+    std::span<const std::byte> key;
+    //! New value, or nullptr to delete.
+    const std::string* value;
+};
+
+bool DestroyMmapDB(const fs::path& path)
+{
+    std::error_code ec;
+    fs::remove(path / MMAPDB_FILENAME, ec);
+    return !ec;
+}
+
+MmapDBEngine::ReadTxn::ReadTxn(const MmapDBEngine& engine) : m_engine{engine}
+{
+    // Start looking for a free slot at one depending on the thread, so that
+    // threads reading at the same time don't compete for the same slots.
+    const size_t start{std::hash<std::thread::id>{}(std::this_thread::get_id())};
+    for (size_t i{0}; i < READER_SLOTS && m_slot == READER_SLOTS; ++i) {
+        uint64_t expected{NO_READER};
+        if (m_engine.m_reader_slots[(start + i) % READER_SLOTS].txn.compare_exchange_strong(expected, m_engine.m_txn.load())) {
+            m_slot = (start + i) % READER_SLOTS;
+        }
+    }
+    if (m_slot == READER_SLOTS) {
+        LOCK(m_engine.m_mutex);
+        m_txn = m_engine.m_txn.load();
+        m_root = m_engine.m_roots[m_txn % 2].load();
+        ++m_engine.m_readers[m_txn];
+        return;
+    }
+    // A writer that scanned the slots before the commit was stored in ours may
+    // reuse its pages once it has published the next two commits, and the
+    // root may be of a later commit by then. Both are ruled out once the
+    // commit is still the latest after the slot was updated.
+    auto& slot{m_engine.m_reader_slots[m_slot].txn};
+    do {
+        m_txn = m_engine.m_txn.load();
+        m_root = m_engine.m_roots[m_txn % 2].load();
+        slot.store(m_txn);
+    } while (m_engine.m_txn.load() != m_txn);
+}
+
+MmapDBEngine::ReadTxn::~ReadTxn()
+{
+    if (m_slot < READER_SLOTS) {
+        m_engine.m_reader_slots[m_slot].txn.store(NO_READER);
+        return;
+    }
+    LOCK(m_engine.m_mutex);
+    const auto it{m_engine.m_readers.find(m_txn)};
+    if (--it->second == 0) m_engine.m_readers.erase(it);
+}
+
+MmapDBEngine::MmapDBEngine(const DBParams& params)
+    : m_path{params.path / MMAPDB_FILENAME}, m_memory_only{params.memory_only}, m_map_size{MapSize(params.memory_only)}
+{
+#ifdef WIN32
+    throw dbwrapper_error("The mmap database backend is not supported on Windows");
+#else
+    if (!m_memory_only) {
+        if (util::LockDirectory(params.path, "LOCK") != util::LockResult::Success) {
+            throw dbwrapper_error(strprintf("Cannot obtain a lock on database directory %s", fs::PathToString(params.path)));
+        }
+        LogPrintf("Opening mmap database in %s\n", fs::PathToString(params.path));
+    }
+    LOCK(m_write_mutex);
+    try {
+        Open();
+    } catch (const dbwrapper_error&) {
+        if (m_map) munmap(m_map, m_map_size);
+        if (m_fd != -1) close(m_fd);
+        if (!m_memory_only) UnlockDirectory(params.path, "LOCK");
+        throw;
+    }
+    LogPrintf("Opened mmap database successfully\n");
+#endif
+}
+
+MmapDBEngine::~MmapDBEngine()
+{
+#ifndef WIN32
+    {
+        LOCK(m_write_mutex);
+        // Make the last write durable on shutdown, even if it wasn't synced.
+        if (m_meta_unsynced && !m_failed) {
+            try {
+                Sync(m_meta.txn % 2, 1);
+            } catch (const dbwrapper_error& e) {
+                LogPrintf("%s\n", e.what());
+            }
+        }
+    }
+    munmap(m_map, m_map_size);
+    if (m_fd != -1) {
+        close(m_fd);
+        UnlockDirectory(m_path.parent_path(), "LOCK");
+    }
+#endif
+}
+
+void MmapDBEngine::Open()
+{
+#ifndef WIN32
+    if (m_memory_only) {
+        void* map{mmap(nullptr, m_map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)};
+        if (map == MAP_FAILED) throw dbwrapper_error(strprintf("Failed to reserve memory for mmap database: %s", SysErrorString(errno)));
+        m_map = static_cast<std::byte*>(map);
+        m_file_size = m_map_size;
+        m_next_pgno = FIRST_DATA_PAGE;
+        Publish(Meta{.next_pgno = m_next_pgno});
+        return;
+    }
+
+    m_fd = open(fs::PathToString(m_path).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd == -1) throw dbwrapper_error(strprintf("Failed to open %s: %s", fs::PathToString(m_path), SysErrorString(errno)));
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) throw dbwrapper_error(strprintf("Failed to stat %s: %s", fs::PathToString(m_path), SysErrorString(errno)));
+    m_file_size = st.st_size;
+    if (m_file_size > m_map_size) throw dbwrapper_error(strprintf("%s is too large to map", fs::PathToString(m_path)));
+    void* map{mmap(nullptr, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0)};
+    if (map == MAP_FAILED) throw dbwrapper_error(strprintf("Failed to map %s: %s", fs::PathToString(m_path), SysErrorString(errno)));
+    m_map = static_cast<std::byte*>(map);
+    // Lookups are scattered across the file, so reading ahead only evicts
+    // useful pages.
+    posix_madvise(m_map, m_map_size, POSIX_MADV_RANDOM);
+
+    Meta meta;
+    const auto is_zero{[&](Pgno pgno) { return std::all_of(Page(pgno), Page(pgno + 1), [](std::byte b) { return b == std::byte{0}; }); }};
+    // A crash while creating the file may leave the meta pages empty.
+    if (m_file_size == 0 || (m_file_size >= FIRST_DATA_PAGE * PAGE_SIZE && is_zero(0) && is_zero(1))) {
+        meta.next_pgno = FIRST_DATA_PAGE;
+        Extend(FIRST_DATA_PAGE);
+        WriteMeta(MutablePage(0), meta);
+        Sync(0, 1);
+    } else {
+        std::optional<Meta> metas[2];
+        if (m_file_size >= FIRST_DATA_PAGE * PAGE_SIZE) {
+            metas[0] = ReadMeta(Page(0));
+            metas[1] = ReadMeta(Page(1));
+        }
+        if (!metas[0] && !metas[1]) throw dbwrapper_error(strprintf("Corrupted mmap database %s: no valid meta page", fs::PathToString(m_path)));
+        meta = (metas[0] && (!metas[1] || metas[0]->txn > metas[1]->txn)) ? *metas[0] : *metas[1];
+        if (size_t{meta.next_pgno} * PAGE_SIZE > m_file_size) throw dbwrapper_error(strprintf("Corrupted mmap database %s: file is truncated", fs::PathToString(m_path)));
+    }
+    m_next_pgno = meta.next_pgno;
+
+    // The free list holds the pages that were free at the last commit,
+    // followed by the pages that commit freed. Nobody reads the database
+    // yet, but the older meta page may still refer to the latter.
+    if (meta.freelist != 0) {
+        const std::byte* list{Page(meta.freelist)};
+        const uint32_t num_free{ReadLE32(list)};
+        const uint32_t num_pending{ReadLE32(list + 4)};
+        if (8 + 4 * (size_t{num_free} + num_pending) > size_t{meta.freelist_pages} * PAGE_SIZE) {
+            throw dbwrapper_error(strprintf("Corrupted mmap database %s: invalid free list", fs::PathToString(m_path)));
+        }
+        m_free.reserve(num_free);
+        for (uint32_t i{0}; i < num_free; ++i) m_free.push_back(ReadLE32(list + 8 + 4 * i));
+        std::vector<Pgno> pending;
+        pending.reserve(num_pending);
+        for (uint32_t i{0}; i < num_pending; ++i) pending.push_back(ReadLE32(list + 8 + 4 * (size_t{num_free} + i)));
+        m_pending.emplace_back(meta.txn, std::move(pending));
+    }
+    Publish(meta);
+#endif
+}
+
+void MmapDBEngine::Publish(const Meta& meta)
+{
+    m_meta = meta;
+    LOCK(m_mutex);
+    m_roots[meta.txn % 2] = meta.root;
+    m_used_pages = meta.next_pgno;
+    m_txn = meta.txn;
+}
+
+void MmapDBEngine::Extend(Pgno end)
+{
+    const size_t needed{size_t{end} * PAGE_SIZE};
+    if (needed <= m_file_size) return;
+    if (needed > m_map_size) throw dbwrapper_error(strprintf("Mmap database %s is full (%u MiB)", fs::PathToString(m_path), m_map_size >> 20));
+    assert(!m_memory_only);
+#ifndef WIN32
+    size_t new_size{std::max(needed, m_file_size + std::max(MIN_GROWTH, m_file_size / 8))};
+    new_size = std::min(m_map_size, (new_size + MIN_GROWTH - 1) / MIN_GROWTH * MIN_GROWTH);
+    // Reserve the space on disk, so that running out of it fails here rather
+    // than with a SIGBUS when a page of the mapping is first written.
+    int result{EOPNOTSUPP};
+#ifdef HAVE_POSIX_FALLOCATE
+    result = posix_fallocate(m_fd, m_file_size, new_size - m_file_size);
+#endif
+    if (result == EINVAL || result == EOPNOTSUPP) result = ftruncate(m_fd, new_size) == 0 ? 0 : errno;
+    if (result != 0) throw dbwrapper_error(strprintf("Failed to extend %s: %s", fs::PathToString(m_path), SysErrorString(result)));
+    m_file_size = new_size;
+#endif
+}
+
+void MmapDBEngine::Sync(Pgno first, size_t pages)
+{
+    if (m_memory_only) return;
+#ifndef WIN32
+    // msync() takes whole pages of the system, which may be larger than ours.
+    static const size_t sys_page_size{size_t(sysconf(_SC_PAGESIZE))};
+    const size_t begin{size_t{first} * PAGE_SIZE / sys_page_size * sys_page_size};
+    const size_t end{std::min(m_file_size, ((size_t{first} + pages) * PAGE_SIZE + sys_page_size - 1) / sys_page_size * sys_page_size)};
+    if (msync(m_map + begin, end - begin, MS_SYNC) != 0) throw dbwrapper_error(strprintf("Failed to sync %s: %s", fs::PathToString(m_path), SysErrorString(errno)));
+#endif
+}
+
+void MmapDBEngine::SyncDirty()
+{
+    if (m_memory_only) return;
+    std::vector<Pgno> pages{m_dirty.begin(), m_dirty.end()};
+    if (m_meta_unsynced) pages.push_back(m_meta.txn % 2);
+    std::sort(pages.begin(), pages.end());
+    for (size_t begin{0}, end{1}; begin < pages.size(); begin = end++) {
+        while (end < pages.size() && pages[end] - pages[end - 1] <= MAX_SYNC_GAP) ++end;
+        Sync(pages[begin], pages[end - 1] - pages[begin] + 1);
+    }
+    m_meta_unsynced = false;
+}
+
+Pgno MmapDBEngine::AllocatePage()
+{
+    Pgno pgno;
+    if (!m_free.empty()) {
+        pgno = m_free.back();
+        m_free.pop_back();
+    } else {
+        Extend(m_next_pgno + 1);
+        pgno = m_next_pgno++;
+    }
+    m_dirty.insert(pgno);
+    return pgno;
+}
+
+Pgno MmapDBEngine::AllocateRun(size_t pages)
+{
+    if (pages == 1) return AllocatePage();
+    // In the free pages, sorted in descending order, a run is a range whose
+    // first and last pages are pages - 1 apart.
+    for (size_t i{0}; i + pages <= m_free.size(); ++i) {
+        if (m_free[i] - m_free[i + pages - 1] != pages - 1) continue;
+        const Pgno first{m_free[i + pages - 1]};
+        m_free.erase(m_free.begin() + i, m_free.begin() + i + pages);
+        for (Pgno pgno{first}; pgno < first + pages; ++pgno) m_dirty.insert(pgno);
+        return first;
+    }
+    if (pages > std::numeric_limits<Pgno>::max() - m_next_pgno) throw dbwrapper_error("Mmap database page numbers exhausted");
+    Extend(m_next_pgno + pages);
+    const Pgno first{m_next_pgno};
+    m_next_pgno += pages;
+    for (Pgno pgno{first}; pgno < m_next_pgno; ++pgno) m_dirty.insert(pgno);
+    return first;
+}
+
+void MmapDBEngine::FreePage(Pgno pgno)
+{
+    if (m_dirty.erase(pgno)) {
+        m_freed_dirty.push_back(pgno);
+    } else {
+        m_freed.push_back(pgno);
+    }
+}
+
+void MmapDBEngine::FreeValue(const LeafEntry& entry)
+{
+    const size_t pages{(size_t{entry.overflow_size} + PAGE_SIZE - 1) / PAGE_SIZE};
+    for (size_t i{0}; entry.overflow && i < pages; ++i) FreePage(entry.overflow + i);
+}
+
+std::vector<MmapDBEngine::LeafEntry> MmapDBEngine::MergeLeaf(std::vector<LeafEntry> entries, std::span<const Op> ops)
+{
+    std::vector<LeafEntry> merged;
+    merged.reserve(entries.size() + ops.size());
+    auto it{entries.begin()};
+    for (const Op& op : ops) {
+        while (it != entries.end() && CompareKeys(it->key, op.key) < 0) merged.push_back(*it++);
+        if (it != entries.end() && CompareKeys(it->key, op.key) == 0) FreeValue(*it++);
+        if (!op.value) continue;
+        LeafEntry& entry{merged.emplace_back(LeafEntry{.key = op.key})};
+        const auto value{MakeByteSpan(*op.value)};
+        if (value.size() <= MAX_INLINE_VALUE) {
+            entry.value = value;
+        } else {
+            entry.overflow = AllocateRun((value.size() + PAGE_SIZE - 1) / PAGE_SIZE);
+            entry.overflow_size = value.size();
+            std::memcpy(MutablePage(entry.overflow), value.data(), value.size());
+        }
+    }
+    merged.insert(merged.end(), it, entries.end());
+    return merged;
+}
+
+std::vector<MmapDBEngine::Child> MmapDBEngine::WriteLeaves(const std::string& lower, std::span<const LeafEntry> entries)
+{
+    std::vector<Child> pages;
+    if (entries.empty()) return pages;
+    size_t begin{0};
+    for (const size_t end : SplitIntoPages(entries)) {
+        const Pgno pgno{AllocatePage()};
+        std::byte* page{MutablePage(pgno)};
+        size_t offset{PAGE_HEADER_SIZE + 2 * (end - begin)};
+        for (size_t i{begin}; i < end; ++i) {
+            const LeafEntry& entry{entries[i]};
+            WriteLE16(page + PAGE_HEADER_SIZE + 2 * (i - begin), offset);
+            std::byte* out{page + offset};
+            WriteLE16(out, entry.key.size());
+            std::memcpy(out + 6, entry.key.data(), entry.key.size());
+            if (entry.overflow) {
+                WriteLE32(out + 2, entry.overflow_size | OVERFLOW_FLAG);
+                WriteLE32(out + 6 + entry.key.size(), entry.overflow);
+            } else {
+                WriteLE32(out + 2, entry.value.size());
+                if (!entry.value.empty()) std::memcpy(out + 6 + entry.key.size(), entry.value.data(), entry.value.size());
+            }
+            offset += entry.EncodedSize() - 2;
+        }
+        WriteLE16(page, PAGE_LEAF);
+        WriteLE16(page + 2, end - begin);
+        WriteLE16(page + 4, offset - PAGE_HEADER_SIZE);
+        pages.push_back(Child{
+            .key = begin == 0 ? lower : Separator(entries[begin - 1].key, entries[begin].key),
+            .pgno = pgno,
+            .fill = offset - PAGE_HEADER_SIZE,
+        });
+        begin = end;
+    }
+    return pages;
+}
+
+std::vector<MmapDBEngine::Child> MmapDBEngine::WriteBranches(std::span<const Child> children)
+{
+    std::vector<Child> pages;
+    size_t begin{0};
+    for (const size_t end : SplitIntoPages(children)) {
+        const Pgno pgno{AllocatePage()};
+        std::byte* page{MutablePage(pgno)};
+        size_t offset{PAGE_HEADER_SIZE + 2 * (end - begin)};
+        for (size_t i{begin}; i < end; ++i) {
+            const Child& child{children[i]};
+            WriteLE16(page + PAGE_HEADER_SIZE + 2 * (i - begin), offset);
+            std::byte* out{page + offset};
+            WriteLE32(out, child.pgno);
+            WriteLE16(out + 4, child.key.size());
+            if (!child.key.empty()) std::memcpy(out + 6, child.key.data(), child.key.size());
+            offset += child.EncodedSize() - 2;
+        }
+        WriteLE16(page, PAGE_BRANCH);
+        WriteLE16(page + 2, end - begin);
+        WriteLE16(page + 4, offset - PAGE_HEADER_SIZE);
+        pages.push_back(Child{.key = children[begin].key, .pgno = pgno, .fill = offset - PAGE_HEADER_SIZE});
+        begin = end;
+    }
+    return pages;
+}
+
+void MmapDBEngine::Rebalance(std::vector<Child>& children, std::vector<bool>& fresh)
+{
+    size_t i{0};
+    while (i < children.size() && children.size() > 1) {
+        if (!fresh[i] || children[i].fill >= MIN_FILL) {
+            ++i;
+            continue;
+        }
+        // Merge the underfull page with its right neighbour, or with its left
+        // one if it is the last, and split the result again if needed.
+        const size_t left{i + 1 < children.size() ? i : i - 1};
+        const NodeView left_node{Page(children[left].pgno)};
+        const NodeView right_node{Page(children[left + 1].pgno)};
+        std::vector<Child> merged;
+        if (left_node.IsLeaf()) {
+            std::vector<LeafEntry> entries;
+            for (const NodeView& node : {left_node, right_node}) {
+                for (size_t j{0}; j < node.Count(); ++j) {
+                    LeafEntry& entry{entries.emplace_back(LeafEntry{.key = node.LeafKey(j)})};
+                    if (const uint32_t raw_size{node.RawValueSize(j)}; raw_size & OVERFLOW_FLAG) {
+                        entry.overflow = ReadLE32(node.ValueData(j));
+                        entry.overflow_size = raw_size & ~OVERFLOW_FLAG;
+                    } else {
+                        entry.value = {node.ValueData(j), raw_size};
+                    }
+                }
+            }
+            merged = WriteLeaves(children[left].key, entries);
+        } else {
+            std::vector<Child> entries;
+            for (size_t side{0}; side < 2; ++side) {
+                const NodeView& node{side == 0 ? left_node : right_node};
+                for (size_t j{0}; j < node.Count(); ++j) {
+                    const auto key{j == 0 ? KeySpan(children[left + side].key) : node.BranchKey(j)};
+                    entries.push_back(Child{.key = {reinterpret_cast<const char*>(key.data()), key.size()}, .pgno = node.ChildPage(j)});
+                }
+            }
+            merged = WriteBranches(entries);
+        }
+        FreePage(children[left].pgno);
+        FreePage(children[left + 1].pgno);
+        children.erase(children.begin() + left, children.begin() + left + 2);
+        fresh.erase(fresh.begin() + left, fresh.begin() + left + 2);
+        children.insert(children.begin() + left, merged.begin(), merged.end());
+        fresh.insert(fresh.begin() + left, merged.size(), true);
+        i = left;
+    }
+}
+
+std::vector<MmapDBEngine::Child> MmapDBEngine::Apply(const Child& node, std::span<const Op> ops)
+{
+    const NodeView view{Page(node.pgno)};
+    FreePage(node.pgno);
+    if (view.IsLeaf()) {
+        std::vector<LeafEntry> entries;
+        entries.reserve(view.Count());
+        for (size_t i{0}; i < view.Count(); ++i) {
+            LeafEntry& entry{entries.emplace_back(LeafEntry{.key = view.LeafKey(i)})};
+            if (const uint32_t raw_size{view.RawValueSize(i)}; raw_size & OVERFLOW_FLAG) {
+                entry.overflow = ReadLE32(view.ValueData(i));
+                entry.overflow_size = raw_size & ~OVERFLOW_FLAG;
+            } else {
+                entry.value = {view.ValueData(i), raw_size};
+            }
+        }
+        return WriteLeaves(node.key, MergeLeaf(std::move(entries), ops));
+    }
+
+    std::vector<Child> children;
+    std::vector<bool> fresh;
+    size_t op_begin{0};
+    for (size_t i{0}; i < view.Count(); ++i) {
+        const auto key{i == 0 ? KeySpan(node.key) : view.BranchKey(i)};
+        Child child{.key = {reinterpret_cast<const char*>(key.data()), key.size()}, .pgno = view.ChildPage(i)};
+        size_t op_end{ops.size()};
+        if (i + 1 < view.Count()) {
+            const auto next_key{view.BranchKey(i + 1)};
+            op_end = std::partition_point(ops.begin() + op_begin, ops.end(), [&](const Op& op) { return CompareKeys(op.key, next_key) < 0; }) - ops.begin();
+        }
+        if (op_begin == op_end) {
+            children.push_back(std::move(child));
+            fresh.push_back(false);
+            continue;
+        }
+        const auto replaced{Apply(child, ops.subspan(op_begin, op_end - op_begin))};
+        children.insert(children.end(), replaced.begin(), replaced.end());
+        fresh.insert(fresh.end(), replaced.size(), true);
+        op_begin = op_end;
+    }
+    if (children.empty()) return children;
+    // The first child may have been removed; its successor then covers the
+    // whole lower range.
+    children[0].key = node.key;
+    Rebalance(children, fresh);
+    return WriteBranches(children);
+}
+
+void MmapDBEngine::Write(DBEngineBatch& batch_in, bool sync)
+{
+    auto& batch{static_cast<MmapBatch&>(batch_in)};
+    if (batch.m_ops.empty()) return;
+
+    // Sort the changes by key. Only the last change to a key counts.
+    std::vector<size_t> order(batch.m_ops.size());
+    for (size_t i{0}; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return batch.m_ops[a].first < batch.m_ops[b].first; });
+    std::vector<Op> ops;
+    ops.reserve(order.size());
+    for (size_t i{0}; i < order.size(); ++i) {
+        if (i + 1 < order.size() && batch.m_ops[order[i]].first == batch.m_ops[order[i + 1]].first) continue;
+        const auto& [key, value]{batch.m_ops[order[i]]};
+        ops.push_back(Op{.key = KeySpan(key), .value = value ? &*value : nullptr});
+    }
+
+    LOCK(m_write_mutex);
+    if (m_failed) throw dbwrapper_error(strprintf("Mmap database %s is unusable after an earlier write failed", fs::PathToString(m_path)));
+    Meta meta{m_meta};
+    // Pages freed by a commit are part of the tree before it. They can be
+    // reused once both meta pages and all readers are at that commit or later.
+    // The meta page of the latest commit may not be synced yet, but the older
+    // one is, and it is only overwritten once the latest is synced too.
+    uint64_t reusable{meta.txn > 0 ? meta.txn - 1 : 0};
+    for (const ReaderSlot& slot : m_reader_slots) reusable = std::min(reusable, slot.txn.load());
+    {
+        LOCK(m_mutex);
+        if (!m_readers.empty()) reusable = std::min(reusable, m_readers.begin()->first);
+    }
+    auto it{m_pending.begin()};
+    for (; it != m_pending.end() && it->first <= reusable; ++it) {
+        m_free.insert(m_free.end(), it->second.begin(), it->second.end());
+    }
+    m_pending.erase(m_pending.begin(), it);
+    std::sort(m_free.begin(), m_free.end(), std::greater{});
+    try {
+        std::vector<Child> level;
+        if (meta.root != 0) {
+            level = Apply(Child{.key = {}, .pgno = meta.root}, ops);
+        } else {
+            level = WriteLeaves({}, MergeLeaf({}, ops));
+        }
+        while (level.size() > 1) {
+            level = WriteBranches(level);
+        }
+        meta.root = level.empty() ? 0 : level[0].pgno;
+        // Drop branch pages left with a single child at the top.
+        while (meta.root != 0) {
+            const NodeView root{Page(meta.root)};
+            if (root.IsLeaf() || root.Count() > 1) break;
+            FreePage(meta.root);
+            meta.root = root.ChildPage(0);
+        }
+        Commit(meta, sync);
+    } catch (...) {
+        m_failed = true;
+        throw;
+    }
+}
+
+void MmapDBEngine::Commit(Meta meta, bool sync)
+{
+    // Write the free list: the pages free after this commit, then the ones
+    // this commit frees, which the previous tree still uses. Its own pages may
+    // be taken from the list, so they are allocated first, for the longest it
+    // can be.
+    for (Pgno i{0}; i < meta.freelist_pages; ++i) FreePage(meta.freelist + i);
+    size_t pending_pages{0};
+    for (const auto& [txn, pages] : m_pending) pending_pages += pages.size();
+    const size_t list_bytes{8 + 4 * (m_free.size() + m_freed_dirty.size() + pending_pages + m_freed.size())};
+    meta.freelist_pages = (list_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+    meta.freelist = AllocateRun(meta.freelist_pages);
+    std::vector<Pgno> free_list{m_free};
+    free_list.insert(free_list.end(), m_freed_dirty.begin(), m_freed_dirty.end());
+    for (const auto& [txn, pages] : m_pending) free_list.insert(free_list.end(), pages.begin(), pages.end());
+    std::byte* list{MutablePage(meta.freelist)};
+    WriteLE32(list, free_list.size());
+    WriteLE32(list + 4, m_freed.size());
+    size_t offset{8};
+    for (const std::vector<Pgno>* pages : {&free_list, &m_freed}) {
+        for (const Pgno pgno : *pages) {
+            WriteLE32(list + offset, pgno);
+            offset += 4;
+        }
+    }
+    meta.next_pgno = m_next_pgno;
+    ++meta.txn;
+
+    // The new pages must be on disk before a meta page refers to them, and
+    // the meta page of the previous commit before the one it is paired with
+    // is overwritten.
+    SyncDirty();
+    WriteMeta(MutablePage(meta.txn % 2), meta);
+    if (sync) {
+        Sync(meta.txn % 2, 1);
+    } else {
+        m_meta_unsynced = true;
+    }
+
+    m_free.insert(m_free.end(), m_freed_dirty.begin(), m_freed_dirty.end());
+    m_pending.emplace_back(meta.txn, std::move(m_freed));
+    m_freed.clear();
+    m_freed_dirty.clear();
+    m_dirty.clear();
+    size_t pending_usage{memusage::DynamicUsage(m_pending)};
+    for (const auto& [txn, pages] : m_pending) pending_usage += memusage::DynamicUsage(pages);
+    m_memory_usage = memusage::DynamicUsage(m_free) + pending_usage;
+    Publish(meta);
+}
+
+std::optional<std::string> MmapDBEngine::Read(std::span<const std::byte> key) const
+{
+    const ReadTxn txn{*this};
+    if (txn.Root() == 0) return std::nullopt;
+    NodeView node{Page(txn.Root())};
+    while (!node.IsLeaf()) node = NodeView{Page(node.ChildPage(node.FindChild(key)))};
+    const size_t index{node.LowerBound(key)};
+    if (index == node.Count() || CompareKeys(node.LeafKey(index), key) != 0) return std::nullopt;
+    const auto value{LeafValue(*this, node, index)};
+    return std::string{reinterpret_cast<const char*>(value.data()), value.size()};
+}
+
+bool MmapDBEngine::Exists(std::span<const std::byte> key) const
+{
+    const ReadTxn txn{*this};
+    if (txn.Root() == 0) return false;
+    NodeView node{Page(txn.Root())};
+    while (!node.IsLeaf()) node = NodeView{Page(node.ChildPage(node.FindChild(key)))};
+    const size_t index{node.LowerBound(key)};
+    return index < node.Count() && CompareKeys(node.LeafKey(index), key) == 0;
+}
+
+std::unique_ptr<DBEngineBatch> MmapDBEngine::NewBatch() const
+{
+    return std::make_unique<MmapBatch>();
+}
+
+std::unique_ptr<DBEngineIterator> MmapDBEngine::NewIterator() const
+{
+    return std::make_unique<MmapIterator>(*this);
+}
+
+size_t MmapDBEngine::EstimateSize(std::span<const std::byte> begin, std::span<const std::byte> end) const
+{
+    const ReadTxn txn{*this};
+    if (txn.Root() == 0) return 0;
+    // Locate both keys as a fraction of the tree, assuming the pages on each
+    // level hold about the same number of entries.
+    const auto position{[&](std::span<const std::byte> key) {
+        double pos{0}, width{1};
+        NodeView node{Page(txn.Root())};
+        while (!node.IsLeaf()) {
+            const size_t index{node.FindChild(key)};
+            width /= node.Count();
+            pos += width * index;
+            node = NodeView{Page(node.ChildPage(index))};
+        }
+        return pos + width * node.LowerBound(key) / node.Count();
+    }};
+    const double fraction{position(end) - position(begin)};
+    const size_t used_bytes{size_t{m_used_pages.load()} * PAGE_SIZE};
+    return fraction > 0 ? size_t(fraction * used_bytes) : 0;
+}
+
+size_t MmapDBEngine::DynamicMemoryUsage() const
+{
+    return m_memory_usage;
+}
+
+void MmapDBEngine::Compact()
+{
+    // Overwritten and deleted data is reclaimed page by page as later writes
+    // reuse the free pages, so there is nothing to compact.
+}
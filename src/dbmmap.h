@@ -0,0 +1,199 @@
+// Copyright (c) 2026-present The QTC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef QTC_DBMMAP_H
+#define QTC_DBMMAP_H
+
+#include <dbengine.h>
+#include <sync.h>
+#include <util/fs.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/** Name of the MmapDBEngine data file inside the database directory. */
+inline constexpr const char* MMAPDB_FILENAME{"data.mmdb"};
+
+/** Remove the MmapDBEngine data file in path, if there is one. */
+bool DestroyMmapDB(const fs::path& path);
+
+/**
+ * Storage engine keeping a copy-on-write B+tree in a memory-mapped file, in
+ * the style of LMDB.
+ *
+ * Reads walk the tree in place in the mapping: there is no block cache or
+ * decompression, and the operating system's page cache holds the hot pages.
+ * Readers take no lock and never wait for the writer. A write copies every
+ * page it changes to free space, syncs them, and then commits by writing the
+ * new root to the older of two meta pages, so that a crash leaves the last
+ * committed tree intact. Pages that a write replaces are reused once neither
+ * meta page nor any reader refers to a tree that contains them. A synced write
+ * is durable once it returns. Otherwise its meta page is synced with the next
+ * write, and only a crash of the operating system before then can lose it.
+ *
+ * The layout is tuned for the chainstate, whose keys are short and begin with
+ * a transaction hash: branch pages only store the shortest prefix telling two
+ * leaves apart, which for hashes is a few bytes, so the tree is wide and shallow.
+ */
+class MmapDBEngine final : public DBEngine
+{
+public:
+    using Pgno = uint32_t;
+
+    //! Size of a page, in bytes.
+    static constexpr size_t PAGE_SIZE{4096};
+    //! Longest key that can be stored.
+    static constexpr size_t MAX_KEY_SIZE{512};
+    //! Values larger than this are stored in pages of their own.
+    static constexpr size_t MAX_INLINE_VALUE{1024};
+
+    explicit MmapDBEngine(const DBParams& params);
+    ~MmapDBEngine() override;
+
+    std::optional<std::string> Read(std::span<const std::byte> key) const override;
+    bool Exists(std::span<const std::byte> key) const override;
+    std::unique_ptr<DBEngineBatch> NewBatch() const override;
+    void Write(DBEngineBatch& batch, bool sync) override EXCLUSIVE_LOCKS_REQUIRED(!m_write_mutex, !m_mutex);
+    std::unique_ptr<DBEngineIterator> NewIterator() const override;
+    size_t EstimateSize(std::span<const std::byte> begin, std::span<const std::byte> end) const override;
+    size_t DynamicMemoryUsage() const override;
+    void Compact() override;
+    void CompactRange(std::span<const std::byte> begin, std::span<const std::byte> end) override {}
+    //! Writes only ever wait for each other.
+    DBWriteStalls WriteStalls() const override { return {}; }
+
+    //! Committed state, as stored in a meta page.
+    struct Meta {
+        uint64_t txn{0};
+        Pgno root{0};
+        //! First page past the end of the used part of the file.
+        Pgno next_pgno{0};
+        //! Run of pages listing the free pages, or 0 if there are none.
+        Pgno freelist{0};
+        uint32_t freelist_pages{0};
+    };
+
+    //! Pins the tree of the latest commit, so its pages are not reused while
+    //! it is being read.
+    class ReadTxn
+    {
+        const MmapDBEngine& m_engine;
+        //! Index of the reader slot holding the commit, or READER_SLOTS if
+        //! none was free.
+        size_t m_slot{READER_SLOTS};
+        uint64_t m_txn{0};
+        Pgno m_root{0};
+
+    public:
+        explicit ReadTxn(const MmapDBEngine& engine);
+        ~ReadTxn();
+        ReadTxn(const ReadTxn&) = delete;
+        ReadTxn& operator=(const ReadTxn&) = delete;
+
+        Pgno Root() const { return m_root; }
+        const MmapDBEngine& Engine() const { return m_engine; }
+    };
+
+    const std::byte* Page(Pgno pgno) const { return m_map + size_t{pgno} * PAGE_SIZE; }
+
+private:
+    //! A new or replaced entry of a leaf page.
+    struct LeafEntry;
+    //! A child of a branch page, with the lowest key that may be stored below it.
+    struct Child;
+    //! A change to apply, in key order.
+    struct Op;
+
+    //! Number of readers that can pin a commit without taking m_mutex.
+    static constexpr size_t READER_SLOTS{64};
+    //! Value of a reader slot that is not in use.
+    static constexpr uint64_t NO_READER{std::numeric_limits<uint64_t>::max()};
+
+    //! Commit pinned by a reader, on a cache line of its own.
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> txn{NO_READER};
+    };
+
+    const fs::path m_path;
+    const bool m_memory_only;
+    //! Descriptor of the data file, or -1 if memory-only.
+    int m_fd{-1};
+    std::byte* m_map{nullptr};
+    //! Size of the address range reserved for the mapping. The file can not
+    //! grow beyond it.
+    size_t m_map_size{0};
+
+    //! Latest commit. It is published after its root, which readers find by
+    //! its parity, like its meta page.
+    std::atomic<uint64_t> m_txn{0};
+    std::array<std::atomic<Pgno>, 2> m_roots{};
+    //! Pages used by the latest commit.
+    std::atomic<Pgno> m_used_pages{0};
+    //! Commits pinned by active readers. A reader claims a free slot with the
+    //! latest commit and checks that it is still the latest afterwards, so the
+    //! writer, which scans the slots before publishing a commit, either sees
+    //! the slot or the reader moves on to the new commit.
+    mutable std::array<ReaderSlot, READER_SLOTS> m_reader_slots;
+
+    mutable Mutex m_mutex;
+    //! Number of active readers that found no free slot, per commit they are
+    //! reading.
+    mutable std::map<uint64_t, int> m_readers GUARDED_BY(m_mutex);
+
+    //! Serializes writes. The state below is only used by the writer.
+    Mutex m_write_mutex;
+    Meta m_meta GUARDED_BY(m_write_mutex);
+    //! Whether the meta page of the latest commit still has to be synced.
+    bool m_meta_unsynced GUARDED_BY(m_write_mutex){false};
+    size_t m_file_size GUARDED_BY(m_write_mutex){0};
+    Pgno m_next_pgno GUARDED_BY(m_write_mutex){0};
+    //! Pages that may be overwritten. Sorted in descending order while a
+    //! write is in progress, so that runs of pages can be found in it.
+    std::vector<Pgno> m_free GUARDED_BY(m_write_mutex);
+    //! Pages freed by each commit, which may still be read.
+    std::vector<std::pair<uint64_t, std::vector<Pgno>>> m_pending GUARDED_BY(m_write_mutex);
+    //! Pages allocated by the write in progress.
+    std::unordered_set<Pgno> m_dirty GUARDED_BY(m_write_mutex);
+    //! Committed pages freed by the write in progress.
+    std::vector<Pgno> m_freed GUARDED_BY(m_write_mutex);
+    //! Pages both allocated and freed by the write in progress. They become
+    //! free once it commits, as entries read from them may still be in use.
+    std::vector<Pgno> m_freed_dirty GUARDED_BY(m_write_mutex);
+    //! Set when a write failed, after which the state above and on disk is
+    //! unknown and no more writes are accepted.
+    bool m_failed GUARDED_BY(m_write_mutex){false};
+    std::atomic<size_t> m_memory_usage{0};
+
+    std::byte* MutablePage(Pgno pgno) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex) { return m_map + size_t{pgno} * PAGE_SIZE; }
+
+    void Open() EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex, !m_mutex);
+    void Extend(Pgno end) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+    void Sync(Pgno first, size_t pages) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+    void SyncDirty() EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+    void Publish(const Meta& meta) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex, !m_mutex);
+    Pgno AllocatePage() EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+    Pgno AllocateRun(size_t pages) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+    void FreePage(Pgno pgno) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+    void FreeValue(const LeafEntry& entry) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+
+    std::vector<Child> Apply(const Child& node, std::span<const Op> ops) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+    std::vector<LeafEntry> MergeLeaf(std::vector<LeafEntry> entries, std::span<const Op> ops) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+    void Rebalance(std::vector<Child>& children, std::vector<bool>& fresh) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+    std::vector<Child> WriteLeaves(const std::string& lower, std::span<const LeafEntry> entries) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+    std::vector<Child> WriteBranches(std::span<const Child> children) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex);
+    void Commit(Meta meta, bool sync) EXCLUSIVE_LOCKS_REQUIRED(m_write_mutex, !m_mutex);
+};
+
+#endif // QTC_DBMMAP_H
@@ -4,20 +4,25 @@
 
 #include <dbwrapper.h>
 
+#include <dbengine.h>
+#include <dbmmap.h>
 #include <logging.h>
 #include <random.h>
 #include <serialize.h>
 #include <span.h>
 #include <streams.h>
+#include <tinyformat.h>
 #include <util/fs.h>
 #include <util/fs_helpers.h>
 #include <util/strencodings.h>
+#include <util/time.h>
 
 #include <algorithm>
 #include <cassert>
 #include <cstdarg>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <leveldb/cache.h>
 #include <leveldb/db.h>
 #include <leveldb/env.h>
@@ -28,15 +33,37 @@
 #include <leveldb/slice.h>
 #include <leveldb/status.h>
 #include <leveldb/write_batch.h>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <utility>
 
 static auto CharCast(const std::byte* data) { return reinterpret_cast<const char*>(data); }
 
+std::optional<DBBackend> DBBackendFromString(std::string_view str)
+{
+    if (str == "leveldb") return DBBackend::LEVELDB;
+    if (str == "mmap") return DBBackend::MMAP;
+    return std::nullopt;
+}
+
+std::string DBBackendToString(DBBackend backend)
+{
+    switch (backend) {
+    case DBBackend::LEVELDB: return "leveldb";
+    case DBBackend::MMAP: return "mmap";
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
+
 bool DestroyDB(const std::string& path_str)
 {
-    return leveldb::DestroyDB(path_str, {}).ok();
+    // Remove the mmap engine's files first, so that leveldb::DestroyDB can
+    // remove the then empty directory.
+    return DestroyMmapDB(fs::PathFromString(path_str)) && leveldb::DestroyDB(path_str, {}).ok();
 }
 
 /** Handle database error by throwing dbwrapper_error exception.
@@ -55,7 +82,17 @@ class CQuantum CoinLevelDBLogger : public leveldb::Logger {
 public:
     // This code is adapted from posix_logger.h, which is why it is using vsprintf.
     // Please do not do this in normal code
+    //! Counts writes that waited for a memtable to be written out or for
+    //! level 0 files to be compacted. LevelDB only reports these in its log.
+    std::atomic<uint64_t>& m_write_stalls;
+
+    explicit CQuantum CoinLevelDBLogger(std::atomic<uint64_t>& write_stalls) : m_write_stalls{write_stalls} {}
+
     void Logv(const char * format, va_list ap) override {
+            if (std::strcmp(format, "Current memtable full; waiting...\n") == 0 ||
+                std::strcmp(format, "Too many L0 files; waiting...\n") == 0) {
+                ++m_write_stalls;
+            }
             if (!LogAcceptCategory(BCLog::LEVELDB, BCLog::Level::Debug)) {
                 return;
             }
@@ -134,14 +171,32 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(size_t nCacheSize, const DBOptions& db_options, std::atomic<uint64_t>& write_stalls)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+    if (db_options.bulk_load) {
+        // The write buffers have their own budget, as the cache is sized for
+        // reads. Up to two of them may be held in memory at once. Each one is
+        // written out as a level 0 file, so larger buffers mean fewer files
+        // to trigger compactions and write stalls.
+        options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
+        options.write_buffer_size = std::max(nCacheSize / 4, db_options.bulk_write_buffer_bytes / 2);
+        // Larger level 0 files also take longer to compact into level 1, while
+        // more of them are written, so let more of them pile up before
+        // compacting and stalling, up to four times the defaults.
+        const int scale{static_cast<int>(std::clamp<size_t>(options.write_buffer_size / DBWRAPPER_BULK_L0_SCALE_BYTES, 1, 4))};
+        options.l0_compaction_trigger *= scale;
+        options.l0_slowdown_writes_trigger *= scale;
+        options.l0_stop_writes_trigger *= scale;
+        LogDebug(BCLog::LEVELDB, "LevelDB using write_buffer_size=%d l0_compaction_trigger=%d l0_slowdown_writes_trigger=%d l0_stop_writes_trigger=%d for bulk load\n",
+                 options.write_buffer_size, options.l0_compaction_trigger, options.l0_slowdown_writes_trigger, options.l0_stop_writes_trigger);
+    } else {
+        options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
+        options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+    }
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
     options.compression = leveldb::kNoCompression;
-    options.info_log = new CQuantum CoinLevelDBLogger();
+    options.info_log = new CQuantum CoinLevelDBLogger(write_stalls);
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
@@ -152,46 +207,43 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-struct CDBBatch::WriteBatchImpl {
-    leveldb::WriteBatch batch;
-};
-
-CDBBatch::CDBBatch(const CDBWrapper& _parent)
-    : parent{_parent},
-      m_impl_batch{std::make_unique<CDBBatch::WriteBatchImpl>()}
+namespace {
+class LevelDBBatch final : public DBEngineBatch
 {
-    Clear();
-};
-
-CDBBatch::~CDBBatch() = default;
+public:
+    leveldb::WriteBatch m_batch;
 
-void CDBBatch::Clear()
-{
-    m_impl_batch->batch.Clear();
-}
+    void Put(std::span<const std::byte> key, std::span<const std::byte> value) override
+    {
+        m_batch.Put(leveldb::Slice{CharCast(key.data()), key.size()}, leveldb::Slice{CharCast(value.data()), value.size()});
+    }
+    void Delete(std::span<const std::byte> key) override
+    {
+        m_batch.Delete(leveldb::Slice{CharCast(key.data()), key.size()});
+    }
+    void Clear() override { m_batch.Clear(); }
+    size_t ApproximateSize() const override { return m_batch.ApproximateSize(); }
+};
 
-void CDBBatch::WriteImpl(std::span<const std::byte> key, DataStream& ssValue)
+class LevelDBIterator final : public DBEngineIterator
 {
-    leveldb::Slice slKey(CharCast(key.data()), key.size());
-    ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
-    leveldb::Slice slValue(CharCast(ssValue.data()), ssValue.size());
-    m_impl_batch->batch.Put(slKey, slValue);
-}
+    const std::unique_ptr<leveldb::Iterator> m_iter;
 
-void CDBBatch::EraseImpl(std::span<const std::byte> key)
-{
-    leveldb::Slice slKey(CharCast(key.data()), key.size());
-    m_impl_batch->batch.Delete(slKey);
-}
+public:
+    explicit LevelDBIterator(leveldb::Iterator* iter) : m_iter{iter} {}
+
+    bool Valid() const override { return m_iter->Valid(); }
+    void SeekToFirst() override { m_iter->SeekToFirst(); }
+    void Seek(std::span<const std::byte> key) override { m_iter->Seek(leveldb::Slice{CharCast(key.data()), key.size()}); }
+    void Next() override { m_iter->Next(); }
+    std::span<const std::byte> Key() const override { return MakeByteSpan(m_iter->key()); }
+    std::span<const std::byte> Value() const override { return MakeByteSpan(m_iter->value()); }
+};
 
-size_t CDBBatch::ApproximateSize() const
+class LevelDBEngine final : public DBEngine
 {
-    return m_impl_batch->batch.ApproximateSize();
-}
-
-struct LevelDBContext {
     //! custom environment this database is using (may be nullptr in case of default environment)
-    leveldb::Env* penv;
+    leveldb::Env* penv{nullptr};
 
     //! database options used
     leveldb::Options options;
@@ -209,42 +261,195 @@ struct LevelDBContext {
     leveldb::WriteOptions syncoptions;
 
     //! the database itself
-    leveldb::DB* pdb;
+    leveldb::DB* pdb{nullptr};
+
+    //! number of writes that stalled, counted by the logger
+    std::atomic<uint64_t> m_write_stalls{0};
+
+    //! total time spent in writes that stalled, in microseconds
+    std::atomic<int64_t> m_write_stall_us{0};
+
+public:
+    explicit LevelDBEngine(const DBParams& params)
+    {
+        readoptions.verify_checksums = true;
+        iteroptions.verify_checksums = true;
+        iteroptions.fill_cache = false;
+        syncoptions.sync = true;
+        options = GetOptions(params.cache_bytes, params.options, m_write_stalls);
+        options.create_if_missing = true;
+        if (params.memory_only) {
+            penv = leveldb::NewMemEnv(leveldb::Env::Default());
+            options.env = penv;
+        } else {
+            LogPrintf("Opening LevelDB in %s%s\n", fs::PathToString(params.path), params.options.bulk_load ? " for bulk load" : "");
+        }
+        // PathToString() return value is safe to pass to leveldb open function,
+        // because on POSIX leveldb passes the byte string directly to ::open(), and
+        // on Windows it converts from UTF-8 to UTF-16 before calling ::CreateFileW
+        // (see env_posix.cc and env_windows.cc).
+        leveldb::Status status = leveldb::DB::Open(options, fs::PathToString(params.path), &pdb);
+        HandleError(status);
+        LogPrintf("Opened LevelDB successfully\n");
+    }
+
+    ~LevelDBEngine() override
+    {
+        delete pdb;
+        pdb = nullptr;
+        delete options.filter_policy;
+        options.filter_policy = nullptr;
+        delete options.info_log;
+        options.info_log = nullptr;
+        delete options.block_cache;
+        options.block_cache = nullptr;
+        delete penv;
+        options.env = nullptr;
+    }
+
+    std::optional<std::string> Read(std::span<const std::byte> key) const override
+    {
+        leveldb::Slice slKey(CharCast(key.data()), key.size());
+        std::string strValue;
+        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        if (!status.ok()) {
+            if (status.IsNotFound())
+                return std::nullopt;
+            LogPrintf("LevelDB read failure: %s\n", status.ToString());
+            HandleError(status);
+        }
+        return strValue;
+    }
+
+    bool Exists(std::span<const std::byte> key) const override
+    {
+        return Read(key).has_value();
+    }
+
+    std::unique_ptr<DBEngineBatch> NewBatch() const override
+    {
+        return std::make_unique<LevelDBBatch>();
+    }
+
+    void Write(DBEngineBatch& batch, bool sync) override
+    {
+        const uint64_t stalls_before{m_write_stalls};
+        const auto start{SteadyClock::now()};
+        leveldb::Status status = pdb->Write(sync ? syncoptions : writeoptions, &static_cast<LevelDBBatch&>(batch).m_batch);
+        if (m_write_stalls != stalls_before) {
+            // Attribute the whole write to the stall; waiting dominates it.
+            m_write_stall_us += Ticks<std::chrono::microseconds>(SteadyClock::now() - start);
+        }
+        HandleError(status);
+    }
+
+    std::unique_ptr<DBEngineIterator> NewIterator() const override
+    {
+        return std::make_unique<LevelDBIterator>(pdb->NewIterator(iteroptions));
+    }
+
+    size_t EstimateSize(std::span<const std::byte> begin, std::span<const std::byte> end) const override
+    {
+        leveldb::Slice slKey1(CharCast(begin.data()), begin.size());
+        leveldb::Slice slKey2(CharCast(end.data()), end.size());
+        uint64_t size = 0;
+        leveldb::Range range(slKey1, slKey2);
+        pdb->GetApproximateSizes(&range, 1, &size);
+        return size;
+    }
+
+    size_t DynamicMemoryUsage() const override
+    {
+        std::string memory;
+        std::optional<size_t> parsed;
+        if (!pdb->GetProperty("leveldb.approximate-memory-usage", &memory) || !(parsed = ToIntegral<size_t>(memory))) {
+            LogDebug(BCLog::LEVELDB, "Failed to get approximate-memory-usage property\n");
+            return 0;
+        }
+        return parsed.value();
+    }
+
+    void Compact() override
+    {
+        pdb->CompactRange(nullptr, nullptr);
+    }
+
+    void CompactRange(std::span<const std::byte> begin, std::span<const std::byte> end) override
+    {
+        leveldb::Slice slKey1(CharCast(begin.data()), begin.size());
+        leveldb::Slice slKey2(CharCast(end.data()), end.size());
+        pdb->CompactRange(&slKey1, &slKey2);
+    }
+
+    DBWriteStalls WriteStalls() const override
+    {
+        return {.count = m_write_stalls, .duration = std::chrono::microseconds{m_write_stall_us.load()}};
+    }
 };
+} // namespace
 
-CDBWrapper::CDBWrapper(const DBParams& params)
-    : m_db_context{std::make_unique<LevelDBContext>()}, m_name{fs::PathToString(params.path.stem())}, m_path{params.path}, m_is_memory{params.memory_only}
+std::unique_ptr<DBEngine> MakeDBEngine(const DBParams& params)
 {
-    DBContext().penv = nullptr;
-    DBContext().readoptions.verify_checksums = true;
-    DBContext().iteroptions.verify_checksums = true;
-    DBContext().iteroptions.fill_cache = false;
-    DBContext().syncoptions.sync = true;
-    DBContext().options = GetOptions(params.cache_bytes);
-    DBContext().options.create_if_missing = true;
-    if (params.memory_only) {
-        DBContext().penv = leveldb::NewMemEnv(leveldb::Env::Default());
-        DBContext().options.env = DBContext().penv;
-    } else {
+    if (!params.memory_only) {
+        const bool has_leveldb{fs::exists(params.path / "CURRENT")};
+        const bool has_mmap{fs::exists(params.path / MMAPDB_FILENAME)};
         if (params.wipe_data) {
-            LogPrintf("Wiping LevelDB in %s\n", fs::PathToString(params.path));
-            leveldb::Status result = leveldb::DestroyDB(fs::PathToString(params.path), DBContext().options);
-            HandleError(result);
+            if (has_leveldb || has_mmap) {
+                LogPrintf("Wiping database in %s\n", fs::PathToString(params.path));
+                if (!DestroyDB(fs::PathToString(params.path))) {
+                    throw dbwrapper_error(strprintf("Failed to wipe database in %s", fs::PathToString(params.path)));
+                }
+            }
+        } else if ((has_leveldb && params.options.backend != DBBackend::LEVELDB) || (has_mmap && params.options.backend != DBBackend::MMAP)) {
+            throw dbwrapper_error(strprintf("Database in %s was created with the %s backend, not %s",
+                                            fs::PathToString(params.path), DBBackendToString(has_leveldb ? DBBackend::LEVELDB : DBBackend::MMAP),
+                                            DBBackendToString(params.options.backend)));
         }
         TryCreateDirectories(params.path);
-        LogPrintf("Opening LevelDB in %s\n", fs::PathToString(params.path));
     }
-    // PathToString() return value is safe to pass to leveldb open function,
-    // because on POSIX leveldb passes the byte string directly to ::open(), and
-    // on Windows it converts from UTF-8 to UTF-16 before calling ::CreateFileW
-    // (see env_posix.cc and env_windows.cc).
-    leveldb::Status status = leveldb::DB::Open(DBContext().options, fs::PathToString(params.path), &DBContext().pdb);
-    HandleError(status);
-    LogPrintf("Opened LevelDB successfully\n");
+    switch (params.options.backend) {
+    case DBBackend::LEVELDB: return std::make_unique<LevelDBEngine>(params);
+    case DBBackend::MMAP: return std::make_unique<MmapDBEngine>(params);
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
 
+CDBBatch::CDBBatch(const CDBWrapper& _parent)
+    : parent{_parent},
+      m_impl_batch{_parent.Engine().NewBatch()}
+{
+    Clear();
+};
+
+CDBBatch::~CDBBatch() = default;
+
+void CDBBatch::Clear()
+{
+    m_impl_batch->Clear();
+}
+
+void CDBBatch::WriteImpl(std::span<const std::byte> key, DataStream& ssValue)
+{
+    ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+    m_impl_batch->Put(key, ssValue);
+}
+
+void CDBBatch::EraseImpl(std::span<const std::byte> key)
+{
+    m_impl_batch->Delete(key);
+}
+
+size_t CDBBatch::ApproximateSize() const
+{
+    return m_impl_batch->ApproximateSize();
+}
+
+CDBWrapper::CDBWrapper(const DBParams& params)
+    : m_engine{MakeDBEngine(params)}, m_name{fs::PathToString(params.path.stem())}, m_path{params.path}, m_is_memory{params.memory_only}
+{
     if (params.options.force_compact) {
         LogPrintf("Starting database compaction of %s\n", fs::PathToString(params.path));
-        DBContext().pdb->CompactRange(nullptr, nullptr);
+        Engine().Compact();
         LogPrintf("Finished database compaction of %s\n", fs::PathToString(params.path));
     }
 
@@ -268,19 +473,7 @@ CDBWrapper::CDBWrapper(const DBParams& params)
     LogPrintf("Using obfuscation key for %s: %s\n", fs::PathToString(params.path), HexStr(obfuscate_key));
 }
 
-CDBWrapper::~CDBWrapper()
-{
-    delete DBContext().pdb;
-    DBContext().pdb = nullptr;
-    delete DBContext().options.filter_policy;
-    DBContext().options.filter_policy = nullptr;
-    delete DBContext().options.info_log;
-    DBContext().options.info_log = nullptr;
-    delete DBContext().options.block_cache;
-    DBContext().options.block_cache = nullptr;
-    delete DBContext().penv;
-    DBContext().options.env = nullptr;
-}
+CDBWrapper::~CDBWrapper() = default;
 
 bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
@@ -289,8 +482,7 @@ bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
     if (log_memory) {
         mem_before = DynamicMemoryUsage() / 1024.0 / 1024;
     }
-    leveldb::Status status = DBContext().pdb->Write(fSync ? DBContext().syncoptions : DBContext().writeoptions, &batch.m_impl_batch->batch);
-    HandleError(status);
+    Engine().Write(*batch.m_impl_batch, fSync);
     if (log_memory) {
         double mem_after = DynamicMemoryUsage() / 1024.0 / 1024;
         LogDebug(BCLog::LEVELDB, "WriteBatch memory usage: db=%s, before=%.1fMiB, after=%.1fMiB\n",
@@ -301,13 +493,7 @@ bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 
 size_t CDBWrapper::DynamicMemoryUsage() const
 {
-    std::string memory;
-    std::optional<size_t> parsed;
-    if (!DBContext().pdb->GetProperty("leveldb.approximate-memory-usage", &memory) || !(parsed = ToIntegral<size_t>(memory))) {
-        LogDebug(BCLog::LEVELDB, "Failed to get approximate-memory-usage property\n");
-        return 0;
-    }
-    return parsed.value();
+    return Engine().DynamicMemoryUsage();
 }
 
 // Prefixed with null character to avoid collisions with other keys
@@ -331,41 +517,27 @@ std::vector<unsigned char> CDBWrapper::CreateObfuscateKey() const
 
 std::optional<std::string> CDBWrapper::ReadImpl(std::span<const std::byte> key) const
 {
-    leveldb::Slice slKey(CharCast(key.data()), key.size());
-    std::string strValue;
-    leveldb::Status status = DBContext().pdb->Get(DBContext().readoptions, slKey, &strValue);
-    if (!status.ok()) {
-        if (status.IsNotFound())
-            return std::nullopt;
-        LogPrintf("LevelDB read failure: %s\n", status.ToString());
-        HandleError(status);
-    }
-    return strValue;
+    return Engine().Read(key);
 }
 
 bool CDBWrapper::ExistsImpl(std::span<const std::byte> key) const
 {
-    leveldb::Slice slKey(CharCast(key.data()), key.size());
-
-    std::string strValue;
-    leveldb::Status status = DBContext().pdb->Get(DBContext().readoptions, slKey, &strValue);
-    if (!status.ok()) {
-        if (status.IsNotFound())
-            return false;
-        LogPrintf("LevelDB read failure: %s\n", status.ToString());
-        HandleError(status);
-    }
-    return true;
+    return Engine().Exists(key);
 }
 
 size_t CDBWrapper::EstimateSizeImpl(std::span<const std::byte> key1, std::span<const std::byte> key2) const
 {
-    leveldb::Slice slKey1(CharCast(key1.data()), key1.size());
-    leveldb::Slice slKey2(CharCast(key2.data()), key2.size());
-    uint64_t size = 0;
-    leveldb::Range range(slKey1, slKey2);
-    DBContext().pdb->GetApproximateSizes(&range, 1, &size);
-    return size;
+    return Engine().EstimateSize(key1, key2);
+}
+
+void CDBWrapper::CompactRangeImpl(std::span<const std::byte> key1, std::span<const std::byte> key2) const
+{
+    Engine().CompactRange(key1, key2);
+}
+
+DBWriteStalls CDBWrapper::WriteStalls() const
+{
+    return Engine().WriteStalls();
 }
 
 bool CDBWrapper::IsEmpty()
@@ -375,40 +547,33 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
-struct CDBIterator::IteratorImpl {
-    const std::unique_ptr<leveldb::Iterator> iter;
-
-    explicit IteratorImpl(leveldb::Iterator* _iter) : iter{_iter} {}
-};
-
-CDBIterator::CDBIterator(const CDBWrapper& _parent, std::unique_ptr<IteratorImpl> _piter) : parent(_parent),
-                                                                                            m_impl_iter(std::move(_piter)) {}
+CDBIterator::CDBIterator(const CDBWrapper& _parent, std::unique_ptr<DBEngineIterator> _piter) : parent(_parent),
+                                                                                              m_impl_iter(std::move(_piter)) {}
 
 CDBIterator* CDBWrapper::NewIterator()
 {
-    return new CDBIterator{*this, std::make_unique<CDBIterator::IteratorImpl>(DBContext().pdb->NewIterator(DBContext().iteroptions))};
+    return new CDBIterator{*this, Engine().NewIterator()};
 }
 
 void CDBIterator::SeekImpl(std::span<const std::byte> key)
 {
-    leveldb::Slice slKey(CharCast(key.data()), key.size());
-    m_impl_iter->iter->Seek(slKey);
+    m_impl_iter->Seek(key);
 }
 
 std::span<const std::byte> CDBIterator::GetKeyImpl() const
 {
-    return MakeByteSpan(m_impl_iter->iter->key());
+    return m_impl_iter->Key();
 }
 
 std::span<const std::byte> CDBIterator::GetValueImpl() const
 {
-    return MakeByteSpan(m_impl_iter->iter->value());
+    return m_impl_iter->Value();
 }
 
 CDBIterator::~CDBIterator() = default;
-bool CDBIterator::Valid() const { return m_impl_iter->iter->Valid(); }
-void CDBIterator::SeekToFirst() { m_impl_iter->iter->SeekToFirst(); }
-void CDBIterator::Next() { m_impl_iter->iter->Next(); }
+bool CDBIterator::Valid() const { return m_impl_iter->Valid(); }
+void CDBIterator::SeekToFirst() { m_impl_iter->SeekToFirst(); }
+void CDBIterator::Next() { m_impl_iter->Next(); }
 
 namespace dbwrapper_private {
 
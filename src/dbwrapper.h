@@ -12,31 +12,63 @@
 #include <util/check.h>
 #include <util/fs.h>
 
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <memory>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 static const size_t DBWRAPPER_MAX_FILE_SIZE = 32 << 20; // 32 MiB
+//! Size of the bulk load write buffer per multiple of the default level 0 triggers
+static const size_t DBWRAPPER_BULK_L0_SCALE_BYTES = 32 << 20; // 32 MiB
+
+//! Storage engine holding the data of a CDBWrapper.
+enum class DBBackend {
+    //! The bundled LevelDB.
+    LEVELDB,
+    //! A copy-on-write B+tree in a memory-mapped file, see MmapDBEngine.
+    MMAP,
+};
+
+std::optional<DBBackend> DBBackendFromString(std::string_view str);
+std::string DBBackendToString(DBBackend backend);
 
 //! User-controlled performance and debug options.
 struct DBOptions {
     //! Compact database on startup.
     bool force_compact = false;
+    //! Storage engine to use. A database can only be reopened with the engine
+    //! that created it.
+    DBBackend backend = DBBackend::LEVELDB;
+    //! Tune the engine for a stream of large writes, as during initial block
+    //! download, at the expense of read performance.
+    bool bulk_load = false;
+    //! Memory for the write buffers while bulk loading, on top of the cache.
+    //! The engine may use less, e.g. when this is smaller than its default.
+    size_t bulk_write_buffer_bytes = 0;
+};
+
+//! Writes that had to wait for the storage engine to catch up with compaction.
+struct DBWriteStalls {
+    uint64_t count{0};
+    std::chrono::microseconds duration{0};
 };
 
 //! Application-specific storage settings.
 struct DBParams {
-    //! Location in the filesystem where leveldb data will be stored.
+    //! Location in the filesystem where the database will be stored.
     fs::path path;
-    //! Configures various leveldb cache settings.
+    //! Configures various leveldb cache settings. The mmap engine relies on
+    //! the operating system's page cache instead.
     size_t cache_bytes;
-    //! If true, use leveldb's memory environment.
+    //! If true, keep the database in memory only.
     bool memory_only = false;
     //! If true, remove all existing data.
     bool wipe_data = false;
@@ -54,6 +86,9 @@ public:
 };
 
 class CDBWrapper;
+class DBEngine;
+class DBEngineBatch;
+class DBEngineIterator;
 
 /** These should be considered an implementation detail of the specific database.
  */
@@ -67,6 +102,7 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
 }; // namespace dbwrapper_private
 
+/** Remove the database at path_str, whichever engine created it. */
 bool DestroyDB(const std::string& path_str);
 
 /** Batch of changes queued to be written to a CDBWrapper */
@@ -77,8 +113,7 @@ class CDBBatch
 private:
     const CDBWrapper &parent;
 
-    struct WriteBatchImpl;
-    const std::unique_ptr<WriteBatchImpl> m_impl_batch;
+    const std::unique_ptr<DBEngineBatch> m_impl_batch;
 
     DataStream ssKey{};
     DataStream ssValue{};
@@ -120,12 +155,9 @@ public:
 
 class CDBIterator
 {
-public:
-    struct IteratorImpl;
-
 private:
     const CDBWrapper &parent;
-    const std::unique_ptr<IteratorImpl> m_impl_iter;
+    const std::unique_ptr<DBEngineIterator> m_impl_iter;
 
     void SeekImpl(std::span<const std::byte> key);
     std::span<const std::byte> GetKeyImpl() const;
@@ -135,9 +167,9 @@ public:
 
     /**
      * @param[in] _parent          Parent CDBWrapper instance.
-     * @param[in] _piter           The original leveldb iterator.
+     * @param[in] _piter           The storage engine's iterator.
      */
-    CDBIterator(const CDBWrapper& _parent, std::unique_ptr<IteratorImpl> _piter);
+    CDBIterator(const CDBWrapper& _parent, std::unique_ptr<DBEngineIterator> _piter);
     ~CDBIterator();
 
     bool Valid() const;
@@ -175,14 +207,13 @@ public:
     }
 };
 
-struct LevelDBContext;
-
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
+    friend class CDBBatch;
 private:
-    //! holds all leveldb-specific fields of this class
-    std::unique_ptr<LevelDBContext> m_db_context;
+    //! the storage engine holding the data
+    std::unique_ptr<DBEngine> m_engine;
 
     //! the name of this database
     std::string m_name;
@@ -207,7 +238,8 @@ private:
     std::optional<std::string> ReadImpl(std::span<const std::byte> key) const;
     bool ExistsImpl(std::span<const std::byte> key) const;
     size_t EstimateSizeImpl(std::span<const std::byte> key1, std::span<const std::byte> key2) const;
-    auto& DBContext() const LIFETIMEBOUND { return *Assert(m_db_context); }
+    void CompactRangeImpl(std::span<const std::byte> key1, std::span<const std::byte> key2) const;
+    auto& Engine() const LIFETIMEBOUND { return *Assert(m_engine); }
 
 public:
     CDBWrapper(const DBParams& params);
@@ -271,9 +303,12 @@ public:
 
     bool WriteBatch(CDBBatch& batch, bool fSync = false);
 
-    // Get an estimate of LevelDB memory usage (in bytes).
+    // Get an estimate of the storage engine's memory usage (in bytes).
     size_t DynamicMemoryUsage() const;
 
+    //! Writes that stalled since the database was opened.
+    DBWriteStalls WriteStalls() const;
+
     CDBIterator* NewIterator();
 
     /**
@@ -291,6 +326,20 @@ public:
         ssKey2 << key_end;
         return EstimateSizeImpl(ssKey1, ssKey2);
     }
+
+    /**
+     * Compact a certain range of keys in the database.
+     */
+    template<typename K>
+    void CompactRange(const K& key_begin, const K& key_end) const
+    {
+        DataStream ssKey1{}, ssKey2{};
+        ssKey1.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        ssKey1 << key_begin;
+        ssKey2 << key_end;
+        CompactRangeImpl(ssKey1, ssKey2);
+    }
 };
 
 #endif // QTC_DBWRAPPER_H
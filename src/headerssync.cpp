@@ -9,6 +9,8 @@
 #include <util/time.h>
 #include <util/vector.h>
 
+#include <algorithm>
+
 // The two constants below are computed using the simulation script in
 // contrib/devtools/headerssync-params.py.
 
@@ -316,3 +318,146 @@ CBlockLocator HeadersSyncState::NextHeadersRequestLocator() const
 
     return CBlockLocator{std::move(locator)};
 }
+
+HeadersRangeSync::HeadersRangeSync(const Consensus::Params& consensus_params, std::vector<Anchor> anchors) :
+    m_consensus_params(consensus_params), m_anchors(std::move(anchors))
+{
+    std::sort(m_anchors.begin(), m_anchors.end(), [](const Anchor& a, const Anchor& b) { return a.height < b.height; });
+    m_anchors.erase(std::unique(m_anchors.begin(), m_anchors.end(), [](const Anchor& a, const Anchor& b) { return a.height == b.height; }), m_anchors.end());
+    for (size_t i = 0; i + 1 < m_anchors.size(); ++i) {
+        Range& range = m_ranges.emplace_back();
+        range.start = i;
+        range.last_hash = m_anchors[i].hash;
+    }
+}
+
+HeadersRangeSync::Range* HeadersRangeSync::FindRange(NodeId peer)
+{
+    for (Range& range : m_ranges) {
+        if (range.peer == peer) return &range;
+    }
+    return nullptr;
+}
+
+const HeadersRangeSync::Range* HeadersRangeSync::FindRange(NodeId peer) const
+{
+    for (const Range& range : m_ranges) {
+        if (range.peer == peer) return &range;
+    }
+    return nullptr;
+}
+
+void HeadersRangeSync::Reset(Range& range)
+{
+    range.peer.reset();
+    range.last_progress = std::chrono::microseconds{0};
+    ClearShrink(range.headers);
+    range.last_hash = m_anchors[range.start].hash;
+    range.last_bits = 0;
+    range.complete = false;
+}
+
+std::optional<HeadersRangeSync::Request> HeadersRangeSync::AssignRange(NodeId peer, int best_header_height, int peer_height,
+                                                                       std::chrono::microseconds now)
+{
+    if (FindRange(peer)) return std::nullopt;
+
+    for (Range& range : m_ranges) {
+        if (range.peer || range.complete) continue;
+        const Anchor& end{m_anchors[range.start + 1]};
+        if (end.height <= best_header_height || end.height > peer_height) continue;
+
+        range.peer = peer;
+        range.last_progress = now;
+        LogDebug(BCLog::NET, "Headers range sync started with peer=%d: height=%i to height=%i\n", peer, m_anchors[range.start].height, end.height);
+        return Request{CBlockLocator{std::vector<uint256>{range.last_hash}}, end.hash};
+    }
+    return std::nullopt;
+}
+
+bool HeadersRangeSync::IsRangeResponse(NodeId peer, const std::vector<CBlockHeader>& headers) const
+{
+    const Range* range{FindRange(peer)};
+    return range && !headers.empty() && headers[0].hashPrevBlock == range->last_hash;
+}
+
+HeadersRangeSync::ProcessingResult HeadersRangeSync::ProcessNextHeaders(NodeId peer, const std::vector<CBlockHeader>& headers,
+                                                                        bool full_headers_message, std::chrono::microseconds now)
+{
+    ProcessingResult ret;
+
+    Range* range{FindRange(peer)};
+    Assume(range);
+    if (!range) return ret;
+
+    const Anchor& end{m_anchors[range->start + 1]};
+    int height = m_anchors[range->start].height + range->headers.size();
+    for (const CBlockHeader& header : headers) {
+        ++height;
+        // The difficulty transition into the first header is checked once the
+        // range connects, as we don't know the lower anchor's nBits before then.
+        if (header.hashPrevBlock != range->last_hash || height > end.height ||
+                (!range->headers.empty() && !PermittedDifficultyTransition(m_consensus_params, height, range->last_bits, header.nBits))) {
+            LogDebug(BCLog::NET, "Headers range sync aborted with peer=%d: invalid header at height=%i\n", peer, height);
+            Reset(*range);
+            return ret;
+        }
+        const uint256 hash{header.GetHash()};
+        if (height == end.height && hash != end.hash) {
+            LogDebug(BCLog::NET, "Headers range sync aborted with peer=%d: chain does not reach block %s at height=%i\n", peer, end.hash.ToString(), height);
+            Reset(*range);
+            return ret;
+        }
+        range->headers.push_back(header);
+        range->last_hash = hash;
+        range->last_bits = header.nBits;
+    }
+    range->last_progress = now;
+    ret.success = true;
+
+    if (height == end.height) {
+        LogDebug(BCLog::NET, "Headers range sync complete with peer=%d: height=%i to height=%i\n", peer, m_anchors[range->start].height, end.height);
+        range->peer.reset();
+        range->complete = true;
+    } else if (!full_headers_message) {
+        // The peer has nothing more for us; leave the range to someone else.
+        LogDebug(BCLog::NET, "Headers range sync stopped with peer=%d: no headers beyond height=%i\n", peer, height);
+        Reset(*range);
+    } else {
+        ret.next_request = Request{CBlockLocator{std::vector<uint256>{range->last_hash}}, end.hash};
+    }
+    return ret;
+}
+
+void HeadersRangeSync::ReleaseRange(NodeId peer)
+{
+    if (Range* range{FindRange(peer)}) Reset(*range);
+}
+
+void HeadersRangeSync::ReleaseStalledRanges(std::chrono::microseconds now, std::chrono::microseconds timeout)
+{
+    for (Range& range : m_ranges) {
+        if (range.peer && now - range.last_progress > timeout) {
+            LogDebug(BCLog::NET, "Headers range sync timed out with peer=%d: height=%i to height=%i\n", *range.peer, m_anchors[range.start].height, m_anchors[range.start + 1].height);
+            Reset(range);
+        }
+    }
+}
+
+std::vector<CBlockHeader> HeadersRangeSync::PopHeadersReadyForAcceptance(const std::function<bool(const uint256&)>& have_header)
+{
+    std::vector<CBlockHeader> ret;
+    for (auto it = m_ranges.begin(); it != m_ranges.end();) {
+        const uint256& start_hash{m_anchors[it->start].hash};
+        // Only return one continuous run of ranges at a time.
+        const bool connects{ret.empty() ? have_header(start_hash) : ret.back().GetHash() == start_hash};
+        if (!it->complete || !connects) {
+            if (!ret.empty()) break;
+            ++it;
+            continue;
+        }
+        ret.insert(ret.end(), std::make_move_iterator(it->headers.begin()), std::make_move_iterator(it->headers.end()));
+        it = m_ranges.erase(it);
+    }
+    return ret;
+}
@@ -14,7 +14,10 @@
 #include <util/bitdeque.h>
 #include <util/hasher.h>
 
+#include <chrono>
 #include <deque>
+#include <functional>
+#include <optional>
 #include <vector>
 
 // A compressed CBlockHeader, which leaves out the prevhash
@@ -275,4 +278,104 @@ private:
     State m_download_state{State::PRESYNC};
 };
 
+/** HeadersRangeSync:
+ *
+ * Headers are normally fetched from one peer at a time, one round trip per
+ * batch of 2000. Where we know the hash of the block at some height in advance
+ * (the blocks our assumeutxo snapshots are based on), the headers between two
+ * such anchors can be fetched from other peers at the same time, by sending a
+ * GETHEADERS with the lower anchor as locator and the upper one as hash_stop.
+ *
+ * A range is pinned by hardcoded hashes at both ends, so only one chain of
+ * headers can complete it, and its length is known up front. That bounds the
+ * memory a peer can make us use for it, so unlike HeadersSyncState we can keep
+ * the headers as they arrive. The caller checks their proof of work before
+ * passing them in; they are fully validated once the range connects to our
+ * block index. A range that does not end at its upper anchor is discarded.
+ */
+class HeadersRangeSync {
+public:
+    /** A block whose height and hash are known in advance. */
+    struct Anchor {
+        int height;
+        uint256 hash;
+    };
+
+    /** A GETHEADERS request to send to a peer downloading a range. */
+    struct Request {
+        CBlockLocator locator;
+        uint256 hash_stop;
+    };
+
+    /** Result data structure for ProcessNextHeaders. */
+    struct ProcessingResult {
+        /** false if the peer sent headers that cannot be part of the range, which has been released. */
+        bool success{false};
+        /** The request to send next, if the range is not complete yet. */
+        std::optional<Request> next_request;
+    };
+
+    /**
+     * consensus_params: parameters needed for difficulty adjustment validation
+     * anchors: the anchors to download the ranges between, in any order
+     */
+    HeadersRangeSync(const Consensus::Params& consensus_params, std::vector<Anchor> anchors);
+
+    /** Assign the lowest range that no peer is downloading, that ends above
+     *  best_header_height and that a peer at peer_height can serve. Returns the
+     *  first request to send to the peer, if a range was assigned. */
+    std::optional<Request> AssignRange(NodeId peer, int best_header_height, int peer_height,
+                                       std::chrono::microseconds now);
+
+    /** Whether headers received from peer continue the range it is downloading. */
+    bool IsRangeResponse(NodeId peer, const std::vector<CBlockHeader>& headers) const;
+
+    /** Append headers for which IsRangeResponse() holds to the peer's range.
+     *  full_headers_message: true if the message was at max capacity,
+     *                        indicating more headers may be available */
+    ProcessingResult ProcessNextHeaders(NodeId peer, const std::vector<CBlockHeader>& headers,
+                                        bool full_headers_message, std::chrono::microseconds now);
+
+    /** Stop downloading the range assigned to peer, if any, discarding its progress. */
+    void ReleaseRange(NodeId peer);
+
+    /** Release ranges whose peer has not sent any of it for timeout. */
+    void ReleaseStalledRanges(std::chrono::microseconds now, std::chrono::microseconds timeout);
+
+    /** Remove the completed ranges that connect to a block have_header()
+     *  returns true for, lowest first, and return their headers. */
+    std::vector<CBlockHeader> PopHeadersReadyForAcceptance(const std::function<bool(const uint256&)>& have_header);
+
+private:
+    struct Range {
+        /** Index of the lower anchor in m_anchors; the upper one follows it. */
+        size_t start;
+        /** The peer downloading the range, if any. */
+        std::optional<NodeId> peer;
+        /** When the peer was assigned the range or last sent part of it. */
+        std::chrono::microseconds last_progress{0};
+        /** Headers received so far, starting right after the lower anchor. Kept
+         *  whole, as CompressedHeader leaves out fields the block hash commits to. */
+        std::vector<CBlockHeader> headers;
+        /** Hash and nBits of the last header in headers (or the lower anchor's hash). */
+        uint256 last_hash;
+        uint32_t last_bits{0};
+        /** Whether headers reaches the upper anchor. */
+        bool complete{false};
+    };
+
+    Range* FindRange(NodeId peer);
+    const Range* FindRange(NodeId peer) const;
+    void Reset(Range& range);
+
+    /** We use the consensus params to check difficulty transitions within a range */
+    const Consensus::Params& m_consensus_params;
+
+    /** Anchors, by increasing height */
+    std::vector<Anchor> m_anchors;
+
+    /** One entry per pair of consecutive anchors that has not been accepted yet, by increasing height */
+    std::deque<Range> m_ranges;
+};
+
 #endif // QTC_HEADERSSYNC_H
@@ -21,6 +21,8 @@
 #include <validation.h>
 
 #include <chrono>
+#include <deque>
+#include <future>
 #include <memory>
 #include <optional>
 #include <stdexcept>
@@ -32,6 +34,17 @@ constexpr uint8_t DB_BEST_BLOCK{'B'};
 
 constexpr auto SYNC_LOG_INTERVAL{30s};
 constexpr auto SYNC_LOCATOR_WRITE_INTERVAL{30s};
+//! Number of blocks read ahead on the block read threads while an index is syncing
+constexpr size_t SYNC_READ_AHEAD_BLOCKS{16};
+
+namespace {
+/** A block being read on a block read thread ahead of BaseIndex::Sync processing it. */
+struct BlockReadAhead {
+    const CBlockIndex* index;
+    FlatFilePos pos;
+    std::future<std::vector<unsigned char>> data;
+};
+} // namespace
 
 template <typename... Args>
 void BaseIndex::FatalErrorf(util::ConstevalFormatString<sizeof...(Args)> fmt, const Args&... args)
@@ -188,6 +201,7 @@ void BaseIndex::Sync()
     if (!m_synced) {
         std::chrono::steady_clock::time_point last_log_time{0s};
         std::chrono::steady_clock::time_point last_locator_write_time{0s};
+        std::deque<BlockReadAhead> read_ahead;
         while (true) {
             if (m_interrupt) {
                 LogPrintf("%s: m_interrupt set; exiting ThreadSync\n", GetName());
@@ -226,8 +240,40 @@ void BaseIndex::Sync()
             }
             pindex = pindex_next;
 
+            // Keep the next few blocks being read, so that the index does not have to wait on the
+            // disk for each block in turn.
+            if (read_ahead.empty() || read_ahead.front().index != pindex) read_ahead.clear();
+            {
+                LOCK(::cs_main);
+                const CBlockIndex* last{read_ahead.empty() ? nullptr : read_ahead.back().index};
+                while (read_ahead.size() < SYNC_READ_AHEAD_BLOCKS) {
+                    const CBlockIndex* next{last ? m_chainstate->m_chain.Next(last) : pindex};
+                    if (!next || !(next->nStatus & BLOCK_HAVE_DATA)) break;
+                    auto promise{std::make_shared<std::promise<std::vector<unsigned char>>>()};
+                    auto future{promise->get_future()};
+                    if (!m_chainstate->m_blockman.ReadRawBlockAsync(next->GetBlockPos(), [promise](std::vector<unsigned char> data) {
+                            promise->set_value(std::move(data));
+                        })) {
+                        break;
+                    }
+                    read_ahead.push_back({next, next->GetBlockPos(), std::move(future)});
+                    last = next;
+                }
+            }
+
+            std::optional<CBlock> block;
+            if (!read_ahead.empty() && read_ahead.front().index == pindex) {
+                const std::vector<unsigned char> data{read_ahead.front().data.get()};
+                if (!data.empty() && m_chainstate->m_blockman.DecodeBlock(block.emplace(), MakeByteSpan(data), read_ahead.front().pos, pindex->GetBlockHash())) {
+                    read_ahead.pop_front();
+                } else {
+                    // Fall back to a synchronous read, which reports the error if there is one.
+                    block.reset();
+                    read_ahead.clear();
+                }
+            }
 
-            if (!ProcessBlock(pindex)) return; // error logged internally
+            if (!ProcessBlock(pindex, block ? &*block : nullptr)) return; // error logged internally
 
             auto current_time{std::chrono::steady_clock::now()};
             if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
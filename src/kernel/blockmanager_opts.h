@@ -16,6 +16,14 @@ class CChainParams;
 namespace kernel {
 
 static constexpr bool DEFAULT_XOR_BLOCKSDIR{true};
+/** Default for -blockreadthreads */
+static constexpr int DEFAULT_BLOCK_READ_THREADS{2};
+/** Maximum for -blockreadthreads */
+static constexpr int MAX_BLOCK_READ_THREADS{16};
+/** Default for -reindexthreads */
+static constexpr int DEFAULT_REINDEX_THREADS{4};
+/** Maximum for -reindexthreads */
+static constexpr int MAX_REINDEX_THREADS{16};
 
 /**
  * An options struct for `BlockManager`, more ergonomically referred to as
@@ -26,6 +34,10 @@ struct BlockManagerOpts {
     bool use_xor{DEFAULT_XOR_BLOCKSDIR};
     uint64_t prune_target{0};
     bool fast_prune{false};
+    //! Number of threads serving BlockManager::ReadRawBlockAsync(). With 0, asynchronous reads are unavailable.
+    int block_read_threads{0};
+    //! Number of threads reading block files ahead during -reindex. With 0, block files are read by the importing thread.
+    int reindex_threads{0};
     const fs::path blocks_dir;
     Notifications& notifications;
     DBParams block_tree_db_params;
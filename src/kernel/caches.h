@@ -15,6 +15,9 @@ static constexpr size_t DEFAULT_KERNEL_CACHE{450_MiB};
 static constexpr size_t MAX_BLOCK_DB_CACHE{2_MiB};
 //! Max memory allocated to coin DB specific cache (bytes)
 static constexpr size_t MAX_COINS_DB_CACHE{8_MiB};
+//! Max memory taken from the coins cache for the coin DB write buffers while
+//! catching up (bytes)
+static constexpr size_t MAX_COINS_DB_WRITE_BUFFERS{256_MiB};
 
 namespace kernel {
 struct CacheSizes {
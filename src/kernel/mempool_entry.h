@@ -11,6 +11,7 @@
 #include <policy/policy.h>
 #include <policy/settings.h>
 #include <primitives/transaction.h>
+#include <txgraph.h>
 #include <util/epochguard.h>
 #include <util/overflow.h>
 
@@ -60,9 +61,13 @@ struct CompareIteratorByHash {
  * (m_count_with_descendants, nSizeWithDescendants, and nModFeesWithDescendants) for
  * all ancestors of the newly added transaction.
  *
+ * Each entry is also the TxGraph::Ref of its transaction in the mempool's
+ * TxGraph, which tracks clusters and their linearization. An entry that is
+ * not (yet) part of a mempool holds an empty Ref.
+ *
  */
 
-class CTxMemPoolEntry
+class CTxMemPoolEntry : public TxGraph::Ref
 {
 public:
     typedef std::reference_wrapper<const CTxMemPoolEntry> CTxMemPoolEntryRef;
@@ -71,7 +76,31 @@ public:
     typedef std::set<CTxMemPoolEntryRef, CompareIteratorByHash> Children;
 
 private:
-    CTxMemPoolEntry(const CTxMemPoolEntry&) = default;
+    //! Copies the transaction data, but not the TxGraph::Ref, which stays empty.
+    CTxMemPoolEntry(const CTxMemPoolEntry& entry)
+        : TxGraph::Ref{},
+          tx{entry.tx},
+          m_parents{entry.m_parents},
+          m_children{entry.m_children},
+          nFee{entry.nFee},
+          nTxWeight{entry.nTxWeight},
+          nUsageSize{entry.nUsageSize},
+          nTime{entry.nTime},
+          entry_sequence{entry.entry_sequence},
+          entryHeight{entry.entryHeight},
+          spendsCoinbase{entry.spendsCoinbase},
+          sigOpCost{entry.sigOpCost},
+          m_modified_fee{entry.m_modified_fee},
+          lockPoints{entry.lockPoints},
+          m_count_with_descendants{entry.m_count_with_descendants},
+          nSizeWithDescendants{entry.nSizeWithDescendants},
+          nModFeesWithDescendants{entry.nModFeesWithDescendants},
+          m_count_with_ancestors{entry.m_count_with_ancestors},
+          nSizeWithAncestors{entry.nSizeWithAncestors},
+          nModFeesWithAncestors{entry.nModFeesWithAncestors},
+          nSigOpCostWithAncestors{entry.nSigOpCostWithAncestors},
+          idx_randomized{entry.idx_randomized},
+          m_epoch_marker{entry.m_epoch_marker} {}
     struct ExplicitCopyTag {
         explicit ExplicitCopyTag() = default;
     };
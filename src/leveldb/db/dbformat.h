@@ -20,7 +20,8 @@
 namespace leveldb {
 
 // Grouping of constants.  We may want to make some of these
-// parameters set via options.
+// parameters set via options.  The level-0 triggers below are the defaults
+// of the corresponding Options fields.
 namespace config {
 static const int kNumLevels = 7;
 
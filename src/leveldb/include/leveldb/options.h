@@ -81,6 +81,16 @@ struct LEVELDB_EXPORT Options {
   // the next time the database is opened.
   size_t write_buffer_size = 4 * 1024 * 1024;
 
+  // Number of level-0 files at which a compaction into level-1 is started,
+  // at which writes are slowed down, and at which writes are stopped until
+  // the compaction catches up.
+  //
+  // Raising these during bulk loads lets more level-0 files accumulate
+  // before writes stall, at the expense of read performance.
+  int l0_compaction_trigger = 4;
+  int l0_slowdown_writes_trigger = 8;
+  int l0_stop_writes_trigger = 12;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
@@ -2387,6 +2387,16 @@ void CConnman::DumpAddresses()
              addrman.Size(), Ticks<std::chrono::milliseconds>(SteadyClock::now() - start));
 }
 
+void CConnman::FlushAddresses()
+{
+    const auto start{SteadyClock::now()};
+
+    FlushPeerAddresses(::gArgs, addrman);
+
+    LogDebug(BCLog::NET, "Flushed address changes to disk  %dms\n",
+             Ticks<std::chrono::milliseconds>(SteadyClock::now() - start));
+}
+
 void CConnman::ProcessAddrFetch()
 {
     AssertLockNotHeld(m_unused_i2p_sessions_mutex);
@@ -3382,7 +3392,7 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     }
 
     // Dump network addresses
-    scheduler.scheduleEvery([this] { DumpAddresses(); }, DUMP_PEERS_INTERVAL);
+    scheduler.scheduleEvery([this] { FlushAddresses(); }, DUMP_PEERS_INTERVAL);
 
     // Run the ASMap Health check once and then schedule it to run every 24h.
     if (m_netgroupman.UsingASMap()) {
@@ -3859,6 +3869,19 @@ std::optional<std::pair<CNetMessage, bool>> CNode::PollMessage()
     return std::make_pair(std::move(msgs.front()), !m_msg_process_queue.empty());
 }
 
+std::optional<CNetMessage> CNode::PollMessageOfType(std::string_view msg_type)
+{
+    LOCK(m_msg_process_queue_mutex);
+    if (m_msg_process_queue.empty() || m_msg_process_queue.front().m_type != msg_type) return std::nullopt;
+
+    CNetMessage msg{std::move(m_msg_process_queue.front())};
+    m_msg_process_queue.pop_front();
+    m_msg_process_queue_size -= msg.GetMemoryUsage();
+    fPauseRecv = m_msg_process_queue_size > m_recv_flood_size;
+
+    return msg;
+}
+
 bool CConnman::NodeFullyConnected(const CNode* pnode)
 {
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
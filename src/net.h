@@ -756,6 +756,14 @@ public:
     std::optional<std::pair<CNetMessage, bool>> PollMessage()
         EXCLUSIVE_LOCKS_REQUIRED(!m_msg_process_queue_mutex);
 
+    /** Poll the next message from the processing queue of this connection,
+     * but only if it is of the given type.
+     *
+     * Returns std::nullopt if the processing queue is empty or its next
+     * message is of another type. */
+    std::optional<CNetMessage> PollMessageOfType(std::string_view msg_type)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_msg_process_queue_mutex);
+
     /** Account for the total size of a sent message in the per msg type connection stats. */
     void AccountForSentBytes(const std::string& msg_type, size_t sent_bytes)
         EXCLUSIVE_LOCKS_REQUIRED(cs_vSend)
@@ -1379,7 +1387,10 @@ private:
     /** (Try to) send data from node's vSendMsg. Returns (bytes_sent, data_left). */
     std::pair<size_t, bool> SocketSendData(CNode& node) const EXCLUSIVE_LOCKS_REQUIRED(node.cs_vSend);
 
+    //! Write all addresses to peers.dat.
     void DumpAddresses();
+    //! Persist the addresses that changed since the last flush, see FlushPeerAddresses().
+    void FlushAddresses();
 
     // Network stats
     void RecordBytesRecv(uint64_t bytes);
@@ -14,6 +14,7 @@
 #include <chainparams.h>
 #include <common/bloom.h>
 #include <consensus/amount.h>
+#include <consensus/consensus.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
 #include <core_memusage.h>
@@ -65,6 +66,7 @@
 #include <array>
 #include <atomic>
 #include <compare>
+#include <condition_variable>
 #include <cstddef>
 #include <deque>
 #include <exception>
@@ -94,6 +96,9 @@ TRACEPOINT_SEMAPHORE(net, misbehaving_connection);
  *  Timeout = base + per_header * (expected number of headers) */
 static constexpr auto HEADERS_DOWNLOAD_TIMEOUT_BASE = 15min;
 static constexpr auto HEADERS_DOWNLOAD_TIMEOUT_PER_HEADER = 1ms;
+/** How long a peer downloading a headers range (see HeadersRangeSync) may go
+ *  without sending us any of it before the range is given to another peer. */
+static constexpr auto HEADERS_RANGE_TIMEOUT{2min};
 /** How long to wait for a peer to respond to a getheaders request */
 static constexpr auto HEADERS_RESPONSE_TIME{2min};
 /** Protect at least this many outbound peers from disconnection due to slow/
@@ -124,6 +129,12 @@ static const unsigned int MAX_LOCATOR_SZ = 101;
 static const unsigned int MAX_INV_SZ = 50000;
 /** Limit to avoid sending big packets. Not used in processing incoming GETDATA for compatibility */
 static const unsigned int MAX_GETDATA_SZ = 1000;
+/** Maximum number of tx messages queued back to back by one peer that are validated together. */
+static constexpr size_t MAX_TX_BATCH_SIZE{16};
+/** No more tx messages are added to a batch once its transactions reach this weight, so that a
+ *  batch costs about as much to validate as a single large transaction and other peers are not
+ *  kept waiting. */
+static constexpr int64_t MAX_TX_BATCH_WEIGHT{MAX_STANDARD_TX_WEIGHT};
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Default time during which a peer must stall block download progress before being disconnected.
@@ -137,17 +148,68 @@ static const int MAX_CMPCTBLOCK_DEPTH = 5;
 /** Maximum depth of blocks we're willing to respond to GETBLOCKTXN requests for. */
 static const int MAX_BLOCKTXN_DEPTH = 10;
 static_assert(MAX_BLOCKTXN_DEPTH <= MIN_BLOCKS_TO_KEEP, "MAX_BLOCKTXN_DEPTH too high");
+/** How long we hold a GETBLOCKTXN for a compact block we forwarded before reconstructing it. */
+static constexpr auto PENDING_GETBLOCKTXN_TIMEOUT{10s};
+/** Maximum number of such GETBLOCKTXN we hold per peer. */
+static constexpr size_t MAX_PENDING_GETBLOCKTXN{4};
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
  *  degree of disordering of blocks on disk (which make reindexing and pruning harder). We'll probably
  *  want to make this a per-peer adaptive value at some point. */
 static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
+/** Memory budget for the block download window. With blocks up to MAX_BLOCK_SERIALIZED_SIZE, a window of
+ *  BLOCK_DOWNLOAD_WINDOW blocks could describe tens of gigabytes of out-of-order data, so the effective window
+ *  is shrunk until the expected size of the blocks in it fits this budget. */
+static constexpr uint64_t BLOCK_DOWNLOAD_WINDOW_BYTES{1ULL << 31};
+/** Lower bound for the byte-budgeted block download window, in blocks. */
+static constexpr unsigned int BLOCK_DOWNLOAD_WINDOW_MIN{64};
+/** Bytes we are willing to have in flight from a peer whose throughput we have not measured yet. */
+static constexpr uint64_t BLOCK_DOWNLOAD_INFLIGHT_BYTES_INITIAL{64ULL << 20};
+// Until blocks have been received, the limits are those of the block-count based download.
+static_assert(BLOCK_DOWNLOAD_WINDOW_BYTES / BLOCK_DOWNLOAD_SIZE_INITIAL == BLOCK_DOWNLOAD_WINDOW);
+static_assert(BLOCK_DOWNLOAD_INFLIGHT_BYTES_INITIAL / BLOCK_DOWNLOAD_SIZE_INITIAL >= MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+/** Amount of data kept in flight per peer, expressed as transfer time at the peer's measured throughput on
+ *  top of its round-trip time (i.e. a bandwidth-delay product with headroom). */
+static constexpr auto BLOCK_DOWNLOAD_INFLIGHT_TARGET{4s};
+/** Weight of a new sample in the exponentially weighted block size and peer throughput averages. */
+static constexpr double BLOCK_DOWNLOAD_EWMA_ALPHA{0.2};
 /** Block download timeout base, expressed in multiples of the block interval (i.e. 10 min) */
 static constexpr double BLOCK_DOWNLOAD_TIMEOUT_BASE = 1;
 /** Additional block download timeout per parallel downloading peer (i.e. 5 min) */
 static constexpr double BLOCK_DOWNLOAD_TIMEOUT_PER_PEER = 0.5;
 /** Maximum number of headers to announce when relaying blocks with headers message.*/
 static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
+
+unsigned int BlockDownloadWindow(double avg_block_size)
+{
+    const uint64_t window{BLOCK_DOWNLOAD_WINDOW_BYTES / std::max<uint64_t>(1, avg_block_size)};
+    return std::clamp<uint64_t>(window, BLOCK_DOWNLOAD_WINDOW_MIN, BLOCK_DOWNLOAD_WINDOW);
+}
+
+int MaxBlocksInTransit(double avg_block_size, double download_rate, std::chrono::microseconds min_ping_time)
+{
+    double budget_bytes{BLOCK_DOWNLOAD_INFLIGHT_BYTES_INITIAL};
+    if (download_rate > 0) {
+        // Keep the pipe full: the bandwidth-delay product, plus BLOCK_DOWNLOAD_INFLIGHT_TARGET worth of data
+        // so that a burst of validation on our side doesn't drain it.
+        const auto rtt{min_ping_time == std::chrono::microseconds::max() ? 0us : min_ping_time};
+        budget_bytes = download_rate * (count_microseconds(rtt + BLOCK_DOWNLOAD_INFLIGHT_TARGET) / 1e6);
+    }
+    const double blocks{budget_bytes / std::max(1.0, avg_block_size)};
+    return static_cast<int>(std::clamp<double>(blocks, 1, MAX_BLOCKS_IN_TRANSIT_PER_PEER));
+}
+
+std::chrono::microseconds BlockStallingTimeout(double avg_block_size, double download_rate, std::chrono::seconds stalling_timeout)
+{
+    std::chrono::microseconds timeout{stalling_timeout};
+    if (download_rate > 0) {
+        // A peer that is still delivering at its usual rate is slow, not stalling. Its in-flight limit
+        // already shrinks with its throughput, so only disconnect once it falls behind its own pace.
+        const double transfer_secs{std::min<double>(avg_block_size / download_rate, count_seconds(BLOCK_STALLING_TIMEOUT_MAX))};
+        timeout = std::max(timeout, std::chrono::microseconds{int64_t(transfer_secs * 1e6)});
+    }
+    return std::min<std::chrono::microseconds>(timeout, BLOCK_STALLING_TIMEOUT_MAX);
+}
 /** Minimum blocks required to signal NODE_NETWORK_LIMITED */
 static const unsigned int NODE_NETWORK_LIMITED_MIN_BLOCKS = 288;
 /** Window, in blocks, for connecting to NODE_NETWORK_LIMITED peers */
@@ -278,6 +340,8 @@ struct Peer {
 
     /** Whether this peer relays txs via wtxid */
     std::atomic<bool> m_wtxid_relay{false};
+    /** Whether this peer wants our wtxid announcements with size and fee hints (INVHINTS) */
+    std::atomic<bool> m_inv_hints{false};
     /** The feerate in the most recent BIP133 `feefilter` message sent to the peer.
      *  It is *not* a p2p protocol violation for the peer to send us
      *  transactions with a lower fee rate than this. See BIP133. */
@@ -389,6 +453,14 @@ struct Peer {
     Mutex m_getdata_requests_mutex;
     /** Work queue of items requested by this peer **/
     std::deque<CInv> m_getdata_requests GUARDED_BY(m_getdata_requests_mutex);
+    /** Whether a block this peer requested is being read on a block read thread. Further getdata
+     *  items are held back until it has been sent, so replies stay in request order. */
+    std::atomic<bool> m_block_read_pending{false};
+
+    /** Getblocktxn requests for compact blocks we forwarded before reconstructing them, with the
+     *  time each arrived, oldest first. Answered once the block is available, or treated like a
+     *  request for an unknown block after PENDING_GETBLOCKTXN_TIMEOUT. */
+    std::deque<std::pair<BlockTransactionsRequest, std::chrono::microseconds>> m_pending_getblocktxn GUARDED_BY(NetEventsInterface::g_msgproc_mutex);
 
     /** Time of the last getheaders message to this peer */
     NodeClock::time_point m_last_getheaders_timestamp GUARDED_BY(NetEventsInterface::g_msgproc_mutex){};
@@ -449,6 +521,8 @@ struct CNodeState {
     std::list<QueuedBlock> vBlocksInFlight;
     //! When the first entry in vBlocksInFlight started downloading. Don't care when vBlocksInFlight is empty.
     std::chrono::microseconds m_downloading_since{0us};
+    //! Smoothed block download throughput from this peer in bytes per second, or 0 if not yet measured.
+    double m_block_download_rate{0};
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload{false};
     /** Whether this peer wants invs or cmpctblocks (when possible) for block announcements. */
@@ -503,6 +577,7 @@ public:
     PeerManagerImpl(CConnman& connman, AddrMan& addrman,
                     BanMan* banman, ChainstateManager& chainman,
                     CTxMemPool& pool, node::Warnings& warnings, Options opts);
+    ~PeerManagerImpl() override;
 
     /** Overridden from CValidationInterface. */
     void ActiveTipChange(const CBlockIndex& new_tip, bool) override
@@ -523,7 +598,7 @@ public:
     void FinalizeNode(const CNode& node) override EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_headers_presync_mutex, !m_tx_download_mutex);
     bool HasAllDesirableServiceFlags(ServiceFlags services) const override;
     bool ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt) override
-        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_most_recent_block_mutex, !m_headers_presync_mutex, g_msgproc_mutex, !m_tx_download_mutex);
+        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_most_recent_block_mutex, !m_headers_presync_mutex, g_msgproc_mutex, !m_tx_download_mutex, !m_block_reads_mutex);
     bool SendMessages(CNode* pto) override
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_most_recent_block_mutex, g_msgproc_mutex, !m_tx_download_mutex);
 
@@ -532,7 +607,7 @@ public:
     void CheckForStaleTipAndEvictPeers() override;
     std::optional<std::string> FetchBlock(NodeId peer_id, const CBlockIndex& block_index) override
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex);
-    bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats) const override EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex);
+    bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats) const override EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_tx_download_mutex);
     std::vector<TxOrphanage::OrphanTxBase> GetOrphanTransactions() override EXCLUSIVE_LOCKS_REQUIRED(!m_tx_download_mutex);
     PeerManagerInfo GetInfo() const override EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex);
     void SendPings() override EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex);
@@ -545,7 +620,7 @@ public:
     void UnitTestMisbehaving(NodeId peer_id) override EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex) { Misbehaving(*Assert(GetPeerRef(peer_id)), ""); };
     void ProcessMessage(CNode& pfrom, const std::string& msg_type, DataStream& vRecv,
                         const std::chrono::microseconds time_received, const std::atomic<bool>& interruptMsgProc) override
-        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_most_recent_block_mutex, !m_headers_presync_mutex, g_msgproc_mutex, !m_tx_download_mutex);
+        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_most_recent_block_mutex, !m_headers_presync_mutex, g_msgproc_mutex, !m_tx_download_mutex, !m_block_reads_mutex);
     void UpdateLastBlockAnnounceTime(NodeId node, int64_t time_in_seconds) override;
     ServiceFlags GetDesirableServiceFlags(ServiceFlags services) const override;
 
@@ -623,6 +698,15 @@ private:
     void ProcessPackageResult(const node::PackageToValidate& package_to_validate, const PackageMempoolAcceptResult& package_result)
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, g_msgproc_mutex, m_tx_download_mutex);
 
+    /** Handle transactions received back to back from a peer: hand each to the download manager
+     * and submit the ones it wants validated to the mempool together, in the order received.
+     */
+    void ProcessTransactionBatch(CNode& pfrom, Peer& peer, const std::vector<CTransactionRef>& txs)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, g_msgproc_mutex, !m_tx_download_mutex);
+
+    /** Trace and, if enabled, capture a message taken from the processing queue of a peer. */
+    void TraceInboundMessage(const CNode& node, const CNetMessage& msg);
+
     /**
      * Reconsider orphan transactions after a parent has been accepted to the mempool.
      *
@@ -705,6 +789,14 @@ private:
      * This returns true if a getheaders is actually sent, and false otherwise.
      */
     bool MaybeSendGetHeaders(CNode& pfrom, const CBlockLocator& locator, Peer& peer) EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex);
+    /** Send the next request for the headers range a peer is downloading (see HeadersRangeSync). */
+    void SendHeadersRangeRequest(CNode& pfrom, Peer& peer, const HeadersRangeSync::Request& request) EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex);
+    /** If headers continue the range pfrom is downloading, add them to it.
+     *  @return true if the headers were handled */
+    bool MaybeProcessHeadersRange(CNode& pfrom, Peer& peer, const std::vector<CBlockHeader>& headers)
+        EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex) LOCKS_EXCLUDED(::cs_main);
+    /** Accept the headers of completed ranges that now connect to our block index. */
+    void AcceptHeadersRanges() LOCKS_EXCLUDED(::cs_main);
     /** Potentially fetch blocks from this peer upon receipt of a new headers tip */
     void HeadersDirectFetchBlocks(CNode& pfrom, const Peer& peer, const CBlockIndex& last_header);
     /** Update peer state based on received headers message */
@@ -713,6 +805,22 @@ private:
 
     void SendBlockTransactions(CNode& pfrom, Peer& peer, const CBlock& block, const BlockTransactionsRequest& req);
 
+    /** Answer a getblocktxn for a block we have stored: with blocktxn if it is recent enough, with
+     *  the full block otherwise. Returns false if we don't have the block. */
+    bool SendStoredBlockTransactions(CNode& pfrom, Peer& peer, const BlockTransactionsRequest& req)
+        EXCLUSIVE_LOCKS_REQUIRED(!cs_main, !peer.m_getdata_requests_mutex);
+
+    /** Answer a getblocktxn that arrived before we had reconstructed the block, once we have it. */
+    void MaybeSendPendingBlockTransactions(CNode& node, Peer& peer, std::chrono::microseconds current_time)
+        EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex, !m_most_recent_block_mutex, !cs_main, !peer.m_getdata_requests_mutex);
+
+    /**
+     * Forward a compact block whose header passed PoW to our high-bandwidth peers, before we have
+     * reconstructed or validated the block (see BIP 152).
+     */
+    void FastRelayCompactBlock(const CBlockIndex& index, const CBlockHeaderAndShortTxIDs& cmpctblock, NodeId from)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_most_recent_block_mutex);
+
     /** Send a message to a peer */
     void PushMessage(CNode& node, CSerializedNetMsg&& msg) const { m_connman.PushMessage(&node, std::move(msg)); }
     template <typename... Args>
@@ -768,7 +876,7 @@ private:
      * - A txhash (txid or wtxid) in m_txrequest is not also in m_lazy_recent_confirmed_transactions.
      * - Each data structure's limits hold (m_orphanage max size, m_txrequest per-peer limits, etc).
      */
-    Mutex m_tx_download_mutex ACQUIRED_BEFORE(m_mempool.cs);
+    mutable Mutex m_tx_download_mutex ACQUIRED_BEFORE(m_mempool.cs);
     node::TxDownloadManager m_txdownloadman GUARDED_BY(m_tx_download_mutex);
 
     std::unique_ptr<TxReconciliationTracker> m_txreconciliation;
@@ -818,6 +926,10 @@ private:
     /** Number of nodes with fSyncStarted. */
     int nSyncStarted GUARDED_BY(cs_main) = 0;
 
+    /** Headers between hardcoded blocks, downloaded from peers other than the
+     *  ones with fSyncStarted while we are far behind. */
+    HeadersRangeSync m_headers_ranges GUARDED_BY(cs_main);
+
     /** Hash of the last block we received via INV */
     uint256 m_last_block_inv_triggering_headers_sync GUARDED_BY(g_msgproc_mutex){};
 
@@ -857,6 +969,14 @@ private:
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> m_most_recent_compact_block GUARDED_BY(m_most_recent_block_mutex);
     uint256 m_most_recent_block_hash GUARDED_BY(m_most_recent_block_mutex);
     std::unique_ptr<const std::map<uint256, CTransactionRef>> m_most_recent_block_txs GUARDED_BY(m_most_recent_block_mutex);
+    /** The compact block we last forwarded ahead of reconstructing it (see FastRelayCompactBlock). */
+    uint256 m_fast_relayed_block_hash GUARDED_BY(m_most_recent_block_mutex);
+
+    /** Number of block requests being served on block read threads. The destructor waits for them,
+     *  as their callbacks use this object. */
+    Mutex m_block_reads_mutex;
+    std::condition_variable m_block_reads_cv;
+    int m_block_reads_in_flight GUARDED_BY(m_block_reads_mutex){0};
 
     // Data about the low-work headers synchronization, aggregated from all peers' HeadersSyncStates.
     /** Mutex guarding the other m_headers_presync_* variables. */
@@ -951,9 +1071,13 @@ private:
         EXCLUSIVE_LOCKS_REQUIRED(!m_most_recent_block_mutex, NetEventsInterface::g_msgproc_mutex);
 
     void ProcessGetData(CNode& pfrom, Peer& peer, const std::atomic<bool>& interruptMsgProc)
-        EXCLUSIVE_LOCKS_REQUIRED(!m_most_recent_block_mutex, peer.m_getdata_requests_mutex, NetEventsInterface::g_msgproc_mutex)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_most_recent_block_mutex, peer.m_getdata_requests_mutex, NetEventsInterface::g_msgproc_mutex, !m_block_reads_mutex)
         LOCKS_EXCLUDED(::cs_main);
 
+    /** Announce transactions a reconciliation round found the peer to be missing. */
+    void AnnounceReconciledTxs(CNode& pto, Peer& peer, const std::vector<Wtxid>& wtxids)
+        EXCLUSIVE_LOCKS_REQUIRED(NetEventsInterface::g_msgproc_mutex);
+
     /** Process a new block. Perform any post-processing housekeeping */
     void ProcessBlock(CNode& node, const std::shared_ptr<const CBlock>& block, bool force_processing, bool min_pow_checked);
 
@@ -975,6 +1099,33 @@ private:
     /** Number of peers from which we're downloading blocks. */
     int m_peers_downloading_from GUARDED_BY(cs_main) = 0;
 
+    /** Compact blocks we started reconstructing. */
+    std::atomic<uint64_t> m_cmpctblocks_received{0};
+    /** getblocktxn round-trips needed to complete compact block reconstruction. */
+    std::atomic<uint64_t> m_getblocktxn_sent{0};
+    /** Transactions requested through those getblocktxn round-trips. */
+    std::atomic<uint64_t> m_getblocktxn_txn_requested{0};
+
+    /** Smoothed serialized size of recently received blocks, used to express the block download
+     *  window and per-peer in-flight limits in bytes. */
+    double m_avg_block_size GUARDED_BY(cs_main){BLOCK_DOWNLOAD_SIZE_INITIAL};
+
+    /** Update the block size and per-peer throughput estimates after receiving a block of nBytes
+     *  serialized bytes that we requested from nodeid. Must be called before RemoveBlockRequest. */
+    void RecordBlockDownload(NodeId nodeid, const uint256& hash, size_t nBytes) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** Size of the block download window, in blocks, so that it fits BLOCK_DOWNLOAD_WINDOW_BYTES. */
+    unsigned int GetBlockDownloadWindow() const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** Number of blocks we are willing to have in flight from a peer, derived from its measured
+     *  throughput and round-trip time. Always between 1 and MAX_BLOCKS_IN_TRANSIT_PER_PEER. */
+    int GetMaxBlocksInTransit(const CNodeState& state, std::chrono::microseconds min_ping_time) const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** Time a stalling peer is given before being disconnected: at least stalling_timeout, extended to
+     *  the time the peer needs to transfer one block at its measured throughput, capped at
+     *  BLOCK_STALLING_TIMEOUT_MAX. */
+    std::chrono::microseconds GetStallingTimeout(const CNodeState& state, std::chrono::seconds stalling_timeout) const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     void AddToCompactExtraTransactions(const CTransactionRef& tx) EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex);
 
     /** Orphan/conflicted/etc transactions that are kept for compact block reconstruction.
@@ -1005,7 +1156,21 @@ private:
     bool BlockRequestAllowed(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool AlreadyHaveBlock(const uint256& block_hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     void ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv& inv)
-        EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex, !m_most_recent_block_mutex);
+        EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex, !m_most_recent_block_mutex, !m_block_reads_mutex);
+    /**
+     * Answer a block request from the serialized block read from disk, which is empty if the read
+     * failed. May run on a block read thread (see ProcessGetBlockData), so it must not use
+     * anything only the message handler thread may touch.
+     */
+    void SendBlockFromDisk(CNode& pfrom, Peer& peer, const CInv& inv, const CBlockIndex& index,
+                           const CBlockIndex& tip, bool send_cmpctblock, uint64_t cmpctblock_nonce,
+                           std::vector<unsigned char> block_data) LOCKS_EXCLUDED(::cs_main);
+    /** Send a block in the format asked for by inv. */
+    void SendBlock(CNode& pfrom, Peer& peer, const CInv& inv, const CBlock& block, bool send_cmpctblock,
+                   const CBlockHeaderAndShortTxIDs* recent_compact_block, uint64_t cmpctblock_nonce);
+    /** Trigger the peer to send a getblocks request for the next batch of inventory if inv was the
+     *  last block of the previous batch. Must be sent right after that block. */
+    void MaybeSendContinuationInv(CNode& pfrom, Peer& peer, const CInv& inv, const CBlockIndex& tip);
 
     /**
      * Validation logic for compact filters request handling.
@@ -1213,6 +1378,46 @@ void PeerManagerImpl::RemoveBlockRequest(const uint256& hash, std::optional<Node
     }
 }
 
+void PeerManagerImpl::RecordBlockDownload(NodeId nodeid, const uint256& hash, size_t nBytes)
+{
+    CNodeState* state = State(nodeid);
+    if (state == nullptr || state->vBlocksInFlight.empty()) return;
+
+    // Only blocks we actually asked for tell us something about the size of the blocks we're downloading.
+    auto range = mapBlocksInFlight.equal_range(hash);
+    if (std::none_of(range.first, range.second, [&](const auto& entry) { return entry.second.first == nodeid; })) return;
+
+    m_avg_block_size += BLOCK_DOWNLOAD_EWMA_ALPHA * (nBytes - m_avg_block_size);
+
+    // Peers serve blocks in the order they were requested, so the transfer time of the block at the front of
+    // the queue is the time since m_downloading_since. Blocks received out of order would inflate the measured
+    // rate and are ignored.
+    if (state->vBlocksInFlight.front().pindex->GetBlockHash() != hash) return;
+    const auto elapsed{GetTime<std::chrono::microseconds>() - state->m_downloading_since};
+    if (elapsed <= 0us) return;
+    const double sample{nBytes / (elapsed.count() / 1e6)};
+    if (state->m_block_download_rate == 0) {
+        state->m_block_download_rate = sample;
+    } else {
+        state->m_block_download_rate += BLOCK_DOWNLOAD_EWMA_ALPHA * (sample - state->m_block_download_rate);
+    }
+}
+
+unsigned int PeerManagerImpl::GetBlockDownloadWindow() const
+{
+    return BlockDownloadWindow(m_avg_block_size);
+}
+
+int PeerManagerImpl::GetMaxBlocksInTransit(const CNodeState& state, std::chrono::microseconds min_ping_time) const
+{
+    return MaxBlocksInTransit(m_avg_block_size, state.m_block_download_rate, min_ping_time);
+}
+
+std::chrono::microseconds PeerManagerImpl::GetStallingTimeout(const CNodeState& state, std::chrono::seconds stalling_timeout) const
+{
+    return BlockStallingTimeout(m_avg_block_size, state.m_block_download_rate, stalling_timeout);
+}
+
 bool PeerManagerImpl::BlockRequested(NodeId nodeid, const CBlockIndex& block, std::list<QueuedBlock>::iterator** pit)
 {
     const uint256& hash{block.GetBlockHash()};
@@ -1412,10 +1617,10 @@ void PeerManagerImpl::FindNextBlocksToDownload(const Peer& peer, unsigned int co
         return;
 
     const CBlockIndex *pindexWalk = state->pindexLastCommonBlock;
-    // Never fetch further than the best block we know the peer has, or more than BLOCK_DOWNLOAD_WINDOW + 1 beyond the last
+    // Never fetch further than the best block we know the peer has, or more than the download window + 1 beyond the last
     // linked block we have in common with this peer. The +1 is so we can detect stalling, namely if we would be able to
     // download that next block if the window were 1 larger.
-    int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
+    int nWindowEnd = state->pindexLastCommonBlock->nHeight + GetBlockDownloadWindow();
 
     FindNextBlocks(vBlocks, peer, state, pindexWalk, count, nWindowEnd, &m_chainman.ActiveChain(), &nodeStaller);
 }
@@ -1446,7 +1651,7 @@ void PeerManagerImpl::TryDownloadingHistoricalBlocks(const Peer& peer, unsigned
         return;
     }
 
-    FindNextBlocks(vBlocks, peer, state, from_tip, count, std::min<int>(from_tip->nHeight + BLOCK_DOWNLOAD_WINDOW, target_block->nHeight));
+    FindNextBlocks(vBlocks, peer, state, from_tip, count, std::min<int>(from_tip->nHeight + GetBlockDownloadWindow(), target_block->nHeight));
 }
 
 void PeerManagerImpl::FindNextBlocks(std::vector<const CBlockIndex*>& vBlocks, const Peer& peer, CNodeState *state, const CBlockIndex *pindexWalk, unsigned int count, int nWindowEnd, const CChain* activeChain, NodeId* nodeStaller)
@@ -1622,6 +1827,7 @@ void PeerManagerImpl::FinalizeNode(const CNode& node)
 
     if (state->fSyncStarted)
         nSyncStarted--;
+    m_headers_ranges.ReleaseRange(nodeid);
 
     for (const QueuedBlock& entry : state->vBlocksInFlight) {
         auto range = mapBlocksInFlight.equal_range(entry.pindex->GetBlockHash());
@@ -1756,6 +1962,7 @@ bool PeerManagerImpl::GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats) c
         }
     }
     stats.time_offset = peer->m_time_offset;
+    stats.m_tx_fetch_latency = WITH_LOCK(m_tx_download_mutex, return m_txdownloadman.GetFetchLatency(nodeid));
 
     return true;
 }
@@ -1771,6 +1978,10 @@ PeerManagerInfo PeerManagerImpl::GetInfo() const
     return PeerManagerInfo{
         .median_outbound_time_offset = m_outbound_time_offsets.Median(),
         .ignores_incoming_txs = m_opts.ignore_incoming_txs,
+        .cmpctblocks_received = m_cmpctblocks_received.load(),
+        .getblocktxn_sent = m_getblocktxn_sent.load(),
+        .getblocktxn_txn_requested = m_getblocktxn_txn_requested.load(),
+        .txreconciliation = m_txreconciliation ? std::make_optional(m_txreconciliation->GetStats()) : std::nullopt,
     };
 }
 
@@ -1913,6 +2124,16 @@ std::optional<std::string> PeerManagerImpl::FetchBlock(NodeId peer_id, const CBl
     return std::nullopt;
 }
 
+/** The blocks whose hash we know in advance: genesis and the assumeutxo snapshot blocks. */
+static std::vector<HeadersRangeSync::Anchor> HeadersRangeAnchors(const CChainParams& params)
+{
+    std::vector<HeadersRangeSync::Anchor> anchors{{0, params.GenesisBlock().GetHash()}};
+    for (const int height : params.GetAvailableSnapshotHeights()) {
+        anchors.push_back({height, params.AssumeutxoForHeight(height)->blockhash});
+    }
+    return anchors;
+}
+
 std::unique_ptr<PeerManager> PeerManager::make(CConnman& connman, AddrMan& addrman,
                                                BanMan* banman, ChainstateManager& chainman,
                                                CTxMemPool& pool, node::Warnings& warnings, Options opts)
@@ -1932,6 +2153,7 @@ PeerManagerImpl::PeerManagerImpl(CConnman& connman, AddrMan& addrman,
       m_chainman(chainman),
       m_mempool(pool),
       m_txdownloadman(node::TxDownloadOptions{pool, m_rng, opts.max_orphan_txs, opts.deterministic_rng}),
+      m_headers_ranges{chainman.GetConsensus(), HeadersRangeAnchors(chainman.GetParams())},
       m_warnings{warnings},
       m_opts{opts}
 {
@@ -1942,6 +2164,12 @@ PeerManagerImpl::PeerManagerImpl(CConnman& connman, AddrMan& addrman,
     }
 }
 
+PeerManagerImpl::~PeerManagerImpl()
+{
+    WAIT_LOCK(m_block_reads_mutex, lock);
+    m_block_reads_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_block_reads_mutex) { return m_block_reads_in_flight == 0; });
+}
+
 void PeerManagerImpl::StartScheduledTasks(CScheduler& scheduler)
 {
     // Stale tip checking and peer eviction are on two different timers, but we
@@ -2018,7 +2246,9 @@ void PeerManagerImpl::BlockDisconnected(const std::shared_ptr<const CBlock> &blo
  */
 void PeerManagerImpl::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock)
 {
-    auto pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(*pblock, FastRandomContext().rand64());
+    // The block isn't connected yet, so our mempool still tells us which of its transactions we (and
+    // likely our peers) never saw.
+    auto pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(*pblock, FastRandomContext().rand64(), &m_mempool);
 
     LOCK(cs_main);
 
@@ -2067,6 +2297,41 @@ void PeerManagerImpl::NewPoWValidBlock(const CBlockIndex *pindex, const std::sha
     });
 }
 
+void PeerManagerImpl::FastRelayCompactBlock(const CBlockIndex& index, const CBlockHeaderAndShortTxIDs& cmpctblock, NodeId from)
+{
+    LOCK(cs_main);
+
+    // Only forward blocks that extend our tip and that we are still waiting for; anything else is
+    // announced through the regular path once (and if) it is validated.
+    if (index.pprev != m_chainman.ActiveChain().Tip() || (index.nStatus & BLOCK_HAVE_DATA)) return;
+    if (index.nHeight <= m_highest_fast_announce) return;
+    if (!DeploymentActiveAt(index, m_chainman, Consensus::DEPLOYMENT_SEGWIT)) return;
+
+    const uint256 hash{index.GetBlockHash()};
+    WITH_LOCK(m_most_recent_block_mutex, m_fast_relayed_block_hash = hash);
+
+    const std::shared_future<CSerializedNetMsg> lazy_ser{
+        std::async(std::launch::deferred, [&] { return NetMsg::Make(NetMsgType::CMPCTBLOCK, cmpctblock); })};
+
+    m_connman.ForEachNode([this, &index, &lazy_ser, &hash, from](CNode* pnode) EXCLUSIVE_LOCKS_REQUIRED(::cs_main) {
+        AssertLockHeld(::cs_main);
+
+        if (pnode->GetId() == from || pnode->GetCommonVersion() < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect)
+            return;
+        ProcessBlockAvailability(pnode->GetId());
+        CNodeState& state = *State(pnode->GetId());
+        // Same conditions as NewPoWValidBlock, which skips peers we already sent the header to here.
+        if (state.m_requested_hb_cmpctblocks && !PeerHasHeader(&state, &index) && PeerHasHeader(&state, index.pprev)) {
+            LogDebug(BCLog::NET, "%s forwarding header-and-ids %s to peer=%d before reconstruction\n", "PeerManager::FastRelayCompactBlock",
+                    hash.ToString(), pnode->GetId());
+
+            const CSerializedNetMsg& ser_cmpctblock{lazy_ser.get()};
+            PushMessage(*pnode, ser_cmpctblock.Copy());
+            state.pindexBestHeaderSent = &index;
+        }
+    });
+}
+
 /**
  * Update our best height and announce any block hashes which weren't previously
  * in m_chainman.ActiveChain() to our peers.
@@ -2303,97 +2568,147 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
         block_pos = pindex->GetBlockPos();
     }
 
-    std::shared_ptr<const CBlock> pblock;
+    // Compact block requests for blocks too old to be worth compacting are answered with the full
+    // block, with witness.
+    const bool send_cmpctblock{inv.IsMsgCmpctBlk() && can_direct_fetch && pindex->nHeight >= tip->nHeight - MAX_CMPCTBLOCK_DEPTH};
+
     if (a_recent_block && a_recent_block->GetHash() == inv.hash) {
-        pblock = a_recent_block;
-    } else if (inv.IsMsgWitnessBlk()) {
-        // Fast-path: in this case it is possible to serve the block directly from disk,
-        // as the network format matches the format on disk
-        std::vector<std::byte> block_data;
-        if (!m_chainman.m_blockman.ReadRawBlock(block_data, block_pos)) {
-            if (WITH_LOCK(m_chainman.GetMutex(), return m_chainman.m_blockman.IsBlockPruned(*pindex))) {
-                LogDebug(BCLog::NET, "Block was pruned before it could be read, %s\n", pfrom.DisconnectMsg(fLogIPs));
-            } else {
-                LogError("Cannot load block from disk, %s\n", pfrom.DisconnectMsg(fLogIPs));
+        SendBlock(pfrom, peer, inv, *a_recent_block, send_cmpctblock,
+                  a_recent_compact_block && a_recent_compact_block->header.GetHash() == inv.hash ? a_recent_compact_block.get() : nullptr,
+                  send_cmpctblock ? m_rng.rand64() : 0);
+        MaybeSendContinuationInv(pfrom, peer, inv, *tip);
+        return;
+    }
+
+    // Read the block on a block read thread if there is one, so that a peer fetching old blocks
+    // does not hold up the message handler (and every other peer) while we wait on the disk. The
+    // nonce is drawn here because m_rng may only be used from the message handler thread.
+    const uint64_t cmpctblock_nonce{send_cmpctblock ? m_rng.rand64() : 0};
+    const NodeId node_id{pfrom.GetId()};
+    WITH_LOCK(m_block_reads_mutex, ++m_block_reads_in_flight);
+    peer.m_block_read_pending = true;
+    const bool queued{m_chainman.m_blockman.ReadRawBlockAsync(block_pos,
+        [this, node_id, inv, pindex, tip, send_cmpctblock, cmpctblock_nonce](std::vector<unsigned char> block_data) {
+            PeerRef peer{GetPeerRef(node_id)};
+            CNode* node{nullptr};
+            m_connman.ForNode(node_id, [&node](CNode* pnode) {
+                node = pnode->AddRef();
+                return true;
+            });
+            if (peer && node) {
+                SendBlockFromDisk(*node, *peer, inv, *pindex, *tip, send_cmpctblock, cmpctblock_nonce, std::move(block_data));
             }
-            pfrom.fDisconnect = true;
-            return;
+            if (node) node->Release();
+            if (peer) peer->m_block_read_pending = false;
+            m_connman.WakeMessageHandler();
+            LOCK(m_block_reads_mutex);
+            --m_block_reads_in_flight;
+            m_block_reads_cv.notify_all();
+        })};
+    if (queued) return;
+
+    WITH_LOCK(m_block_reads_mutex, --m_block_reads_in_flight);
+    peer.m_block_read_pending = false;
+    std::vector<unsigned char> block_data;
+    if (!m_chainman.m_blockman.ReadRawBlock(block_data, block_pos)) block_data.clear();
+    SendBlockFromDisk(pfrom, peer, inv, *pindex, *tip, send_cmpctblock, cmpctblock_nonce, std::move(block_data));
+}
+
+void PeerManagerImpl::SendBlockFromDisk(CNode& pfrom, Peer& peer, const CInv& inv, const CBlockIndex& index,
+                                        const CBlockIndex& tip, bool send_cmpctblock, uint64_t cmpctblock_nonce,
+                                        std::vector<unsigned char> block_data)
+{
+    if (block_data.empty()) {
+        if (WITH_LOCK(m_chainman.GetMutex(), return m_chainman.m_blockman.IsBlockPruned(index))) {
+            LogDebug(BCLog::NET, "Block was pruned before it could be read, %s\n", pfrom.DisconnectMsg(fLogIPs));
+        } else {
+            LogError("Cannot load block from disk, %s\n", pfrom.DisconnectMsg(fLogIPs));
         }
-        MakeAndPushMessage(pfrom, NetMsgType::BLOCK, std::span{block_data});
-        // Don't set pblock as we've sent the block
+        pfrom.fDisconnect = true;
+        return;
+    }
+
+    if (inv.IsMsgWitnessBlk() || (inv.IsMsgCmpctBlk() && !send_cmpctblock)) {
+        // Fast-path: in this case it is possible to serve the block directly from disk,
+        // as the network format matches the format on disk. The buffer it was read into
+        // becomes the message buffer rather than being copied there.
+        CSerializedNetMsg msg;
+        msg.m_type = NetMsgType::BLOCK;
+        msg.data = std::move(block_data);
+        PushMessage(pfrom, std::move(msg));
     } else {
-        // Send block from disk
-        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-        if (!m_chainman.m_blockman.ReadBlock(*pblockRead, block_pos, inv.hash)) {
-            if (WITH_LOCK(m_chainman.GetMutex(), return m_chainman.m_blockman.IsBlockPruned(*pindex))) {
-                LogDebug(BCLog::NET, "Block was pruned before it could be read, %s\n", pfrom.DisconnectMsg(fLogIPs));
-            } else {
-                LogError("Cannot load block from disk, %s\n", pfrom.DisconnectMsg(fLogIPs));
-            }
+        CBlock block;
+        if (!m_chainman.m_blockman.DecodeBlock(block, MakeByteSpan(block_data), index.GetBlockPos(), inv.hash)) {
+            LogError("Cannot load block from disk, %s\n", pfrom.DisconnectMsg(fLogIPs));
             pfrom.fDisconnect = true;
             return;
         }
-        pblock = pblockRead;
-    }
-    if (pblock) {
-        if (inv.IsMsgBlk()) {
-            MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_NO_WITNESS(*pblock));
-        } else if (inv.IsMsgWitnessBlk()) {
-            MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_WITH_WITNESS(*pblock));
-        } else if (inv.IsMsgFilteredBlk()) {
-            bool sendMerkleBlock = false;
-            CMerkleBlock merkleBlock;
-            if (auto tx_relay = peer.GetTxRelay(); tx_relay != nullptr) {
-                LOCK(tx_relay->m_bloom_filter_mutex);
-                if (tx_relay->m_bloom_filter) {
-                    sendMerkleBlock = true;
-                    merkleBlock = CMerkleBlock(*pblock, *tx_relay->m_bloom_filter);
-                }
-            }
-            if (sendMerkleBlock) {
-                MakeAndPushMessage(pfrom, NetMsgType::MERKLEBLOCK, merkleBlock);
-                // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                // This avoids hurting performance by pointlessly requiring a round-trip
-                // Note that there is currently no way for a node to request any single transactions we didn't send here -
-                // they must either disconnect and retry or request the full block.
-                // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                // however we MUST always provide at least what the remote peer needs
-                typedef std::pair<unsigned int, uint256> PairType;
-                for (PairType& pair : merkleBlock.vMatchedTxn)
-                    MakeAndPushMessage(pfrom, NetMsgType::TX, TX_NO_WITNESS(*pblock->vtx[pair.first]));
+        SendBlock(pfrom, peer, inv, block, send_cmpctblock, /*recent_compact_block=*/nullptr, cmpctblock_nonce);
+    }
+    MaybeSendContinuationInv(pfrom, peer, inv, tip);
+}
+
+void PeerManagerImpl::SendBlock(CNode& pfrom, Peer& peer, const CInv& inv, const CBlock& block, bool send_cmpctblock,
+                                const CBlockHeaderAndShortTxIDs* recent_compact_block, uint64_t cmpctblock_nonce)
+{
+    if (inv.IsMsgBlk()) {
+        MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_NO_WITNESS(block));
+    } else if (inv.IsMsgWitnessBlk()) {
+        MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_WITH_WITNESS(block));
+    } else if (inv.IsMsgFilteredBlk()) {
+        bool sendMerkleBlock = false;
+        CMerkleBlock merkleBlock;
+        if (auto tx_relay = peer.GetTxRelay(); tx_relay != nullptr) {
+            LOCK(tx_relay->m_bloom_filter_mutex);
+            if (tx_relay->m_bloom_filter) {
+                sendMerkleBlock = true;
+                merkleBlock = CMerkleBlock(block, *tx_relay->m_bloom_filter);
             }
-            // else
-            // no response
-        } else if (inv.IsMsgCmpctBlk()) {
-            // If a peer is asking for old blocks, we're almost guaranteed
-            // they won't have a useful mempool to match against a compact block,
-            // and we don't feel like constructing the object for them, so
-            // instead we respond with the full, non-compact block.
-            if (can_direct_fetch && pindex->nHeight >= tip->nHeight - MAX_CMPCTBLOCK_DEPTH) {
-                if (a_recent_compact_block && a_recent_compact_block->header.GetHash() == inv.hash) {
-                    MakeAndPushMessage(pfrom, NetMsgType::CMPCTBLOCK, *a_recent_compact_block);
-                } else {
-                    CBlockHeaderAndShortTxIDs cmpctblock{*pblock, m_rng.rand64()};
-                    MakeAndPushMessage(pfrom, NetMsgType::CMPCTBLOCK, cmpctblock);
-                }
+        }
+        if (sendMerkleBlock) {
+            MakeAndPushMessage(pfrom, NetMsgType::MERKLEBLOCK, merkleBlock);
+            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+            // This avoids hurting performance by pointlessly requiring a round-trip
+            // Note that there is currently no way for a node to request any single transactions we didn't send here -
+            // they must either disconnect and retry or request the full block.
+            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+            // however we MUST always provide at least what the remote peer needs
+            typedef std::pair<unsigned int, uint256> PairType;
+            for (PairType& pair : merkleBlock.vMatchedTxn)
+                MakeAndPushMessage(pfrom, NetMsgType::TX, TX_NO_WITNESS(*block.vtx[pair.first]));
+        }
+        // else
+        // no response
+    } else if (inv.IsMsgCmpctBlk()) {
+        // If a peer is asking for old blocks, we're almost guaranteed
+        // they won't have a useful mempool to match against a compact block,
+        // and we don't feel like constructing the object for them, so
+        // instead we respond with the full, non-compact block.
+        if (send_cmpctblock) {
+            if (recent_compact_block) {
+                MakeAndPushMessage(pfrom, NetMsgType::CMPCTBLOCK, *recent_compact_block);
             } else {
-                MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_WITH_WITNESS(*pblock));
+                CBlockHeaderAndShortTxIDs cmpctblock{block, cmpctblock_nonce};
+                MakeAndPushMessage(pfrom, NetMsgType::CMPCTBLOCK, cmpctblock);
             }
+        } else {
+            MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_WITH_WITNESS(block));
         }
     }
+}
 
-    {
-        LOCK(peer.m_block_inv_mutex);
-        // Trigger the peer node to send a getblocks request for the next batch of inventory
-        if (inv.hash == peer.m_continuation_block) {
-            // Send immediately. This must send even if redundant,
-            // and we want it right after the last block so they don't
-            // wait for other stuff first.
-            std::vector<CInv> vInv;
-            vInv.emplace_back(MSG_BLOCK, tip->GetBlockHash());
-            MakeAndPushMessage(pfrom, NetMsgType::INV, vInv);
-            peer.m_continuation_block.SetNull();
-        }
+void PeerManagerImpl::MaybeSendContinuationInv(CNode& pfrom, Peer& peer, const CInv& inv, const CBlockIndex& tip)
+{
+    LOCK(peer.m_block_inv_mutex);
+    // Trigger the peer node to send a getblocks request for the next batch of inventory
+    if (inv.hash == peer.m_continuation_block) {
+        // Send immediately. This must send even if redundant,
+        // and we want it right after the last block so they don't
+        // wait for other stuff first.
+        std::vector<CInv> vInv;
+        vInv.emplace_back(MSG_BLOCK, tip.GetBlockHash());
+        MakeAndPushMessage(pfrom, NetMsgType::INV, vInv);
+        peer.m_continuation_block.SetNull();
     }
 }
 
@@ -2417,10 +2732,38 @@ CTransactionRef PeerManagerImpl::FindTxForGetData(const Peer::TxRelay& tx_relay,
     return {};
 }
 
+void PeerManagerImpl::AnnounceReconciledTxs(CNode& pto, Peer& peer, const std::vector<Wtxid>& wtxids)
+{
+    auto tx_relay = peer.GetTxRelay();
+    if (!tx_relay || wtxids.empty()) return;
+
+    std::vector<CInv> vInv;
+    LOCK(tx_relay->m_tx_inventory_mutex);
+    for (const Wtxid& wtxid : wtxids) {
+        if (tx_relay->m_tx_inventory_known_filter.contains(wtxid.ToUint256())) continue;
+        if (!m_mempool.exists(GenTxid::Wtxid(wtxid))) continue;
+        tx_relay->m_tx_inventory_known_filter.insert(wtxid.ToUint256());
+        vInv.emplace_back(MSG_WTX, wtxid.ToUint256());
+        if (vInv.size() == MAX_INV_SZ) {
+            MakeAndPushMessage(pto, NetMsgType::INV, vInv);
+            vInv.clear();
+        }
+    }
+    if (!vInv.empty()) MakeAndPushMessage(pto, NetMsgType::INV, vInv);
+
+    // Ensure we'll respond to GETDATA requests for anything we've just announced
+    LOCK(m_mempool.cs);
+    tx_relay->m_last_inv_sequence = m_mempool.GetSequence();
+}
+
 void PeerManagerImpl::ProcessGetData(CNode& pfrom, Peer& peer, const std::atomic<bool>& interruptMsgProc)
 {
     AssertLockNotHeld(cs_main);
 
+    // Wait for the block being read for this peer to be sent before answering anything it asked
+    // for after it.
+    if (peer.m_block_read_pending) return;
+
     auto tx_relay = peer.GetTxRelay();
 
     std::deque<CInv>::iterator it = peer.m_getdata_requests.begin();
@@ -2515,6 +2858,71 @@ void PeerManagerImpl::SendBlockTransactions(CNode& pfrom, Peer& peer, const CBlo
     MakeAndPushMessage(pfrom, NetMsgType::BLOCKTXN, resp);
 }
 
+bool PeerManagerImpl::SendStoredBlockTransactions(CNode& pfrom, Peer& peer, const BlockTransactionsRequest& req)
+{
+    FlatFilePos block_pos{};
+    {
+        LOCK(cs_main);
+
+        const CBlockIndex* pindex = m_chainman.m_blockman.LookupBlockIndex(req.blockhash);
+        if (!pindex || !(pindex->nStatus & BLOCK_HAVE_DATA)) return false;
+
+        if (pindex->nHeight >= m_chainman.ActiveChain().Height() - MAX_BLOCKTXN_DEPTH) {
+            block_pos = pindex->GetBlockPos();
+        }
+    }
+
+    if (!block_pos.IsNull()) {
+        CBlock block;
+        const bool ret{m_chainman.m_blockman.ReadBlock(block, block_pos, req.blockhash)};
+        // If height is above MAX_BLOCKTXN_DEPTH then this block cannot get
+        // pruned after we release cs_main above, so this read should never fail.
+        assert(ret);
+
+        SendBlockTransactions(pfrom, peer, block, req);
+        return true;
+    }
+
+    // If an older block is requested (should never happen in practice,
+    // but can happen in tests) send a block response instead of a
+    // blocktxn response. Sending a full block response instead of a
+    // small blocktxn response is preferable in the case where a peer
+    // might maliciously send lots of getblocktxn requests to trigger
+    // expensive disk reads, because it will require the peer to
+    // actually receive all the data read from disk over the network.
+    LogDebug(BCLog::NET, "Peer %d sent us a getblocktxn for a block > %i deep\n", pfrom.GetId(), MAX_BLOCKTXN_DEPTH);
+    CInv inv{MSG_WITNESS_BLOCK, req.blockhash};
+    WITH_LOCK(peer.m_getdata_requests_mutex, peer.m_getdata_requests.push_back(inv));
+    // The message processing loop will go around again (without pausing) and we'll respond then
+    return true;
+}
+
+void PeerManagerImpl::MaybeSendPendingBlockTransactions(CNode& node, Peer& peer, std::chrono::microseconds current_time)
+{
+    for (auto it{peer.m_pending_getblocktxn.begin()}; it != peer.m_pending_getblocktxn.end();) {
+        const auto& [req, received_time] = *it;
+
+        std::shared_ptr<const CBlock> recent_block;
+        {
+            LOCK(m_most_recent_block_mutex);
+            if (m_most_recent_block_hash == req.blockhash) recent_block = m_most_recent_block;
+        }
+        if (recent_block) {
+            SendBlockTransactions(node, peer, *recent_block, req);
+        } else if (SendStoredBlockTransactions(node, peer, req)) {
+            // Answered from disk: another block became our most recent one in the meantime.
+        } else if (current_time > received_time + PENDING_GETBLOCKTXN_TIMEOUT) {
+            // We never completed the block (or it was invalid). Same as for any block we don't
+            // have: the peer will fetch it elsewhere.
+            LogDebug(BCLog::NET, "Peer %d sent us a getblocktxn for a block we don't have\n", node.GetId());
+        } else {
+            ++it;
+            continue;
+        }
+        it = peer.m_pending_getblocktxn.erase(it);
+    }
+}
+
 bool PeerManagerImpl::CheckHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, Peer& peer)
 {
     // Do these headers have proof-of-work matching what's claimed?
@@ -2735,6 +3143,55 @@ bool PeerManagerImpl::MaybeSendGetHeaders(CNode& pfrom, const CBlockLocator& loc
     return false;
 }
 
+void PeerManagerImpl::SendHeadersRangeRequest(CNode& pfrom, Peer& peer, const HeadersRangeSync::Request& request)
+{
+    // Not subject to MaybeSendGetHeaders()'s rate limit: we only ask for more
+    // once the previous part of the range has arrived.
+    MakeAndPushMessage(pfrom, NetMsgType::GETHEADERS, request.locator, request.hash_stop);
+    peer.m_last_getheaders_timestamp = NodeClock::now();
+}
+
+bool PeerManagerImpl::MaybeProcessHeadersRange(CNode& pfrom, Peer& peer, const std::vector<CBlockHeader>& headers)
+{
+    HeadersRangeSync::ProcessingResult result;
+    {
+        LOCK(cs_main);
+        // Anything else this peer sends us, such as a block announcement, is
+        // processed as usual. If it stops serving the range, it times out.
+        if (!m_headers_ranges.IsRangeResponse(pfrom.GetId(), headers)) return false;
+        result = m_headers_ranges.ProcessNextHeaders(pfrom.GetId(), headers, headers.size() == m_opts.max_headers_result,
+                                                     GetTime<std::chrono::microseconds>());
+    }
+    peer.m_last_getheaders_timestamp = {};
+    if (result.next_request) {
+        SendHeadersRangeRequest(pfrom, peer, *result.next_request);
+    } else if (result.success) {
+        AcceptHeadersRanges();
+    }
+    return true;
+}
+
+void PeerManagerImpl::AcceptHeadersRanges()
+{
+    const std::vector<CBlockHeader> headers{WITH_LOCK(cs_main, return m_headers_ranges.PopHeadersReadyForAcceptance(
+        [&](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(::cs_main) { return m_chainman.m_blockman.LookupBlockIndex(hash) != nullptr; }))};
+    if (headers.empty()) return;
+
+    // The headers of a range end at a block hash we hardcode, which stands in
+    // for the anti-DoS work check. Feed them to validation in batches of the
+    // usual size, so cs_main is not held for the whole range at once.
+    const CBlockIndex* pindex_last{nullptr};
+    for (size_t i = 0; i < headers.size(); i += m_opts.max_headers_result) {
+        const std::span<const CBlockHeader> batch{std::span{headers}.subspan(i, std::min<size_t>(m_opts.max_headers_result, headers.size() - i))};
+        BlockValidationState state;
+        if (!m_chainman.ProcessNewBlockHeaders(batch, /*min_pow_checked=*/true, state, &pindex_last)) {
+            LogDebug(BCLog::NET, "Headers from parallel download rejected: %s\n", state.ToString());
+            return;
+        }
+    }
+    LogDebug(BCLog::NET, "Accepted %u headers from parallel download, up to height=%d\n", headers.size(), pindex_last->nHeight);
+}
+
 /*
  * Given a new headers tip ending in last_header, potentially request blocks towards that tip.
  * We require that the given tip have at least as much work as our tip, and for
@@ -2891,6 +3348,12 @@ void PeerManagerImpl::ProcessHeadersMessage(CNode& pfrom, Peer& peer,
         return;
     }
 
+    // Headers continuing a range this peer downloads for us are kept aside
+    // until the range connects to our block index.
+    if (MaybeProcessHeadersRange(pfrom, peer, headers)) return;
+
+    const int best_header_height{WITH_LOCK(cs_main, return m_chainman.m_best_header->nHeight)};
+
     const CBlockIndex *pindexLast = nullptr;
 
     // We'll set already_validated_work to true if these headers are
@@ -2902,10 +3365,22 @@ void PeerManagerImpl::ProcessHeadersMessage(CNode& pfrom, Peer& peer,
 
     // If we're in the middle of headers sync, let it do its magic.
     bool have_headers_sync = false;
+    bool restart_presync = false;
     {
         LOCK(peer.m_headers_sync_mutex);
 
-        already_validated_work = IsContinuationOfLowWorkHeadersSync(peer, pfrom, headers);
+        // If headers ranges downloaded from other peers have taken our best
+        // header beyond where this peer's presync has got to, start over from
+        // there rather than walk the same headers.
+        if (peer.m_headers_sync && peer.m_headers_sync->GetState() == HeadersSyncState::State::PRESYNC &&
+                peer.m_headers_sync->GetPresyncHeight() < best_header_height) {
+            LogDebug(BCLog::NET, "Restarting headers presync with peer=%d from height=%d\n", pfrom.GetId(), best_header_height);
+            peer.m_headers_sync.reset(nullptr);
+            WITH_LOCK(m_headers_presync_mutex, m_headers_presync_stats.erase(pfrom.GetId()));
+            restart_presync = true;
+        }
+
+        if (!restart_presync) already_validated_work = IsContinuationOfLowWorkHeadersSync(peer, pfrom, headers);
 
         // The headers we passed in may have been:
         // - untouched, perhaps if no headers-sync was in progress, or some
@@ -2923,6 +3398,11 @@ void PeerManagerImpl::ProcessHeadersMessage(CNode& pfrom, Peer& peer,
 
         have_headers_sync = !!peer.m_headers_sync;
     }
+    if (restart_presync) {
+        peer.m_last_getheaders_timestamp = {};
+        MaybeSendGetHeaders(pfrom, WITH_LOCK(cs_main, return GetLocator(m_chainman.m_best_header)), peer);
+        return;
+    }
 
     // Do these headers connect to something in our block index?
     const CBlockIndex *chain_start_header{WITH_LOCK(::cs_main, return m_chainman.m_blockman.LookupBlockIndex(headers[0].hashPrevBlock))};
@@ -2996,10 +3476,17 @@ void PeerManagerImpl::ProcessHeadersMessage(CNode& pfrom, Peer& peer,
         LogBlockHeader(*pindexLast, pfrom, /*via_compact_block=*/false);
     }
 
+    // These headers may have been what a completed headers range was waiting on.
+    AcceptHeadersRanges();
+
     // Consider fetching more headers if we are not using our headers-sync mechanism.
     if (nCount == m_opts.max_headers_result && !have_headers_sync) {
         // Headers message had its maximum size; the peer may have more headers.
-        if (MaybeSendGetHeaders(pfrom, GetLocator(pindexLast), peer)) {
+        // Continue from our best header instead if a headers range took it past
+        // these, to skip what we already have.
+        const CBlockIndex* locator_start{WITH_LOCK(cs_main,
+            return m_chainman.m_best_header->GetAncestor(pindexLast->nHeight) == pindexLast ? m_chainman.m_best_header : pindexLast)};
+        if (MaybeSendGetHeaders(pfrom, GetLocator(locator_start), peer)) {
             LogDebug(BCLog::NET, "more getheaders (%d) to end to peer=%d (startheight:%d)\n",
                     pindexLast->nHeight, pfrom.GetId(), peer.m_starting_height);
         }
@@ -3119,6 +3606,87 @@ void PeerManagerImpl::ProcessPackageResult(const node::PackageToValidate& packag
     }
 }
 
+void PeerManagerImpl::ProcessTransactionBatch(CNode& pfrom, Peer& peer, const std::vector<CTransactionRef>& txs)
+{
+    for (const CTransactionRef& ptx : txs) {
+        AddKnownTx(peer, peer.m_wtxid_relay ? ptx->GetWitnessHash().ToUint256() : ptx->GetHash().ToUint256());
+    }
+
+    std::vector<CTransactionRef> to_validate;
+    {
+        LOCK2(cs_main, m_tx_download_mutex);
+
+        std::set<Wtxid> received;
+        for (const CTransactionRef& ptx : txs) {
+            const CTransaction& tx = *ptx;
+
+            // Had the first copy been validated before this one was received, this one would have been
+            // found in the mempool or among the recent rejects; ignore it.
+            if (!received.insert(tx.GetWitnessHash()).second) continue;
+
+            const auto& [should_validate, package_to_validate] = m_txdownloadman.ReceivedTx(pfrom.GetId(), ptx, GetTime<std::chrono::microseconds>());
+            if (!should_validate) {
+                if (pfrom.HasPermission(NetPermissionFlags::ForceRelay)) {
+                    // Always relay transactions received from peers with forcerelay
+                    // permission, even if they were already in the mempool, allowing
+                    // the node to function as a gateway for nodes hidden behind it.
+                    if (!m_mempool.exists(GenTxid::Txid(tx.GetHash()))) {
+                        LogPrintf("Not relaying non-mempool transaction %s (wtxid=%s) from forcerelay peer=%d\n",
+                                  tx.GetHash().ToString(), tx.GetWitnessHash().ToString(), pfrom.GetId());
+                    } else {
+                        LogPrintf("Force relaying tx %s (wtxid=%s) from peer=%d\n",
+                                  tx.GetHash().ToString(), tx.GetWitnessHash().ToString(), pfrom.GetId());
+                        RelayTransaction(tx.GetHash(), tx.GetWitnessHash());
+                    }
+                }
+
+                if (package_to_validate) {
+                    const auto package_result{ProcessNewPackage(m_chainman.ActiveChainstate(), m_mempool, package_to_validate->m_txns, /*test_accept=*/false, /*client_maxfeerate=*/std::nullopt)};
+                    LogDebug(BCLog::TXPACKAGES, "package evaluation for %s: %s\n", package_to_validate->ToString(),
+                             package_result.m_state.IsValid() ? "package accepted" : "package rejected");
+                    ProcessPackageResult(package_to_validate.value(), package_result);
+                }
+                continue;
+            }
+
+            // ReceivedTx should not be telling us to validate the tx and a package.
+            Assume(!package_to_validate.has_value());
+            to_validate.push_back(ptx);
+        }
+    }
+    if (to_validate.empty()) return;
+
+    // Read the coins the transactions to validate spend before taking cs_main
+    // again, so that validating them does not wait on the disk with the lock
+    // held. Transactions that are already known, rejected or orphaned are not
+    // looked up, so that sending them again costs us no disk reads. The chain
+    // and mempool may change meanwhile, which validation accounts for anyway.
+    for (const CTransactionRef& ptx : to_validate) {
+        m_chainman.ActiveChainstate().PrefetchInputs(*ptx);
+    }
+
+    LOCK2(cs_main, m_tx_download_mutex);
+    const std::vector<MempoolAcceptResult> results{m_chainman.ProcessTransactions(to_validate)};
+    for (size_t i{0}; i < to_validate.size(); ++i) {
+        const CTransactionRef& ptx{to_validate[i]};
+        const MempoolAcceptResult& result{results[i]};
+        const TxValidationState& state = result.m_state;
+
+        if (result.m_result_type == MempoolAcceptResult::ResultType::VALID) {
+            ProcessValidTx(pfrom.GetId(), ptx, result.m_replaced_transactions);
+            pfrom.m_last_tx_time = GetTime<std::chrono::seconds>();
+        }
+        if (state.IsInvalid()) {
+            if (auto package_to_validate{ProcessInvalidTx(pfrom.GetId(), ptx, state, /*first_time_failure=*/true)}) {
+                const auto package_result{ProcessNewPackage(m_chainman.ActiveChainstate(), m_mempool, package_to_validate->m_txns, /*test_accept=*/false, /*client_maxfeerate=*/std::nullopt)};
+                LogDebug(BCLog::TXPACKAGES, "package evaluation for %s: %s\n", package_to_validate->ToString(),
+                         package_result.m_state.IsValid() ? "package accepted" : "package rejected");
+                ProcessPackageResult(package_to_validate.value(), package_result);
+            }
+        }
+    }
+}
+
 // NOTE: the orphan processing used to be uninterruptible and quadratic, which could allow a peer to stall the node for
 // hours with specially crafted transactions. See https://qtccore.org/en/2024/07/03/disclose-orphan-dos.
 bool PeerManagerImpl::ProcessOrphanTx(Peer& peer)
@@ -3609,6 +4177,10 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
 
         if (greatest_common_version >= WTXID_RELAY_VERSION) {
             MakeAndPushMessage(pfrom, NetMsgType::WTXIDRELAY);
+            // Size and fee hints extend wtxid announcements, and only help us if we download txs from this peer.
+            if (!RejectIncomingTxs(pfrom)) {
+                MakeAndPushMessage(pfrom, NetMsgType::SENDINVHINTS);
+            }
         }
 
         // Signal ADDRv2 support (BIP155).
@@ -3867,6 +4439,17 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         return;
     }
 
+    // Like WTXIDRELAY, which it extends, INVHINTS support must be negotiated between VERSION and VERACK.
+    if (msg_type == NetMsgType::SENDINVHINTS) {
+        if (pfrom.fSuccessfullyConnected) {
+            LogDebug(BCLog::NET, "sendinvhints received after verack, %s\n", pfrom.DisconnectMsg(fLogIPs));
+            pfrom.fDisconnect = true;
+            return;
+        }
+        peer->m_inv_hints = true;
+        return;
+    }
+
     // Received from a peer demonstrating readiness to announce transactions via reconciliations.
     // This feature negotiation must happen between VERSION and VERACK to avoid relay problems
     // from switching announcement protocols after the connection is up.
@@ -3928,6 +4511,56 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         return;
     }
 
+    if (msg_type == NetMsgType::REQRECON) {
+        if (!m_txreconciliation || !m_txreconciliation->IsPeerRegistered(pfrom.GetId())) {
+            LogDebug(BCLog::NET, "reqrecon from peer=%d ignored, as we don't reconcile with it\n", pfrom.GetId());
+            return;
+        }
+        uint16_t peer_recon_set_size, peer_q;
+        vRecv >> peer_recon_set_size >> peer_q;
+        if (!m_txreconciliation->HandleReconciliationRequest(pfrom.GetId(), peer_recon_set_size, peer_q, time_received)) {
+            LogDebug(BCLog::NET, "txreconciliation protocol violation (unexpected reqrecon), %s\n", pfrom.DisconnectMsg(fLogIPs));
+            pfrom.fDisconnect = true;
+        }
+        return;
+    }
+
+    if (msg_type == NetMsgType::SKETCH) {
+        if (!m_txreconciliation || !m_txreconciliation->IsPeerRegistered(pfrom.GetId())) {
+            LogDebug(BCLog::NET, "sketch from peer=%d ignored, as we don't reconcile with it\n", pfrom.GetId());
+            return;
+        }
+        std::vector<uint8_t> skdata;
+        vRecv >> skdata;
+        const auto result{m_txreconciliation->HandleSketch(pfrom.GetId(), skdata)};
+        if (!result) {
+            LogDebug(BCLog::NET, "txreconciliation protocol violation (unexpected or oversized sketch), %s\n", pfrom.DisconnectMsg(fLogIPs));
+            pfrom.fDisconnect = true;
+            return;
+        }
+        MakeAndPushMessage(pfrom, NetMsgType::RECONCILDIFF, uint8_t{result->success}, result->ask_shortids);
+        AnnounceReconciledTxs(pfrom, *peer, result->announce);
+        return;
+    }
+
+    if (msg_type == NetMsgType::RECONCILDIFF) {
+        if (!m_txreconciliation || !m_txreconciliation->IsPeerRegistered(pfrom.GetId())) {
+            LogDebug(BCLog::NET, "reconcildiff from peer=%d ignored, as we don't reconcile with it\n", pfrom.GetId());
+            return;
+        }
+        uint8_t success;
+        std::vector<uint32_t> ask_shortids;
+        vRecv >> success >> ask_shortids;
+        const auto announce{m_txreconciliation->HandleReconciliationDifference(pfrom.GetId(), success != 0, ask_shortids)};
+        if (!announce) {
+            LogDebug(BCLog::NET, "txreconciliation protocol violation (unexpected reconcildiff), %s\n", pfrom.DisconnectMsg(fLogIPs));
+            pfrom.fDisconnect = true;
+            return;
+        }
+        AnnounceReconciledTxs(pfrom, *peer, *announce);
+        return;
+    }
+
     if (msg_type == NetMsgType::ADDR || msg_type == NetMsgType::ADDRV2) {
         const auto ser_params{
             msg_type == NetMsgType::ADDRV2 ?
@@ -4116,6 +4749,41 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         return;
     }
 
+    if (msg_type == NetMsgType::INVHINTS) {
+        std::vector<TxInvHint> hints;
+        vRecv >> hints;
+        if (hints.size() > MAX_INV_SZ) {
+            Misbehaving(*peer, strprintf("invhints message size = %u", hints.size()));
+            return;
+        }
+
+        if (RejectIncomingTxs(pfrom)) {
+            LogDebug(BCLog::NET, "transaction invhints sent in violation of protocol, %s\n", pfrom.DisconnectMsg(fLogIPs));
+            pfrom.fDisconnect = true;
+            return;
+        }
+
+        // Hints extend wtxid announcements; ignore them from peers that announce by txid, like mismatched INVs.
+        if (!peer->m_wtxid_relay) return;
+
+        LOCK2(cs_main, m_tx_download_mutex);
+
+        const auto current_time{GetTime<std::chrono::microseconds>()};
+        for (const TxInvHint& hint : hints) {
+            if (interruptMsgProc) return;
+
+            AddKnownTx(*peer, hint.wtxid);
+
+            if (!m_chainman.IsInitialBlockDownload()) {
+                const bool fAlreadyHave{m_txdownloadman.AddTxAnnouncement(pfrom.GetId(), GenTxid::Wtxid(hint.wtxid), current_time,
+                                                                          node::TxAnnouncementHint{hint.vsize, hint.fee})};
+                LogDebug(BCLog::NET, "got invhint: wtx %s vsize=%u fee=%d  %s peer=%d\n", hint.wtxid.ToString(), hint.vsize, hint.fee,
+                         fAlreadyHave ? "have" : "new", pfrom.GetId());
+            }
+        }
+        return;
+    }
+
     if (msg_type == NetMsgType::GETDATA) {
         std::vector<CInv> vInv;
         vRecv >> vInv;
@@ -4222,43 +4890,17 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             return;
         }
 
-        FlatFilePos block_pos{};
-        {
-            LOCK(cs_main);
-
-            const CBlockIndex* pindex = m_chainman.m_blockman.LookupBlockIndex(req.blockhash);
-            if (!pindex || !(pindex->nStatus & BLOCK_HAVE_DATA)) {
-                LogDebug(BCLog::NET, "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom.GetId());
-                return;
-            }
-
-            if (pindex->nHeight >= m_chainman.ActiveChain().Height() - MAX_BLOCKTXN_DEPTH) {
-                block_pos = pindex->GetBlockPos();
-            }
-        }
-
-        if (!block_pos.IsNull()) {
-            CBlock block;
-            const bool ret{m_chainman.m_blockman.ReadBlock(block, block_pos, req.blockhash)};
-            // If height is above MAX_BLOCKTXN_DEPTH then this block cannot get
-            // pruned after we release cs_main above, so this read should never fail.
-            assert(ret);
+        if (SendStoredBlockTransactions(pfrom, *peer, req)) return;
 
-            SendBlockTransactions(pfrom, *peer, block, req);
+        if (WITH_LOCK(m_most_recent_block_mutex, return m_fast_relayed_block_hash == req.blockhash)) {
+            // We forwarded this compact block before reconstructing it ourselves. Answer once we
+            // have the block; if the peer keeps too many of these outstanding, the oldest goes.
+            LogDebug(BCLog::CMPCTBLOCK, "Peer %d sent us a getblocktxn for block %s we are still reconstructing\n", pfrom.GetId(), req.blockhash.ToString());
+            if (peer->m_pending_getblocktxn.size() >= MAX_PENDING_GETBLOCKTXN) peer->m_pending_getblocktxn.pop_front();
+            peer->m_pending_getblocktxn.emplace_back(req, GetTime<std::chrono::microseconds>());
             return;
         }
-
-        // If an older block is requested (should never happen in practice,
-        // but can happen in tests) send a block response instead of a
-        // blocktxn response. Sending a full block response instead of a
-        // small blocktxn response is preferable in the case where a peer
-        // might maliciously send lots of getblocktxn requests to trigger
-        // expensive disk reads, because it will require the peer to
-        // actually receive all the data read from disk over the network.
-        LogDebug(BCLog::NET, "Peer %d sent us a getblocktxn for a block > %i deep\n", pfrom.GetId(), MAX_BLOCKTXN_DEPTH);
-        CInv inv{MSG_WITNESS_BLOCK, req.blockhash};
-        WITH_LOCK(peer->m_getdata_requests_mutex, peer->m_getdata_requests.push_back(inv));
-        // The message processing loop will go around again (without pausing) and we'll respond then
+        LogDebug(BCLog::NET, "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom.GetId());
         return;
     }
 
@@ -4354,62 +4996,33 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         // is not considered a protocol violation, so don't punish the peer.
         if (m_chainman.IsInitialBlockDownload()) return;
 
-        CTransactionRef ptx;
-        vRecv >> TX_WITH_WITNESS(ptx);
-        const CTransaction& tx = *ptx;
-
-        const uint256& txid = ptx->GetHash();
-        const uint256& wtxid = ptx->GetWitnessHash();
-
-        const uint256& hash = peer->m_wtxid_relay ? wtxid : txid;
-        AddKnownTx(*peer, hash);
-
-        LOCK2(cs_main, m_tx_download_mutex);
-
-        const auto& [should_validate, package_to_validate] = m_txdownloadman.ReceivedTx(pfrom.GetId(), ptx);
-        if (!should_validate) {
-            if (pfrom.HasPermission(NetPermissionFlags::ForceRelay)) {
-                // Always relay transactions received from peers with forcerelay
-                // permission, even if they were already in the mempool, allowing
-                // the node to function as a gateway for nodes hidden behind it.
-                if (!m_mempool.exists(GenTxid::Txid(tx.GetHash()))) {
-                    LogPrintf("Not relaying non-mempool transaction %s (wtxid=%s) from forcerelay peer=%d\n",
-                              tx.GetHash().ToString(), tx.GetWitnessHash().ToString(), pfrom.GetId());
-                } else {
-                    LogPrintf("Force relaying tx %s (wtxid=%s) from peer=%d\n",
-                              tx.GetHash().ToString(), tx.GetWitnessHash().ToString(), pfrom.GetId());
-                    RelayTransaction(tx.GetHash(), tx.GetWitnessHash());
-                }
-            }
-
-            if (package_to_validate) {
-                const auto package_result{ProcessNewPackage(m_chainman.ActiveChainstate(), m_mempool, package_to_validate->m_txns, /*test_accept=*/false, /*client_maxfeerate=*/std::nullopt)};
-                LogDebug(BCLog::TXPACKAGES, "package evaluation for %s: %s\n", package_to_validate->ToString(),
-                         package_result.m_state.IsValid() ? "package accepted" : "package rejected");
-                ProcessPackageResult(package_to_validate.value(), package_result);
-            }
-            return;
-        }
-
-        // ReceivedTx should not be telling us to validate the tx and a package.
-        Assume(!package_to_validate.has_value());
-
-        const MempoolAcceptResult result = m_chainman.ProcessTransaction(ptx);
-        const TxValidationState& state = result.m_state;
-
-        if (result.m_result_type == MempoolAcceptResult::ResultType::VALID) {
-            ProcessValidTx(pfrom.GetId(), ptx, result.m_replaced_transactions);
-            pfrom.m_last_tx_time = GetTime<std::chrono::seconds>();
-        }
-        if (state.IsInvalid()) {
-            if (auto package_to_validate{ProcessInvalidTx(pfrom.GetId(), ptx, state, /*first_time_failure=*/true)}) {
-                const auto package_result{ProcessNewPackage(m_chainman.ActiveChainstate(), m_mempool, package_to_validate->m_txns, /*test_accept=*/false, /*client_maxfeerate=*/std::nullopt)};
-                LogDebug(BCLog::TXPACKAGES, "package evaluation for %s: %s\n", package_to_validate->ToString(),
-                         package_result.m_state.IsValid() ? "package accepted" : "package rejected");
-                ProcessPackageResult(package_to_validate.value(), package_result);
+        std::vector<CTransactionRef> txs;
+        {
+            CTransactionRef ptx;
+            vRecv >> TX_WITH_WITNESS(ptx);
+            txs.push_back(std::move(ptx));
+        }
+        // Transactions relayed in a burst, e.g. after a block, sit back to back in the
+        // processing queue. Take the ones that follow this one so they are validated together,
+        // as long as the batch stays cheap enough not to hold up the other peers.
+        int64_t batch_weight{GetTransactionWeight(*txs.front())};
+        while (txs.size() < MAX_TX_BATCH_SIZE && batch_weight < MAX_TX_BATCH_WEIGHT &&
+               !pfrom.fDisconnect && !interruptMsgProc) {
+            auto msg{pfrom.PollMessageOfType(NetMsgType::TX)};
+            if (!msg) break;
+            TraceInboundMessage(pfrom, *msg);
+
+            try {
+                CTransactionRef ptx;
+                msg->m_recv >> TX_WITH_WITNESS(ptx);
+                batch_weight += GetTransactionWeight(*ptx);
+                txs.push_back(std::move(ptx));
+            } catch (const std::exception& e) {
+                LogDebug(BCLog::NET, "%s(%s, %u bytes): Exception '%s' (%s) caught\n", __func__, SanitizeString(msg->m_type), msg->m_message_size, e.what(), typeid(e).name());
             }
         }
 
+        ProcessTransactionBatch(pfrom, *peer, txs);
         return;
     }
 
@@ -4427,6 +5040,13 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         bool received_new_header = false;
         const auto blockhash = cmpctblock.header.GetHash();
 
+        // For a block from one of our high-bandwidth peers that extends our tip, start matching its
+        // short IDs against our mempool while the header's proof of work is checked below. Both are
+        // expensive for large blocks; the result is discarded if the header turns out to be invalid.
+        const std::vector<CTransactionRef> extra_txn{vExtraTxnForCompact};
+        std::optional<PartiallyDownloadedBlock> speculative_block;
+        std::future<ReadStatus> speculative_status;
+
         {
         LOCK(cs_main);
 
@@ -4446,6 +5066,13 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         if (!m_chainman.m_blockman.LookupBlockIndex(blockhash)) {
             received_new_header = true;
         }
+
+        if (received_new_header && pfrom.m_bip152_highbandwidth_to && prev_block == m_chainman.ActiveChain().Tip()) {
+            speculative_block.emplace(&m_mempool);
+            speculative_status = std::async(std::launch::async, [&speculative_block, &cmpctblock, &extra_txn] {
+                return speculative_block->InitData(cmpctblock, extra_txn);
+            });
+        }
         }
 
         const CBlockIndex *pindex = nullptr;
@@ -4461,8 +5088,21 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         Assert(pindex);
         if (received_new_header) {
             LogBlockHeader(*pindex, pfrom, /*via_compact_block=*/true);
+            // The header's proof of work is valid: let our high-bandwidth peers start on the block
+            // while we reconstruct and validate it.
+            FastRelayCompactBlock(*pindex, cmpctblock, pfrom.GetId());
         }
 
+        // Use the speculative reconstruction if we started one, and otherwise start from scratch.
+        const auto init_partial_block = [&](PartiallyDownloadedBlock& partial_block) {
+            if (speculative_status.valid()) {
+                const ReadStatus status{speculative_status.get()};
+                partial_block = std::move(*speculative_block);
+                return status;
+            }
+            return partial_block.InitData(cmpctblock, extra_txn);
+        };
+
         bool fProcessBLOCKTXN = false;
 
         // If we end up treating this as a plain headers message, call that as well
@@ -4538,7 +5178,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                 }
 
                 PartiallyDownloadedBlock& partialBlock = *(*queuedBlockIt)->partialBlock;
-                ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = init_partial_block(partialBlock);
                 if (status == READ_STATUS_INVALID) {
                     RemoveBlockRequest(pindex->GetBlockHash(), pfrom.GetId()); // Reset in-flight state in case Misbehaving does not result in a disconnect
                     Misbehaving(*peer, "invalid compact block");
@@ -4556,6 +5196,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                     return;
                 }
 
+                ++m_cmpctblocks_received;
                 BlockTransactionsRequest req;
                 for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
                     if (!partialBlock.IsTxAvailable(i))
@@ -4567,6 +5208,8 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                     // We will try to round-trip any compact blocks we get on failure,
                     // as long as it's first...
                     req.blockhash = pindex->GetBlockHash();
+                    ++m_getblocktxn_sent;
+                    m_getblocktxn_txn_requested += req.indexes.size();
                     MakeAndPushMessage(pfrom, NetMsgType::GETBLOCKTXN, req);
                 } else if (pfrom.m_bip152_highbandwidth_to &&
                     (!pfrom.IsInboundConn() ||
@@ -4577,6 +5220,8 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                     // - we already have an outbound attempt in flight(so we'll take what we can get), or
                     // - it's not the final parallel download slot (which we may reserve for first outbound)
                     req.blockhash = pindex->GetBlockHash();
+                    ++m_getblocktxn_sent;
+                    m_getblocktxn_txn_requested += req.indexes.size();
                     MakeAndPushMessage(pfrom, NetMsgType::GETBLOCKTXN, req);
                 } else {
                     // Give up for this peer and wait for other peer(s)
@@ -4589,7 +5234,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                 // Optimistically try to reconstruct anyway since we might be
                 // able to without any round trips.
                 PartiallyDownloadedBlock tempBlock(&m_mempool);
-                ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = init_partial_block(tempBlock);
                 if (status != READ_STATUS_OK) {
                     // TODO: don't ignore failures
                     return;
@@ -4723,6 +5368,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         }
 
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        const size_t nBlockSize{vRecv.size()};
         vRecv >> TX_WITH_WITNESS(*pblock);
 
         LogDebug(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom.GetId());
@@ -4746,6 +5392,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             // Always process the block if we requested it, since we may
             // need it even when it's not a candidate for a new best tip.
             forceProcessing = IsBlockRequested(hash);
+            RecordBlockDownload(pfrom.GetId(), hash, nBlockSize);
             RemoveBlockRequest(hash, pfrom.GetId());
             // mapBlockSource is only used for punishing peers and setting
             // which peers send us compact blocks, so the race between here and
@@ -5013,7 +5660,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             }
         }
         LOCK(m_tx_download_mutex);
-        m_txdownloadman.ReceivedNotFound(pfrom.GetId(), tx_invs);
+        m_txdownloadman.ReceivedNotFound(pfrom.GetId(), tx_invs, GetTime<std::chrono::microseconds>());
         return;
     }
 
@@ -5087,6 +5734,10 @@ bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt
 
     if (processed_orphan) return true;
 
+    // While a block read for this peer is pending, leave its messages queued until the read
+    // completes and wakes the message handler, so that they are answered after the block.
+    if (peer->m_block_read_pending) return false;
+
     // this maintains the order of responses
     // and prevents m_getdata_requests to grow unbounded
     {
@@ -5105,19 +5756,7 @@ bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt
 
     CNetMessage& msg{poll_result->first};
     bool fMoreWork = poll_result->second;
-
-    TRACEPOINT(net, inbound_message,
-        pfrom->GetId(),
-        pfrom->m_addr_name.c_str(),
-        pfrom->ConnectionTypeAsString().c_str(),
-        msg.m_type.c_str(),
-        msg.m_recv.size(),
-        msg.m_recv.data()
-    );
-
-    if (m_opts.capture_messages) {
-        CaptureMessage(pfrom->addr, msg.m_type, MakeUCharSpan(msg.m_recv), /*is_incoming=*/true);
-    }
+    TraceInboundMessage(*pfrom, msg);
 
     try {
         ProcessMessage(*pfrom, msg.m_type, msg.m_recv, msg.m_time, interruptMsgProc);
@@ -5142,6 +5781,22 @@ bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt
     return fMoreWork;
 }
 
+void PeerManagerImpl::TraceInboundMessage(const CNode& node, const CNetMessage& msg)
+{
+    TRACEPOINT(net, inbound_message,
+        node.GetId(),
+        node.m_addr_name.c_str(),
+        node.ConnectionTypeAsString().c_str(),
+        msg.m_type.c_str(),
+        msg.m_recv.size(),
+        msg.m_recv.data()
+    );
+
+    if (m_opts.capture_messages) {
+        CaptureMessage(node.addr, msg.m_type, MakeUCharSpan(msg.m_recv), /*is_incoming=*/true);
+    }
+}
+
 void PeerManagerImpl::ConsiderEviction(CNode& pto, Peer& peer, std::chrono::seconds time_in_seconds)
 {
     AssertLockHeld(cs_main);
@@ -5593,6 +6248,8 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
 
     MaybeSendSendHeaders(*pto, *peer);
 
+    MaybeSendPendingBlockTransactions(*pto, *peer, current_time);
+
     {
         LOCK(cs_main);
 
@@ -5653,6 +6310,16 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
             }
         }
 
+        // While we are far behind, also have other outbound peers download the
+        // headers between blocks we know in advance (see HeadersRangeSync).
+        if (!state.fSyncStarted && pto->IsFullOutboundConn() && CanServeBlocks(*peer) &&
+                !m_chainman.m_blockman.LoadingBlocks() && m_chainman.m_best_header->Time() <= NodeClock::now() - 24h) {
+            m_headers_ranges.ReleaseStalledRanges(current_time, HEADERS_RANGE_TIMEOUT);
+            if (auto request{m_headers_ranges.AssignRange(pto->GetId(), m_chainman.m_best_header->nHeight, peer->m_starting_height, current_time)}) {
+                SendHeadersRangeRequest(*pto, *peer, *request);
+            }
+        }
+
         //
         // Try sending block announcements via headers
         //
@@ -5873,6 +6540,9 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
                     // No reason to drain out at many times the network's capacity,
                     // especially since we have many peers and some will draw much shorter delays.
                     unsigned int nRelayedTransactions = 0;
+                    // Peers that negotiated INVHINTS get their wtxid announcements with size and fee attached.
+                    const bool send_hints{peer->m_wtxid_relay && peer->m_inv_hints};
+                    std::vector<TxInvHint> vInvHints;
                     LOCK(tx_relay->m_bloom_filter_mutex);
                     size_t broadcast_max{INVENTORY_BROADCAST_TARGET + (tx_relay->m_tx_inventory_to_send.size()/1000)*5};
                     broadcast_max = std::min<size_t>(INVENTORY_BROADCAST_MAX, broadcast_max);
@@ -5899,27 +6569,61 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
                             continue;
                         }
                         if (tx_relay->m_bloom_filter && !tx_relay->m_bloom_filter->IsRelevantAndUpdate(*txinfo.tx)) continue;
+                        // Reconciling peers learn about most transactions through their reconciliation set.
+                        if (m_txreconciliation && peer->m_wtxid_relay && m_txreconciliation->AddToSet(pto->GetId(), Wtxid::FromUint256(hash))) {
+                            continue;
+                        }
                         // Send
-                        vInv.push_back(inv);
-                        nRelayedTransactions++;
-                        if (vInv.size() == MAX_INV_SZ) {
-                            MakeAndPushMessage(*pto, NetMsgType::INV, vInv);
-                            vInv.clear();
+                        if (send_hints) {
+                            vInvHints.push_back(TxInvHint{hash, static_cast<uint32_t>(txinfo.vsize), txinfo.fee});
+                            if (vInvHints.size() == MAX_INV_SZ) {
+                                MakeAndPushMessage(*pto, NetMsgType::INVHINTS, vInvHints);
+                                vInvHints.clear();
+                            }
+                        } else {
+                            vInv.push_back(inv);
+                            if (vInv.size() == MAX_INV_SZ) {
+                                MakeAndPushMessage(*pto, NetMsgType::INV, vInv);
+                                vInv.clear();
+                            }
                         }
+                        nRelayedTransactions++;
                         tx_relay->m_tx_inventory_known_filter.insert(hash);
                     }
+                    if (!vInvHints.empty()) {
+                        MakeAndPushMessage(*pto, NetMsgType::INVHINTS, vInvHints);
+                    }
 
                     // Ensure we'll respond to GETDATA requests for anything we've just announced
                     LOCK(m_mempool.cs);
                     tx_relay->m_last_inv_sequence = m_mempool.GetSequence();
                 }
+
+                if (m_txreconciliation) {
+                    // Answer reconciliation requests on the trickle schedule, so the sketch doesn't
+                    // reveal when we learnt about the transactions in it.
+                    if (fSendTrickle) {
+                        if (auto skdata{m_txreconciliation->RespondToReconciliationRequest(pto->GetId())}) {
+                            MakeAndPushMessage(*pto, NetMsgType::SKETCH, *skdata);
+                        }
+                    }
+                    if (auto request{m_txreconciliation->InitiateReconciliationRequest(pto->GetId(), current_time)}) {
+                        MakeAndPushMessage(*pto, NetMsgType::REQRECON, request->first, request->second);
+                    }
+                }
         }
         if (!vInv.empty())
             MakeAndPushMessage(*pto, NetMsgType::INV, vInv);
 
+        if (m_txreconciliation) {
+            // Flood what no reconciliation round is going to cover anymore, so a peer that stops
+            // reconciling (or never starts) still learns about every transaction.
+            AnnounceReconciledTxs(*pto, *peer, m_txreconciliation->FlushStaleSet(pto->GetId(), current_time));
+        }
+
         // Detect whether we're stalling
         auto stalling_timeout = m_block_stalling_timeout.load();
-        if (state.m_stalling_since.count() && state.m_stalling_since < current_time - stalling_timeout) {
+        if (state.m_stalling_since.count() && state.m_stalling_since < current_time - GetStallingTimeout(state, stalling_timeout)) {
             // Stalling only triggers when the block download window cannot move. During normal steady state,
             // the download window should be much larger than the to-be-downloaded set of blocks, so disconnection
             // should only happen during initial block download.
@@ -5988,11 +6692,12 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (CanServeBlocks(*peer) && ((sync_blocks_and_headers_from_peer && !IsLimitedPeer(*peer)) || !m_chainman.IsInitialBlockDownload()) && state.vBlocksInFlight.size() < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        const int max_blocks_in_transit{GetMaxBlocksInTransit(state, pto->m_min_ping_time.load())};
+        if (CanServeBlocks(*peer) && ((sync_blocks_and_headers_from_peer && !IsLimitedPeer(*peer)) || !m_chainman.IsInitialBlockDownload()) && state.vBlocksInFlight.size() < static_cast<size_t>(max_blocks_in_transit)) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            auto get_inflight_budget = [&state]() {
-                return std::max(0, MAX_BLOCKS_IN_TRANSIT_PER_PEER - static_cast<int>(state.vBlocksInFlight.size()));
+            auto get_inflight_budget = [&state, max_blocks_in_transit]() {
+                return std::max(0, max_blocks_in_transit - static_cast<int>(state.vBlocksInFlight.size()));
             };
 
             // If a snapshot chainstate is in use, we want to find its next blocks
@@ -8,6 +8,7 @@
 
 #include <consensus/amount.h>
 #include <net.h>
+#include <node/txreconciliation.h>
 #include <protocol.h>
 #include <threadsafety.h>
 #include <txorphanage.h>
@@ -35,7 +36,7 @@ class Warnings;
 } // namespace node
 
 /** Whether transaction reconciliation protocol should be enabled by default. */
-static constexpr bool DEFAULT_TXRECONCILIATION_ENABLE{false};
+static constexpr bool DEFAULT_TXRECONCILIATION_ENABLE{true};
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const uint32_t DEFAULT_MAX_ORPHAN_TRANSACTIONS{100};
 /** Default number of non-mempool transactions to keep around for block reconstruction. Includes
@@ -48,6 +49,18 @@ static const unsigned int MAX_CMPCTBLOCKS_INFLIGHT_PER_BLOCK = 3;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
  *  less than this number, we reached its tip. Changing this value is a protocol upgrade. */
 static const unsigned int MAX_HEADERS_RESULTS = 2000;
+/** Block size assumed for the block download limits before any block has been received. */
+static constexpr uint64_t BLOCK_DOWNLOAD_SIZE_INITIAL{2ULL << 20};
+
+/** Size of the block download window, in blocks, for blocks of the given average serialized size. */
+unsigned int BlockDownloadWindow(double avg_block_size);
+/** Number of blocks to have in flight from a peer with the given smoothed throughput in bytes per
+ *  second (0 if not measured yet) and round-trip time. Always between 1 and the per-peer maximum. */
+int MaxBlocksInTransit(double avg_block_size, double download_rate, std::chrono::microseconds min_ping_time);
+/** Time a stalling peer is given before being disconnected: at least stalling_timeout, extended to
+ *  the time the peer needs to transfer one block at its measured throughput, capped at the maximum
+ *  stalling timeout. */
+std::chrono::microseconds BlockStallingTimeout(double avg_block_size, double download_rate, std::chrono::seconds stalling_timeout);
 
 struct CNodeStateStats {
     int nSyncHeight = -1;
@@ -63,11 +76,17 @@ struct CNodeStateStats {
     ServiceFlags their_services;
     int64_t presync_height{-1};
     std::chrono::seconds time_offset{0};
+    std::optional<std::chrono::microseconds> m_tx_fetch_latency;
 };
 
 struct PeerManagerInfo {
     std::chrono::seconds median_outbound_time_offset{0s};
     bool ignores_incoming_txs{false};
+    uint64_t cmpctblocks_received{0};
+    uint64_t getblocktxn_sent{0};
+    uint64_t getblocktxn_txn_requested{0};
+    //! Set when transaction reconciliation is enabled
+    std::optional<TxReconciliationStats> txreconciliation;
 };
 
 class PeerManager : public CValidationInterface, public NetEventsInterface
@@ -12,6 +12,7 @@
 #include <util/translation.h>
 #include <validation.h>
 
+#include <algorithm>
 #include <cstdint>
 
 namespace node {
@@ -35,6 +36,9 @@ util::Result<void> ApplyArgsManOptions(const ArgsManager& args, BlockManager::Op
 
     if (auto value{args.GetBoolArg("-fastprune")}) opts.fast_prune = *value;
 
+    opts.block_read_threads = std::clamp<int64_t>(args.GetIntArg("-blockreadthreads", kernel::DEFAULT_BLOCK_READ_THREADS), 0, kernel::MAX_BLOCK_READ_THREADS);
+    opts.reindex_threads = std::clamp<int64_t>(args.GetIntArg("-reindexthreads", kernel::DEFAULT_REINDEX_THREADS), 0, kernel::MAX_REINDEX_THREADS);
+
     ReadDatabaseArgs(args, opts.block_tree_db_params.options);
 
     return {};
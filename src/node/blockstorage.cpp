@@ -8,6 +8,7 @@
 #include <chain.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
+#include <core_memusage.h>
 #include <dbwrapper.h>
 #include <flatfile.h>
 #include <hash.h>
@@ -31,15 +32,22 @@
 #include <util/batchpriority.h>
 #include <util/check.h>
 #include <util/fs.h>
+#include <util/thread.h>
 #include <util/signalinterrupt.h>
 #include <util/strencodings.h>
 #include <util/translation.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <condition_variable>
 #include <cstddef>
+#include <deque>
+#include <functional>
 #include <map>
 #include <optional>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 
 namespace kernel {
 static constexpr uint8_t DB_BLOCK_FILES{'f'};
@@ -245,7 +253,7 @@ void BlockManager::PruneOneBlockFile(const int fileNumber)
         CBlockIndex* pindex = &entry.second;
         if (pindex->nFile == fileNumber) {
             pindex->nStatus &= ~BLOCK_HAVE_DATA;
-            pindex->nStatus &= ~BLOCK_HAVE_UNDO;
+            pindex->nStatus &= ~(BLOCK_HAVE_UNDO | BLOCK_UNDO_COLUMNAR);
             pindex->nFile = 0;
             pindex->nDataPos = 0;
             pindex->nUndoPos = 0;
@@ -267,6 +275,7 @@ void BlockManager::PruneOneBlockFile(const int fileNumber)
     }
 
     m_blockfile_info.at(fileNumber) = CBlockFileInfo{};
+    m_blockfile_offsets.erase(fileNumber);
     m_dirty_fileinfo.insert(fileNumber);
 }
 
@@ -656,10 +665,9 @@ CBlockFileInfo* BlockManager::GetBlockFileInfo(size_t n)
     return &m_blockfile_info.at(n);
 }
 
-bool BlockManager::ReadBlockUndo(CBlockUndo& blockundo, const CBlockIndex& index) const
+template <typename UndoData>
+bool BlockManager::ReadUndoData(UndoData& blockundo, const FlatFilePos& pos, const CBlockIndex& index) const
 {
-    const FlatFilePos pos{WITH_LOCK(::cs_main, return index.GetUndoPos())};
-
     // Open history file to read
     AutoFile file{OpenUndoFile(pos, true)};
     if (file.IsNull()) {
@@ -691,6 +699,27 @@ bool BlockManager::ReadBlockUndo(CBlockUndo& blockundo, const CBlockIndex& index
     return true;
 }
 
+bool BlockManager::ReadBlockUndo(CBlockUndo& blockundo, const CBlockIndex& index) const
+{
+    const auto [pos, status]{WITH_LOCK(::cs_main, return std::make_pair(index.GetUndoPos(), index.nStatus))};
+    if (!(status & BLOCK_UNDO_COLUMNAR)) return ReadUndoData(blockundo, pos, index);
+    CBlockUndoColumns columns;
+    if (!ReadUndoData(columns, pos, index)) return false;
+    blockundo = columns.ToBlockUndo();
+    return true;
+}
+
+bool BlockManager::ReadBlockUndo(CBlockUndoColumns& blockundo, const CBlockIndex& index) const
+{
+    const auto [pos, status]{WITH_LOCK(::cs_main, return std::make_pair(index.GetUndoPos(), index.nStatus))};
+    if (status & BLOCK_UNDO_COLUMNAR) return ReadUndoData(blockundo, pos, index);
+    // Undo data written before the columnar format.
+    CBlockUndo legacy;
+    if (!ReadUndoData(legacy, pos, index)) return false;
+    blockundo = CBlockUndoColumns{legacy};
+    return true;
+}
+
 bool BlockManager::FlushUndoFile(int block_file, bool finalize)
 {
     FlatFilePos undo_pos_old(block_file, m_blockfile_info[block_file].nUndoSize);
@@ -813,7 +842,9 @@ FlatFilePos BlockManager::FindNextBlockPos(unsigned int nAddSize, unsigned int n
     }
 
     bool finalize_undo = false;
-    unsigned int max_blockfile_size{MAX_BLOCKFILE_SIZE};
+    // Pruning removes whole block files, so keep them smaller to stay close
+    // to the prune target.
+    unsigned int max_blockfile_size{m_prune_mode ? MAX_PRUNED_BLOCKFILE_SIZE : MAX_BLOCKFILE_SIZE};
     // Use smaller blockfiles in test-only -fastprune mode - but avoid
     // the possibility of having a block not fit into the block file.
     if (m_opts.fast_prune) {
@@ -856,6 +887,7 @@ FlatFilePos BlockManager::FindNextBlockPos(unsigned int nAddSize, unsigned int n
         // data may be inconsistent after a crash if the flush is called during
         // a reindex. A flush error might also leave some of the data files
         // untrimmed.
+        WriteBlockFileFooter(last_blockfile);
         if (!FlushBlockFile(last_blockfile, /*fFinalize=*/true, finalize_undo)) {
             LogPrintLevel(BCLog::BLOCKSTORAGE, BCLog::Level::Warning,
                           "Failed to flush previous block file %05i (finalize=1, finalize_undo=%i) before opening new block file %05i\n",
@@ -867,6 +899,7 @@ FlatFilePos BlockManager::FindNextBlockPos(unsigned int nAddSize, unsigned int n
 
     m_blockfile_info[nFile].AddBlock(nHeight, nTime);
     m_blockfile_info[nFile].nSize += nAddSize;
+    m_blockfile_offsets[nFile].push_back(pos.nPos);
 
     bool out_of_space;
     size_t bytes_allocated = m_block_file_seq.Allocate(pos, nAddSize, out_of_space);
@@ -882,6 +915,64 @@ FlatFilePos BlockManager::FindNextBlockPos(unsigned int nAddSize, unsigned int n
     return pos;
 }
 
+void BlockManager::WriteBlockFileFooter(int file_num)
+{
+    AssertLockHeld(cs_LastBlockFile);
+    const auto offsets{m_blockfile_offsets.extract(file_num)};
+    CBlockFileInfo& info{m_blockfile_info[file_num]};
+    if (offsets.empty() || offsets.mapped().size() != info.nBlocks) return;
+
+    DataStream index{};
+    index << offsets.mapped();
+    const uint32_t footer_size{static_cast<uint32_t>(index.size()) + BLOCKFILE_FOOTER_TRAILER_BYTES};
+    try {
+        AutoFile file{OpenBlockFile(FlatFilePos(file_num, info.nSize), /*fReadOnly=*/false)};
+        if (file.IsNull()) return; // This error is logged in OpenBlockFile
+        file.write(index);
+        file << static_cast<uint32_t>(index.size()) << BLOCKFILE_FOOTER_MAGIC;
+        if (file.fclose() != 0) throw std::ios_base::failure("fclose failed");
+    } catch (const std::ios_base::failure& e) {
+        LogPrintLevel(BCLog::BLOCKSTORAGE, BCLog::Level::Warning,
+                      "Failed to write index footer of block file %05i: %s\n", file_num, e.what());
+        return;
+    }
+    // Extend the file info over the footer, so that finalizing the file does not truncate it.
+    info.nSize += footer_size;
+    m_dirty_fileinfo.insert(file_num);
+}
+
+std::optional<std::vector<uint32_t>> ReadBlockFileFooter(AutoFile& file)
+{
+    try {
+        file.seek(0, SEEK_END);
+        const int64_t file_size{file.tell()};
+        if (file_size < BLOCKFILE_FOOTER_TRAILER_BYTES) return std::nullopt;
+        file.seek(file_size - BLOCKFILE_FOOTER_TRAILER_BYTES, SEEK_SET);
+        uint32_t index_size;
+        std::array<uint8_t, BLOCKFILE_FOOTER_MAGIC.size()> magic;
+        file >> index_size >> magic;
+        if (magic != BLOCKFILE_FOOTER_MAGIC) return std::nullopt;
+        const int64_t index_pos{file_size - BLOCKFILE_FOOTER_TRAILER_BYTES - index_size};
+        if (index_pos < 0) return std::nullopt;
+
+        file.seek(index_pos, SEEK_SET);
+        DataStream index{};
+        index.resize(index_size);
+        file.read(index);
+        std::vector<uint32_t> offsets;
+        index >> offsets;
+        file.seek(0, SEEK_SET);
+
+        // The offsets must point at storage headers in ascending order, in front of the footer.
+        if (!index.empty() || offsets.empty()) return std::nullopt;
+        if (std::ranges::adjacent_find(offsets, std::greater_equal{}) != offsets.end()) return std::nullopt;
+        if (offsets.back() + int64_t{STORAGE_HEADER_BYTES} > index_pos) return std::nullopt;
+        return offsets;
+    } catch (const std::ios_base::failure&) {
+        return std::nullopt;
+    }
+}
+
 void BlockManager::UpdateBlockInfo(const CBlock& block, unsigned int nHeight, const FlatFilePos& pos)
 {
     LOCK(cs_LastBlockFile);
@@ -935,7 +1026,8 @@ bool BlockManager::WriteBlockUndo(const CBlockUndo& blockundo, BlockValidationSt
     // Write undo information to disk
     if (block.GetUndoPos().IsNull()) {
         FlatFilePos pos;
-        const auto blockundo_size{static_cast<uint32_t>(GetSerializeSize(blockundo))};
+        const CBlockUndoColumns columns{blockundo};
+        const auto blockundo_size{static_cast<uint32_t>(GetSerializeSize(columns))};
         if (!FindUndoPos(state, block.nFile, pos, blockundo_size + UNDO_DATA_DISK_OVERHEAD)) {
             LogError("FindUndoPos failed for %s while writing block undo", pos.ToString());
             return false;
@@ -956,9 +1048,9 @@ bool BlockManager::WriteBlockUndo(const CBlockUndo& blockundo, BlockValidationSt
             {
                 // Calculate checksum
                 HashWriter hasher{};
-                hasher << block.pprev->GetBlockHash() << blockundo;
+                hasher << block.pprev->GetBlockHash() << columns;
                 // Write undo data & checksum
-                fileout << blockundo << hasher.GetHash();
+                fileout << columns << hasher.GetHash();
             }
 
             fileout.flush(); // Make sure `AutoFile`/`BufferedWriter` go out of scope before we call `FlushUndoFile`
@@ -983,7 +1075,7 @@ bool BlockManager::WriteBlockUndo(const CBlockUndo& blockundo, BlockValidationSt
         }
         // update nUndoPos in block index
         block.nUndoPos = pos.nPos;
-        block.nStatus |= BLOCK_HAVE_UNDO;
+        block.nStatus |= BLOCK_HAVE_UNDO | BLOCK_UNDO_COLUMNAR;
         m_dirty_blockindex.insert(&block);
     }
 
@@ -1000,6 +1092,13 @@ bool BlockManager::ReadBlock(CBlock& block, const FlatFilePos& pos, const std::o
         return false;
     }
 
+    return DecodeBlock(block, block_data, pos, expected_hash);
+}
+
+bool BlockManager::DecodeBlock(CBlock& block, std::span<const std::byte> block_data, const FlatFilePos& pos, const std::optional<uint256>& expected_hash) const
+{
+    block.SetNull();
+
     try {
         // Read block
         SpanReader{block_data} >> TX_WITH_WITNESS(block);
@@ -1038,6 +1137,17 @@ bool BlockManager::ReadBlock(CBlock& block, const CBlockIndex& index) const
 }
 
 bool BlockManager::ReadRawBlock(std::vector<std::byte>& block, const FlatFilePos& pos) const
+{
+    return ReadRawBlockImpl(block, pos);
+}
+
+bool BlockManager::ReadRawBlock(std::vector<unsigned char>& block, const FlatFilePos& pos) const
+{
+    return ReadRawBlockImpl(block, pos);
+}
+
+template <typename Byte>
+bool BlockManager::ReadRawBlockImpl(std::vector<Byte>& block, const FlatFilePos& pos) const
 {
     if (pos.nPos < STORAGE_HEADER_BYTES) {
         // If nPos is less than STORAGE_HEADER_BYTES, we can't read the header that precedes the block data
@@ -1052,6 +1162,12 @@ bool BlockManager::ReadRawBlock(std::vector<std::byte>& block, const FlatFilePos
         return false;
     }
 
+    return ReadRawBlockFromFile(filein, block, pos);
+}
+
+template <typename Byte>
+bool BlockManager::ReadRawBlockFromFile(AutoFile& filein, std::vector<Byte>& block, const FlatFilePos& pos) const
+{
     try {
         MessageStartChars blk_start;
         unsigned int blk_size;
@@ -1071,7 +1187,7 @@ bool BlockManager::ReadRawBlock(std::vector<std::byte>& block, const FlatFilePos
         }
 
         block.resize(blk_size); // Zeroing of memory is intentional here
-        filein.read(block);
+        filein.read(MakeWritableByteSpan(block));
     } catch (const std::exception& e) {
         LogError("Read from block file failed: %s for %s while reading raw block", e.what(), pos.ToString());
         return false;
@@ -1080,6 +1196,35 @@ bool BlockManager::ReadRawBlock(std::vector<std::byte>& block, const FlatFilePos
     return true;
 }
 
+void BlockManager::ReadRawBlocks(std::span<const FlatFilePos> positions, std::vector<std::vector<unsigned char>>& blocks) const
+{
+    blocks.assign(positions.size(), {});
+    if (positions.empty()) return;
+
+    const int file{positions.front().nFile};
+    AutoFile filein{OpenBlockFile({file, 0}, /*fReadOnly=*/true)};
+    if (filein.IsNull()) {
+        LogError("OpenBlockFile failed for %s while reading raw blocks", positions.front().ToString());
+        return;
+    }
+
+    for (size_t i{0}; i < positions.size(); ++i) {
+        const FlatFilePos& pos{positions[i]};
+        if (!Assume(pos.nFile == file)) continue;
+        if (pos.nPos < STORAGE_HEADER_BYTES) {
+            LogError("Failed for %s while reading raw block storage header", pos.ToString());
+            continue;
+        }
+        try {
+            filein.seek(pos.nPos - STORAGE_HEADER_BYTES, SEEK_SET);
+        } catch (const std::exception& e) {
+            LogError("Seek in block file failed: %s for %s while reading raw block", e.what(), pos.ToString());
+            continue;
+        }
+        if (!ReadRawBlockFromFile(filein, blocks[i], pos)) blocks[i].clear();
+    }
+}
+
 FlatFilePos BlockManager::WriteBlock(const CBlock& block, int nHeight)
 {
     const unsigned int block_size{static_cast<unsigned int>(GetSerializeSize(TX_WITH_WITNESS(block)))};
@@ -1156,13 +1301,101 @@ static auto InitBlocksdirXorKey(const BlockManager::Options& opts)
     return std::vector<std::byte>{xor_key.begin(), xor_key.end()};
 }
 
+/** The most block reads from the same block file that one block read thread serves together. */
+static constexpr size_t MAX_COALESCED_BLOCK_READS{16};
+
+/** Threads serving BlockManager::ReadRawBlockAsync(). */
+class BlockReadPool
+{
+    struct Request {
+        FlatFilePos pos;
+        std::function<void(std::vector<unsigned char>)> callback;
+    };
+
+    const BlockManager& m_blockman;
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Request> m_queue GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::vector<std::thread> m_threads;
+
+    void ThreadRead() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        while (true) {
+            std::vector<Request> batch;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || !m_queue.empty(); });
+                // Requests still queued when stopping are served before exiting.
+                if (m_queue.empty()) return;
+                // Take the oldest request, together with the other queued requests for the same block
+                // file, so that the file is opened once and read front to back.
+                const int file{m_queue.front().pos.nFile};
+                for (auto it{m_queue.begin()}; it != m_queue.end() && batch.size() < MAX_COALESCED_BLOCK_READS;) {
+                    if (it->pos.nFile == file) {
+                        batch.push_back(std::move(*it));
+                        it = m_queue.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+
+            std::sort(batch.begin(), batch.end(), [](const Request& a, const Request& b) { return a.pos.nPos < b.pos.nPos; });
+            std::vector<FlatFilePos> positions;
+            for (const Request& request : batch) {
+                if (positions.empty() || positions.back() != request.pos) positions.push_back(request.pos);
+            }
+            std::vector<std::vector<unsigned char>> blocks;
+            m_blockman.ReadRawBlocks(positions, blocks);
+
+            size_t block_index{0};
+            for (size_t i{0}; i < batch.size(); ++i) {
+                while (positions[block_index] != batch[i].pos) ++block_index;
+                // Requests for the same block are adjacent: copy the data for all but the last of them.
+                const bool last_request{i + 1 == batch.size() || batch[i + 1].pos != batch[i].pos};
+                batch[i].callback(last_request ? std::move(blocks[block_index]) : blocks[block_index]);
+            }
+        }
+    }
+
+public:
+    BlockReadPool(const BlockManager& blockman, int num_threads) : m_blockman{blockman}
+    {
+        for (int i{0}; i < num_threads; ++i) {
+            m_threads.emplace_back(&util::TraceThread, strprintf("blockread.%i", i), [this] { ThreadRead(); });
+        }
+    }
+
+    ~BlockReadPool()
+    {
+        WITH_LOCK(m_mutex, m_stop = true);
+        m_cond.notify_all();
+        for (std::thread& thread : m_threads) thread.join();
+    }
+
+    void Push(const FlatFilePos& pos, std::function<void(std::vector<unsigned char>)> callback) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        WITH_LOCK(m_mutex, m_queue.push_back({pos, std::move(callback)}));
+        m_cond.notify_one();
+    }
+};
+
+bool BlockManager::ReadRawBlockAsync(const FlatFilePos& pos, std::function<void(std::vector<unsigned char>)> callback) const
+{
+    if (!m_read_pool) return false;
+    m_read_pool->Push(pos, std::move(callback));
+    return true;
+}
+
 BlockManager::BlockManager(const util::SignalInterrupt& interrupt, Options opts)
     : m_prune_mode{opts.prune_target > 0},
       m_xor_key{InitBlocksdirXorKey(opts)},
       m_opts{std::move(opts)},
       m_block_file_seq{FlatFileSeq{m_opts.blocks_dir, "blk", m_opts.fast_prune ? 0x4000 /* 16kB */ : BLOCKFILE_CHUNK_SIZE}},
       m_undo_file_seq{FlatFileSeq{m_opts.blocks_dir, "rev", UNDOFILE_CHUNK_SIZE}},
-      m_interrupt{interrupt}
+      m_interrupt{interrupt},
+      m_read_pool{m_opts.block_read_threads > 0 ? std::make_unique<BlockReadPool>(*this, m_opts.block_read_threads) : nullptr}
 {
     m_block_tree_db = std::make_unique<BlockTreeDB>(m_opts.block_tree_db_params);
 
@@ -1176,6 +1409,8 @@ BlockManager::BlockManager(const util::SignalInterrupt& interrupt, Options opts)
     }
 }
 
+BlockManager::~BlockManager() = default;
+
 class ImportingNow
 {
     std::atomic<bool>& m_importing;
@@ -1193,32 +1428,276 @@ public:
     }
 };
 
+using ReindexBlocks = std::vector<std::pair<std::shared_ptr<CBlock>, FlatFilePos>>;
+
+/** Find the storage headers in block file data the way LoadExternalBlockFile() scans for them. */
+static std::vector<uint32_t> ScanBlockFileData(std::span<const std::byte> data, const MessageStartChars& message_start)
+{
+    const auto magic{std::as_bytes(std::span{message_start})};
+    std::vector<uint32_t> offsets;
+    size_t pos{0};
+    while (pos < data.size()) {
+        const auto found{std::ranges::search(data.subspan(pos), magic)};
+        pos = found.begin() - data.begin();
+        if (pos + STORAGE_HEADER_BYTES > data.size()) break;
+        uint32_t size;
+        SpanReader{data.subspan(pos + magic.size(), sizeof(size))} >> size;
+        if (size < 80 || size > MAX_BLOCK_SERIALIZED_SIZE) {
+            ++pos;
+            continue;
+        }
+        offsets.push_back(pos);
+        pos += STORAGE_HEADER_BYTES + size;
+    }
+    return offsets;
+}
+
+/**
+ * Threads reading and deserializing the block files ahead of the importing thread
+ * during -reindex. Each thread reads whole files, using their index footer if they
+ * have one, and files are handed out in order. Files are only read ahead while the
+ * memory of the files being read and buffered stays below max_bytes, though one
+ * file is always read so that the importing thread makes progress.
+ */
+class BlockFileReadAhead
+{
+    const BlockManager& m_blockman;
+    const MessageStartChars m_message_start;
+    const size_t m_max_bytes;
+    std::vector<std::thread> m_threads;
+
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    //! Next file for a thread to read.
+    int m_next_read GUARDED_BY(m_mutex){0};
+    //! Next file to hand to the importing thread.
+    int m_next_take GUARDED_BY(m_mutex){0};
+    //! First file that does not exist, once known.
+    std::optional<int> m_end GUARDED_BY(m_mutex);
+    //! Blocks of the files read ahead, with their memory usage.
+    std::map<int, std::pair<ReindexBlocks, size_t>> m_files GUARDED_BY(m_mutex);
+    //! Memory of the files in m_files, plus the size of the files being read.
+    size_t m_buffered_bytes GUARDED_BY(m_mutex){0};
+    bool m_stop GUARDED_BY(m_mutex){false};
+
+    //! Read all blocks in a file. Returns std::nullopt if the file does not exist.
+    std::optional<ReindexBlocks> ReadFile(int file_num) const
+    {
+        const FlatFilePos file_pos{file_num, 0};
+        if (!fs::exists(m_blockman.GetBlockPosFilename(file_pos))) return std::nullopt;
+        AutoFile file{m_blockman.OpenBlockFile(file_pos, /*fReadOnly=*/true)};
+        if (file.IsNull()) return std::nullopt; // This error is logged in OpenBlockFile
+
+        std::optional<std::vector<uint32_t>> offsets;
+        std::vector<std::byte> data;
+        try {
+            offsets = ReadBlockFileFooter(file);
+            file.seek(0, SEEK_END);
+            data.resize(file.tell());
+            file.seek(0, SEEK_SET);
+            file.read(data);
+        } catch (const std::ios_base::failure& e) {
+            LogPrintLevel(BCLog::REINDEX, BCLog::Level::Warning, "Failed to read block file %05i: %s\n", file_num, e.what());
+            return ReindexBlocks{};
+        }
+        if (!offsets) offsets = ScanBlockFileData(data, m_message_start);
+
+        ReindexBlocks blocks;
+        blocks.reserve(offsets->size());
+        for (const uint32_t offset : *offsets) {
+            if (offset + STORAGE_HEADER_BYTES > data.size()) continue;
+            try {
+                SpanReader header{std::span{data}.subspan(offset, STORAGE_HEADER_BYTES)};
+                MessageStartChars message_start;
+                uint32_t size;
+                header >> message_start >> size;
+                if (message_start != m_message_start || size > data.size() - offset - STORAGE_HEADER_BYTES) continue;
+                auto block{std::make_shared<CBlock>()};
+                SpanReader{std::span{data}.subspan(offset + STORAGE_HEADER_BYTES, size)} >> TX_WITH_WITNESS(*block);
+                blocks.emplace_back(std::move(block), FlatFilePos{file_num, offset + STORAGE_HEADER_BYTES});
+            } catch (const std::exception& e) {
+                // Like LoadExternalBlockFile(), skip data that does not deserialize cleanly.
+                LogDebug(BCLog::REINDEX, "%s: unexpected data at offset 0x%x of block file %05i - %s. continuing\n",
+                         __func__, offset, file_num, e.what());
+            }
+        }
+        return blocks;
+    }
+
+    void ThreadRead() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        while (true) {
+            int file_num;
+            size_t reserved_bytes;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+                    return m_stop || (m_end && m_next_read >= *m_end) || m_buffered_bytes == 0 || m_buffered_bytes < m_max_bytes;
+                });
+                if (m_stop || (m_end && m_next_read >= *m_end)) return;
+                file_num = m_next_read++;
+                // Reserve the size of the file while it is read, so that other
+                // threads do not start reading past the limit in the meantime.
+                std::error_code ec;
+                reserved_bytes = fs::file_size(m_blockman.GetBlockPosFilename(FlatFilePos{file_num, 0}), ec);
+                if (ec) reserved_bytes = 0;
+                m_buffered_bytes += reserved_bytes;
+            }
+            auto blocks{ReadFile(file_num)};
+            size_t usage{0};
+            if (blocks) {
+                usage = memusage::DynamicUsage(*blocks);
+                for (const auto& [block, pos] : *blocks) {
+                    usage += memusage::DynamicUsage(block) + RecursiveDynamicUsage(*block);
+                }
+            }
+            {
+                LOCK(m_mutex);
+                m_buffered_bytes -= reserved_bytes;
+                if (blocks) {
+                    m_buffered_bytes += usage;
+                    m_files.emplace(file_num, std::make_pair(std::move(*blocks), usage));
+                } else if (!m_end || file_num < *m_end) {
+                    m_end = file_num;
+                }
+            }
+            m_cond.notify_all();
+        }
+    }
+
+public:
+    BlockFileReadAhead(const BlockManager& blockman, const MessageStartChars& message_start, int num_threads, size_t max_bytes)
+        : m_blockman{blockman}, m_message_start{message_start}, m_max_bytes{max_bytes}
+    {
+        for (int i{0}; i < num_threads; ++i) {
+            m_threads.emplace_back(&util::TraceThread, strprintf("reindex.%i", i), [this] { ThreadRead(); });
+        }
+    }
+
+    ~BlockFileReadAhead()
+    {
+        WITH_LOCK(m_mutex, m_stop = true);
+        m_cond.notify_all();
+        for (std::thread& thread : m_threads) thread.join();
+    }
+
+    //! Wait for the blocks of the next block file. Returns std::nullopt once all files were handed out.
+    std::optional<std::pair<int, ReindexBlocks>> Next() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        std::optional<std::pair<int, ReindexBlocks>> next;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+                return m_files.contains(m_next_take) || (m_end && m_next_take >= *m_end);
+            });
+            auto file{m_files.extract(m_next_take)};
+            if (file.empty()) return std::nullopt;
+            m_buffered_bytes -= file.mapped().second;
+            next.emplace(m_next_take++, std::move(file.mapped().first));
+        }
+        m_cond.notify_all();
+        return next;
+    }
+};
+
+/**
+ * Whether blocks imported so far during -reindex can be connected without waiting
+ * for the remaining block files. Connecting them before the assumed valid block is
+ * known and buried under the best header the way ConnectBlock() requires would
+ * verify all their scripts.
+ */
+static bool CanActivateDuringReindex(ChainstateManager& chainman) EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
+{
+    if (chainman.AssumedValidBlock().IsNull()) return true;
+    const CBlockIndex* assumed_valid{chainman.m_blockman.LookupBlockIndex(chainman.AssumedValidBlock())};
+    return assumed_valid && chainman.IsAssumedValid(*assumed_valid);
+}
+
+/**
+ * Reindex all block files with files read ahead by -reindexthreads threads, while
+ * the chain is activated on another thread as soon as that does not lose assumevalid.
+ * Blocks are accepted in file order on the calling thread, so that the block index
+ * ends up the same as when reading the files one at a time.
+ */
+static void ReindexBlockFiles(ChainstateManager& chainman, std::multimap<uint256, FlatFilePos>& blocks_with_unknown_parent)
+{
+    Mutex activate_mutex;
+    std::condition_variable activate_cond;
+    bool activate_pending{false};
+    bool import_done{false};
+    std::thread activate_thread{&util::TraceThread, "reindexactivate", [&] {
+        while (true) {
+            {
+                WAIT_LOCK(activate_mutex, lock);
+                activate_cond.wait(lock, [&] { return activate_pending || import_done; });
+                if (import_done) return;
+                activate_pending = false;
+            }
+            if (!WITH_LOCK(::cs_main, return CanActivateDuringReindex(chainman))) continue;
+            for (Chainstate* chainstate : WITH_LOCK(::cs_main, return chainman.GetAll())) {
+                BlockValidationState state;
+                if (!chainstate->ActivateBestChain(state, nullptr)) {
+                    LogDebug(BCLog::REINDEX, "failed to activate chain (%s)\n", state.ToString());
+                    return;
+                }
+            }
+        }
+    }};
+
+    {
+        // The coins cache fills up only as the chain is connected, so a quarter
+        // of it can hold the blocks read ahead.
+        BlockFileReadAhead read_ahead{chainman.m_blockman, chainman.GetParams().MessageStart(), chainman.m_blockman.GetReindexThreads(),
+                                      chainman.m_total_coinstip_cache / 4};
+        while (auto file{read_ahead.Next()}) {
+            auto& [file_num, blocks]{*file};
+            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)file_num);
+            chainman.LoadExternalBlocks(blocks, blocks_with_unknown_parent);
+            if (chainman.m_interrupt) break;
+            WITH_LOCK(activate_mutex, activate_pending = true);
+            activate_cond.notify_one();
+        }
+    }
+
+    WITH_LOCK(activate_mutex, import_done = true);
+    activate_cond.notify_one();
+    activate_thread.join();
+}
+
 void ImportBlocks(ChainstateManager& chainman, std::span<const fs::path> import_paths)
 {
     ImportingNow imp{chainman.m_blockman.m_importing};
 
     // -reindex
     if (!chainman.m_blockman.m_blockfiles_indexed) {
-        int nFile = 0;
         // Map of disk positions for blocks with unknown parent (only used for reindex);
         // parent hash -> child disk position, multiple children can have the same parent.
         std::multimap<uint256, FlatFilePos> blocks_with_unknown_parent;
-        while (true) {
-            FlatFilePos pos(nFile, 0);
-            if (!fs::exists(chainman.m_blockman.GetBlockPosFilename(pos))) {
-                break; // No block files left to reindex
-            }
-            AutoFile file{chainman.m_blockman.OpenBlockFile(pos, /*fReadOnly=*/true)};
-            if (file.IsNull()) {
-                break; // This error is logged in OpenBlockFile
-            }
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            chainman.LoadExternalBlockFile(file, &pos, &blocks_with_unknown_parent);
-            if (chainman.m_interrupt) {
-                LogPrintf("Interrupt requested. Exit %s\n", __func__);
-                return;
+        if (chainman.m_blockman.GetReindexThreads() > 0) {
+            ReindexBlockFiles(chainman, blocks_with_unknown_parent);
+        } else {
+            int nFile = 0;
+            while (true) {
+                FlatFilePos pos(nFile, 0);
+                if (!fs::exists(chainman.m_blockman.GetBlockPosFilename(pos))) {
+                    break; // No block files left to reindex
+                }
+                AutoFile file{chainman.m_blockman.OpenBlockFile(pos, /*fReadOnly=*/true)};
+                if (file.IsNull()) {
+                    break; // This error is logged in OpenBlockFile
+                }
+                // Finished block files list the offsets of their blocks in a footer, so that
+                // they do not need to be scanned for the message start.
+                const auto offsets{ReadBlockFileFooter(file)};
+                LogPrintf("Reindexing block file blk%05u.dat%s...\n", (unsigned int)nFile, offsets ? " using its index footer" : "");
+                chainman.LoadExternalBlockFile(file, &pos, &blocks_with_unknown_parent, offsets ? std::span{*offsets} : std::span<const uint32_t>{});
+                if (chainman.m_interrupt) break;
+                nFile++;
             }
-            nFile++;
+        }
+        if (chainman.m_interrupt) {
+            LogPrintf("Interrupt requested. Exit %s\n", __func__);
+            return;
         }
         WITH_LOCK(::cs_main, chainman.m_blockman.m_block_tree_db->WriteReindexing(false));
         chainman.m_blockman.m_blockfiles_indexed = true;
@@ -7,6 +7,7 @@
 
 #include <attributes.h>
 #include <chain.h>
+#include <consensus/consensus.h>
 #include <dbwrapper.h>
 #include <flatfile.h>
 #include <kernel/blockmanager_opts.h>
@@ -37,6 +38,7 @@
 
 class BlockValidationState;
 class CBlockUndo;
+class CBlockUndoColumns;
 class Chainstate;
 class ChainstateManager;
 namespace Consensus {
@@ -67,12 +69,15 @@ public:
 namespace node {
 using kernel::BlockTreeDB;
 
-/** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
-static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
-/** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
-static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
-/** The maximum size of a blk?????.dat file (since 0.8) */
-static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
+/** The pre-allocation chunk size for blk?????.dat files, so that a full block needs at most one allocation */
+static const unsigned int BLOCKFILE_CHUNK_SIZE = MAX_BLOCK_SERIALIZED_SIZE; // 32 MiB
+/** The pre-allocation chunk size for rev?????.dat files */
+static const unsigned int UNDOFILE_CHUNK_SIZE = MAX_BLOCK_SERIALIZED_SIZE / 8; // 4 MiB
+/** The maximum size of a blk?????.dat file, holding at least eight full blocks */
+static const unsigned int MAX_BLOCKFILE_SIZE = 8 * MAX_BLOCK_SERIALIZED_SIZE; // 256 MiB
+/** The maximum size of a blk?????.dat file when pruning, which removes whole files at a time.
+ *  MIN_DISK_SPACE_FOR_BLOCK_FILES relies on it. */
+static const unsigned int MAX_PRUNED_BLOCKFILE_SIZE = 4 * MAX_BLOCK_SERIALIZED_SIZE; // 128 MiB
 
 /** Size of header written by WriteBlock before a serialized CBlock (8 bytes) */
 static constexpr uint32_t STORAGE_HEADER_BYTES{std::tuple_size_v<MessageStartChars> + sizeof(unsigned int)};
@@ -80,6 +85,22 @@ static constexpr uint32_t STORAGE_HEADER_BYTES{std::tuple_size_v<MessageStartCha
 /** Total overhead when writing undo data: header (8 bytes) plus checksum (32 bytes) */
 static constexpr uint32_t UNDO_DATA_DISK_OVERHEAD{STORAGE_HEADER_BYTES + uint256::size()};
 
+/** Magic bytes ending a finished blk?????.dat file that carries a block offset index */
+static constexpr std::array<uint8_t, 8> BLOCKFILE_FOOTER_MAGIC{'q', 't', 'c', 'b', 'l', 'k', 'i', 'x'};
+/** Size of the fixed trailer of a block file footer: index size (4 bytes) plus magic (8 bytes) */
+static constexpr uint32_t BLOCKFILE_FOOTER_TRAILER_BYTES{sizeof(uint32_t) + std::tuple_size_v<decltype(BLOCKFILE_FOOTER_MAGIC)>};
+
+/**
+ * Read the block offset index from the footer of a finished block file.
+ *
+ * Finished block files end with the offsets of the storage headers of all
+ * blocks in the file, so that they can be reindexed without scanning for
+ * message start bytes. Returns std::nullopt if the file has no valid footer,
+ * e.g. because it is still being written to or was finished by an older
+ * version. The file is left positioned at its start.
+ */
+std::optional<std::vector<uint32_t>> ReadBlockFileFooter(AutoFile& file);
+
 // Because validation code takes pointers to the map's CBlockIndex objects, if
 // we ever switch to another associative container, we need to either use a
 // container that has stable addressing (true of all std associative
@@ -127,6 +148,7 @@ struct BlockfileCursor {
 
 std::ostream& operator<<(std::ostream& os, const BlockfileCursor& cursor);
 
+class BlockReadPool;
 
 /**
  * Maintains a tree of blocks (stored in `m_block_index`) which is consulted
@@ -172,6 +194,16 @@ private:
 
     AutoFile OpenUndoFile(const FlatFilePos& pos, bool fReadOnly = false) const;
 
+    /** Read undo data in the format given by UndoData from pos and check it. */
+    template <typename UndoData>
+    bool ReadUndoData(UndoData& blockundo, const FlatFilePos& pos, const CBlockIndex& index) const;
+
+    template <typename Byte>
+    bool ReadRawBlockImpl(std::vector<Byte>& block, const FlatFilePos& pos) const;
+    /** Read the block stored at pos from a block file positioned at its storage header. */
+    template <typename Byte>
+    bool ReadRawBlockFromFile(AutoFile& filein, std::vector<Byte>& block, const FlatFilePos& pos) const;
+
     /* Calculate the block/rev files to delete based on height specified by user with RPC command pruneblockchain */
     void FindFilesToPruneManual(
         std::set<int>& setFilesToPrune,
@@ -201,9 +233,20 @@ private:
         const Chainstate& chain,
         ChainstateManager& chainman);
 
+    /**
+     * Append the block offset index footer to a block file that is about to be
+     * finished. Only done if the offsets of all blocks in the file are known,
+     * i.e. the file was not carried over from before a restart.
+     */
+    void WriteBlockFileFooter(int file_num) EXCLUSIVE_LOCKS_REQUIRED(cs_LastBlockFile);
+
     RecursiveMutex cs_LastBlockFile;
     std::vector<CBlockFileInfo> m_blockfile_info;
 
+    //! Offsets of the storage headers of the blocks written to each block file
+    //! since startup, used to write the footer once the file is finished.
+    std::unordered_map<int, std::vector<uint32_t>> m_blockfile_offsets GUARDED_BY(cs_LastBlockFile);
+
     //! Since assumedvalid chainstates may be syncing a range of the chain that is very
     //! far away from the normal/background validation process, we should segment blockfiles
     //! for assumed chainstates. Otherwise, we might have wildly different height ranges
@@ -262,6 +305,7 @@ public:
     using Options = kernel::BlockManagerOpts;
 
     explicit BlockManager(const util::SignalInterrupt& interrupt, Options opts);
+    ~BlockManager();
 
     const util::SignalInterrupt& m_interrupt;
     std::atomic<bool> m_importing{false};
@@ -352,6 +396,9 @@ public:
     [[nodiscard]] uint64_t GetPruneTarget() const { return m_opts.prune_target; }
     static constexpr auto PRUNE_TARGET_MANUAL{std::numeric_limits<uint64_t>::max()};
 
+    /** Number of threads reading block files ahead during -reindex. */
+    [[nodiscard]] int GetReindexThreads() const { return m_opts.reindex_threads; }
+
     [[nodiscard]] bool LoadingBlocks() const { return m_importing || !m_blockfiles_indexed; }
 
     /** Calculate the amount of disk space the block & undo files currently use */
@@ -414,10 +461,34 @@ public:
     bool ReadBlock(CBlock& block, const FlatFilePos& pos, const std::optional<uint256>& expected_hash) const;
     bool ReadBlock(CBlock& block, const CBlockIndex& index) const;
     bool ReadRawBlock(std::vector<std::byte>& block, const FlatFilePos& pos) const;
+    /** Read the serialized block straight into a network message buffer, so it can be sent without copying. */
+    bool ReadRawBlock(std::vector<unsigned char>& block, const FlatFilePos& pos) const;
+    /** Read serialized blocks that are all stored in the same block file, opening it only once.
+     *  Positions are read in the given order, so callers should sort them. blocks[i] is left empty
+     *  if positions[i] could not be read. */
+    void ReadRawBlocks(std::span<const FlatFilePos> positions, std::vector<std::vector<unsigned char>>& blocks) const;
+    /**
+     * Queue a read of the serialized block at pos on the block read threads (-blockreadthreads),
+     * so that the caller does not wait on disk. Queued reads from the same block file are served
+     * together, and concurrent reads of the same block share one read. The callback runs on a
+     * block read thread, and is passed an empty vector if the block could not be read.
+     *
+     * @returns false if there are no block read threads, in which case the callback is not called.
+     */
+    bool ReadRawBlockAsync(const FlatFilePos& pos, std::function<void(std::vector<unsigned char>)> callback) const;
+    /** Deserialize a block as returned by ReadRawBlock and check it the same way ReadBlock does. */
+    bool DecodeBlock(CBlock& block, std::span<const std::byte> block_data, const FlatFilePos& pos, const std::optional<uint256>& expected_hash) const;
 
     bool ReadBlockUndo(CBlockUndo& blockundo, const CBlockIndex& index) const;
+    /** Read the undo data of a block as columns, which is cheaper to restore coins from. */
+    bool ReadBlockUndo(CBlockUndoColumns& blockundo, const CBlockIndex& index) const;
 
     void CleanupBlockRevFiles() const;
+
+private:
+    //! Threads serving ReadRawBlockAsync(), if any. Declared last, so that they are stopped before
+    //! anything they use is destroyed.
+    const std::unique_ptr<BlockReadPool> m_read_pool;
 };
 
 // Calls ActivateBestChain() even if no blocks are imported.
@@ -7,6 +7,7 @@
 #include <arith_uint256.h>
 #include <common/args.h>
 #include <common/system.h>
+#include <dbwrapper.h>
 #include <logging.h>
 #include <node/coins_view_args.h>
 #include <node/database_args.h>
@@ -48,6 +49,13 @@ util::Result<void> ApplyArgsManOptions(const ArgsManager& args, ChainstateManage
     if (auto value{args.GetIntArg("-maxtipage")}) opts.max_tip_age = std::chrono::seconds{*value};
 
     ReadDatabaseArgs(args, opts.coins_db);
+    if (auto value{args.GetArg("-chainstatebackend")}) {
+        if (auto backend{DBBackendFromString(*value)}) {
+            opts.coins_db.backend = *backend;
+        } else {
+            return util::Error{Untranslated(strprintf("Invalid -chainstatebackend value (%s), must be leveldb or mmap", *value))};
+        }
+    }
     ReadCoinsViewArgs(args, opts.coins_view);
 
     int script_threads = args.GetIntArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
@@ -59,6 +67,8 @@ util::Result<void> ApplyArgsManOptions(const ArgsManager& args, ChainstateManage
     // Subtract 1 because the main thread counts towards the par threads.
     opts.worker_threads_num = script_threads - 1;
 
+    opts.coins_prefetch_threads = std::clamp<int64_t>(args.GetIntArg("-prefetchthreads", DEFAULT_COINS_PREFETCH_THREADS), 0, MAX_COINS_PREFETCH_THREADS);
+
     if (auto max_size = args.GetIntArg("-maxsigcachesize")) {
         // 1. When supplied with a max_size of 0, both the signature cache and
         //    script execution cache create the minimum possible cache (2
@@ -12,6 +12,8 @@ class ArgsManager;
 
 /** -par default (number of script-checking threads, 0 = auto) */
 static constexpr int DEFAULT_SCRIPTCHECK_THREADS{0};
+/** -prefetchthreads default (number of threads reading block inputs from the coins database) */
+static constexpr int DEFAULT_COINS_PREFETCH_THREADS{4};
 
 namespace node {
 [[nodiscard]] util::Result<void> ApplyArgsManOptions(const ArgsManager& args, ChainstateManager::Options& opts);
@@ -4,9 +4,12 @@
 
 #include <node/mempool_persist.h>
 
+#include <chain.h>
 #include <clientversion.h>
 #include <consensus/amount.h>
+#include <hash.h>
 #include <logging.h>
+#include <policy/policy.h>
 #include <primitives/transaction.h>
 #include <random.h>
 #include <serialize.h>
@@ -20,12 +23,14 @@
 #include <util/time.h>
 #include <validation.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <exception>
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <set>
 #include <stdexcept>
 #include <utility>
@@ -38,6 +43,122 @@ namespace node {
 static const uint64_t MEMPOOL_DUMP_VERSION_NO_XOR_KEY{1};
 static const uint64_t MEMPOOL_DUMP_VERSION{2};
 
+/** Maximum number of transactions from the file submitted to the mempool together, with their
+ * script checks spread over the script check threads */
+static constexpr size_t MEMPOOL_LOAD_BATCH_SIZE{256};
+
+/** A mempool file written by this node ends with a checksum of its contents keyed with a secret
+ * kept next to it, so that it can tell the files it wrote itself from any others. */
+static fs::path ChecksumKeyPath(const fs::path& dump_path)
+{
+    return dump_path + ".key";
+}
+
+static std::optional<uint256> ReadChecksumKey(const fs::path& dump_path, FopenFn mockable_fopen_function)
+{
+    AutoFile file{mockable_fopen_function(ChecksumKeyPath(dump_path), "rb")};
+    if (file.IsNull()) return std::nullopt;
+    try {
+        uint256 key;
+        file >> key;
+        return key;
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+static std::optional<uint256> GetOrCreateChecksumKey(const fs::path& dump_path, FopenFn mockable_fopen_function)
+{
+    if (auto key{ReadChecksumKey(dump_path, mockable_fopen_function)}) return key;
+
+    uint256 key;
+    GetStrongRandBytes(key);
+    AutoFile file{mockable_fopen_function(ChecksumKeyPath(dump_path), "wb")};
+    if (file.IsNull()) return std::nullopt;
+    try {
+        file << key;
+        if (!file.Commit()) throw std::runtime_error("Commit failed");
+        if (file.fclose() != 0) throw std::runtime_error("Close failed");
+    } catch (const std::exception& e) {
+        LogInfo("Failed to write mempool checksum key: %s. Continuing anyway.\n", e.what());
+        return std::nullopt;
+    }
+    return key;
+}
+
+/** The rules the scripts of the transactions in the mempool were verified under: the chain tip
+ * and the consensus and policy script verification flags in use at it. They are written in the
+ * clear ahead of the checksum, which commits to them. */
+struct MempoolScriptRules {
+    uint256 tip_hash;
+    uint32_t consensus_flags{0};
+    uint32_t policy_flags{0};
+
+    friend bool operator==(const MempoolScriptRules&, const MempoolScriptRules&) = default;
+
+    SERIALIZE_METHODS(MempoolScriptRules, obj) { READWRITE(obj.tip_hash, obj.consensus_flags, obj.policy_flags); }
+};
+
+/** Size of the rules and the checksum ending a mempool file written by this node */
+static constexpr int64_t DUMP_TRAILER_SIZE{uint256::size() + 2 * sizeof(uint32_t) + uint256::size()};
+
+static std::optional<MempoolScriptRules> GetMempoolScriptRules(const Chainstate& active_chainstate) EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
+{
+    AssertLockHeld(::cs_main);
+    const CBlockIndex* tip{active_chainstate.m_chain.Tip()};
+    if (!tip) return std::nullopt;
+    return MempoolScriptRules{tip->GetBlockHash(), GetMempoolConsensusScriptFlags(active_chainstate), STANDARD_SCRIPT_VERIFY_FLAGS};
+}
+
+/** The checksum also commits to the software version, as the scripts of the transactions in the
+ * file are only known to be valid under the rules of the version that accepted them. */
+static uint256 DumpChecksum(const uint256& key, const MempoolScriptRules& rules, const uint256& contents_hash)
+{
+    return (HashWriter{} << key << CLIENT_VERSION << rules << contents_hash).GetHash();
+}
+
+/** The rules the scripts of the transactions in the file at load_path were verified under, if it
+ * ends with a valid checksum from this node. */
+static std::optional<MempoolScriptRules> ReadOwnDumpRules(const fs::path& load_path, FopenFn mockable_fopen_function)
+{
+    const auto key{ReadChecksumKey(load_path, mockable_fopen_function)};
+    if (!key) return std::nullopt;
+
+    AutoFile file{mockable_fopen_function(load_path, "rb")};
+    if (file.IsNull()) return std::nullopt;
+    try {
+        file.seek(0, SEEK_END);
+        const int64_t trailer_pos{file.tell() - DUMP_TRAILER_SIZE};
+        file.seek(0, SEEK_SET);
+
+        HashVerifier verifier{file};
+        uint64_t version;
+        verifier >> version;
+        if (version == MEMPOOL_DUMP_VERSION) {
+            std::vector<std::byte> xor_key;
+            verifier >> xor_key;
+            file.SetXor(xor_key);
+        } else if (version != MEMPOOL_DUMP_VERSION_NO_XOR_KEY) {
+            return std::nullopt;
+        }
+        std::vector<std::byte> buf(1 << 20);
+        while (file.tell() < trailer_pos) {
+            const size_t chunk{static_cast<size_t>(std::min<int64_t>(buf.size(), trailer_pos - file.tell()))};
+            verifier.read(std::span{buf}.first(chunk));
+        }
+        if (file.tell() != trailer_pos) return std::nullopt;
+        // The trailer is not obfuscated.
+        file.SetXor({});
+        MempoolScriptRules rules;
+        uint256 checksum;
+        file >> rules >> checksum;
+        if (checksum != DumpChecksum(*key, rules, verifier.GetHash())) return std::nullopt;
+        return rules;
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
 bool LoadMempool(CTxMemPool& pool, const fs::path& load_path, Chainstate& active_chainstate, ImportMempoolOptions&& opts)
 {
     if (load_path.empty()) return false;
@@ -55,6 +176,50 @@ bool LoadMempool(CTxMemPool& pool, const fs::path& load_path, Chainstate& active
     int64_t unbroadcast = 0;
     const auto now{NodeClock::now()};
 
+    // A file this node wrote itself holds transactions whose scripts it verified before. Loading
+    // them without verifying their scripts again leaves the mempool as it was before the restart,
+    // as long as the tip and the script flags are still those they were verified under. Otherwise,
+    // or if the file was changed since, the scripts are verified as for any other file.
+    const auto own_dump_rules{opts.trust_own_dump ? ReadOwnDumpRules(load_path, opts.mockable_fopen_function) : std::nullopt};
+    bool trusted{own_dump_rules && own_dump_rules == WITH_LOCK(cs_main, return GetMempoolScriptRules(active_chainstate))};
+    if (trusted) {
+        LogInfo("Mempool file was written by this node, not verifying the scripts of its transactions\n");
+    } else if (opts.trust_own_dump) {
+        LogInfo("Mempool file was not written by this node under the current tip and script flags, verifying the scripts of its transactions\n");
+    }
+
+    std::vector<CTransactionRef> batch;
+    std::vector<int64_t> batch_times;
+    std::set<Txid> batch_txids;
+    const auto submit_batch{[&] {
+        if (batch.empty()) return;
+        LOCK(cs_main);
+        // The tip may have moved on while loading.
+        if (trusted && own_dump_rules != GetMempoolScriptRules(active_chainstate)) {
+            LogInfo("Chain tip changed while loading the mempool file, verifying the scripts of its remaining transactions\n");
+            trusted = false;
+        }
+        const auto results{AcceptTransactionsToMemoryPool(active_chainstate, batch, batch_times, /*test_accept=*/false, trusted)};
+        for (size_t i{0}; i < batch.size(); ++i) {
+            if (results[i].m_result_type == MempoolAcceptResult::ResultType::VALID) {
+                ++count;
+            } else {
+                // mempool may contain the transaction already, e.g. from
+                // wallet(s) having loaded it while we were processing
+                // mempool transactions; consider these as valid, instead of
+                // failed, but mark them as 'already there'
+                if (pool.exists(GenTxid::Txid(batch[i]->GetHash()))) {
+                    ++already_there;
+                } else {
+                    ++failed;
+                }
+            }
+        }
+        batch.clear();
+        batch_times.clear();
+        batch_txids.clear();
+    }};
+
     try {
         uint64_t version;
         file >> version;
@@ -97,27 +262,24 @@ bool LoadMempool(CTxMemPool& pool, const fs::path& load_path, Chainstate& active
                 pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
             if (nTime > TicksSinceEpoch<std::chrono::seconds>(now - pool.m_opts.expiry)) {
-                LOCK(cs_main);
-                const auto& accepted = AcceptToMemoryPool(active_chainstate, tx, nTime, /*bypass_limits=*/false, /*test_accept=*/false);
-                if (accepted.m_result_type == MempoolAcceptResult::ResultType::VALID) {
-                    ++count;
-                } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (pool.exists(GenTxid::Txid(tx->GetHash()))) {
-                        ++already_there;
-                    } else {
-                        ++failed;
-                    }
+                // Parents are written before their children. A child starts a new batch, so that
+                // the inputs of every transaction in a batch are available when its scripts are
+                // checked ahead of the others.
+                if (std::any_of(tx->vin.begin(), tx->vin.end(), [&](const CTxIn& txin) { return batch_txids.contains(txin.prevout.hash); })) {
+                    submit_batch();
                 }
+                batch_txids.insert(tx->GetHash());
+                batch.push_back(std::move(tx));
+                batch_times.push_back(nTime);
+                if (batch.size() >= MEMPOOL_LOAD_BATCH_SIZE) submit_batch();
             } else {
                 ++expired;
             }
             if (active_chainstate.m_chainman.m_interrupt)
                 return false;
         }
+        submit_batch();
+        if (active_chainstate.m_chainman.m_interrupt) return false;
         std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
 
@@ -146,25 +308,36 @@ bool LoadMempool(CTxMemPool& pool, const fs::path& load_path, Chainstate& active
     return true;
 }
 
-bool DumpMempool(const CTxMemPool& pool, const fs::path& dump_path, FopenFn mockable_fopen_function, bool skip_file_commit)
+bool DumpMempool(const CTxMemPool& pool, const Chainstate& active_chainstate, const fs::path& dump_path, FopenFn mockable_fopen_function, bool skip_file_commit)
 {
     auto start = SteadyClock::now();
 
     std::map<uint256, CAmount> mapDeltas;
-    std::vector<TxMempoolInfo> vinfo;
+    // Each transaction with its number of in-mempool ancestors, which orders it after its parents
+    std::vector<std::pair<uint64_t, TxMempoolInfo>> vinfo;
     std::set<uint256> unbroadcast_txids;
+    std::optional<MempoolScriptRules> rules;
 
     static Mutex dump_mutex;
     LOCK(dump_mutex);
 
     {
-        LOCK(pool.cs);
+        // Only copy what is written out while holding the mempool lock. The transactions
+        // themselves are shared, not copied. cs_main keeps the tip the one the mempool is
+        // consistent with.
+        LOCK2(cs_main, pool.cs);
+        rules = GetMempoolScriptRules(active_chainstate);
         for (const auto &i : pool.mapDeltas) {
             mapDeltas[i.first] = i.second;
         }
-        vinfo = pool.infoAll();
+        vinfo.reserve(pool.mapTx.size());
+        for (const CTxMemPoolEntry& entry : pool.mapTx) {
+            vinfo.emplace_back(entry.GetCountWithAncestors(),
+                               TxMempoolInfo{entry.GetSharedTx(), entry.GetTime(), entry.GetFee(), entry.GetTxSize(), entry.GetModifiedFee() - entry.GetFee()});
+        }
         unbroadcast_txids = pool.GetUnbroadcastTxs();
     }
+    std::stable_sort(vinfo.begin(), vinfo.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
 
     auto mid = SteadyClock::now();
 
@@ -174,30 +347,38 @@ bool DumpMempool(const CTxMemPool& pool, const fs::path& dump_path, FopenFn mock
     }
 
     try {
+        HashedSourceWriter hashed{file};
         const uint64_t version{pool.m_opts.persist_v1_dat ? MEMPOOL_DUMP_VERSION_NO_XOR_KEY : MEMPOOL_DUMP_VERSION};
-        file << version;
+        hashed << version;
 
         std::vector<std::byte> xor_key(8);
         if (!pool.m_opts.persist_v1_dat) {
             FastRandomContext{}.fillrand(xor_key);
-            file << xor_key;
+            hashed << xor_key;
         }
         file.SetXor(xor_key);
 
         uint64_t mempool_transactions_to_write(vinfo.size());
-        file << mempool_transactions_to_write;
+        hashed << mempool_transactions_to_write;
         LogInfo("Writing %u mempool transactions to file...\n", mempool_transactions_to_write);
-        for (const auto& i : vinfo) {
-            file << TX_WITH_WITNESS(*(i.tx));
-            file << int64_t{count_seconds(i.m_time)};
-            file << int64_t{i.nFeeDelta};
+        for (const auto& [_, i] : vinfo) {
+            hashed << TX_WITH_WITNESS(*(i.tx));
+            hashed << int64_t{count_seconds(i.m_time)};
+            hashed << int64_t{i.nFeeDelta};
             mapDeltas.erase(i.tx->GetHash());
         }
 
-        file << mapDeltas;
+        hashed << mapDeltas;
 
         LogInfo("Writing %d unbroadcast transactions to file.\n", unbroadcast_txids.size());
-        file << unbroadcast_txids;
+        hashed << unbroadcast_txids;
+
+        // Appended after the data older versions read, which ignore it.
+        const auto key{GetOrCreateChecksumKey(dump_path, mockable_fopen_function)};
+        if (key && rules) {
+            file.SetXor({});
+            file << *rules << DumpChecksum(*key, *rules, hashed.GetHash());
+        }
 
         if (!skip_file_commit && !file.Commit())
             throw std::runtime_error("Commit failed");
@@ -12,8 +12,8 @@ class CTxMemPool;
 
 namespace node {
 
-/** Dump the mempool to a file. */
-bool DumpMempool(const CTxMemPool& pool, const fs::path& dump_path,
+/** Dump the mempool to a file, along with the tip and script flags its scripts were verified under. */
+bool DumpMempool(const CTxMemPool& pool, const Chainstate& active_chainstate, const fs::path& dump_path,
                  fsbridge::FopenFn mockable_fopen_function = fsbridge::fopen,
                  bool skip_file_commit = false);
 
@@ -22,6 +22,9 @@ struct ImportMempoolOptions {
     bool use_current_time{false};
     bool apply_fee_delta_priority{true};
     bool apply_unbroadcast_set{true};
+    /** Do not verify the scripts of the transactions if the file was written by this node at the
+     * current tip and under the current script flags */
+    bool trust_own_dump{false};
 };
 /** Import the file and attempt to add its contents to the mempool. */
 bool LoadMempool(CTxMemPool& pool, const fs::path& load_path,
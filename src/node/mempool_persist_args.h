@@ -16,6 +16,11 @@ namespace node {
  * automatically load the mempool on start and save to disk on shutdown
  */
 static constexpr bool DEFAULT_PERSIST_MEMPOOL{true};
+/**
+ * Default for -persistmempooltrusted, indicating whether the scripts of the
+ * transactions in a mempool file written by this node are verified again on load
+ */
+static constexpr bool DEFAULT_PERSIST_MEMPOOL_TRUSTED{false};
 
 bool ShouldPersistMempool(const ArgsManager& argsman);
 fs::path MempoolPath(const ArgsManager& argsman);
@@ -220,7 +220,7 @@ bool BlockAssembler::TestPackage(uint64_t packageSize, int64_t packageSigOpsCost
 
 // Perform transaction-level checks before adding to block:
 // - transaction finality (locktime)
-bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& package) const
+bool BlockAssembler::TestPackageTransactions(std::span<const CTxMemPool::txiter> package) const
 {
     for (CTxMemPool::txiter it : package) {
         if (!IsFinalTx(it->GetTx(), nHeight, m_lock_time_cutoff)) {
@@ -304,6 +304,10 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
     const auto& mempool{*Assert(m_mempool)};
     LOCK(mempool.cs);
 
+    if (const auto block_builder{mempool.GetBlockBuilder()}) {
+        return addChunks(*block_builder, nPackagesSelected);
+    }
+
     // mapModifiedTx will store sorted packages after they are modified
     // because some of their txs are already in the block
     indexed_modified_transaction_set mapModifiedTx;
@@ -411,8 +415,12 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
         onlyUnconfirmed(ancestors);
         ancestors.insert(iter);
 
+        // Sort the entries in a valid order.
+        std::vector<CTxMemPool::txiter> sortedEntries;
+        SortForBlock(ancestors, sortedEntries);
+
         // Test if all tx's are Final
-        if (!TestPackageTransactions(ancestors)) {
+        if (!TestPackageTransactions(sortedEntries)) {
             if (fUsingModified) {
                 mapModifiedTx.get<ancestor_score>().erase(modit);
                 failedTx.insert(iter->GetSharedTx()->GetHash());
@@ -423,9 +431,7 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
         // This transaction will make it in; reset the failed counter.
         nConsecutiveFailed = 0;
 
-        // Package can be added. Sort the entries in a valid order.
-        std::vector<CTxMemPool::txiter> sortedEntries;
-        SortForBlock(ancestors, sortedEntries);
+        // Package can be added.
 
         for (size_t i = 0; i < sortedEntries.size(); ++i) {
             AddToBlock(sortedEntries[i]);
@@ -441,6 +447,57 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
     }
 }
 
+void BlockAssembler::addChunks(TxGraph::BlockBuilder& block_builder, int& nPackagesSelected)
+{
+    const auto& mempool{*Assert(m_mempool)};
+    AssertLockHeld(mempool.cs);
+
+    // Same early exit heuristic as addPackageTxs().
+    const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
+    constexpr int32_t BLOCK_FULL_ENOUGH_WEIGHT_DELTA = 4000;
+    int64_t nConsecutiveFailed = 0;
+
+    std::vector<CTxMemPool::txiter> chunk_entries;
+    while (const auto chunk{block_builder.GetCurrentChunk()}) {
+        const auto& [chunk_refs, chunk_feerate] = *chunk;
+        if (chunk_feerate.fee < m_options.blockMinFeeRate.GetFee(chunk_feerate.size)) {
+            // Chunks come in decreasing feerate order, so everything else has a lower fee rate
+            return;
+        }
+
+        // Chunks are topologically sorted already.
+        chunk_entries.clear();
+        int64_t chunk_sigops_cost{0};
+        for (const TxGraph::Ref* ref : chunk_refs) {
+            chunk_entries.push_back(mempool.GetIterFromRef(*ref));
+            chunk_sigops_cost += chunk_entries.back()->GetSigOpCost();
+        }
+
+        if (!TestPackage(chunk_feerate.size, chunk_sigops_cost) || !TestPackageTransactions(chunk_entries)) {
+            // Later chunks of the same cluster may depend on this one, so the
+            // builder skips the remainder of the cluster.
+            block_builder.Skip();
+            ++nConsecutiveFailed;
+
+            if (nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES && nBlockWeight >
+                    m_options.nBlockMaxWeight - BLOCK_FULL_ENOUGH_WEIGHT_DELTA) {
+                // Give up if we're close to full and haven't succeeded in a while
+                return;
+            }
+            continue;
+        }
+
+        nConsecutiveFailed = 0;
+        for (const CTxMemPool::txiter& it : chunk_entries) {
+            AddToBlock(it);
+        }
+        block_builder.Include();
+
+        ++nPackagesSelected;
+        pblocktemplate->m_package_feerates.emplace_back(chunk_feerate.fee, chunk_feerate.size);
+    }
+}
+
 void AddMerkleRootAndCoinbase(CBlock& block, CTransactionRef coinbase, uint32_t version, uint32_t timestamp, uint32_t nonce)
 {
     if (block.vtx.size() == 0) {
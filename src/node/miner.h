@@ -10,12 +10,14 @@
 #include <node/types.h>
 #include <policy/policy.h>
 #include <primitives/block.h>
+#include <txgraph.h>
 #include <txmempool.h>
 #include <util/feefrac.h>
 
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <span>
 
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/indexed_by.hpp>
@@ -201,10 +203,15 @@ private:
     /** Add transactions based on feerate including unconfirmed ancestors
       * Increments nPackagesSelected / nDescendantsUpdated with corresponding
       * statistics from the package selection (for logging statistics).
+      * Delegates to addChunks() unless the mempool holds an oversized cluster.
       *
       * @pre BlockAssembler::m_mempool must not be nullptr
     */
     void addPackageTxs(int& nPackagesSelected, int& nDescendantsUpdated) EXCLUSIVE_LOCKS_REQUIRED(!m_mempool->cs);
+    /** Add whole chunks of the mempool's cluster linearization in decreasing
+      * feerate order, skipping the rest of a cluster once one of its chunks
+      * does not fit. Increments nPackagesSelected per chunk. */
+    void addChunks(TxGraph::BlockBuilder& block_builder, int& nPackagesSelected) EXCLUSIVE_LOCKS_REQUIRED(m_mempool->cs);
 
     // helper functions for addPackageTxs()
     /** Remove confirmed (inBlock) entries from given set */
@@ -215,7 +222,7 @@ private:
       * locktime, premature-witness, serialized size (if necessary)
       * These checks should always succeed, and they're here
       * only as an extra check in case of suboptimal node configuration */
-    bool TestPackageTransactions(const CTxMemPool::setEntries& package) const;
+    bool TestPackageTransactions(std::span<const CTxMemPool::txiter> package) const;
     /** Sort the package in an order that is valid to appear in a block */
     void SortForBlock(const CTxMemPool::setEntries& package, std::vector<CTxMemPool::txiter>& sortedEntries);
 };
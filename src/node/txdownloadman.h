@@ -5,12 +5,15 @@
 #ifndef QTC_NODE_TXDOWNLOADMAN_H
 #define QTC_NODE_TXDOWNLOADMAN_H
 
+#include <consensus/amount.h>
 #include <net.h>
 #include <policy/packages.h>
 #include <txorphanage.h>
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
+#include <optional>
 
 class CBlock;
 class CRollingBloomFilter;
@@ -36,6 +39,18 @@ static constexpr auto NONPREF_PEER_TX_DELAY{2s};
 static constexpr auto OVERLOADED_PEER_TX_DELAY{2s};
 /** How long to wait before downloading a transaction from an additional peer */
 static constexpr auto GETDATA_TX_INTERVAL{60s};
+/** Announcements whose hinted feerate is at least this multiple of the mempool minimum feerate are
+ *  scheduled as priority downloads (see TxAnnouncementHint). */
+static constexpr int PRIORITY_TX_FEERATE_FACTOR{2};
+/** Fetch latency assumed for peers we have not received a requested transaction from yet. */
+static constexpr auto DEFAULT_TX_FETCH_LATENCY{1s};
+/** Priority announcements from preferred peers are delayed by the announcing peer's fetch latency, up to
+ *  this much. This makes them requestable from the fastest of those peers first. */
+static constexpr auto MAX_PRIORITY_TX_LATENCY_DELAY{2s};
+/** Priority requests time out after this multiple of the peer's fetch latency, bounded by
+ *  PRIORITY_TX_MIN_INTERVAL and GETDATA_TX_INTERVAL, so that a slow peer cannot hold them for long. */
+static constexpr int PRIORITY_TX_INTERVAL_FACTOR{4};
+static constexpr auto PRIORITY_TX_MIN_INTERVAL{5s};
 struct TxDownloadOptions {
     /** Read-only reference to mempool. */
     const CTxMemPool& m_mempool;
@@ -46,6 +61,11 @@ struct TxDownloadOptions {
     /** Instantiate TxRequestTracker as deterministic (used for tests). */
     bool m_deterministic_txrequest{false};
 };
+/** Virtual size and fee of an announced transaction, as claimed by the announcing peer. */
+struct TxAnnouncementHint {
+    uint32_t m_vsize;
+    CAmount m_fee;
+};
 struct TxDownloadConnectionInfo {
     /** Whether this peer is preferred for transaction download. */
     const bool m_preferred;
@@ -136,14 +156,16 @@ public:
 
     /** Consider adding this tx hash to txrequest. Should be called whenever a new inv has been received.
      * Also called internally when a transaction is missing parents so that we can request them.
+     * If the peer included a size and fee hint, a high enough feerate makes this a priority download.
      * Returns true if this was a dropped inv (p2p_inv=true and we already have the tx), false otherwise. */
-    bool AddTxAnnouncement(NodeId peer, const GenTxid& gtxid, std::chrono::microseconds now);
+    bool AddTxAnnouncement(NodeId peer, const GenTxid& gtxid, std::chrono::microseconds now,
+                           const std::optional<TxAnnouncementHint>& hint = std::nullopt);
 
     /** Get getdata requests to send. */
     std::vector<GenTxid> GetRequestsToSend(NodeId nodeid, std::chrono::microseconds current_time);
 
     /** Should be called when a notfound for a tx has been received. */
-    void ReceivedNotFound(NodeId nodeid, const std::vector<uint256>& txhashes);
+    void ReceivedNotFound(NodeId nodeid, const std::vector<uint256>& txhashes, std::chrono::microseconds now);
 
     /** Respond to successful transaction submission to mempool */
     void MempoolAcceptedTx(const CTransactionRef& tx);
@@ -157,7 +179,11 @@ public:
     /** Marks a tx as ReceivedResponse in txrequest and checks whether AlreadyHaveTx.
      * Return a bool indicating whether this tx should be validated. If false, optionally, a
      * PackageToValidate. */
-    std::pair<bool, std::optional<PackageToValidate>> ReceivedTx(NodeId nodeid, const CTransactionRef& ptx);
+    std::pair<bool, std::optional<PackageToValidate>> ReceivedTx(NodeId nodeid, const CTransactionRef& ptx, std::chrono::microseconds now);
+
+    /** Smoothed time this peer has taken to answer our transaction requests, or std::nullopt if it has not
+     * answered any yet. */
+    std::optional<std::chrono::microseconds> GetFetchLatency(NodeId nodeid) const;
 
     /** Whether there are any orphans to reconsider for this peer. */
     bool HaveMoreWork(NodeId nodeid) const;
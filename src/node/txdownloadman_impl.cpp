@@ -8,10 +8,13 @@
 #include <chain.h>
 #include <consensus/validation.h>
 #include <logging.h>
+#include <policy/feerate.h>
 #include <txmempool.h>
 #include <validation.h>
 #include <validationinterface.h>
 
+#include <algorithm>
+
 namespace node {
 // TxDownloadManager wrappers
 TxDownloadManager::TxDownloadManager(const TxDownloadOptions& options) :
@@ -39,17 +42,18 @@ void TxDownloadManager::DisconnectedPeer(NodeId nodeid)
 {
     m_impl->DisconnectedPeer(nodeid);
 }
-bool TxDownloadManager::AddTxAnnouncement(NodeId peer, const GenTxid& gtxid, std::chrono::microseconds now)
+bool TxDownloadManager::AddTxAnnouncement(NodeId peer, const GenTxid& gtxid, std::chrono::microseconds now,
+                                          const std::optional<TxAnnouncementHint>& hint)
 {
-    return m_impl->AddTxAnnouncement(peer, gtxid, now);
+    return m_impl->AddTxAnnouncement(peer, gtxid, now, hint);
 }
 std::vector<GenTxid> TxDownloadManager::GetRequestsToSend(NodeId nodeid, std::chrono::microseconds current_time)
 {
     return m_impl->GetRequestsToSend(nodeid, current_time);
 }
-void TxDownloadManager::ReceivedNotFound(NodeId nodeid, const std::vector<uint256>& txhashes)
+void TxDownloadManager::ReceivedNotFound(NodeId nodeid, const std::vector<uint256>& txhashes, std::chrono::microseconds now)
 {
-    m_impl->ReceivedNotFound(nodeid, txhashes);
+    m_impl->ReceivedNotFound(nodeid, txhashes, now);
 }
 void TxDownloadManager::MempoolAcceptedTx(const CTransactionRef& tx)
 {
@@ -63,9 +67,13 @@ void TxDownloadManager::MempoolRejectedPackage(const Package& package)
 {
     m_impl->MempoolRejectedPackage(package);
 }
-std::pair<bool, std::optional<PackageToValidate>> TxDownloadManager::ReceivedTx(NodeId nodeid, const CTransactionRef& ptx)
+std::pair<bool, std::optional<PackageToValidate>> TxDownloadManager::ReceivedTx(NodeId nodeid, const CTransactionRef& ptx, std::chrono::microseconds now)
+{
+    return m_impl->ReceivedTx(nodeid, ptx, now);
+}
+std::optional<std::chrono::microseconds> TxDownloadManager::GetFetchLatency(NodeId nodeid) const
 {
-    return m_impl->ReceivedTx(nodeid, ptx);
+    return m_impl->GetFetchLatency(nodeid);
 }
 bool TxDownloadManager::HaveMoreWork(NodeId nodeid) const
 {
@@ -172,7 +180,15 @@ void TxDownloadManagerImpl::DisconnectedPeer(NodeId nodeid)
 
 }
 
-bool TxDownloadManagerImpl::AddTxAnnouncement(NodeId peer, const GenTxid& gtxid, std::chrono::microseconds now)
+bool TxDownloadManagerImpl::IsPriorityHint(const TxAnnouncementHint& hint) const
+{
+    if (hint.m_vsize == 0) return false;
+    const CFeeRate min_feerate{std::max(m_opts.m_mempool.GetMinFee(), m_opts.m_mempool.m_opts.min_relay_feerate)};
+    return CFeeRate{hint.m_fee, hint.m_vsize} >= min_feerate * PRIORITY_TX_FEERATE_FACTOR;
+}
+
+bool TxDownloadManagerImpl::AddTxAnnouncement(NodeId peer, const GenTxid& gtxid, std::chrono::microseconds now,
+                                              const std::optional<TxAnnouncementHint>& hint)
 {
     // If this is an orphan we are trying to resolve, consider this peer as a orphan resolution candidate instead.
     // - is wtxid matching something in orphanage
@@ -211,15 +227,29 @@ bool TxDownloadManagerImpl::AddTxAnnouncement(NodeId peer, const GenTxid& gtxid,
         // Too many queued announcements for this peer
         return false;
     }
+
+    // A peer lying about the fee can only make its own announcement of the transaction requestable
+    // sooner (if it is preferred) and our request to it give up sooner.
+    const bool priority{hint && IsPriorityHint(*hint)};
+    if (priority) it->second.m_priority_txs.insert_or_assign(gtxid.GetHash(), now);
+
     // Decide the TxRequestTracker parameters for this announcement:
     // - "preferred": if fPreferredDownload is set (= outbound, or NetPermissionFlags::NoBan permission)
     // - "reqtime": current time plus delays for:
-    //   - NONPREF_PEER_TX_DELAY for announcements from non-preferred connections
+    //   - NONPREF_PEER_TX_DELAY for announcements from non-preferred connections, whatever their
+    //     hint says, so that inbound peers cannot jump the queue by claiming a high fee
+    //   - for priority announcements from preferred connections, the announcing peer's fetch
+    //     latency capped at MAX_PRIORITY_TX_LATENCY_DELAY, so the fastest announcers become
+    //     requestable first
     //   - TXID_RELAY_DELAY for txid announcements while wtxid peers are available
     //   - OVERLOADED_PEER_TX_DELAY for announcements from peers which have at least
     //     MAX_PEER_TX_REQUEST_IN_FLIGHT requests in flight (and don't have NetPermissionFlags::Relay).
     auto delay{0us};
-    if (!info.m_preferred) delay += NONPREF_PEER_TX_DELAY;
+    if (!info.m_preferred) {
+        delay += NONPREF_PEER_TX_DELAY;
+    } else if (priority) {
+        delay += std::min<std::chrono::microseconds>(it->second.FetchLatencyOrDefault(), MAX_PRIORITY_TX_LATENCY_DELAY);
+    }
     if (!gtxid.IsWtxid() && m_num_wtxid_peers > 0) delay += TXID_RELAY_DELAY;
     const bool overloaded = !info.m_relay_permissions && m_txrequest.CountInFlight(peer) >= MAX_PEER_TX_REQUEST_IN_FLIGHT;
     if (overloaded) delay += OVERLOADED_PEER_TX_DELAY;
@@ -275,13 +305,39 @@ std::vector<GenTxid> TxDownloadManagerImpl::GetRequestsToSend(NodeId nodeid, std
     for (const auto& entry : expired) {
         LogDebug(BCLog::NET, "timeout of inflight %s %s from peer=%d\n", entry.second.IsWtxid() ? "wtx" : "tx",
             entry.second.GetHash().ToString(), entry.first);
+        // A timeout counts as a fetch taking the whole request interval, which slows down the
+        // peer's priority requests.
+        if (auto peer_it = m_peer_info.find(entry.first); peer_it != m_peer_info.end()) {
+            RecordFetchTime(peer_it->second, entry.second.GetHash(), current_time);
+        }
     }
+
+    auto peer_it = m_peer_info.find(nodeid);
+    if (peer_it != m_peer_info.end()) {
+        // Forget requests that can no longer be answered in time, e.g. because the transaction was
+        // received from another peer and the announcement deleted.
+        std::erase_if(peer_it->second.m_request_times, [&](const auto& entry) {
+            return entry.second + GETDATA_TX_INTERVAL < current_time;
+        });
+        std::erase_if(peer_it->second.m_priority_txs, [&](const auto& entry) {
+            return entry.second + GETDATA_TX_INTERVAL < current_time;
+        });
+    }
+
     for (const GenTxid& gtxid : requestable) {
         if (!AlreadyHaveTx(gtxid, /*include_reconsiderable=*/false)) {
             LogDebug(BCLog::NET, "Requesting %s %s peer=%d\n", gtxid.IsWtxid() ? "wtx" : "tx",
                 gtxid.GetHash().ToString(), nodeid);
             requests.emplace_back(gtxid);
-            m_txrequest.RequestedTx(nodeid, gtxid.GetHash(), current_time + GETDATA_TX_INTERVAL);
+            auto interval{std::chrono::microseconds{GETDATA_TX_INTERVAL}};
+            if (peer_it != m_peer_info.end()) {
+                peer_it->second.m_request_times.insert_or_assign(gtxid.GetHash(), current_time);
+                if (peer_it->second.m_priority_txs.erase(gtxid.GetHash())) {
+                    interval = std::clamp<std::chrono::microseconds>(peer_it->second.FetchLatencyOrDefault() * PRIORITY_TX_INTERVAL_FACTOR,
+                                                                     PRIORITY_TX_MIN_INTERVAL, GETDATA_TX_INTERVAL);
+                }
+            }
+            m_txrequest.RequestedTx(nodeid, gtxid.GetHash(), current_time + interval);
         } else {
             // We have already seen this transaction, no need to download. This is just a belt-and-suspenders, as
             // this should already be called whenever a transaction becomes AlreadyHaveTx().
@@ -291,15 +347,39 @@ std::vector<GenTxid> TxDownloadManagerImpl::GetRequestsToSend(NodeId nodeid, std
     return requests;
 }
 
-void TxDownloadManagerImpl::ReceivedNotFound(NodeId nodeid, const std::vector<uint256>& txhashes)
+void TxDownloadManagerImpl::ReceivedNotFound(NodeId nodeid, const std::vector<uint256>& txhashes, std::chrono::microseconds now)
 {
+    auto peer_it = m_peer_info.find(nodeid);
     for (const auto& txhash : txhashes) {
         // If we receive a NOTFOUND message for a tx we requested, mark the announcement for it as
         // completed in TxRequestTracker.
         m_txrequest.ReceivedResponse(nodeid, txhash);
+        if (peer_it != m_peer_info.end()) RecordFetchTime(peer_it->second, txhash, now);
     }
 }
 
+bool TxDownloadManagerImpl::RecordFetchTime(PeerInfo& peer_info, const uint256& txhash, std::chrono::microseconds now)
+{
+    auto it = peer_info.m_request_times.find(txhash);
+    if (it == peer_info.m_request_times.end()) return false;
+    const auto sample{std::max(now - it->second, 0us)};
+    peer_info.m_request_times.erase(it);
+    if (peer_info.m_fetch_latency == 0us) {
+        peer_info.m_fetch_latency = std::max(sample, 1us);
+    } else {
+        // Weigh the new sample 1/8, like TCP's smoothed round-trip time.
+        peer_info.m_fetch_latency = std::max((peer_info.m_fetch_latency * 7 + sample) / 8, 1us);
+    }
+    return true;
+}
+
+std::optional<std::chrono::microseconds> TxDownloadManagerImpl::GetFetchLatency(NodeId nodeid) const
+{
+    auto it = m_peer_info.find(nodeid);
+    if (it == m_peer_info.end() || it->second.m_fetch_latency == 0us) return std::nullopt;
+    return it->second.m_fetch_latency;
+}
+
 std::optional<PackageToValidate> TxDownloadManagerImpl::Find1P1CPackage(const CTransactionRef& ptx, NodeId nodeid)
 {
     const auto& parent_wtxid{ptx->GetWitnessHash()};
@@ -513,7 +593,7 @@ void TxDownloadManagerImpl::MempoolRejectedPackage(const Package& package)
     RecentRejectsReconsiderableFilter().insert(GetPackageHash(package));
 }
 
-std::pair<bool, std::optional<PackageToValidate>> TxDownloadManagerImpl::ReceivedTx(NodeId nodeid, const CTransactionRef& ptx)
+std::pair<bool, std::optional<PackageToValidate>> TxDownloadManagerImpl::ReceivedTx(NodeId nodeid, const CTransactionRef& ptx, std::chrono::microseconds now)
 {
     const uint256& txid = ptx->GetHash();
     const uint256& wtxid = ptx->GetWitnessHash();
@@ -522,6 +602,10 @@ std::pair<bool, std::optional<PackageToValidate>> TxDownloadManagerImpl::Receive
     m_txrequest.ReceivedResponse(nodeid, txid);
     if (ptx->HasWitness()) m_txrequest.ReceivedResponse(nodeid, wtxid);
 
+    if (auto peer_it = m_peer_info.find(nodeid); peer_it != m_peer_info.end()) {
+        if (!RecordFetchTime(peer_it->second, wtxid, now)) RecordFetchTime(peer_it->second, txid, now);
+    }
+
     // First check if we should drop this tx.
     // We do the AlreadyHaveTx() check using wtxid, rather than txid - in the
     // absence of witness malleation, this is strictly better, because the
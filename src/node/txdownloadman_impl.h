@@ -134,7 +134,28 @@ public:
         /** Information relevant to scheduling tx requests. */
         const TxDownloadConnectionInfo m_connection_info;
 
+        /** When each of our outstanding transaction requests to this peer was sent. Entries are
+         * removed when answered or expired, and pruned after GETDATA_TX_INTERVAL otherwise. */
+        std::map<uint256, std::chrono::microseconds> m_request_times;
+
+        /** Transactions this peer announced with a hint that makes them priority downloads (see
+         * PRIORITY_TX_FEERATE_FACTOR), with the announcement time. Our request to this peer then
+         * times out according to its fetch latency. Entries are removed when the request is sent,
+         * and pruned after GETDATA_TX_INTERVAL otherwise. Kept per peer, so that a peer's hints
+         * only ever affect requests to that peer. */
+        std::map<uint256, std::chrono::microseconds> m_priority_txs;
+
+        /** Exponentially weighted moving average of the time this peer takes to answer a
+         * transaction request, or zero if it has not answered one yet. */
+        std::chrono::microseconds m_fetch_latency{0us};
+
         PeerInfo(const TxDownloadConnectionInfo& info) : m_connection_info{info} {}
+
+        /** The measured fetch latency, or DEFAULT_TX_FETCH_LATENCY if there is none yet. */
+        std::chrono::microseconds FetchLatencyOrDefault() const
+        {
+            return m_fetch_latency > 0us ? m_fetch_latency : std::chrono::microseconds{DEFAULT_TX_FETCH_LATENCY};
+        }
     };
 
     /** Information for all of the peers we may download transactions from. This is not necessarily
@@ -163,13 +184,22 @@ public:
     /** Consider adding this tx hash to txrequest. Should be called whenever a new inv has been received.
      * Also called internally when a transaction is missing parents so that we can request them.
      */
-    bool AddTxAnnouncement(NodeId peer, const GenTxid& gtxid, std::chrono::microseconds now);
+    bool AddTxAnnouncement(NodeId peer, const GenTxid& gtxid, std::chrono::microseconds now,
+                           const std::optional<TxAnnouncementHint>& hint = std::nullopt);
+
+    /** Whether a transaction with this hinted size and fee should be downloaded with priority. */
+    bool IsPriorityHint(const TxAnnouncementHint& hint) const;
 
     /** Get getdata requests to send. */
     std::vector<GenTxid> GetRequestsToSend(NodeId nodeid, std::chrono::microseconds current_time);
 
     /** Marks a tx as ReceivedResponse in txrequest. */
-    void ReceivedNotFound(NodeId nodeid, const std::vector<uint256>& txhashes);
+    void ReceivedNotFound(NodeId nodeid, const std::vector<uint256>& txhashes, std::chrono::microseconds now);
+
+    /** Update the peer's fetch latency if txhash was requested from it. Returns whether it was. */
+    bool RecordFetchTime(PeerInfo& peer_info, const uint256& txhash, std::chrono::microseconds now);
+
+    std::optional<std::chrono::microseconds> GetFetchLatency(NodeId nodeid) const;
 
     /** Look for a child of this transaction in the orphanage to form a 1-parent-1-child package,
      * skipping any combinations that have already been tried. Return the resulting package along with
@@ -180,7 +210,7 @@ public:
     RejectedTxTodo MempoolRejectedTx(const CTransactionRef& ptx, const TxValidationState& state, NodeId nodeid, bool first_time_failure);
     void MempoolRejectedPackage(const Package& package);
 
-    std::pair<bool, std::optional<PackageToValidate>> ReceivedTx(NodeId nodeid, const CTransactionRef& ptx);
+    std::pair<bool, std::optional<PackageToValidate>> ReceivedTx(NodeId nodeid, const CTransactionRef& ptx, std::chrono::microseconds now);
 
     bool HaveMoreWork(NodeId nodeid);
     CTransactionRef GetTxToReconsider(NodeId nodeid);
@@ -644,28 +644,36 @@ void TxOrphanageImpl::EraseForBlock(const CBlock& block)
 
 std::vector<CTransactionRef> TxOrphanageImpl::GetChildrenFromSamePeer(const CTransactionRef& parent, NodeId peer) const
 {
-    std::vector<CTransactionRef> children_found;
+    // Look up the children through the parent's outputs rather than scanning all of this peer's
+    // orphans: peers can hold many large, multi-input orphans, while a parent has few outputs.
+    // Since we require the NodeId to match, one peer's announcement order does not bias how we
+    // process other peer's orphans.
     const auto& parent_txid{parent->GetHash()};
-
-    // Iterate through all orphans from this peer, in reverse order, so that more recent
-    // transactions are added first. Doing so helps avoid work when one of the orphans replaced
-    // an earlier one. Since we require the NodeId to match, one peer's announcement order does
-    // not bias how we process other peer's orphans.
-    auto& index_by_peer = m_orphans.get<ByPeer>();
-    auto it_upper = index_by_peer.upper_bound(ByPeerView{peer, true, std::numeric_limits<uint64_t>::max()});
-    auto it_lower = index_by_peer.lower_bound(ByPeerView{peer, false, 0});
-
-    while (it_upper != it_lower) {
-        --it_upper;
-        if (!Assume(it_upper->m_announcer == peer)) break;
-        // Check if this tx spends from parent.
-        for (const auto& input : it_upper->m_tx->vin) {
-            if (input.prevout.hash == parent_txid) {
-                children_found.emplace_back(it_upper->m_tx);
-                break;
-            }
+    const auto& index_by_wtxid = m_orphans.get<ByWtxid>();
+    std::vector<Iter<ByWtxid>> announcements;
+    std::set<Wtxid> children_seen;
+    for (unsigned int i = 0; i < parent->vout.size(); i++) {
+        const auto it_by_prev = m_outpoint_to_orphan_wtxids.find(COutPoint(parent_txid, i));
+        if (it_by_prev == m_outpoint_to_orphan_wtxids.end()) continue;
+        for (const auto& wtxid : it_by_prev->second) {
+            // A child spending several outputs of the parent is only returned once.
+            if (!children_seen.insert(wtxid).second) continue;
+            auto it = index_by_wtxid.find(ByWtxidView{wtxid, peer});
+            if (it != index_by_wtxid.end()) announcements.push_back(it);
         }
     }
+
+    // Sort reconsiderable before non-reconsiderable, then more recent transactions first. Doing so
+    // helps avoid work when one of the orphans replaced an earlier one.
+    std::sort(announcements.begin(), announcements.end(), [](const auto& a, const auto& b) {
+        return std::tie(a->m_reconsider, a->m_entry_sequence) > std::tie(b->m_reconsider, b->m_entry_sequence);
+    });
+
+    std::vector<CTransactionRef> children_found;
+    children_found.reserve(announcements.size());
+    for (const auto& it : announcements) {
+        children_found.emplace_back(it->m_tx);
+    }
     return children_found;
 }
 
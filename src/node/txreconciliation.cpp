@@ -5,10 +5,19 @@
 #include <node/txreconciliation.h>
 
 #include <common/system.h>
+#include <crypto/siphash.h>
 #include <logging.h>
+#include <node/minisketchwrapper.h>
 #include <util/check.h>
+#include <util/hasher.h>
 
+#include <minisketch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <unordered_map>
+#include <unordered_set>
 #include <variant>
 
 
@@ -36,9 +45,6 @@ class TxReconciliationState
 {
 public:
     /**
-     * TODO: This field is public to ignore -Wunused-private-field. Make private once used in
-     * the following commits.
-     *
      * Reconciliation protocol assumes using one role consistently: either a reconciliation
      * initiator (requesting sketches), or responder (sending sketches). This defines our role,
      * based on the direction of the p2p connection.
@@ -47,18 +53,64 @@ public:
     bool m_we_initiate;
 
     /**
-     * TODO: These fields are public to ignore -Wunused-private-field. Make private once used in
-     * the following commits.
-     *
      * These values are used to salt short IDs, which is necessary for transaction reconciliations.
      */
     uint64_t m_k0, m_k1;
 
+    /** Transactions we intend to announce to the peer once a reconciliation says it lacks them. */
+    std::unordered_set<Wtxid, SaltedTxidHasher> m_local_set;
+
+    /** Initiator: when to start the next round, and when the outstanding request was sent (if any). */
+    std::chrono::microseconds m_next_request{0};
+    std::optional<std::chrono::microseconds> m_request_sent;
+
+    /** Initiator: coefficient estimating the set difference, updated after every successful round. */
+    double m_q{RECON_Q_DEFAULT};
+
+    /** Responder: when the peer last requested a reconciliation. Unset until it does, and again
+     *  once it has been idle for RECON_IDLE_TIMEOUT; transactions are flooded meanwhile. */
+    std::optional<std::chrono::microseconds> m_last_request;
+
+    /** Responder: pending reqrecon parameters (remote set size, q), not yet answered. */
+    std::optional<std::pair<uint16_t, double>> m_pending_request;
+
+    /** Responder: the set we sketched, by short ID, kept until the initiator's reconcildiff arrives. */
+    std::optional<std::unordered_map<uint32_t, Wtxid>> m_snapshot;
+
     TxReconciliationState(bool we_initiate, uint64_t k0, uint64_t k1) : m_we_initiate(we_initiate), m_k0(k0), m_k1(k1) {}
+
+    /** Sketch our set with the given capacity, and return the short ID -> wtxid mapping of its elements. */
+    std::unordered_map<uint32_t, Wtxid> ComputeSketch(Minisketch& sketch) const
+    {
+        std::unordered_map<uint32_t, Wtxid> shortids;
+        shortids.reserve(m_local_set.size());
+        for (const Wtxid& wtxid : m_local_set) {
+            const uint32_t shortid{ComputeReconShortID(m_k0, m_k1, wtxid)};
+            // Two transactions colliding on a short ID cancel out in the sketch. That's harmless: the
+            // second one simply isn't reconciled this round and is announced if the peer asks for the first.
+            if (shortids.emplace(shortid, wtxid).second) sketch.Add(shortid);
+        }
+        return shortids;
+    }
 };
 
 } // namespace
 
+uint32_t ComputeReconShortID(uint64_t k0, uint64_t k1, const Wtxid& wtxid)
+{
+    // BIP-330: short IDs are non-zero 32-bit values, as zero can't be stored in a sketch.
+    const uint64_t s{SipHashUint256(k0, k1, wtxid.ToUint256())};
+    return 1 + (s & 0xFFFFFFFF) % 0xFFFFFFFF;
+}
+
+size_t EstimateSketchCapacity(size_t local_set_size, size_t remote_set_size, double q)
+{
+    const size_t set_size_diff{local_set_size > remote_set_size ? local_set_size - remote_set_size : remote_set_size - local_set_size};
+    const size_t min_size{std::min(local_set_size, remote_set_size)};
+    const size_t estimated_diff{1 + set_size_diff + static_cast<size_t>(std::ceil(q * min_size))};
+    return std::min(Minisketch::ComputeCapacity(32, estimated_diff, RECON_FALSE_POSITIVE_COEF), MAX_SKETCH_CAPACITY);
+}
+
 /** Actual implementation for TxReconciliationTracker's data structure. */
 class TxReconciliationTracker::Impl
 {
@@ -76,6 +128,16 @@ private:
      */
     std::unordered_map<NodeId, std::variant<uint64_t, TxReconciliationState>> m_states GUARDED_BY(m_txreconciliation_mutex);
 
+    TxReconciliationStats m_stats GUARDED_BY(m_txreconciliation_mutex);
+
+    TxReconciliationState* GetRegisteredPeerState(NodeId peer_id) EXCLUSIVE_LOCKS_REQUIRED(m_txreconciliation_mutex)
+    {
+        AssertLockHeld(m_txreconciliation_mutex);
+        auto recon_state = m_states.find(peer_id);
+        if (recon_state == m_states.end()) return nullptr;
+        return std::get_if<TxReconciliationState>(&recon_state->second);
+    }
+
 public:
     explicit Impl(uint32_t recon_version) : m_recon_version(recon_version) {}
 
@@ -121,7 +183,7 @@ public:
                       peer_id, is_peer_inbound);
 
         const uint256 full_salt{ComputeSalt(local_salt, remote_salt)};
-        recon_state->second = TxReconciliationState(!is_peer_inbound, full_salt.GetUint64(0), full_salt.GetUint64(1));
+        recon_state->second.emplace<TxReconciliationState>(!is_peer_inbound, full_salt.GetUint64(0), full_salt.GetUint64(1));
         return ReconciliationRegisterResult::SUCCESS;
     }
 
@@ -142,6 +204,215 @@ public:
         return (recon_state != m_states.end() &&
                 std::holds_alternative<TxReconciliationState>(recon_state->second));
     }
+
+    bool AddToSet(NodeId peer_id, const Wtxid& wtxid) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        auto* peer_state = GetRegisteredPeerState(peer_id);
+        if (!peer_state) return false;
+
+        // The fanout choice is derived from the peer's salt, so each transaction is flooded to a
+        // different, unpredictable subset of peers.
+        if (SipHashUint256(peer_state->m_k1, peer_state->m_k0, wtxid.ToUint256()) % RECON_FANOUT_RATIO == 0 ||
+            peer_state->m_local_set.size() >= MAX_RECONSET_SIZE ||
+            (!peer_state->m_we_initiate && !peer_state->m_last_request)) {
+            ++m_stats.txs_flooded;
+            return false;
+        }
+        if (peer_state->m_local_set.insert(wtxid).second) ++m_stats.txs_reconciled;
+        return true;
+    }
+
+    std::optional<std::pair<uint16_t, uint16_t>> InitiateReconciliationRequest(NodeId peer_id, std::chrono::microseconds now) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        auto* peer_state = GetRegisteredPeerState(peer_id);
+        // An unanswered request is given up on by FlushStaleSet.
+        if (!peer_state || !peer_state->m_we_initiate || peer_state->m_request_sent) return std::nullopt;
+        if (now < peer_state->m_next_request) return std::nullopt;
+
+        peer_state->m_next_request = now + RECON_REQUEST_INTERVAL;
+        peer_state->m_request_sent = now;
+        const uint16_t set_size{static_cast<uint16_t>(std::min<size_t>(peer_state->m_local_set.size(), std::numeric_limits<uint16_t>::max()))};
+        const uint16_t q{static_cast<uint16_t>(peer_state->m_q * RECON_Q_PRECISION)};
+        LogPrintLevel(BCLog::TXRECONCILIATION, BCLog::Level::Debug, "Initiate reconciliation with peer=%d (set size %u, q %.3f)\n",
+                      peer_id, set_size, peer_state->m_q);
+        return std::make_pair(set_size, q);
+    }
+
+    bool HandleReconciliationRequest(NodeId peer_id, uint16_t peer_recon_set_size, uint16_t peer_q, std::chrono::microseconds now) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        auto* peer_state = GetRegisteredPeerState(peer_id);
+        if (!peer_state) return true;
+        // Only the initiator may request.
+        if (peer_state->m_we_initiate) return false;
+
+        // The initiator gave up on the previous round (e.g. its request to us timed out), so
+        // reconcile what we sketched for it again in this one.
+        if (peer_state->m_snapshot) {
+            LogPrintLevel(BCLog::TXRECONCILIATION, BCLog::Level::Debug, "Peer=%d abandoned a reconciliation round (%u txs)\n",
+                          peer_id, peer_state->m_snapshot->size());
+            for (const auto& [_, wtxid] : *peer_state->m_snapshot) peer_state->m_local_set.insert(wtxid);
+            peer_state->m_snapshot.reset();
+        }
+        peer_state->m_last_request = now;
+        peer_state->m_pending_request = std::make_pair(peer_recon_set_size, double(peer_q) / RECON_Q_PRECISION);
+        return true;
+    }
+
+    std::optional<std::vector<uint8_t>> RespondToReconciliationRequest(NodeId peer_id) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        auto* peer_state = GetRegisteredPeerState(peer_id);
+        if (!peer_state || !peer_state->m_pending_request) return std::nullopt;
+
+        const auto [remote_set_size, q] = *peer_state->m_pending_request;
+        peer_state->m_pending_request.reset();
+
+        // An empty sketch tells the initiator we have nothing; it then announces its whole set.
+        std::vector<uint8_t> skdata;
+        std::unordered_map<uint32_t, Wtxid> snapshot;
+        if (!peer_state->m_local_set.empty()) {
+            Minisketch sketch{node::MakeMinisketch32(EstimateSketchCapacity(peer_state->m_local_set.size(), remote_set_size, q))};
+            snapshot = peer_state->ComputeSketch(sketch);
+            skdata = sketch.Serialize();
+        }
+        // Transactions arriving from now on belong to the next round.
+        peer_state->m_local_set.clear();
+        peer_state->m_snapshot = std::move(snapshot);
+        m_stats.sketch_bytes_sent += skdata.size();
+
+        LogPrintLevel(BCLog::TXRECONCILIATION, BCLog::Level::Debug, "Send sketch of %u bytes (%u txs) to peer=%d\n",
+                      skdata.size(), peer_state->m_snapshot->size(), peer_id);
+        return skdata;
+    }
+
+    std::optional<ReconciliationResult> HandleSketch(NodeId peer_id, std::span<const uint8_t> skdata) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        auto* peer_state = GetRegisteredPeerState(peer_id);
+        if (!peer_state) return ReconciliationResult{};
+        if (!peer_state->m_we_initiate || !peer_state->m_request_sent) return std::nullopt;
+
+        // Elements of a 32-bit field sketch take 4 bytes each.
+        if (skdata.size() % 4 != 0 || skdata.size() / 4 > MAX_SKETCH_CAPACITY) return std::nullopt;
+        const size_t capacity{skdata.size() / 4};
+        peer_state->m_request_sent.reset();
+        m_stats.sketch_bytes_received += skdata.size();
+
+        ReconciliationResult result;
+        const auto announce_all = [&] {
+            result.success = false;
+            result.announce.assign(peer_state->m_local_set.begin(), peer_state->m_local_set.end());
+            ++m_stats.reconciliations_failed;
+        };
+
+        if (capacity == 0) {
+            announce_all();
+        } else {
+            Minisketch local_sketch{node::MakeMinisketch32(capacity)};
+            const auto local_shortids{peer_state->ComputeSketch(local_sketch)};
+            Minisketch remote_sketch{node::MakeMinisketch32(capacity)};
+            remote_sketch.Deserialize(skdata);
+            local_sketch.Merge(remote_sketch);
+
+            if (auto differences{local_sketch.Decode(capacity)}) {
+                result.success = true;
+                for (const uint64_t diff : *differences) {
+                    const uint32_t shortid{static_cast<uint32_t>(diff)};
+                    const auto it{local_shortids.find(shortid)};
+                    if (it != local_shortids.end()) {
+                        result.announce.push_back(it->second);
+                    } else {
+                        result.ask_shortids.push_back(shortid);
+                    }
+                }
+                // Re-estimate q from what we learnt about the peer's set, for the next round.
+                const size_t local_size{local_shortids.size()};
+                const size_t remote_size{local_size - result.announce.size() + result.ask_shortids.size()};
+                const size_t min_size{std::min(local_size, remote_size)};
+                if (min_size > 0) {
+                    const size_t set_size_diff{local_size > remote_size ? local_size - remote_size : remote_size - local_size};
+                    peer_state->m_q = std::clamp(double(differences->size() - set_size_diff) / min_size, 0.0, 2.0);
+                }
+                ++m_stats.reconciliations_succeeded;
+                m_stats.shortid_bytes += result.ask_shortids.size() * sizeof(uint32_t);
+            } else {
+                announce_all();
+            }
+        }
+        peer_state->m_local_set.clear();
+        m_stats.txs_announced += result.announce.size();
+
+        LogPrintLevel(BCLog::TXRECONCILIATION, BCLog::Level::Debug, "Reconciliation with peer=%d %s: announcing %u, requesting %u\n",
+                      peer_id, result.success ? "succeeded" : "failed", result.announce.size(), result.ask_shortids.size());
+        return result;
+    }
+
+    std::optional<std::vector<Wtxid>> HandleReconciliationDifference(NodeId peer_id, bool success, std::span<const uint32_t> ask_shortids) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        auto* peer_state = GetRegisteredPeerState(peer_id);
+        if (!peer_state) return std::vector<Wtxid>{};
+        if (peer_state->m_we_initiate || !peer_state->m_snapshot) return std::nullopt;
+
+        std::vector<Wtxid> announce;
+        if (success) {
+            for (const uint32_t shortid : ask_shortids) {
+                // Unknown short IDs may be a collision on the initiator's side; nothing to announce.
+                const auto it{peer_state->m_snapshot->find(shortid)};
+                if (it != peer_state->m_snapshot->end()) announce.push_back(it->second);
+            }
+        } else {
+            for (const auto& [_, wtxid] : *peer_state->m_snapshot) announce.push_back(wtxid);
+        }
+        peer_state->m_snapshot.reset();
+        m_stats.txs_announced += announce.size();
+        m_stats.shortid_bytes += ask_shortids.size() * sizeof(uint32_t);
+        return announce;
+    }
+
+    std::vector<Wtxid> FlushStaleSet(NodeId peer_id, std::chrono::microseconds now) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        auto* peer_state = GetRegisteredPeerState(peer_id);
+        if (!peer_state) return {};
+
+        if (peer_state->m_we_initiate) {
+            if (!peer_state->m_request_sent || now < *peer_state->m_request_sent + RECON_RESPONSE_TIMEOUT) return {};
+            LogPrintLevel(BCLog::TXRECONCILIATION, BCLog::Level::Debug, "Reconciliation request to peer=%d timed out\n", peer_id);
+            peer_state->m_request_sent.reset();
+        } else {
+            if (!peer_state->m_last_request || now < *peer_state->m_last_request + RECON_IDLE_TIMEOUT) return {};
+            LogPrintLevel(BCLog::TXRECONCILIATION, BCLog::Level::Debug, "Peer=%d stopped requesting reconciliations\n", peer_id);
+            peer_state->m_last_request.reset();
+            peer_state->m_pending_request.reset();
+        }
+
+        std::vector<Wtxid> flushed(peer_state->m_local_set.begin(), peer_state->m_local_set.end());
+        peer_state->m_local_set.clear();
+        if (peer_state->m_snapshot) {
+            for (const auto& [_, wtxid] : *peer_state->m_snapshot) flushed.push_back(wtxid);
+            peer_state->m_snapshot.reset();
+        }
+        m_stats.txs_flooded += flushed.size();
+        return flushed;
+    }
+
+    TxReconciliationStats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        return m_stats;
+    }
 };
 
 TxReconciliationTracker::TxReconciliationTracker(uint32_t recon_version) : m_impl{std::make_unique<TxReconciliationTracker::Impl>(recon_version)} {}
@@ -168,3 +439,43 @@ bool TxReconciliationTracker::IsPeerRegistered(NodeId peer_id) const
 {
     return m_impl->IsPeerRegistered(peer_id);
 }
+
+bool TxReconciliationTracker::AddToSet(NodeId peer_id, const Wtxid& wtxid)
+{
+    return m_impl->AddToSet(peer_id, wtxid);
+}
+
+std::optional<std::pair<uint16_t, uint16_t>> TxReconciliationTracker::InitiateReconciliationRequest(NodeId peer_id, std::chrono::microseconds now)
+{
+    return m_impl->InitiateReconciliationRequest(peer_id, now);
+}
+
+bool TxReconciliationTracker::HandleReconciliationRequest(NodeId peer_id, uint16_t peer_recon_set_size, uint16_t peer_q, std::chrono::microseconds now)
+{
+    return m_impl->HandleReconciliationRequest(peer_id, peer_recon_set_size, peer_q, now);
+}
+
+std::optional<std::vector<uint8_t>> TxReconciliationTracker::RespondToReconciliationRequest(NodeId peer_id)
+{
+    return m_impl->RespondToReconciliationRequest(peer_id);
+}
+
+std::optional<ReconciliationResult> TxReconciliationTracker::HandleSketch(NodeId peer_id, std::span<const uint8_t> skdata)
+{
+    return m_impl->HandleSketch(peer_id, skdata);
+}
+
+std::optional<std::vector<Wtxid>> TxReconciliationTracker::HandleReconciliationDifference(NodeId peer_id, bool success, std::span<const uint32_t> ask_shortids)
+{
+    return m_impl->HandleReconciliationDifference(peer_id, success, ask_shortids);
+}
+
+std::vector<Wtxid> TxReconciliationTracker::FlushStaleSet(NodeId peer_id, std::chrono::microseconds now)
+{
+    return m_impl->FlushStaleSet(peer_id, now);
+}
+
+TxReconciliationStats TxReconciliationTracker::GetStats() const
+{
+    return m_impl->GetStats();
+}
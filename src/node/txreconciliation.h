@@ -7,13 +7,76 @@
 
 #include <net.h>
 #include <sync.h>
+#include <util/time.h>
+#include <util/transaction_identifier.h>
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <span>
 #include <tuple>
+#include <vector>
 
 /** Supported transaction reconciliation protocol version */
 static constexpr uint32_t TXRECONCILIATION_VERSION{1};
 
+/**
+ * Interval between reconciliations we initiate with each outbound peer. At our transaction rates
+ * (multi-KB PQ transactions, a few per second) this keeps the expected set difference well within
+ * a single sketch while batching enough announcements to make reconciliation worthwhile.
+ */
+static constexpr auto RECON_REQUEST_INTERVAL{8s};
+/** How long an initiator waits for a sketch before giving up on the current round and flooding its set. */
+static constexpr auto RECON_RESPONSE_TIMEOUT{1min};
+/** A responder whose peer hasn't requested a reconciliation for this long floods its set, and keeps
+ *  flooding until the peer requests again. */
+static constexpr auto RECON_IDLE_TIMEOUT{1min};
+/** Transactions beyond this many in a peer's reconciliation set are flooded instead. */
+static constexpr size_t MAX_RECONSET_SIZE{3000};
+/** Transactions are still flooded to one in this many reconciling peers, so they keep propagating
+ *  quickly while the remaining peers learn about them through reconciliation. */
+static constexpr uint64_t RECON_FANOUT_RATIO{10};
+/** Initial coefficient used to estimate the set difference from the set sizes (BIP-330 "q"). */
+static constexpr double RECON_Q_DEFAULT{0.25};
+/** q is sent as an integer scaled by this value. */
+static constexpr uint16_t RECON_Q_PRECISION{(2 << 14) - 1};
+/** Sketches are sized so that the chance of an undetected decoding failure is at most 2^-N. */
+static constexpr uint32_t RECON_FALSE_POSITIVE_COEF{16};
+/** Largest sketch capacity we produce or accept. */
+static constexpr size_t MAX_SKETCH_CAPACITY{2 << 12};
+
+/** Compute the BIP-330 short ID of a transaction under a peer's reconciliation salt. */
+uint32_t ComputeReconShortID(uint64_t k0, uint64_t k1, const Wtxid& wtxid);
+
+/** Capacity of the sketch a responder sends, given both set sizes and the initiator's q. */
+size_t EstimateSketchCapacity(size_t local_set_size, size_t remote_set_size, double q);
+
+/** Outcome of a reconciliation round, from the initiator's point of view. */
+struct ReconciliationResult {
+    /** Whether the set difference could be decoded. Sent to the responder in reconcildiff. */
+    bool success{false};
+    /** Short IDs of transactions the responder has and we don't, to be requested in reconcildiff. */
+    std::vector<uint32_t> ask_shortids;
+    /** Transactions we have and the responder doesn't, to be announced with inv. */
+    std::vector<Wtxid> announce;
+};
+
+/** Counters describing transaction relay through reconciliation since startup. */
+struct TxReconciliationStats {
+    uint64_t reconciliations_succeeded{0};
+    uint64_t reconciliations_failed{0};
+    uint64_t sketch_bytes_sent{0};
+    uint64_t sketch_bytes_received{0};
+    uint64_t shortid_bytes{0};
+    /** Transactions added to reconciliation sets instead of being announced. */
+    uint64_t txs_reconciled{0};
+    /** Transactions announced after reconciliation found them missing at the peer. */
+    uint64_t txs_announced{0};
+    /** Transactions flooded to reconciling peers (fanout, or full set). */
+    uint64_t txs_flooded{0};
+};
+
 enum class ReconciliationRegisterResult {
     NOT_FOUND,
     SUCCESS,
@@ -84,6 +147,57 @@ public:
      * Check if a peer is registered to reconcile transactions with us.
      */
     bool IsPeerRegistered(NodeId peer_id) const;
+
+    /**
+     * Step 1. Add a transaction we would otherwise announce to the peer's reconciliation set.
+     * Returns false if the transaction should be flooded instead: the peer isn't registered, the
+     * peer is one of the transaction's fanout targets, its set is full, or (as a responder) the
+     * peer isn't requesting reconciliations.
+     */
+    bool AddToSet(NodeId peer_id, const Wtxid& wtxid);
+
+    /**
+     * Step 2 (initiator). If a reconciliation round with this peer is due, start it and return the
+     * contents of the reqrecon message to send: our set size and the q coefficient.
+     */
+    std::optional<std::pair<uint16_t, uint16_t>> InitiateReconciliationRequest(NodeId peer_id, std::chrono::microseconds now);
+
+    /**
+     * Step 2 (responder). Record a reqrecon from the peer, to be answered by
+     * RespondToReconciliationRequest. A request replaces one we haven't answered yet, and a
+     * snapshot the peer never sent reconcildiff for goes back into the set. Returns false on a
+     * protocol violation.
+     */
+    bool HandleReconciliationRequest(NodeId peer_id, uint16_t peer_recon_set_size, uint16_t peer_q, std::chrono::microseconds now);
+
+    /**
+     * Step 2 (responder). If the peer requested a reconciliation, snapshot our set for it and return
+     * the sketch to send.
+     */
+    std::optional<std::vector<uint8_t>> RespondToReconciliationRequest(NodeId peer_id);
+
+    /**
+     * Step 3 (initiator). Combine the peer's sketch with ours and decode the set difference. Our
+     * set is cleared: everything in it is either shared or announced. Returns std::nullopt on a
+     * protocol violation.
+     */
+    std::optional<ReconciliationResult> HandleSketch(NodeId peer_id, std::span<const uint8_t> skdata);
+
+    /**
+     * Step 4 (responder). Process the initiator's reconcildiff and return the transactions from the
+     * snapshot to announce: the requested ones on success, all of them on failure. Returns
+     * std::nullopt on a protocol violation.
+     */
+    std::optional<std::vector<Wtxid>> HandleReconciliationDifference(NodeId peer_id, bool success, std::span<const uint32_t> ask_shortids);
+
+    /**
+     * Return (and forget) the transactions that no reconciliation round is going to cover, to be
+     * announced with inv: the set of an initiator whose request timed out, or the set and snapshot
+     * of a responder whose peer stopped requesting reconciliations.
+     */
+    std::vector<Wtxid> FlushStaleSet(NodeId peer_id, std::chrono::microseconds now);
+
+    TxReconciliationStats GetStats() const;
 };
 
 #endif // QTC_NODE_TXRECONCILIATION_H
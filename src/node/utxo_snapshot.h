@@ -18,11 +18,21 @@
 
 #include <cstdint>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 // UTXO set snapshot magic bytes
 static constexpr std::array<uint8_t, 5> SNAPSHOT_MAGIC_BYTES = {'u', 't', 'x', 'o', 0xff};
 
+// UTXO set snapshot manifest magic bytes
+static constexpr std::array<uint8_t, 5> SNAPSHOT_MANIFEST_MAGIC_BYTES = {'u', 't', 'x', 'o', 0xfe};
+
+//! Maximum number of chunk files of a snapshot. Chunks split the txids by
+//! their first byte.
+static constexpr size_t MAX_SNAPSHOT_CHUNKS{256};
+
 class Chainstate;
 
 namespace node {
@@ -101,6 +111,90 @@ public:
     }
 };
 
+//! Describes a UTXO snapshot split into chunk files that can be written and
+//! loaded in parallel. Each chunk holds the coins of a disjoint range of txids,
+//! in the same format as a single-file snapshot including its metadata.
+//! Like SnapshotMetadata, all fields come from an untrusted file.
+class SnapshotManifest
+{
+    inline static const uint16_t VERSION{2};
+public:
+    struct Chunk {
+        //! Name of the chunk file, in the directory of the manifest.
+        std::string filename;
+        uint64_t coins_count{0};
+        //! Range [begin_byte, end_byte) of the first byte of the txids in the chunk.
+        uint16_t begin_byte{0};
+        uint16_t end_byte{256};
+
+        SERIALIZE_METHODS(Chunk, obj) { READWRITE(obj.filename, obj.coins_count, obj.begin_byte, obj.end_byte); }
+    };
+
+    //! Metadata of the whole snapshot.
+    SnapshotMetadata m_metadata;
+    //! MuHash of all coins in the snapshot, as reported by gettxoutsetinfo.
+    uint256 m_muhash;
+    std::vector<Chunk> m_chunks;
+
+    explicit SnapshotManifest(const MessageStartChars network_magic) : m_metadata{network_magic} {}
+    SnapshotManifest(SnapshotMetadata metadata, const uint256& muhash, std::vector<Chunk> chunks) :
+        m_metadata{std::move(metadata)}, m_muhash{muhash}, m_chunks{std::move(chunks)} {}
+
+    template <typename Stream>
+    inline void Serialize(Stream& s) const {
+        s << SNAPSHOT_MANIFEST_MAGIC_BYTES;
+        s << VERSION;
+        s << m_metadata;
+        s << m_muhash;
+        s << m_chunks;
+    }
+
+    template <typename Stream>
+    inline void Unserialize(Stream& s) {
+        std::array<uint8_t, SNAPSHOT_MANIFEST_MAGIC_BYTES.size()> manifest_magic;
+        s >> manifest_magic;
+        if (manifest_magic != SNAPSHOT_MANIFEST_MAGIC_BYTES) {
+            throw std::ios_base::failure("Invalid UTXO set snapshot manifest magic bytes.");
+        }
+        uint16_t version;
+        s >> version;
+        if (version != VERSION) {
+            throw std::ios_base::failure(strprintf("Version of snapshot manifest %s is not supported.", version));
+        }
+        s >> m_metadata;
+        s >> m_muhash;
+        s >> m_chunks;
+
+        if (m_chunks.empty() || m_chunks.size() > MAX_SNAPSHOT_CHUNKS) {
+            throw std::ios_base::failure(strprintf("Invalid number of snapshot chunks (%d).", m_chunks.size()));
+        }
+        uint64_t coins_count{0};
+        uint16_t next_byte{0};
+        for (const Chunk& chunk : m_chunks) {
+            // Chunks must cover all txids in ascending, non-overlapping ranges,
+            // so that no coin can be in two of them.
+            if (chunk.begin_byte != next_byte || chunk.end_byte <= chunk.begin_byte || chunk.end_byte > 256) {
+                throw std::ios_base::failure("Invalid txid ranges of snapshot chunks.");
+            }
+            next_byte = chunk.end_byte;
+            if (chunk.filename.empty() || chunk.filename == "." || chunk.filename == ".." ||
+                chunk.filename.find_first_of("/\\") != std::string::npos) {
+                throw std::ios_base::failure(strprintf("Invalid snapshot chunk file name \"%s\".", chunk.filename));
+            }
+            if (chunk.coins_count > m_metadata.m_coins_count - coins_count) {
+                throw std::ios_base::failure("Mismatch in coins count in snapshot manifest and its chunks.");
+            }
+            coins_count += chunk.coins_count;
+        }
+        if (coins_count != m_metadata.m_coins_count) {
+            throw std::ios_base::failure("Mismatch in coins count in snapshot manifest and its chunks.");
+        }
+        if (next_byte != 256) {
+            throw std::ios_base::failure("Invalid txid ranges of snapshot chunks.");
+        }
+    }
+};
+
 //! The file in the snapshot chainstate dir which stores the base blockhash. This is
 //! needed to reconstruct snapshot chainstates on init.
 //!
@@ -7,6 +7,7 @@
 
 #include <common/system.h>
 #include <consensus/amount.h>
+#include <hash.h>
 #include <kernel/mempool_entry.h>
 #include <logging.h>
 #include <policy/feerate.h>
@@ -18,6 +19,7 @@
 #include <tinyformat.h>
 #include <uint256.h>
 #include <util/fs.h>
+#include <util/readwritefile.h>
 #include <util/serfloat.h>
 #include <util/time.h>
 
@@ -47,6 +49,20 @@ std::string StringForFeeEstimateHorizon(FeeEstimateHorizon horizon)
     assert(false);
 }
 
+std::string StringForFeeEstimateSizeClass(FeeEstimateSizeClass size_class)
+{
+    switch (size_class) {
+    case FeeEstimateSizeClass::SMALL: return "small";
+    case FeeEstimateSizeClass::LARGE: return "large";
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
+
+FeeEstimateSizeClass FeeEstimateSizeClassForVsize(int64_t vsize)
+{
+    return vsize < LARGE_TX_VSIZE_THRESHOLD ? FeeEstimateSizeClass::SMALL : FeeEstimateSizeClass::LARGE;
+}
+
 namespace {
 
 struct EncodedDoubleFormatter
@@ -64,6 +80,13 @@ struct EncodedDoubleFormatter
     }
 };
 
+/** Types of the records in the fee estimates log */
+enum class FeeLogRecord : uint8_t {
+    BLOCK,        //!< A block was processed: height
+    CONFIRMATION, //!< A tracked tx confirmed: size class, blocks to confirm, feerate
+    FAILURE,      //!< A tracked tx left the mempool unconfirmed: size class, bucket index, blocks ago
+};
+
 } // namespace
 
 /**
@@ -113,6 +136,14 @@ private:
     // transactions still unconfirmed after GetMaxConfirms for each bucket
     std::vector<int> oldUnconfTxs;
 
+    // Number of transactions in the mempool for each bucket X that are unconfirmed
+    // for Y or more (but fewer than GetMaxConfirms) blocks as of the height they were
+    // counted at, so that estimates for many targets do not each sum up unconfTxs.
+    mutable std::vector<std::vector<int>> m_unconf_at_least; // m_unconf_at_least[Y][X]
+    mutable std::optional<unsigned int> m_unconf_at_least_height;
+
+    const std::vector<std::vector<int>>& UnconfAtLeast(unsigned int nBlockHeight) const;
+
     void resizeInMemoryCounters(size_t newbuckets);
 
 public:
@@ -144,6 +175,9 @@ public:
     void removeTx(unsigned int entryHeight, unsigned int nBestSeenHeight,
                   unsigned int bucketIndex, bool inBlock);
 
+    /** Record a transaction that left the mempool unconfirmed after blocksAgo blocks */
+    void RecordFailure(unsigned int blocksAgo, unsigned int bucketIndex);
+
     /** Update our estimates by decaying our historical moving average and updating
         with the data gathered from the current block */
     void UpdateMovingAverages();
@@ -165,7 +199,16 @@ public:
     unsigned int GetMaxConfirms() const { return scale * confAvg.size(); }
 
     /** Write state of estimation data to a file*/
-    void Write(AutoFile& fileout) const;
+    template <typename Stream>
+    void Write(Stream& fileout) const
+    {
+        fileout << Using<EncodedDoubleFormatter>(decay);
+        fileout << scale;
+        fileout << Using<VectorFormatter<EncodedDoubleFormatter>>(m_feerate_avg);
+        fileout << Using<VectorFormatter<EncodedDoubleFormatter>>(txCtAvg);
+        fileout << Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(confAvg);
+        fileout << Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(failAvg);
+    }
 
     /**
      * Read saved state of estimation data from a file and replace all internal data structures and
@@ -201,6 +244,22 @@ void TxConfirmStats::resizeInMemoryCounters(size_t newbuckets) {
         unconfTxs[i].resize(newbuckets);
     }
     oldUnconfTxs.resize(newbuckets);
+    m_unconf_at_least_height.reset();
+}
+
+const std::vector<std::vector<int>>& TxConfirmStats::UnconfAtLeast(unsigned int nBlockHeight) const
+{
+    if (m_unconf_at_least_height == nBlockHeight) return m_unconf_at_least;
+
+    const unsigned int bins = unconfTxs.size();
+    m_unconf_at_least.assign(GetMaxConfirms() + 1, std::vector<int>(buckets.size()));
+    for (unsigned int confct = GetMaxConfirms(); confct-- > 0;) {
+        for (unsigned int j = 0; j < buckets.size(); j++) {
+            m_unconf_at_least[confct][j] = m_unconf_at_least[confct + 1][j] + unconfTxs[(nBlockHeight - confct) % bins][j];
+        }
+    }
+    m_unconf_at_least_height = nBlockHeight;
+    return m_unconf_at_least;
 }
 
 // Roll the unconfirmed txs circular buffer
@@ -210,6 +269,7 @@ void TxConfirmStats::ClearCurrent(unsigned int nBlockHeight)
         oldUnconfTxs[j] += unconfTxs[nBlockHeight % unconfTxs.size()][j];
         unconfTxs[nBlockHeight%unconfTxs.size()][j] = 0;
     }
+    m_unconf_at_least_height.reset();
 }
 
 
@@ -269,11 +329,11 @@ double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
     double partialNum = 0;
 
     bool foundAnswer = false;
-    unsigned int bins = unconfTxs.size();
     bool newBucketRange = true;
     bool passing = true;
     EstimatorBucket passBucket;
     EstimatorBucket failBucket;
+    const auto& unconf_at_least = UnconfAtLeast(nBlockHeight);
 
     // Start counting from highest feerate transactions
     for (int bucket = maxbucketindex; bucket >= 0; --bucket) {
@@ -286,8 +346,8 @@ double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
         partialNum += txCtAvg[bucket];
         totalNum += txCtAvg[bucket];
         failNum += failAvg[periodTarget - 1][bucket];
-        for (unsigned int confct = confTarget; confct < GetMaxConfirms(); confct++)
-            extraNum += unconfTxs[(nBlockHeight - confct) % bins][bucket];
+        if ((unsigned int)confTarget < GetMaxConfirms())
+            extraNum += unconf_at_least[confTarget][bucket];
         extraNum += oldUnconfTxs[bucket];
         // If we have enough transaction data points in this range of buckets,
         // we can test for success
@@ -407,16 +467,6 @@ double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
     return median;
 }
 
-void TxConfirmStats::Write(AutoFile& fileout) const
-{
-    fileout << Using<EncodedDoubleFormatter>(decay);
-    fileout << scale;
-    fileout << Using<VectorFormatter<EncodedDoubleFormatter>>(m_feerate_avg);
-    fileout << Using<VectorFormatter<EncodedDoubleFormatter>>(txCtAvg);
-    fileout << Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(confAvg);
-    fileout << Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(failAvg);
-}
-
 void TxConfirmStats::Read(AutoFile& filein, size_t numBuckets)
 {
     // Read data file and do some very basic sanity checking
@@ -478,6 +528,7 @@ unsigned int TxConfirmStats::NewTx(unsigned int nBlockHeight, double val)
     unsigned int bucketindex = bucketMap.lower_bound(val)->second;
     unsigned int blockIndex = nBlockHeight % unconfTxs.size();
     unconfTxs[blockIndex][bucketindex]++;
+    m_unconf_at_least_height.reset();
     return bucketindex;
 }
 
@@ -509,7 +560,15 @@ void TxConfirmStats::removeTx(unsigned int entryHeight, unsigned int nBestSeenHe
                      blockIndex, bucketindex);
         }
     }
-    if (!inBlock && (unsigned int)blocksAgo >= scale) { // Only counts as a failure if not confirmed for entire period
+    m_unconf_at_least_height.reset();
+    if (!inBlock) {
+        RecordFailure(blocksAgo, bucketindex);
+    }
+}
+
+void TxConfirmStats::RecordFailure(unsigned int blocksAgo, unsigned int bucketindex)
+{
+    if (blocksAgo >= scale) { // Only counts as a failure if not confirmed for entire period
         assert(scale != 0);
         unsigned int periodsAgo = blocksAgo / scale;
         for (size_t i = 0; i < periodsAgo && i < failAvg.size(); i++) {
@@ -529,9 +588,17 @@ bool CBlockPolicyEstimator::_removeTx(const uint256& hash, bool inBlock)
     AssertLockHeld(m_cs_fee_estimator);
     std::map<uint256, TxStatsInfo>::iterator pos = mapMemPoolTxs.find(hash);
     if (pos != mapMemPoolTxs.end()) {
-        feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
-        shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
-        longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+        const TxStatsInfo& info = pos->second;
+        for (HorizonStats* stats : {&m_stats, &m_size_class_stats[static_cast<size_t>(info.sizeClass)]}) {
+            stats->feeStats->removeTx(info.blockHeight, nBestSeenHeight, info.bucketIndex, inBlock);
+            stats->shortStats->removeTx(info.blockHeight, nBestSeenHeight, info.bucketIndex, inBlock);
+            stats->longStats->removeTx(info.blockHeight, nBestSeenHeight, info.bucketIndex, inBlock);
+        }
+        // Log the failure TxConfirmStats::removeTx() recorded, if any
+        const unsigned int blocksAgo = nBestSeenHeight == 0 ? 0 : nBestSeenHeight - info.blockHeight;
+        if (!inBlock && nBestSeenHeight >= info.blockHeight && blocksAgo > 0) {
+            m_pending_log << uint8_t(FeeLogRecord::FAILURE) << uint8_t(info.sizeClass) << info.bucketIndex << blocksAgo;
+        }
         mapMemPoolTxs.erase(hash);
         return true;
     } else {
@@ -539,8 +606,48 @@ bool CBlockPolicyEstimator::_removeTx(const uint256& hash, bool inBlock)
     }
 }
 
+void CBlockPolicyEstimator::RecordBlock(unsigned int nBlockHeight)
+{
+    AssertLockHeld(m_cs_fee_estimator);
+    nBestSeenHeight = nBlockHeight;
+
+    for (HorizonStats* stats : {&m_stats, &m_size_class_stats[0], &m_size_class_stats[1]}) {
+        // Update unconfirmed circular buffer
+        stats->feeStats->ClearCurrent(nBlockHeight);
+        stats->shortStats->ClearCurrent(nBlockHeight);
+        stats->longStats->ClearCurrent(nBlockHeight);
+
+        // Decay all exponential averages
+        stats->feeStats->UpdateMovingAverages();
+        stats->shortStats->UpdateMovingAverages();
+        stats->longStats->UpdateMovingAverages();
+    }
+    m_log_blocks++;
+}
+
+void CBlockPolicyEstimator::RecordConfirmation(FeeEstimateSizeClass size_class, int blocksToConfirm, double feerate)
+{
+    AssertLockHeld(m_cs_fee_estimator);
+    for (HorizonStats* stats : {&m_stats, &m_size_class_stats[static_cast<size_t>(size_class)]}) {
+        stats->feeStats->Record(blocksToConfirm, feerate);
+        stats->shortStats->Record(blocksToConfirm, feerate);
+        stats->longStats->Record(blocksToConfirm, feerate);
+    }
+}
+
+void CBlockPolicyEstimator::RecordFailure(FeeEstimateSizeClass size_class, unsigned int bucketIndex, unsigned int blocksAgo)
+{
+    AssertLockHeld(m_cs_fee_estimator);
+    for (HorizonStats* stats : {&m_stats, &m_size_class_stats[static_cast<size_t>(size_class)]}) {
+        stats->feeStats->RecordFailure(blocksAgo, bucketIndex);
+        stats->shortStats->RecordFailure(blocksAgo, bucketIndex);
+        stats->longStats->RecordFailure(blocksAgo, bucketIndex);
+    }
+}
+
 CBlockPolicyEstimator::CBlockPolicyEstimator(const fs::path& estimation_filepath, const bool read_stale_estimates)
-    : m_estimation_filepath{estimation_filepath}
+    : m_estimation_filepath{estimation_filepath},
+      m_log_filepath{fs::path{estimation_filepath}.replace_extension(".log")}
 {
     static_assert(MIN_BUCKET_FEERATE > 0, "Min feerate must be nonzero");
     size_t bucketIndex = 0;
@@ -553,9 +660,12 @@ CBlockPolicyEstimator::CBlockPolicyEstimator(const fs::path& estimation_filepath
     bucketMap[INF_FEERATE] = bucketIndex;
     assert(bucketMap.size() == buckets.size());
 
-    feeStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
-    shortStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
-    longStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+    for (HorizonStats* stats : {&m_stats, &m_size_class_stats[0], &m_size_class_stats[1]}) {
+        stats->feeStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
+        stats->shortStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
+        stats->longStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+    }
+    static_assert(ALL_FEE_ESTIMATE_SIZE_CLASSES.size() == 2);
 
     AutoFile est_file{fsbridge::fopen(m_estimation_filepath, "rb")};
 
@@ -572,9 +682,80 @@ CBlockPolicyEstimator::CBlockPolicyEstimator(const fs::path& estimation_filepath
 
     if (!Read(est_file)) {
         LogPrintf("Failed to read fee estimates from %s. Continue anyway.\n", fs::PathToString(m_estimation_filepath));
+        return;
+    }
+
+    // Bring the estimates up to date with the updates logged since the file was written.
+    const auto [read_ok, contents] = ReadBinaryFile(m_estimation_filepath);
+    if (read_ok) {
+        LOCK(m_cs_fee_estimator);
+        ReplayLog(Hash(contents));
+        UpdateSmartFeeTables();
     }
 }
 
+void CBlockPolicyEstimator::ReplayLog(const uint256& checkpoint_hash)
+{
+    AssertLockHeld(m_cs_fee_estimator);
+    m_log_checkpoint_hash = checkpoint_hash;
+    m_log_valid = false;
+    m_log_blocks = 0;
+
+    const auto [read_ok, contents] = ReadBinaryFile(m_log_filepath);
+    if (!read_ok) return;
+    DataStream log{MakeByteSpan(contents)};
+
+    unsigned int first_block{0};
+    try {
+        uint256 hash;
+        log >> hash;
+        if (hash != checkpoint_hash) {
+            LogPrintf("%s does not extend %s and is ignored.\n", fs::PathToString(m_log_filepath.filename()), fs::PathToString(m_estimation_filepath.filename()));
+            return;
+        }
+        // Records are applied as they are read. The last one may be incomplete if the node
+        // stopped while appending it, in which case the file is written in full on the next flush.
+        while (!log.empty()) {
+            uint8_t type, size_class;
+            unsigned int height, bucket_index, blocks_ago;
+            int blocks_to_confirm;
+            double feerate;
+            log >> type;
+            switch (FeeLogRecord{type}) {
+            case FeeLogRecord::BLOCK:
+                log >> height;
+                if (height <= nBestSeenHeight) throw std::runtime_error("Block heights must increase");
+                RecordBlock(height);
+                if (first_block == 0) first_block = height;
+                break;
+            case FeeLogRecord::CONFIRMATION:
+                log >> size_class >> blocks_to_confirm >> Using<EncodedDoubleFormatter>(feerate);
+                if (size_class >= ALL_FEE_ESTIMATE_SIZE_CLASSES.size()) throw std::runtime_error("Invalid size class");
+                RecordConfirmation(FeeEstimateSizeClass{size_class}, blocks_to_confirm, feerate);
+                break;
+            case FeeLogRecord::FAILURE:
+                log >> size_class >> bucket_index >> blocks_ago;
+                if (size_class >= ALL_FEE_ESTIMATE_SIZE_CLASSES.size()) throw std::runtime_error("Invalid size class");
+                if (bucket_index >= buckets.size()) throw std::runtime_error("Invalid bucket index");
+                RecordFailure(FeeEstimateSizeClass{size_class}, bucket_index, blocks_ago);
+                break;
+            default:
+                throw std::runtime_error("Unknown record type");
+            }
+        }
+        m_log_valid = true;
+    } catch (const std::exception& e) {
+        LogWarning("Stopped reading fee estimate updates from %s (non-fatal): %s", fs::PathToString(m_log_filepath), e.what());
+    }
+
+    if (first_block != 0) {
+        // The replayed blocks extend the range of the saved data
+        if (historicalFirst == 0) historicalFirst = first_block;
+        historicalBest = nBestSeenHeight;
+    }
+    LogDebug(BCLog::ESTIMATEFEE, "Replayed %u blocks of fee estimate updates from %s\n", m_log_blocks, fs::PathToString(m_log_filepath));
+}
+
 CBlockPolicyEstimator::~CBlockPolicyEstimator() = default;
 
 void CBlockPolicyEstimator::TransactionAddedToMempool(const NewMempoolTransactionInfo& tx, uint64_t /*unused*/)
@@ -627,23 +808,34 @@ void CBlockPolicyEstimator::processTransaction(const NewMempoolTransactionInfo&
 
     // Feerates are stored and reported as QTC-per-kb:
     const CFeeRate feeRate(tx.info.m_fee, tx.info.m_virtual_transaction_size);
-
-    mapMemPoolTxs[hash].blockHeight = txHeight;
-    unsigned int bucketIndex = feeStats->NewTx(txHeight, static_cast<double>(feeRate.GetFeePerK()));
-    mapMemPoolTxs[hash].bucketIndex = bucketIndex;
-    unsigned int bucketIndex2 = shortStats->NewTx(txHeight, static_cast<double>(feeRate.GetFeePerK()));
+    const FeeEstimateSizeClass sizeClass = FeeEstimateSizeClassForVsize(tx.info.m_virtual_transaction_size);
+
+    TxStatsInfo& info = mapMemPoolTxs[hash];
+    info.blockHeight = txHeight;
+    info.sizeClass = sizeClass;
+    unsigned int bucketIndex = m_stats.feeStats->NewTx(txHeight, static_cast<double>(feeRate.GetFeePerK()));
+    info.bucketIndex = bucketIndex;
+    unsigned int bucketIndex2 = m_stats.shortStats->NewTx(txHeight, static_cast<double>(feeRate.GetFeePerK()));
     assert(bucketIndex == bucketIndex2);
-    unsigned int bucketIndex3 = longStats->NewTx(txHeight, static_cast<double>(feeRate.GetFeePerK()));
+    unsigned int bucketIndex3 = m_stats.longStats->NewTx(txHeight, static_cast<double>(feeRate.GetFeePerK()));
     assert(bucketIndex == bucketIndex3);
+    const HorizonStats& classStats = m_size_class_stats[static_cast<size_t>(sizeClass)];
+    for (TxConfirmStats* stats : {classStats.feeStats.get(), classStats.shortStats.get(), classStats.longStats.get()}) {
+        unsigned int classBucketIndex = stats->NewTx(txHeight, static_cast<double>(feeRate.GetFeePerK()));
+        assert(bucketIndex == classBucketIndex);
+    }
 }
 
 bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const RemovedMempoolTransactionInfo& tx)
 {
     AssertLockHeld(m_cs_fee_estimator);
-    if (!_removeTx(tx.info.m_tx->GetHash(), true)) {
+    const auto pos = mapMemPoolTxs.find(tx.info.m_tx->GetHash());
+    if (pos == mapMemPoolTxs.end()) {
         // This transaction wasn't being tracked for fee estimation
         return false;
     }
+    const FeeEstimateSizeClass sizeClass = pos->second.sizeClass;
+    _removeTx(tx.info.m_tx->GetHash(), true);
 
     // How many blocks did it take for miners to include this transaction?
     // blocksToConfirm is 1-based, so a transaction included in the earliest
@@ -659,9 +851,9 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const Remo
     // Feerates are stored and reported as QTC-per-kb:
     CFeeRate feeRate(tx.info.m_fee, tx.info.m_virtual_transaction_size);
 
-    feeStats->Record(blocksToConfirm, static_cast<double>(feeRate.GetFeePerK()));
-    shortStats->Record(blocksToConfirm, static_cast<double>(feeRate.GetFeePerK()));
-    longStats->Record(blocksToConfirm, static_cast<double>(feeRate.GetFeePerK()));
+    RecordConfirmation(sizeClass, blocksToConfirm, static_cast<double>(feeRate.GetFeePerK()));
+    m_pending_log << uint8_t(FeeLogRecord::CONFIRMATION) << uint8_t(sizeClass) << blocksToConfirm
+                  << Using<EncodedDoubleFormatter>(static_cast<double>(feeRate.GetFeePerK()));
     return true;
 }
 
@@ -681,17 +873,10 @@ void CBlockPolicyEstimator::processBlock(const std::vector<RemovedMempoolTransac
     // Must update nBestSeenHeight in sync with ClearCurrent so that
     // calls to removeTx (via processBlockTx) correctly calculate age
     // of unconfirmed txs to remove from tracking.
-    nBestSeenHeight = nBlockHeight;
-
-    // Update unconfirmed circular buffer
-    feeStats->ClearCurrent(nBlockHeight);
-    shortStats->ClearCurrent(nBlockHeight);
-    longStats->ClearCurrent(nBlockHeight);
-
-    // Decay all exponential averages
-    feeStats->UpdateMovingAverages();
-    shortStats->UpdateMovingAverages();
-    longStats->UpdateMovingAverages();
+    // Also update the unconfirmed circular buffers and decay all
+    // exponential averages.
+    RecordBlock(nBlockHeight);
+    m_pending_log << uint8_t(FeeLogRecord::BLOCK) << nBlockHeight;
 
     unsigned int countedTxs = 0;
     // Update averages with data points from current block
@@ -712,6 +897,8 @@ void CBlockPolicyEstimator::processBlock(const std::vector<RemovedMempoolTransac
 
     trackedTxs = 0;
     untrackedTxs = 0;
+
+    UpdateSmartFeeTables();
 }
 
 CFeeRate CBlockPolicyEstimator::estimateFee(int confTarget) const
@@ -725,26 +912,26 @@ CFeeRate CBlockPolicyEstimator::estimateFee(int confTarget) const
 
 CFeeRate CBlockPolicyEstimator::estimateRawFee(int confTarget, double successThreshold, FeeEstimateHorizon horizon, EstimationResult* result) const
 {
+    LOCK(m_cs_fee_estimator);
     TxConfirmStats* stats = nullptr;
     double sufficientTxs = SUFFICIENT_FEETXS;
     switch (horizon) {
     case FeeEstimateHorizon::SHORT_HALFLIFE: {
-        stats = shortStats.get();
+        stats = m_stats.shortStats.get();
         sufficientTxs = SUFFICIENT_TXS_SHORT;
         break;
     }
     case FeeEstimateHorizon::MED_HALFLIFE: {
-        stats = feeStats.get();
+        stats = m_stats.feeStats.get();
         break;
     }
     case FeeEstimateHorizon::LONG_HALFLIFE: {
-        stats = longStats.get();
+        stats = m_stats.longStats.get();
         break;
     }
     } // no default case, so the compiler can warn about missing cases
     assert(stats);
 
-    LOCK(m_cs_fee_estimator);
     // Return failure if trying to analyze a target we're not tracking
     if (confTarget <= 0 || (unsigned int)confTarget > stats->GetMaxConfirms())
         return CFeeRate(0);
@@ -764,13 +951,13 @@ unsigned int CBlockPolicyEstimator::HighestTargetTracked(FeeEstimateHorizon hori
     LOCK(m_cs_fee_estimator);
     switch (horizon) {
     case FeeEstimateHorizon::SHORT_HALFLIFE: {
-        return shortStats->GetMaxConfirms();
+        return m_stats.shortStats->GetMaxConfirms();
     }
     case FeeEstimateHorizon::MED_HALFLIFE: {
-        return feeStats->GetMaxConfirms();
+        return m_stats.feeStats->GetMaxConfirms();
     }
     case FeeEstimateHorizon::LONG_HALFLIFE: {
-        return longStats->GetMaxConfirms();
+        return m_stats.longStats->GetMaxConfirms();
     }
     } // no default case, so the compiler can warn about missing cases
     assert(false);
@@ -797,39 +984,39 @@ unsigned int CBlockPolicyEstimator::HistoricalBlockSpan() const
 unsigned int CBlockPolicyEstimator::MaxUsableEstimate() const
 {
     // Block spans are divided by 2 to make sure there are enough potential failing data points for the estimate
-    return std::min(longStats->GetMaxConfirms(), std::max(BlockSpan(), HistoricalBlockSpan()) / 2);
+    return std::min(m_stats.longStats->GetMaxConfirms(), std::max(BlockSpan(), HistoricalBlockSpan()) / 2);
 }
 
 /** Return a fee estimate at the required successThreshold from the shortest
  * time horizon which tracks confirmations up to the desired target.  If
  * checkShorterHorizon is requested, also allow short time horizon estimates
  * for a lower target to reduce the given answer */
-double CBlockPolicyEstimator::estimateCombinedFee(unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const
+double CBlockPolicyEstimator::estimateCombinedFee(const HorizonStats& stats, unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const
 {
     double estimate = -1;
-    if (confTarget >= 1 && confTarget <= longStats->GetMaxConfirms()) {
+    if (confTarget >= 1 && confTarget <= stats.longStats->GetMaxConfirms()) {
         // Find estimate from shortest time horizon possible
-        if (confTarget <= shortStats->GetMaxConfirms()) { // short horizon
-            estimate = shortStats->EstimateMedianVal(confTarget, SUFFICIENT_TXS_SHORT, successThreshold, nBestSeenHeight, result);
+        if (confTarget <= stats.shortStats->GetMaxConfirms()) { // short horizon
+            estimate = stats.shortStats->EstimateMedianVal(confTarget, SUFFICIENT_TXS_SHORT, successThreshold, nBestSeenHeight, result);
         }
-        else if (confTarget <= feeStats->GetMaxConfirms()) { // medium horizon
-            estimate = feeStats->EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, result);
+        else if (confTarget <= stats.feeStats->GetMaxConfirms()) { // medium horizon
+            estimate = stats.feeStats->EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, result);
         }
         else { // long horizon
-            estimate = longStats->EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, result);
+            estimate = stats.longStats->EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, result);
         }
         if (checkShorterHorizon) {
             EstimationResult tempResult;
             // If a lower confTarget from a more recent horizon returns a lower answer use it.
-            if (confTarget > feeStats->GetMaxConfirms()) {
-                double medMax = feeStats->EstimateMedianVal(feeStats->GetMaxConfirms(), SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, &tempResult);
+            if (confTarget > stats.feeStats->GetMaxConfirms()) {
+                double medMax = stats.feeStats->EstimateMedianVal(stats.feeStats->GetMaxConfirms(), SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, &tempResult);
                 if (medMax > 0 && (estimate == -1 || medMax < estimate)) {
                     estimate = medMax;
                     if (result) *result = tempResult;
                 }
             }
-            if (confTarget > shortStats->GetMaxConfirms()) {
-                double shortMax = shortStats->EstimateMedianVal(shortStats->GetMaxConfirms(), SUFFICIENT_TXS_SHORT, successThreshold, nBestSeenHeight, &tempResult);
+            if (confTarget > stats.shortStats->GetMaxConfirms()) {
+                double shortMax = stats.shortStats->EstimateMedianVal(stats.shortStats->GetMaxConfirms(), SUFFICIENT_TXS_SHORT, successThreshold, nBestSeenHeight, &tempResult);
                 if (shortMax > 0 && (estimate == -1 || shortMax < estimate)) {
                     estimate = shortMax;
                     if (result) *result = tempResult;
@@ -843,15 +1030,15 @@ double CBlockPolicyEstimator::estimateCombinedFee(unsigned int confTarget, doubl
 /** Ensure that for a conservative estimate, the DOUBLE_SUCCESS_PCT is also met
  * at 2 * target for any longer time horizons.
  */
-double CBlockPolicyEstimator::estimateConservativeFee(unsigned int doubleTarget, EstimationResult *result) const
+double CBlockPolicyEstimator::estimateConservativeFee(const HorizonStats& stats, unsigned int doubleTarget, EstimationResult *result) const
 {
     double estimate = -1;
     EstimationResult tempResult;
-    if (doubleTarget <= shortStats->GetMaxConfirms()) {
-        estimate = feeStats->EstimateMedianVal(doubleTarget, SUFFICIENT_FEETXS, DOUBLE_SUCCESS_PCT, nBestSeenHeight, result);
+    if (doubleTarget <= stats.shortStats->GetMaxConfirms()) {
+        estimate = stats.feeStats->EstimateMedianVal(doubleTarget, SUFFICIENT_FEETXS, DOUBLE_SUCCESS_PCT, nBestSeenHeight, result);
     }
-    if (doubleTarget <= feeStats->GetMaxConfirms()) {
-        double longEstimate = longStats->EstimateMedianVal(doubleTarget, SUFFICIENT_FEETXS, DOUBLE_SUCCESS_PCT, nBestSeenHeight, &tempResult);
+    if (doubleTarget <= stats.feeStats->GetMaxConfirms()) {
+        double longEstimate = stats.longStats->EstimateMedianVal(doubleTarget, SUFFICIENT_FEETXS, DOUBLE_SUCCESS_PCT, nBestSeenHeight, &tempResult);
         if (longEstimate > estimate) {
             estimate = longEstimate;
             if (result) *result = tempResult;
@@ -867,9 +1054,9 @@ double CBlockPolicyEstimator::estimateConservativeFee(unsigned int doubleTarget,
  * estimates, however, required the 95% threshold at 2 * target be met for any
  * longer time horizons also.
  */
-CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative) const
+CFeeRate CBlockPolicyEstimator::computeSmartFee(const HorizonStats& stats, int confTarget, FeeCalculation *feeCalc, bool conservative) const
 {
-    LOCK(m_cs_fee_estimator);
+    AssertLockHeld(m_cs_fee_estimator);
 
     if (feeCalc) {
         feeCalc->desiredTarget = confTarget;
@@ -880,7 +1067,7 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
     EstimationResult tempResult;
 
     // Return failure if trying to analyze a target we're not tracking
-    if (confTarget <= 0 || (unsigned int)confTarget > longStats->GetMaxConfirms()) {
+    if (confTarget <= 0 || (unsigned int)confTarget > stats.longStats->GetMaxConfirms()) {
         return CFeeRate(0);  // error condition
     }
 
@@ -914,13 +1101,13 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
      *
      * See: https://github.com/qtc/qtc/issues/11800#issuecomment-349697807
      */
-    double halfEst = estimateCombinedFee(confTarget/2, HALF_SUCCESS_PCT, true, &tempResult);
+    double halfEst = estimateCombinedFee(stats, confTarget/2, HALF_SUCCESS_PCT, true, &tempResult);
     if (feeCalc) {
         feeCalc->est = tempResult;
         feeCalc->reason = FeeReason::HALF_ESTIMATE;
     }
     median = halfEst;
-    double actualEst = estimateCombinedFee(confTarget, SUCCESS_PCT, true, &tempResult);
+    double actualEst = estimateCombinedFee(stats, confTarget, SUCCESS_PCT, true, &tempResult);
     if (actualEst > median) {
         median = actualEst;
         if (feeCalc) {
@@ -928,7 +1115,7 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
             feeCalc->reason = FeeReason::FULL_ESTIMATE;
         }
     }
-    double doubleEst = estimateCombinedFee(2 * confTarget, DOUBLE_SUCCESS_PCT, !conservative, &tempResult);
+    double doubleEst = estimateCombinedFee(stats, 2 * confTarget, DOUBLE_SUCCESS_PCT, !conservative, &tempResult);
     if (doubleEst > median) {
         median = doubleEst;
         if (feeCalc) {
@@ -938,7 +1125,7 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
     }
 
     if (conservative || median == -1) {
-        double consEst =  estimateConservativeFee(2 * confTarget, &tempResult);
+        double consEst =  estimateConservativeFee(stats, 2 * confTarget, &tempResult);
         if (consEst > median) {
             median = consEst;
             if (feeCalc) {
@@ -953,18 +1140,108 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
     return CFeeRate(llround(median));
 }
 
+void CBlockPolicyEstimator::UpdateSmartFeeTables()
+{
+    AssertLockHeld(m_cs_fee_estimator);
+    auto tables = std::make_shared<SmartFeeTables>();
+    const unsigned int maxTarget = m_stats.longStats->GetMaxConfirms();
+    // Targets above the highest usable one get the answer for it (see computeSmartFee), so
+    // only the targets up to it need computing.
+    const unsigned int lastComputed = std::clamp(MaxUsableEstimate(), 1U, maxTarget);
+    for (size_t i = 0; i < tables->economical.size(); i++) {
+        const HorizonStats& stats = i == 0 ? m_stats : m_size_class_stats[i - 1];
+        for (const bool conservative : {false, true}) {
+            SmartFeeTable& table = conservative ? tables->conservative[i] : tables->economical[i];
+            table.resize(maxTarget + 1);
+            for (unsigned int target = 1; target <= maxTarget; target++) {
+                if (target <= lastComputed) {
+                    table[target].first = computeSmartFee(stats, target, &table[target].second, conservative);
+                } else {
+                    table[target] = table[lastComputed];
+                    table[target].second.desiredTarget = target;
+                }
+            }
+        }
+    }
+    LOCK(m_smart_fee_mutex);
+    m_smart_fees = std::move(tables);
+}
+
+CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative,
+                                                 std::optional<FeeEstimateSizeClass> size_class) const
+{
+    if (feeCalc) {
+        feeCalc->desiredTarget = confTarget;
+        feeCalc->returnedTarget = confTarget;
+    }
+
+    const std::shared_ptr<const SmartFeeTables> tables = WITH_LOCK(m_smart_fee_mutex, return m_smart_fees);
+    if (!tables) return CFeeRate(0);
+    const size_t index = size_class ? 1 + static_cast<size_t>(*size_class) : 0;
+    const SmartFeeTable& table = conservative ? tables->conservative[index] : tables->economical[index];
+
+    // Return failure if trying to analyze a target we're not tracking
+    if (confTarget <= 0 || (unsigned int)confTarget >= table.size()) {
+        return CFeeRate(0);  // error condition
+    }
+    if (feeCalc) *feeCalc = table[confTarget].second;
+    return table[confTarget].first;
+}
+
 void CBlockPolicyEstimator::Flush() {
     FlushUnconfirmed();
-    FlushFeeEstimates();
+    FlushFeeEstimates(/*checkpoint=*/true);
 }
 
-void CBlockPolicyEstimator::FlushFeeEstimates()
+void CBlockPolicyEstimator::FlushFeeEstimates(bool checkpoint)
 {
+    LOCK(m_cs_fee_estimator);
+    if (!checkpoint && m_log_valid && m_log_blocks < FEE_LOG_MAX_BLOCKS) {
+        AutoFile log_file{fsbridge::fopen(m_log_filepath, "ab")};
+        try {
+            if (log_file.IsNull()) throw std::runtime_error("Unable to open file");
+            log_file.write(std::span<const std::byte>{m_pending_log.data(), m_pending_log.size()});
+            if (log_file.fclose() != 0) throw std::runtime_error("Unable to close file");
+            m_pending_log.clear();
+            LogPrintf("Flushed fee estimate updates to %s.\n", fs::PathToString(m_log_filepath.filename()));
+            return;
+        } catch (const std::exception& e) {
+            // The log may end in a partial record now; start over from a full write.
+            LogWarning("Unable to append to %s (non-fatal): %s", fs::PathToString(m_log_filepath), e.what());
+        }
+    }
+
+    DataStream estimates;
+    m_log_valid = false;
+    try {
+        WriteEstimates(estimates);
+    } catch (const std::exception&) {
+        LogWarning("Unable to write policy estimator data (non-fatal)");
+        return;
+    }
     AutoFile est_file{fsbridge::fopen(m_estimation_filepath, "wb")};
-    if (est_file.IsNull() || !Write(est_file)) {
+    try {
+        if (est_file.IsNull()) throw std::runtime_error("Unable to open file");
+        est_file.write(std::span<const std::byte>{estimates.data(), estimates.size()});
+        if (est_file.fclose() != 0) throw std::runtime_error("Unable to close file");
+    } catch (const std::exception&) {
         LogPrintf("Failed to write fee estimates to %s. Continue anyway.\n", fs::PathToString(m_estimation_filepath));
-    } else {
-        LogPrintf("Flushed fee estimates to %s.\n", fs::PathToString(m_estimation_filepath.filename()));
+        return;
+    }
+    LogPrintf("Flushed fee estimates to %s.\n", fs::PathToString(m_estimation_filepath.filename()));
+
+    // Start a new log extending the file just written.
+    m_log_checkpoint_hash = Hash(estimates);
+    m_log_blocks = 0;
+    m_pending_log.clear();
+    AutoFile log_file{fsbridge::fopen(m_log_filepath, "wb")};
+    try {
+        if (log_file.IsNull()) throw std::runtime_error("Unable to open file");
+        log_file << m_log_checkpoint_hash;
+        if (log_file.fclose() != 0) throw std::runtime_error("Unable to close file");
+        m_log_valid = true;
+    } catch (const std::exception& e) {
+        LogWarning("Unable to write %s (non-fatal): %s", fs::PathToString(m_log_filepath), e.what());
     }
 }
 
@@ -972,19 +1249,7 @@ bool CBlockPolicyEstimator::Write(AutoFile& fileout) const
 {
     try {
         LOCK(m_cs_fee_estimator);
-        fileout << CURRENT_FEES_FILE_VERSION;
-        fileout << int{0}; // Unused dummy field. Written files may contain any value in [0, 289900]
-        fileout << nBestSeenHeight;
-        if (BlockSpan() > HistoricalBlockSpan()/2) {
-            fileout << firstRecordedHeight << nBestSeenHeight;
-        }
-        else {
-            fileout << historicalFirst << historicalBest;
-        }
-        fileout << Using<VectorFormatter<EncodedDoubleFormatter>>(buckets);
-        feeStats->Write(fileout);
-        shortStats->Write(fileout);
-        longStats->Write(fileout);
+        WriteEstimates(fileout);
     }
     catch (const std::exception&) {
         LogWarning("Unable to write policy estimator data (non-fatal)");
@@ -993,6 +1258,32 @@ bool CBlockPolicyEstimator::Write(AutoFile& fileout) const
     return true;
 }
 
+template <typename Stream>
+void CBlockPolicyEstimator::WriteEstimates(Stream& fileout) const
+{
+    AssertLockHeld(m_cs_fee_estimator);
+    fileout << CURRENT_FEES_FILE_VERSION;
+    fileout << int{0}; // Unused dummy field. Written files may contain any value in [0, 289900]
+    fileout << nBestSeenHeight;
+    if (BlockSpan() > HistoricalBlockSpan()/2) {
+        fileout << firstRecordedHeight << nBestSeenHeight;
+    }
+    else {
+        fileout << historicalFirst << historicalBest;
+    }
+    fileout << Using<VectorFormatter<EncodedDoubleFormatter>>(buckets);
+    m_stats.feeStats->Write(fileout);
+    m_stats.shortStats->Write(fileout);
+    m_stats.longStats->Write(fileout);
+    // Appended, so that older versions still read the stats of all transactions above.
+    fileout << uint8_t(m_size_class_stats.size());
+    for (const HorizonStats& stats : m_size_class_stats) {
+        stats.feeStats->Write(fileout);
+        stats.shortStats->Write(fileout);
+        stats.longStats->Write(fileout);
+    }
+}
+
 bool CBlockPolicyEstimator::Read(AutoFile& filein)
 {
     try {
@@ -1030,6 +1321,26 @@ bool CBlockPolicyEstimator::Read(AutoFile& filein)
             fileShortStats->Read(filein, numBuckets);
             fileLongStats->Read(filein, numBuckets);
 
+            // Files written before estimates were tracked per size class end here.
+            std::array<HorizonStats, ALL_FEE_ESTIMATE_SIZE_CLASSES.size()> fileSizeClassStats;
+            uint8_t numSizeClasses{0};
+            try {
+                filein >> numSizeClasses;
+            } catch (const std::ios_base::failure&) {
+            }
+            if (numSizeClasses != 0 && numSizeClasses != fileSizeClassStats.size()) {
+                throw std::runtime_error("Corrupt estimates file. Unexpected number of size classes");
+            }
+            for (HorizonStats& stats : fileSizeClassStats) {
+                if (numSizeClasses == 0) break;
+                stats.feeStats.reset(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
+                stats.shortStats.reset(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
+                stats.longStats.reset(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+                stats.feeStats->Read(filein, numBuckets);
+                stats.shortStats->Read(filein, numBuckets);
+                stats.longStats->Read(filein, numBuckets);
+            }
+
             // Fee estimates file parsed correctly
             // Copy buckets from file and refresh our bucketmap
             buckets = fileBuckets;
@@ -1039,14 +1350,30 @@ bool CBlockPolicyEstimator::Read(AutoFile& filein)
             }
 
             // Destroy old TxConfirmStats and point to new ones that already reference buckets and bucketMap
-            feeStats = std::move(fileFeeStats);
-            shortStats = std::move(fileShortStats);
-            longStats = std::move(fileLongStats);
+            m_stats.feeStats = std::move(fileFeeStats);
+            m_stats.shortStats = std::move(fileShortStats);
+            m_stats.longStats = std::move(fileLongStats);
+            for (size_t i = 0; i < m_size_class_stats.size(); i++) {
+                HorizonStats& stats = m_size_class_stats[i];
+                if (numSizeClasses != 0) {
+                    stats = std::move(fileSizeClassStats[i]);
+                } else {
+                    // Start the per class history afresh, with the buckets just read.
+                    stats.feeStats.reset(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
+                    stats.shortStats.reset(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
+                    stats.longStats.reset(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+                }
+            }
 
             nBestSeenHeight = nFileBestSeenHeight;
             historicalFirst = nFileHistoricalFirst;
             historicalBest = nFileHistoricalBest;
         }
+        // Any log on disk extends the file it was started from, not necessarily this one.
+        m_log_valid = false;
+        m_log_blocks = 0;
+        m_pending_log.clear();
+        UpdateSmartFeeTables();
     }
     catch (const std::exception& e) {
         LogWarning("Unable to read policy estimator data (non-fatal): %s", e.what());
@@ -8,6 +8,7 @@
 #include <consensus/amount.h>
 #include <policy/feerate.h>
 #include <random.h>
+#include <streams.h>
 #include <sync.h>
 #include <threadsafety.h>
 #include <uint256.h>
@@ -18,6 +19,7 @@
 #include <chrono>
 #include <map>
 #include <memory>
+#include <optional>
 #include <set>
 #include <string>
 #include <vector>
@@ -35,6 +37,11 @@ static constexpr std::chrono::hours MAX_FILE_AGE{60};
 // Whether we allow importing a fee_estimates file older than MAX_FILE_AGE.
 static constexpr bool DEFAULT_ACCEPT_STALE_FEE_ESTIMATES{false};
 
+/** Number of blocks of updates appended to the fee estimates log before
+ * fee_estimates.dat is written in full again and the log restarted.
+ */
+static constexpr unsigned int FEE_LOG_MAX_BLOCKS{144};
+
 class AutoFile;
 class TxConfirmStats;
 struct RemovedMempoolTransactionInfo;
@@ -56,6 +63,26 @@ static constexpr auto ALL_FEE_ESTIMATE_HORIZONS = std::array{
 
 std::string StringForFeeEstimateHorizon(FeeEstimateHorizon horizon);
 
+/* Identifier for the size classes of transactions whose confirmations are
+ * tracked separately, in addition to those of all transactions. Spending a
+ * post-quantum output takes a signature and key of several kilobytes, so such
+ * transactions compete for block space differently from small ones. */
+enum class FeeEstimateSizeClass {
+    SMALL,
+    LARGE,
+};
+
+static constexpr auto ALL_FEE_ESTIMATE_SIZE_CLASSES = std::array{
+    FeeEstimateSizeClass::SMALL,
+    FeeEstimateSizeClass::LARGE,
+};
+
+/** Virtual size from which a transaction is in the LARGE size class */
+static constexpr int64_t LARGE_TX_VSIZE_THRESHOLD{1000};
+
+std::string StringForFeeEstimateSizeClass(FeeEstimateSizeClass size_class);
+FeeEstimateSizeClass FeeEstimateSizeClassForVsize(int64_t vsize);
+
 /* Enumeration of reason for returned fee estimate */
 enum class FeeReason {
     NONE,
@@ -197,6 +224,8 @@ private:
     static constexpr double FEE_SPACING = 1.05;
 
     const fs::path m_estimation_filepath;
+    /** Updates made since fee_estimates.dat was last written in full */
+    const fs::path m_log_filepath;
 public:
     /** Create new BlockPolicyEstimator and initialize stats tracking classes with default values */
     CBlockPolicyEstimator(const fs::path& estimation_filepath, const bool read_stale_estimates);
@@ -205,7 +234,7 @@ public:
     /** Process all the transactions that have been included in a block */
     void processBlock(const std::vector<RemovedMempoolTransactionInfo>& txs_removed_for_block,
                       unsigned int nBlockHeight)
-        EXCLUSIVE_LOCKS_REQUIRED(!m_cs_fee_estimator);
+        EXCLUSIVE_LOCKS_REQUIRED(!m_cs_fee_estimator, !m_smart_fee_mutex);
 
     /** Process a transaction accepted to the mempool*/
     void processTransaction(const NewMempoolTransactionInfo& tx)
@@ -222,10 +251,14 @@ public:
     /** Estimate feerate needed to get be included in a block within confTarget
      *  blocks. If no answer can be given at confTarget, return an estimate at
      *  the closest target where one can be given.  'conservative' estimates are
-     *  valid over longer time horizons also.
+     *  valid over longer time horizons also. If size_class is given, only the
+     *  transactions of that size class are considered.
+     *  Answers are precomputed with every block, so this does not wait for the
+     *  estimator to process one.
      */
-    CFeeRate estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative) const
-        EXCLUSIVE_LOCKS_REQUIRED(!m_cs_fee_estimator);
+    CFeeRate estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative,
+                              std::optional<FeeEstimateSizeClass> size_class = std::nullopt) const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_smart_fee_mutex);
 
     /** Return a specific fee estimate calculation with a given success
      * threshold and time horizon, and optionally return detailed data about
@@ -241,7 +274,7 @@ public:
 
     /** Read estimation data from a file */
     bool Read(AutoFile& filein)
-        EXCLUSIVE_LOCKS_REQUIRED(!m_cs_fee_estimator);
+        EXCLUSIVE_LOCKS_REQUIRED(!m_cs_fee_estimator, !m_smart_fee_mutex);
 
     /** Empty mempool transactions on shutdown to record failure to confirm for txs still in mempool */
     void FlushUnconfirmed()
@@ -255,8 +288,12 @@ public:
     void Flush()
         EXCLUSIVE_LOCKS_REQUIRED(!m_cs_fee_estimator);
 
-    /** Record current fee estimations. */
-    void FlushFeeEstimates()
+    /** Record current fee estimations. Only the updates made since the last
+     *  flush are appended to the log, unless checkpoint is set, the log has
+     *  grown to FEE_LOG_MAX_BLOCKS or it does not belong to the current
+     *  fee_estimates.dat, in which case that file is written in full and a new
+     *  log started. */
+    void FlushFeeEstimates(bool checkpoint = false)
         EXCLUSIVE_LOCKS_REQUIRED(!m_cs_fee_estimator);
 
     /** Calculates the age of the file, since last modified */
@@ -269,7 +306,7 @@ protected:
     void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason /*unused*/, uint64_t /*unused*/) override
         EXCLUSIVE_LOCKS_REQUIRED(!m_cs_fee_estimator);
     void MempoolTransactionsRemovedForBlock(const std::vector<RemovedMempoolTransactionInfo>& txs_removed_for_block, unsigned int nBlockHeight) override
-        EXCLUSIVE_LOCKS_REQUIRED(!m_cs_fee_estimator);
+        EXCLUSIVE_LOCKS_REQUIRED(!m_cs_fee_estimator, !m_smart_fee_mutex);
 
 private:
     mutable Mutex m_cs_fee_estimator;
@@ -283,16 +320,43 @@ private:
     {
         unsigned int blockHeight{0};
         unsigned int bucketIndex{0};
+        FeeEstimateSizeClass sizeClass{FeeEstimateSizeClass::SMALL};
         TxStatsInfo() = default;
     };
 
     // map of txids to information about that transaction
     std::map<uint256, TxStatsInfo> mapMemPoolTxs GUARDED_BY(m_cs_fee_estimator);
 
-    /** Classes to track historical data on transaction confirmations */
-    std::unique_ptr<TxConfirmStats> feeStats PT_GUARDED_BY(m_cs_fee_estimator);
-    std::unique_ptr<TxConfirmStats> shortStats PT_GUARDED_BY(m_cs_fee_estimator);
-    std::unique_ptr<TxConfirmStats> longStats PT_GUARDED_BY(m_cs_fee_estimator);
+    /** Classes to track historical data on the confirmations of one set of transactions,
+     * for each time horizon */
+    struct HorizonStats {
+        std::unique_ptr<TxConfirmStats> feeStats;
+        std::unique_ptr<TxConfirmStats> shortStats;
+        std::unique_ptr<TxConfirmStats> longStats;
+    };
+    /** Stats of all transactions */
+    HorizonStats m_stats GUARDED_BY(m_cs_fee_estimator);
+    /** Stats of the transactions of each size class */
+    std::array<HorizonStats, ALL_FEE_ESTIMATE_SIZE_CLASSES.size()> m_size_class_stats GUARDED_BY(m_cs_fee_estimator);
+
+    /** Hash of the fee_estimates.dat the log on disk extends */
+    uint256 m_log_checkpoint_hash GUARDED_BY(m_cs_fee_estimator);
+    /** Whether the log on disk extends the current fee_estimates.dat and ends with a complete record */
+    bool m_log_valid GUARDED_BY(m_cs_fee_estimator){false};
+    /** Number of blocks recorded since fee_estimates.dat was last written in full */
+    unsigned int m_log_blocks GUARDED_BY(m_cs_fee_estimator){0};
+    /** Records of the updates not yet appended to the log */
+    DataStream m_pending_log GUARDED_BY(m_cs_fee_estimator);
+
+    /** estimateSmartFee() answers for one set of transactions and mode, indexed by target */
+    using SmartFeeTable = std::vector<std::pair<CFeeRate, FeeCalculation>>;
+    struct SmartFeeTables {
+        /** Index 0 is for all transactions, the others for each size class */
+        std::array<SmartFeeTable, 1 + ALL_FEE_ESTIMATE_SIZE_CLASSES.size()> economical;
+        std::array<SmartFeeTable, 1 + ALL_FEE_ESTIMATE_SIZE_CLASSES.size()> conservative;
+    };
+    mutable Mutex m_smart_fee_mutex;
+    std::shared_ptr<const SmartFeeTables> m_smart_fees GUARDED_BY(m_smart_fee_mutex);
 
     unsigned int trackedTxs GUARDED_BY(m_cs_fee_estimator){0};
     unsigned int untrackedTxs GUARDED_BY(m_cs_fee_estimator){0};
@@ -303,10 +367,14 @@ private:
     /** Process a transaction confirmed in a block*/
     bool processBlockTx(unsigned int nBlockHeight, const RemovedMempoolTransactionInfo& tx) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
 
-    /** Helper for estimateSmartFee */
-    double estimateCombinedFee(unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
-    /** Helper for estimateSmartFee */
-    double estimateConservativeFee(unsigned int doubleTarget, EstimationResult *result) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    /** Helper for computeSmartFee */
+    double estimateCombinedFee(const HorizonStats& stats, unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    /** Helper for computeSmartFee */
+    double estimateConservativeFee(const HorizonStats& stats, unsigned int doubleTarget, EstimationResult *result) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    /** Calculation behind estimateSmartFee for one set of transactions */
+    CFeeRate computeSmartFee(const HorizonStats& stats, int confTarget, FeeCalculation *feeCalc, bool conservative) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    /** Recompute the answers estimateSmartFee gives */
+    void UpdateSmartFeeTables() EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator, !m_smart_fee_mutex);
     /** Number of blocks of data recorded while fee estimates have been running */
     unsigned int BlockSpan() const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
     /** Number of blocks of recorded fee estimate data represented in saved data file */
@@ -317,6 +385,17 @@ private:
     /** A non-thread-safe helper for the removeTx function */
     bool _removeTx(const uint256& hash, bool inBlock)
         EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+
+    /** Updates of the stats, shared between processing and replaying them from the log */
+    void RecordBlock(unsigned int nBlockHeight) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    void RecordConfirmation(FeeEstimateSizeClass size_class, int blocksToConfirm, double feerate) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    void RecordFailure(FeeEstimateSizeClass size_class, unsigned int bucketIndex, unsigned int blocksAgo) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+
+    /** Serialize the estimation data, as written to fee_estimates.dat */
+    template <typename Stream>
+    void WriteEstimates(Stream& s) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    /** Apply the log on disk, if it extends the fee_estimates.dat with the given hash */
+    void ReplayLog(const uint256& checkpoint_hash) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
 };
 
 class FeeFilterRounder
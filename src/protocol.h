@@ -264,6 +264,35 @@ inline constexpr const char* WTXIDRELAY{"wtxidrelay"};
  * txreconciliation, as described by BIP 330.
  */
 inline constexpr const char* SENDTXRCNCL{"sendtxrcncl"};
+/**
+ * Sent by a reconciliation initiator to request a sketch of the responder's
+ * reconciliation set. Contains the initiator's set size and the q coefficient,
+ * as described by BIP 330.
+ */
+inline constexpr const char* REQRECON{"reqrecon"};
+/**
+ * The responder's sketch of its reconciliation set, as described by BIP 330.
+ */
+inline constexpr const char* SKETCH{"sketch"};
+/**
+ * Sent by the initiator once it decoded (or failed to decode) the set difference.
+ * Contains a success flag and the short IDs of transactions it wants announced,
+ * as described by BIP 330.
+ */
+inline constexpr const char* RECONCILDIFF{"reconcildiff"};
+/**
+ * Indicates that a node wants wtxid announcements to carry the announcer's
+ * view of each transaction's virtual size and fee, via INVHINTS. Like
+ * WTXIDRELAY, it must be sent between VERSION and VERACK.
+ */
+inline constexpr const char* SENDINVHINTS{"sendinvhints"};
+/**
+ * Announces transactions by wtxid together with their virtual size and fee.
+ * Sent instead of transaction INVs to wtxid relay peers that sent
+ * SENDINVHINTS, so they can schedule downloads of high-feerate transactions
+ * ahead of others.
+ */
+inline constexpr const char* INVHINTS{"invhints"};
 /**
  * PQ-Noise handshake message types.
  */
@@ -309,6 +338,11 @@ inline const std::array ALL_NET_MESSAGE_TYPES{std::to_array<std::string>({
     NetMsgType::CFCHECKPT,
     NetMsgType::WTXIDRELAY,
     NetMsgType::SENDTXRCNCL,
+    NetMsgType::REQRECON,
+    NetMsgType::SKETCH,
+    NetMsgType::RECONCILDIFF,
+    NetMsgType::SENDINVHINTS,
+    NetMsgType::INVHINTS,
     NetMsgType::PQ_CLIENTHELLO,
     NetMsgType::PQ_SERVERHELLO,
     NetMsgType::PQ_CLIENTKEM,
@@ -540,4 +574,16 @@ public:
 /** Convert a TX/WITNESS_TX/WTX CInv to a GenTxid. */
 GenTxid ToGenTxid(const CInv& inv);
 
+/** A wtxid announcement with the announcer's view of the transaction's
+ * virtual size and fee (see NetMsgType::INVHINTS). The size and fee are not
+ * verified until the transaction is received, so they must only be used for
+ * scheduling the download. */
+struct TxInvHint {
+    uint256 wtxid;
+    uint32_t vsize{0};
+    int64_t fee{0};
+
+    SERIALIZE_METHODS(TxInvHint, obj) { READWRITE(obj.wtxid, VARINT(obj.vsize), VARINT_MODE(obj.fee, VarIntMode::NONNEGATIVE_SIGNED)); }
+};
+
 #endif // QTC_PROTOCOL_H
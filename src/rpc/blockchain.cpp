@@ -12,10 +12,12 @@
 #include <clientversion.h>
 #include <coins.h>
 #include <common/args.h>
+#include <common/system.h>
 #include <consensus/amount.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <crypto/muhash.h>
 #include <deploymentinfo.h>
 #include <deploymentstatus.h>
 #include <flatfile.h>
@@ -47,6 +49,8 @@
 #include <util/check.h>
 #include <util/fs.h>
 #include <util/strencodings.h>
+#include <util/thread.h>
+#include <util/time.h>
 #include <util/translation.h>
 #include <validation.h>
 #include <validationinterface.h>
@@ -54,13 +58,21 @@
 
 #include <cstdint>
 
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <exception>
 #include <iterator>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <span>
+#include <thread>
+#include <tuple>
 #include <vector>
 
+using kernel::ApplyCoinHash;
 using kernel::CCoinsStats;
 using kernel::CoinStatsHashType;
 
@@ -68,6 +80,7 @@ using interfaces::BlockRef;
 using interfaces::Mining;
 using node::BlockManager;
 using node::NodeContext;
+using node::SnapshotManifest;
 using node::SnapshotMetadata;
 using util::MakeUnorderedList;
 
@@ -87,6 +100,16 @@ UniValue WriteUTXOSnapshot(
     const fs::path& temppath,
     const std::function<void()>& interruption_point = {});
 
+UniValue WriteUTXOSnapshotChunks(
+    Chainstate& chainstate,
+    std::span<const std::unique_ptr<CCoinsViewCursor>> cursors,
+    const CCoinsStats& stats,
+    const CBlockIndex* tip,
+    AutoFile& afile,
+    const fs::path& path,
+    const fs::path& temppath,
+    const std::function<void()>& interruption_point = {});
+
 /* Calculate the difficulty for a given block index.
  */
 double GetDifficulty(const CBlockIndex& blockindex)
@@ -1158,7 +1181,6 @@ static RPCHelpMan gettxout()
 {
     NodeContext& node = EnsureAnyNodeContext(request.context);
     ChainstateManager& chainman = EnsureChainman(node);
-    LOCK(cs_main);
 
     UniValue ret(UniValue::VOBJ);
 
@@ -1168,21 +1190,24 @@ static RPCHelpMan gettxout()
     if (!request.params[2].isNull())
         fMempool = request.params[2].get_bool();
 
+    // The shared coins cache can be read without cs_main.
     Chainstate& active_chainstate = chainman.ActiveChainstate();
-    CCoinsViewCache* coins_view = &active_chainstate.CoinsTip();
+    CCoinsViewShardedCache& coins_view = active_chainstate.CoinsShared();
 
     std::optional<Coin> coin;
+    uint256 best_block;
     if (fMempool) {
         const CTxMemPool& mempool = EnsureMemPool(node);
         LOCK(mempool.cs);
-        CCoinsViewMemPool view(coins_view, mempool);
+        CCoinsViewMemPool view(&coins_view, mempool);
         if (!mempool.isSpent(out)) coin = view.GetCoin(out);
+        best_block = coins_view.GetBestBlock();
     } else {
-        coin = coins_view->GetCoin(out);
+        std::tie(coin, best_block) = coins_view.GetCoinAtBestBlock(out);
     }
     if (!coin) return UniValue::VNULL;
 
-    const CBlockIndex* pindex = active_chainstate.m_blockman.LookupBlockIndex(coins_view->GetBestBlock());
+    const CBlockIndex* pindex = WITH_LOCK(cs_main, return active_chainstate.m_blockman.LookupBlockIndex(best_block));
     ret.pushKV("bestblock", pindex->GetBlockHash().GetHex());
     if (coin->nHeight == MEMPOOL_HEIGHT) {
         ret.pushKV("confirmations", 0);
@@ -2969,6 +2994,20 @@ public:
     };
 };
 
+//! Path of chunk i of a snapshot split into chunks, next to its manifest at path.
+static fs::path SnapshotChunkPath(const fs::path& path, int i)
+{
+    return fs::u8path(path.utf8string() + strprintf(".%d", i));
+}
+
+//! Lowest first byte of the txids in chunk i of a snapshot split into
+//! num_chunks chunks, as chunks split the coins by the first byte of their
+//! txid in key order. Returns 256 for i == num_chunks.
+static unsigned int SnapshotChunkStart(int i, int num_chunks)
+{
+    return i * 256 / num_chunks;
+}
+
 /**
  * Serialize the UTXO set to a file for loading elsewhere.
  *
@@ -2990,6 +3029,9 @@ static RPCHelpMan dumptxoutset()
                     {"rollback", RPCArg::Type::NUM, RPCArg::Optional::OMITTED,
                         "Height or hash of the block to roll back to before creating the snapshot. Note: The further this number is from the tip, the longer this process will take. Consider setting a higher -rpcclienttimeout value in this case.",
                     RPCArgOptions{.skip_type_check = true, .type_str = {"", "string or numeric"}}},
+                    {"chunks", RPCArg::Type::NUM, RPCArg::Default{1},
+                        strprintf("Split the snapshot into this many files (at most %d), which are written and loaded in parallel. "
+                        "The file at path is then a manifest, which can be passed to loadtxoutset, and the chunks are written next to it as <path>.<n>.", MAX_SNAPSHOT_CHUNKS)},
                 },
             },
         },
@@ -3002,12 +3044,15 @@ static RPCHelpMan dumptxoutset()
                     {RPCResult::Type::STR, "path", "the absolute path that the snapshot was written to"},
                     {RPCResult::Type::STR_HEX, "txoutset_hash", "the hash of the UTXO set contents"},
                     {RPCResult::Type::NUM, "nchaintx", "the number of transactions in the chain up to and including the base block"},
+                    {RPCResult::Type::NUM, "chunks", /*optional=*/true, "the number of chunk files the snapshot was split into"},
+                    {RPCResult::Type::STR_HEX, "txoutset_muhash", /*optional=*/true, "the MuHash of the UTXO set contents, when split into chunks"},
                 }
         },
         RPCExamples{
             HelpExampleCli("-rpcclienttimeout=0 dumptxoutset", "utxo.dat latest") +
             HelpExampleCli("-rpcclienttimeout=0 dumptxoutset", "utxo.dat rollback") +
-            HelpExampleCli("-rpcclienttimeout=0 -named dumptxoutset", R"(utxo.dat rollback=853456)")
+            HelpExampleCli("-rpcclienttimeout=0 -named dumptxoutset", R"(utxo.dat rollback=853456)") +
+            HelpExampleCli("-rpcclienttimeout=0 -named dumptxoutset", R"(utxo.dat latest chunks=16)")
         },
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
 {
@@ -3016,6 +3061,10 @@ static RPCHelpMan dumptxoutset()
     const CBlockIndex* target_index{nullptr};
     const std::string snapshot_type{self.Arg<std::string>("type")};
     const UniValue options{request.params[2].isNull() ? UniValue::VOBJ : request.params[2]};
+    const int num_chunks{options.exists("chunks") ? options["chunks"].getInt<int>() : 1};
+    if (num_chunks < 1 || num_chunks > int{MAX_SNAPSHOT_CHUNKS}) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid number of chunks %d, must be between 1 and %d", num_chunks, MAX_SNAPSHOT_CHUNKS));
+    }
     if (options.exists("rollback")) {
         if (!snapshot_type.empty() && snapshot_type != "rollback") {
             throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid snapshot type \"%s\" specified with rollback option", snapshot_type));
@@ -3044,6 +3093,14 @@ static RPCHelpMan dumptxoutset()
             path.utf8string() + " already exists. If you are sure this is what you want, "
             "move it out of the way first");
     }
+    for (int i{0}; num_chunks > 1 && i < num_chunks; ++i) {
+        if (fs::exists(SnapshotChunkPath(path, i))) {
+            throw JSONRPCError(
+                RPC_INVALID_PARAMETER,
+                SnapshotChunkPath(path, i).utf8string() + " already exists. If you are sure this is what you want, "
+                "move it out of the way first");
+        }
+    }
 
     FILE* file{fsbridge::fopen(temppath, "wb")};
     AutoFile afile{file};
@@ -3090,6 +3147,7 @@ static RPCHelpMan dumptxoutset()
 
     Chainstate* chainstate;
     std::unique_ptr<CCoinsViewCursor> cursor;
+    std::vector<std::unique_ptr<CCoinsViewCursor>> chunk_cursors;
     CCoinsStats stats;
     {
         // Lock the chainstate before calling PrepareUtxoSnapshot, to be able
@@ -3111,10 +3169,19 @@ static RPCHelpMan dumptxoutset()
             throw JSONRPCError(RPC_MISC_ERROR, "Could not roll back to requested height.");
         } else {
             std::tie(cursor, stats, tip) = PrepareUTXOSnapshot(*chainstate, node.rpc_interruption_point);
+            // Like the cursor above, these iterate over the coinsdb as of
+            // now, since it cannot be written to while cs_main is held.
+            for (int i{0}; num_chunks > 1 && i < num_chunks; ++i) {
+                uint256 start;
+                start.data()[0] = SnapshotChunkStart(i, num_chunks);
+                chunk_cursors.push_back(chainstate->CoinsDB().Cursor(COutPoint{Txid::FromUint256(start), 0}));
+            }
         }
     }
 
-    UniValue result = WriteUTXOSnapshot(*chainstate, cursor.get(), &stats, tip, afile, path, temppath, node.rpc_interruption_point);
+    UniValue result = num_chunks > 1 ?
+        WriteUTXOSnapshotChunks(*chainstate, chunk_cursors, stats, tip, afile, path, temppath, node.rpc_interruption_point) :
+        WriteUTXOSnapshot(*chainstate, cursor.get(), &stats, tip, afile, path, temppath, node.rpc_interruption_point);
     fs::rename(temppath, path);
 
     result.pushKV("path", path.utf8string());
@@ -3161,29 +3228,25 @@ PrepareUTXOSnapshot(
     return {std::move(pcursor), *CHECK_NONFATAL(maybe_stats), tip};
 }
 
-UniValue WriteUTXOSnapshot(
-    Chainstate& chainstate,
-    CCoinsViewCursor* pcursor,
-    CCoinsStats* maybe_stats,
-    const CBlockIndex* tip,
+/**
+ * Write the coins of cursor to afile in the snapshot format, stopping at the
+ * first coin whose txid starts with a byte of at least end_byte, and hash
+ * them into muhash if set.
+ *
+ * @returns the number of coins written
+ */
+static uint64_t WriteSnapshotCoins(
     AutoFile& afile,
-    const fs::path& path,
-    const fs::path& temppath,
+    CCoinsViewCursor& cursor,
+    unsigned int end_byte,
+    MuHash3072* muhash,
     const std::function<void()>& interruption_point)
 {
-    LOG_TIME_SECONDS(strprintf("writing UTXO snapshot at height %s (%s) to file %s (via %s)",
-        tip->nHeight, tip->GetBlockHash().ToString(),
-        fs::PathToString(path), fs::PathToString(temppath)));
-
-    SnapshotMetadata metadata{chainstate.m_chainman.GetParams().MessageStart(), tip->GetBlockHash(), maybe_stats->coins_count};
-
-    afile << metadata;
-
     COutPoint key;
     Txid last_hash;
     Coin coin;
     unsigned int iter{0};
-    size_t written_coins_count{0};
+    uint64_t written_coins_count{0};
     std::vector<std::pair<uint32_t, Coin>> coins;
 
     // To reduce space the serialization format of the snapshot avoids
@@ -3193,7 +3256,7 @@ UniValue WriteUTXOSnapshot(
     // (key.hash) and when we have them all (key.hash != last_hash) we write
     // them to file using the below lambda function.
     // See also https://github.com/qtc/qtc/issues/25675
-    auto write_coins_to_file = [&](AutoFile& afile, const Txid& last_hash, const std::vector<std::pair<uint32_t, Coin>>& coins, size_t& written_coins_count) {
+    auto write_coins_to_file = [&](AutoFile& afile, const Txid& last_hash, const std::vector<std::pair<uint32_t, Coin>>& coins, uint64_t& written_coins_count) {
         afile << last_hash;
         WriteCompactSize(afile, coins.size());
         for (const auto& [n, coin] : coins) {
@@ -3203,25 +3266,49 @@ UniValue WriteUTXOSnapshot(
         }
     };
 
-    pcursor->GetKey(key);
+    cursor.GetKey(key);
     last_hash = key.hash;
-    while (pcursor->Valid()) {
+    while (cursor.Valid()) {
         if (iter % 5000 == 0) interruption_point();
         ++iter;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+        if (cursor.GetKey(key) && cursor.GetValue(coin)) {
+            if (std::to_integer<unsigned int>(key.hash.begin()[0]) >= end_byte) break;
             if (key.hash != last_hash) {
                 write_coins_to_file(afile, last_hash, coins, written_coins_count);
                 last_hash = key.hash;
                 coins.clear();
             }
+            if (muhash) ApplyCoinHash(*muhash, key, coin);
             coins.emplace_back(key.n, coin);
         }
-        pcursor->Next();
+        cursor.Next();
     }
 
     if (!coins.empty()) {
         write_coins_to_file(afile, last_hash, coins, written_coins_count);
     }
+    return written_coins_count;
+}
+
+UniValue WriteUTXOSnapshot(
+    Chainstate& chainstate,
+    CCoinsViewCursor* pcursor,
+    CCoinsStats* maybe_stats,
+    const CBlockIndex* tip,
+    AutoFile& afile,
+    const fs::path& path,
+    const fs::path& temppath,
+    const std::function<void()>& interruption_point)
+{
+    LOG_TIME_SECONDS(strprintf("writing UTXO snapshot at height %s (%s) to file %s (via %s)",
+        tip->nHeight, tip->GetBlockHash().ToString(),
+        fs::PathToString(path), fs::PathToString(temppath)));
+
+    SnapshotMetadata metadata{chainstate.m_chainman.GetParams().MessageStart(), tip->GetBlockHash(), maybe_stats->coins_count};
+
+    afile << metadata;
+
+    const uint64_t written_coins_count{WriteSnapshotCoins(afile, *pcursor, /*end_byte=*/256, /*muhash=*/nullptr, interruption_point)};
 
     CHECK_NONFATAL(written_coins_count == maybe_stats->coins_count);
 
@@ -3237,6 +3324,107 @@ UniValue WriteUTXOSnapshot(
     return result;
 }
 
+UniValue WriteUTXOSnapshotChunks(
+    Chainstate& chainstate,
+    std::span<const std::unique_ptr<CCoinsViewCursor>> cursors,
+    const CCoinsStats& stats,
+    const CBlockIndex* tip,
+    AutoFile& afile,
+    const fs::path& path,
+    const fs::path& temppath,
+    const std::function<void()>& interruption_point)
+{
+    const int num_chunks{static_cast<int>(cursors.size())};
+    LOG_TIME_SECONDS(strprintf("writing UTXO snapshot at height %s (%s) to %d chunks of %s (via %s)",
+        tip->nHeight, tip->GetBlockHash().ToString(), num_chunks,
+        fs::PathToString(path), fs::PathToString(temppath)));
+
+    const MessageStartChars message_start{chainstate.m_chainman.GetParams().MessageStart()};
+    std::vector<SnapshotManifest::Chunk> chunks(num_chunks);
+    std::vector<MuHash3072> muhashes(num_chunks);
+    std::vector<std::exception_ptr> errors(num_chunks);
+    std::atomic<int> next_chunk{0};
+
+    // Each chunk starts with its own metadata, whose coins count is filled in
+    // once the chunk has been written.
+    const auto write_chunks{[&] {
+        for (int i{next_chunk++}; i < num_chunks; i = next_chunk++) {
+            try {
+                const fs::path chunk_temppath{SnapshotChunkPath(temppath, i)};
+                AutoFile chunk_file{fsbridge::fopen(chunk_temppath, "wb")};
+                if (chunk_file.IsNull()) {
+                    throw JSONRPCError(RPC_MISC_ERROR, "Couldn't open file " + chunk_temppath.utf8string() + " for writing.");
+                }
+                chunk_file << SnapshotMetadata{message_start, tip->GetBlockHash(), 0};
+                chunks[i].coins_count = WriteSnapshotCoins(chunk_file, *cursors[i], SnapshotChunkStart(i + 1, num_chunks), &muhashes[i], interruption_point);
+                chunk_file.seek(0, SEEK_SET);
+                chunk_file << SnapshotMetadata{message_start, tip->GetBlockHash(), chunks[i].coins_count};
+                if (chunk_file.fclose() != 0) {
+                    throw JSONRPCError(RPC_MISC_ERROR, "Failed to write " + chunk_temppath.utf8string());
+                }
+                chunks[i].filename = fs::PathToString(SnapshotChunkPath(path, i).filename());
+                chunks[i].begin_byte = SnapshotChunkStart(i, num_chunks);
+                chunks[i].end_byte = SnapshotChunkStart(i + 1, num_chunks);
+            } catch (...) {
+                errors[i] = std::current_exception();
+                // Give up on the chunks no thread has started yet.
+                next_chunk = num_chunks;
+            }
+        }
+    }};
+    std::vector<std::thread> threads;
+    for (int n{0}; n < std::clamp(GetNumCores(), 1, num_chunks); ++n) {
+        threads.emplace_back(&util::TraceThread, strprintf("snapdump.%i", n), write_chunks);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    uint64_t written_coins_count{0};
+    uint256 muhash_out;
+    try {
+        for (const std::exception_ptr& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+
+        MuHash3072 muhash;
+        for (int i{0}; i < num_chunks; ++i) {
+            written_coins_count += chunks[i].coins_count;
+            muhash *= muhashes[i];
+        }
+        CHECK_NONFATAL(written_coins_count == stats.coins_count);
+        muhash.Finalize(muhash_out);
+
+        afile << SnapshotManifest{SnapshotMetadata{message_start, tip->GetBlockHash(), written_coins_count}, muhash_out, std::move(chunks)};
+        if (afile.fclose() != 0) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Failed to write " + temppath.utf8string());
+        }
+    } catch (...) {
+        // Do not leave the partial manifest and chunks of a failed dump behind.
+        afile.fclose();
+        std::error_code ec;
+        fs::remove(temppath, ec);
+        for (int i{0}; i < num_chunks; ++i) {
+            fs::remove(SnapshotChunkPath(temppath, i), ec);
+        }
+        throw;
+    }
+    for (int i{0}; i < num_chunks; ++i) {
+        fs::rename(SnapshotChunkPath(temppath, i), SnapshotChunkPath(path, i));
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("coins_written", written_coins_count);
+    result.pushKV("base_hash", tip->GetBlockHash().ToString());
+    result.pushKV("base_height", tip->nHeight);
+    result.pushKV("path", path.utf8string());
+    result.pushKV("txoutset_hash", stats.hashSerialized.ToString());
+    result.pushKV("nchaintx", tip->m_chain_tx_count);
+    result.pushKV("chunks", num_chunks);
+    result.pushKV("txoutset_muhash", muhash_out.ToString());
+    return result;
+}
+
 UniValue CreateUTXOSnapshot(
     node::NodeContext& node,
     Chainstate& chainstate,
@@ -3270,7 +3458,7 @@ static RPCHelpMan loadtxoutset()
             {"path",
                 RPCArg::Type::STR,
                 RPCArg::Optional::NO,
-                "path to the snapshot file. If relative, will be prefixed by datadir."},
+                "path to the snapshot file, or to the manifest of a snapshot split into chunks by dumptxoutset. If relative, will be prefixed by datadir."},
         },
         RPCResult{
             RPCResult::Type::OBJ, "", "",
@@ -3298,14 +3486,48 @@ static RPCHelpMan loadtxoutset()
             "Couldn't open file " + path.utf8string() + " for reading.");
     }
 
-    SnapshotMetadata metadata{chainman.GetParams().MessageStart()};
+    // A snapshot split into chunks is loaded through its manifest.
+    bool is_manifest{false};
     try {
-        afile >> metadata;
-    } catch (const std::ios_base::failure& e) {
-        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("Unable to parse metadata: %s", e.what()));
-    }
-
-    auto activation_result{chainman.ActivateSnapshot(afile, metadata, false)};
+        std::array<uint8_t, SNAPSHOT_MANIFEST_MAGIC_BYTES.size()> magic;
+        afile >> magic;
+        is_manifest = magic == SNAPSHOT_MANIFEST_MAGIC_BYTES;
+    } catch (const std::ios_base::failure&) {
+        // Too short for either format, reported when parsing the metadata below.
+    }
+    afile.seek(0, SEEK_SET);
+
+    SnapshotManifest manifest{chainman.GetParams().MessageStart()};
+    SnapshotMetadata& metadata{manifest.m_metadata};
+    auto activation_result{[&]() -> util::Result<CBlockIndex*> {
+        if (!is_manifest) {
+            try {
+                afile >> metadata;
+            } catch (const std::ios_base::failure& e) {
+                throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("Unable to parse metadata: %s", e.what()));
+            }
+            return chainman.ActivateSnapshot(afile, metadata, false);
+        }
+
+        try {
+            afile >> manifest;
+        } catch (const std::ios_base::failure& e) {
+            throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("Unable to parse manifest: %s", e.what()));
+        }
+        std::deque<AutoFile> chunk_files;
+        std::vector<AutoFile*> chunk_file_ptrs;
+        for (const SnapshotManifest::Chunk& chunk : manifest.m_chunks) {
+            const fs::path chunk_path{path.parent_path() / fs::u8path(chunk.filename)};
+            AutoFile& chunk_file{chunk_files.emplace_back(fsbridge::fopen(chunk_path, "rb"))};
+            if (chunk_file.IsNull()) {
+                throw JSONRPCError(
+                    RPC_INVALID_PARAMETER,
+                    "Couldn't open file " + chunk_path.utf8string() + " for reading.");
+            }
+            chunk_file_ptrs.push_back(&chunk_file);
+        }
+        return chainman.ActivateSnapshot(chunk_file_ptrs, manifest, false);
+    }()};
     if (!activation_result) {
         throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Unable to load UTXO snapshot: %s. (%s)", util::ErrorString(activation_result).original, path.utf8string()));
     }
@@ -3339,6 +3561,9 @@ const std::vector<RPCResult> RPCHelpForChainstate{
     {RPCResult::Type::STR_HEX, "snapshot_blockhash", /*optional=*/true, "the base block of the snapshot this chainstate is based on, if any"},
     {RPCResult::Type::NUM, "coins_db_cache_bytes", "size of the coinsdb cache"},
     {RPCResult::Type::NUM, "coins_tip_cache_bytes", "size of the coinstip cache"},
+    {RPCResult::Type::BOOL, "coins_db_bulk_load", "whether the coinsdb is tuned for initial block download"},
+    {RPCResult::Type::NUM, "coins_db_write_stalls", "number of coinsdb writes that had to wait for compaction"},
+    {RPCResult::Type::NUM, "coins_db_write_stall_time", "time spent in coinsdb writes that had to wait for compaction, in seconds"},
     {RPCResult::Type::BOOL, "validated", "whether the chainstate is fully validated. True if all blocks in the chainstate were validated, false if the chain is based on a snapshot and the snapshot has not yet been validated."},
 };
 
@@ -3365,7 +3590,7 @@ return RPCHelpMan{
 
     ChainstateManager& chainman = EnsureAnyChainman(request.context);
 
-    auto make_chain_data = [&](const Chainstate& cs, bool validated) EXCLUSIVE_LOCKS_REQUIRED(::cs_main) {
+    auto make_chain_data = [&](Chainstate& cs, bool validated) EXCLUSIVE_LOCKS_REQUIRED(::cs_main) {
         AssertLockHeld(::cs_main);
         UniValue data(UniValue::VOBJ);
         if (!cs.m_chain.Tip()) {
@@ -3382,6 +3607,10 @@ return RPCHelpMan{
         data.pushKV("verificationprogress", chainman.GuessVerificationProgress(tip));
         data.pushKV("coins_db_cache_bytes",  cs.m_coinsdb_cache_size_bytes);
         data.pushKV("coins_tip_cache_bytes", cs.m_coinstip_cache_size_bytes);
+        const DBWriteStalls write_stalls{cs.CoinsDB().WriteStalls()};
+        data.pushKV("coins_db_bulk_load", cs.CoinsDB().IsBulkLoad());
+        data.pushKV("coins_db_write_stalls", write_stalls.count);
+        data.pushKV("coins_db_write_stall_time", Ticks<SecondsDouble>(write_stalls.duration));
         if (cs.m_from_snapshot_blockhash) {
             data.pushKV("snapshot_blockhash", cs.m_from_snapshot_blockhash->ToString());
         }
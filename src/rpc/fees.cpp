@@ -14,12 +14,14 @@
 #include <rpc/server_util.h>
 #include <rpc/util.h>
 #include <txmempool.h>
+#include <util/string.h>
 #include <univalue.h>
 #include <validationinterface.h>
 
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <optional>
 #include <string>
 
 using common::FeeModeFromString;
@@ -39,6 +41,8 @@ static RPCHelpMan estimatesmartfee()
             {"conf_target", RPCArg::Type::NUM, RPCArg::Optional::NO, "Confirmation target in blocks (1 - 1008)"},
             {"estimate_mode", RPCArg::Type::STR, RPCArg::Default{"economical"}, "The fee estimate mode.\n"
               + FeeModesDetail(std::string("default mode will be used"))},
+            {"tx_vsize", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "Virtual size of the transaction. If given, the estimate is based only on\n"
+              "confirmed transactions of a similar size (below or at least " + util::ToString(LARGE_TX_VSIZE_THRESHOLD) + " vbytes)."},
         },
         RPCResult{
             RPCResult::Type::OBJ, "", "",
@@ -75,11 +79,19 @@ static RPCHelpMan estimatesmartfee()
                 }
                 if (fee_mode == FeeEstimateMode::CONSERVATIVE) conservative = true;
             }
+            std::optional<FeeEstimateSizeClass> size_class;
+            if (!request.params[2].isNull()) {
+                const int64_t tx_vsize{request.params[2].getInt<int64_t>()};
+                if (tx_vsize <= 0) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid tx_vsize");
+                }
+                size_class = FeeEstimateSizeClassForVsize(tx_vsize);
+            }
 
             UniValue result(UniValue::VOBJ);
             UniValue errors(UniValue::VARR);
             FeeCalculation feeCalc;
-            CFeeRate feeRate{fee_estimator.estimateSmartFee(conf_target, &feeCalc, conservative)};
+            CFeeRate feeRate{fee_estimator.estimateSmartFee(conf_target, &feeCalc, conservative, size_class)};
             if (feeRate != CFeeRate(0)) {
                 CFeeRate min_mempool_feerate{mempool.GetMinFee()};
                 CFeeRate min_relay_feerate{mempool.m_opts.min_relay_feerate};
@@ -805,6 +805,7 @@ static RPCHelpMan savemempool()
 {
     const ArgsManager& args{EnsureAnyArgsman(request.context)};
     const CTxMemPool& mempool = EnsureAnyMemPool(request.context);
+    const ChainstateManager& chainman = EnsureAnyChainman(request.context);
 
     if (!mempool.GetLoadTried()) {
         throw JSONRPCError(RPC_MISC_ERROR, "The mempool was not loaded yet");
@@ -812,7 +813,7 @@ static RPCHelpMan savemempool()
 
     const fs::path& dump_path = MempoolPath(args);
 
-    if (!DumpMempool(mempool, dump_path)) {
+    if (!DumpMempool(mempool, chainman.ActiveChainstate(), dump_path)) {
         throw JSONRPCError(RPC_MISC_ERROR, "Unable to dump mempool to disk");
     }
 
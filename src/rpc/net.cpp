@@ -154,6 +154,7 @@ static RPCHelpMan getpeerinfo()
                     {RPCResult::Type::NUM, "pingtime", /*optional=*/true, "The last ping time in milliseconds (ms), if any"},
                     {RPCResult::Type::NUM, "minping", /*optional=*/true, "The minimum observed ping time in milliseconds (ms), if any"},
                     {RPCResult::Type::NUM, "pingwait", /*optional=*/true, "The duration in milliseconds (ms) of an outstanding ping (if non-zero)"},
+                    {RPCResult::Type::NUM, "txfetchtime", /*optional=*/true, "The smoothed time in seconds this peer took to answer our transaction requests, if it answered any"},
                     {RPCResult::Type::NUM, "version", "The peer version, such as 70001"},
                     {RPCResult::Type::STR, "subver", "The string version"},
                     {RPCResult::Type::BOOL, "inbound", "Inbound (true) or Outbound (false)"},
@@ -256,6 +257,9 @@ static RPCHelpMan getpeerinfo()
         if (statestats.m_ping_wait > 0s) {
             obj.pushKV("pingwait", Ticks<SecondsDouble>(statestats.m_ping_wait));
         }
+        if (statestats.m_tx_fetch_latency) {
+            obj.pushKV("txfetchtime", Ticks<SecondsDouble>(*statestats.m_tx_fetch_latency));
+        }
         obj.pushKV("version", stats.nVersion);
         // Use the sanitized form of subver here, to avoid tricksy remote peers from
         // corrupting or modifying the JSON output by putting special characters in
@@ -642,6 +646,23 @@ static RPCHelpMan getnetworkinfo()
                             {RPCResult::Type::STR, "SERVICE_NAME", "the service name"},
                         }},
                         {RPCResult::Type::BOOL, "localrelay", "true if transaction relay is requested from peers"},
+                        {RPCResult::Type::OBJ, "compactblocks", "compact block reconstruction statistics since startup",
+                        {
+                            {RPCResult::Type::NUM, "received", "compact blocks we started reconstructing"},
+                            {RPCResult::Type::NUM, "getblocktxn_roundtrips", "getblocktxn round-trips needed to complete a reconstruction"},
+                            {RPCResult::Type::NUM, "txn_requested", "transactions requested through those round-trips"},
+                        }},
+                        {RPCResult::Type::OBJ, "txreconciliation", /*optional=*/true, "transaction reconciliation statistics since startup (only present if -txreconciliation is enabled)",
+                        {
+                            {RPCResult::Type::NUM, "reconciliations_succeeded", "reconciliation rounds we initiated whose set difference could be decoded"},
+                            {RPCResult::Type::NUM, "reconciliations_failed", "reconciliation rounds we initiated that fell back to announcing the whole set"},
+                            {RPCResult::Type::NUM, "sketch_bytes_sent", "bytes of sketches sent"},
+                            {RPCResult::Type::NUM, "sketch_bytes_received", "bytes of sketches received"},
+                            {RPCResult::Type::NUM, "shortid_bytes", "bytes of short IDs exchanged in reconcildiff messages"},
+                            {RPCResult::Type::NUM, "txs_reconciled", "transactions added to reconciliation sets instead of being announced"},
+                            {RPCResult::Type::NUM, "txs_announced", "transactions announced after reconciliation"},
+                            {RPCResult::Type::NUM, "txs_flooded", "transactions flooded to reconciling peers"},
+                        }},
                         {RPCResult::Type::OBJ, "pqnoise", "PQ Noise transport statistics",
                         {
                             {RPCResult::Type::NUM, "handshakes_attempted", "Total PQ handshake attempts"},
@@ -711,6 +732,23 @@ static RPCHelpMan getnetworkinfo()
         auto peerman_info{node.peerman->GetInfo()};
         obj.pushKV("localrelay", !peerman_info.ignores_incoming_txs);
         obj.pushKV("timeoffset", Ticks<std::chrono::seconds>(peerman_info.median_outbound_time_offset));
+        UniValue cmpctblocks(UniValue::VOBJ);
+        cmpctblocks.pushKV("received", peerman_info.cmpctblocks_received);
+        cmpctblocks.pushKV("getblocktxn_roundtrips", peerman_info.getblocktxn_sent);
+        cmpctblocks.pushKV("txn_requested", peerman_info.getblocktxn_txn_requested);
+        obj.pushKV("compactblocks", std::move(cmpctblocks));
+        if (const auto& recon{peerman_info.txreconciliation}) {
+            UniValue txrecon(UniValue::VOBJ);
+            txrecon.pushKV("reconciliations_succeeded", recon->reconciliations_succeeded);
+            txrecon.pushKV("reconciliations_failed", recon->reconciliations_failed);
+            txrecon.pushKV("sketch_bytes_sent", recon->sketch_bytes_sent);
+            txrecon.pushKV("sketch_bytes_received", recon->sketch_bytes_received);
+            txrecon.pushKV("shortid_bytes", recon->shortid_bytes);
+            txrecon.pushKV("txs_reconciled", recon->txs_reconciled);
+            txrecon.pushKV("txs_announced", recon->txs_announced);
+            txrecon.pushKV("txs_flooded", recon->txs_flooded);
+            obj.pushKV("txreconciliation", std::move(txrecon));
+        }
     }
     if (node.connman) {
         obj.pushKV("networkactive", node.connman->GetNetworkActive());
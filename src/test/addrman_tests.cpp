@@ -787,6 +787,86 @@ BOOST_AUTO_TEST_CASE(addrman_serialization)
     BOOST_CHECK(addr_pos7.position != addr_pos8.position);
 }
 
+BOOST_AUTO_TEST_CASE(addrman_changes)
+{
+    const auto ratio = GetCheckRatio(m_node);
+    auto addrman = std::make_unique<AddrMan>(EMPTY_NETGROUPMAN, DETERMINISTIC, ratio);
+    const CNetAddr source{ResolveIP("252.2.2.2")};
+
+    const CAddress new1{ResolveService("250.1.1.1", 8333), NODE_NONE};
+    const CAddress new2{ResolveService("250.2.1.1", 8333), NODE_NONE};
+    const CAddress new3{ResolveService("250.3.1.1", 8333), NODE_NONE};
+    const CAddress tried1{ResolveService("250.4.1.1", 8333), NODE_NONE};
+    BOOST_CHECK(addrman->Add({new1, new2, tried1}, source));
+    BOOST_CHECK(addrman->Good(tried1));
+
+    DataStream snapshot{};
+    snapshot << *addrman;
+
+    // Nothing changed since the serialization.
+    DataStream batch{};
+    BOOST_CHECK_EQUAL(addrman->WriteChanges(batch).value(), 0U);
+
+    BOOST_CHECK(addrman->Add({new3}, source));
+    BOOST_CHECK(addrman->Good(new1));
+    const uint64_t mark{addrman->GetChangesMark()};
+    addrman->Attempt(new2, /*fCountFailure=*/true);
+    BOOST_CHECK_EQUAL(addrman->WriteChanges(batch).value(), 3U);
+
+    // Changes stay tracked until they are forgotten, e.g. because writing the batch failed. Only
+    // the ones made up to the mark are forgotten.
+    DataStream retry_batch{};
+    BOOST_CHECK_EQUAL(addrman->WriteChanges(retry_batch).value(), 3U);
+    addrman->ForgetChanges(mark);
+    DataStream empty_batch{};
+    BOOST_CHECK_EQUAL(addrman->WriteChanges(empty_batch).value(), 1U);
+    addrman->ForgetChanges(addrman->GetChangesMark());
+    empty_batch.clear();
+    BOOST_CHECK_EQUAL(addrman->WriteChanges(empty_batch).value(), 0U);
+
+    // Applying the batch on top of the serialization reproduces the current state.
+    auto addrman_loaded = std::make_unique<AddrMan>(EMPTY_NETGROUPMAN, DETERMINISTIC, ratio);
+    DataStream snapshot_copy{snapshot};
+    snapshot_copy >> *addrman_loaded;
+    BOOST_CHECK_EQUAL(addrman_loaded->Size(), 3U);
+    std::vector<DataStream> batches{batch};
+    BOOST_CHECK_EQUAL(addrman_loaded->ApplyChanges(batches), 1U);
+
+    BOOST_CHECK_EQUAL(addrman_loaded->Size(), 4U);
+    BOOST_CHECK_EQUAL(addrman_loaded->Size(/*net=*/std::nullopt, /*in_new=*/false), 2U);
+    for (const CAddress& addr : {new1, new2, new3, tried1}) {
+        AddressPosition pos{addrman->FindAddressEntry(addr).value()};
+        BOOST_CHECK(pos == addrman_loaded->FindAddressEntry(addr).value());
+    }
+    const auto entries{addrman_loaded->GetEntries(/*from_tried=*/false)};
+    const auto it{std::find_if(entries.begin(), entries.end(), [&](const auto& entry) { return CService{entry.first} == new2; })};
+    BOOST_REQUIRE(it != entries.end());
+    BOOST_CHECK_EQUAL(it->first.nAttempts, 1);
+
+    // A batch is not applied to an addrman with a different key.
+    auto addrman_other = std::make_unique<AddrMan>(EMPTY_NETGROUPMAN, !DETERMINISTIC, ratio);
+    batches = {batch};
+    BOOST_CHECK_EQUAL(addrman_other->ApplyChanges(batches), 0U);
+    BOOST_CHECK_EQUAL(addrman_other->Size(), 0U);
+
+    // After too many changes to track, only a full serialization persists them.
+    for (int i = 0; i < 300; ++i) {
+        std::vector<CAddress> addrs;
+        for (int j = 0; j < 250; ++j) {
+            addrs.emplace_back(ResolveService(strprintf("251.%i.%i.1", i % 250, j), 8333 + i / 250), NODE_NONE);
+        }
+        addrman->Add(addrs, ResolveIP(strprintf("253.%i.1.1", i % 250)));
+    }
+    const uint64_t overflow_mark{addrman->GetChangesMark()};
+    BOOST_CHECK(!addrman->WriteChanges(empty_batch).has_value());
+    // A change after the mark isn't tracked, so forgetting up to the mark isn't enough.
+    addrman->SetServices(tried1, NODE_NETWORK);
+    addrman->ForgetChanges(overflow_mark);
+    BOOST_CHECK(!addrman->WriteChanges(empty_batch).has_value());
+    addrman->ForgetChanges(addrman->GetChangesMark());
+    BOOST_CHECK_EQUAL(addrman->WriteChanges(empty_batch).value(), 0U);
+}
+
 BOOST_AUTO_TEST_CASE(remove_invalid)
 {
     // Confirm that invalid addresses are ignored in unserialization.
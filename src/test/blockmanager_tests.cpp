@@ -13,6 +13,11 @@
 #include <util/chaintype.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <vector>
+
 #include <boost/test/unit_test.hpp>
 #include <test/util/logging.h>
 #include <test/util/setup_common.h>
@@ -21,6 +26,8 @@ using node::STORAGE_HEADER_BYTES;
 using node::BlockManager;
 using node::KernelNotifications;
 using node::MAX_BLOCKFILE_SIZE;
+using node::MAX_PRUNED_BLOCKFILE_SIZE;
+using node::ReadBlockFileFooter;
 
 // use BasicTestingSetup here for the data directory configuration, setup, and cleanup
 BOOST_FIXTURE_TEST_SUITE(blockmanager_tests, BasicTestingSetup)
@@ -57,6 +64,33 @@ BOOST_AUTO_TEST_CASE(blockmanager_find_block_pos)
     BOOST_CHECK_EQUAL(actual.nPos, STORAGE_HEADER_BYTES + ::GetSerializeSize(TX_WITH_WITNESS(params->GenesisBlock())) + STORAGE_HEADER_BYTES);
 }
 
+BOOST_AUTO_TEST_CASE(blockmanager_pruned_blockfile_size)
+{
+    const auto params {CreateChainParams(ArgsManager{}, ChainType::MAIN)};
+    KernelNotifications notifications{Assert(m_node.shutdown_request), m_node.exit_status, *Assert(m_node.warnings)};
+    // Pruned nodes keep block files at the size the prune target minimum
+    // assumes, unpruned nodes let them grow larger.
+    for (const bool prune : {false, true}) {
+        const fs::path dir{m_args.GetDataDirNet() / (prune ? "pruned" : "unpruned")};
+        fs::create_directories(dir / "blocks");
+        const BlockManager::Options blockman_opts{
+            .chainparams = *params,
+            .prune_target = prune ? MIN_DISK_SPACE_FOR_BLOCK_FILES : 0,
+            .blocks_dir = dir / "blocks",
+            .notifications = notifications,
+            .block_tree_db_params = DBParams{
+                .path = dir / "index",
+                .cache_bytes = 0,
+            },
+        };
+        BlockManager blockman{*Assert(m_node.shutdown_signal), blockman_opts};
+        BOOST_CHECK_EQUAL(blockman.IsPruneMode(), prune);
+        BOOST_CHECK_EQUAL(blockman.WriteBlock(params->GenesisBlock(), 0).nFile, 0);
+        WITH_LOCK(::cs_main, blockman.GetBlockFileInfo(0)->nSize = MAX_PRUNED_BLOCKFILE_SIZE - STORAGE_HEADER_BYTES);
+        BOOST_CHECK_EQUAL(blockman.WriteBlock(params->GenesisBlock(), 1).nFile, prune ? 1 : 0);
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(blockmanager_scan_unlink_already_pruned_files, TestChain100Setup)
 {
     // Cap last block file size, and mine new block in a new block file.
@@ -98,6 +132,39 @@ BOOST_FIXTURE_TEST_CASE(blockmanager_scan_unlink_already_pruned_files, TestChain
     BOOST_CHECK(!blockman.OpenBlockFile(new_pos, true).IsNull());
 }
 
+BOOST_FIXTURE_TEST_CASE(blockmanager_blockfile_footer, TestChain100Setup)
+{
+    // Cap last block file size, and mine new block in a new block file.
+    const auto& chainman = Assert(m_node.chainman);
+    auto& blockman = chainman->m_blockman;
+    const CBlockIndex* old_tip{WITH_LOCK(chainman->GetMutex(), return chainman->ActiveChain().Tip())};
+    const int old_file_number{WITH_LOCK(chainman->GetMutex(), return old_tip->GetBlockPos().nFile)};
+    WITH_LOCK(chainman->GetMutex(), blockman.GetBlockFileInfo(old_file_number)->nSize = MAX_BLOCKFILE_SIZE);
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+
+    // The finished file lists the storage headers of all its blocks in its footer.
+    std::vector<uint32_t> expected;
+    {
+        LOCK(chainman->GetMutex());
+        for (const CBlockIndex* pindex{old_tip}; pindex; pindex = pindex->pprev) {
+            expected.push_back(pindex->GetBlockPos().nPos - STORAGE_HEADER_BYTES);
+        }
+    }
+    std::ranges::reverse(expected);
+    AutoFile old_file{blockman.OpenBlockFile(FlatFilePos(old_file_number, 0), /*fReadOnly=*/true)};
+    const auto offsets{ReadBlockFileFooter(old_file)};
+    BOOST_REQUIRE(offsets);
+    BOOST_CHECK(*offsets == expected);
+    BOOST_CHECK_EQUAL(old_file.tell(), 0);
+
+    // The file still being written to has none.
+    const CBlockIndex* new_tip{WITH_LOCK(chainman->GetMutex(), return chainman->ActiveChain().Tip())};
+    const int new_file_number{WITH_LOCK(chainman->GetMutex(), return new_tip->GetBlockPos().nFile)};
+    BOOST_CHECK_NE(new_file_number, old_file_number);
+    AutoFile new_file{blockman.OpenBlockFile(FlatFilePos(new_file_number, 0), /*fReadOnly=*/true)};
+    BOOST_CHECK(!ReadBlockFileFooter(new_file));
+}
+
 BOOST_FIXTURE_TEST_CASE(blockmanager_block_data_availability, TestChain100Setup)
 {
     // The goal of the function is to return the first not pruned block in the range [upper_block, lower_block].
@@ -216,4 +283,58 @@ BOOST_AUTO_TEST_CASE(blockmanager_flush_block_file)
     BOOST_CHECK_EQUAL(read_block.nVersion, 2);
 }
 
+BOOST_AUTO_TEST_CASE(blockmanager_read_raw_blocks)
+{
+    KernelNotifications notifications{Assert(m_node.shutdown_request), m_node.exit_status, *Assert(m_node.warnings)};
+    node::BlockManager::Options blockman_opts{
+        .chainparams = Params(),
+        .block_read_threads = 2,
+        .blocks_dir = m_args.GetBlocksDirPath(),
+        .notifications = notifications,
+        .block_tree_db_params = DBParams{
+            .path = m_args.GetDataDirNet() / "blocks" / "index",
+            .cache_bytes = 0,
+        },
+    };
+    BlockManager blockman{*Assert(m_node.shutdown_signal), blockman_opts};
+
+    std::vector<FlatFilePos> positions;
+    std::vector<std::vector<unsigned char>> expected;
+    for (int i{1}; i <= 3; ++i) {
+        CBlock block;
+        block.nVersion = i;
+        positions.push_back(blockman.WriteBlock(block, /*nHeight=*/i));
+        BOOST_REQUIRE(blockman.ReadRawBlock(expected.emplace_back(), positions.back()));
+    }
+
+    // Reading several blocks from one file returns the same bytes as reading them one by one.
+    std::vector<std::vector<unsigned char>> blocks;
+    blockman.ReadRawBlocks(positions, blocks);
+    BOOST_CHECK(blocks == expected);
+
+    // Queued reads, including several of the same block, all get the block they asked for.
+    std::vector<std::future<std::vector<unsigned char>>> futures;
+    for (const FlatFilePos& pos : {positions[2], positions[0], positions[2], positions[1]}) {
+        auto promise{std::make_shared<std::promise<std::vector<unsigned char>>>()};
+        futures.push_back(promise->get_future());
+        BOOST_REQUIRE(blockman.ReadRawBlockAsync(pos, [promise](std::vector<unsigned char> data) {
+            promise->set_value(std::move(data));
+        }));
+    }
+    BOOST_CHECK(futures[0].get() == expected[2]);
+    BOOST_CHECK(futures[1].get() == expected[0]);
+    BOOST_CHECK(futures[2].get() == expected[2]);
+    BOOST_CHECK(futures[3].get() == expected[1]);
+
+    // A position past the end of the file cannot be read.
+    FlatFilePos bad_pos{positions[2]};
+    bad_pos.nPos += 1000;
+    auto promise{std::make_shared<std::promise<std::vector<unsigned char>>>()};
+    auto future{promise->get_future()};
+    BOOST_REQUIRE(blockman.ReadRawBlockAsync(bad_pos, [promise](std::vector<unsigned char> data) {
+        promise->set_value(std::move(data));
+    }));
+    BOOST_CHECK(future.get().empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,7 +6,6 @@
 #include <clientversion.h>
 #include <coins.h>
 #include <streams.h>
-#include <test/util/poolresourcetester.h>
 #include <test/util/random.h>
 #include <test/util/setup_common.h>
 #include <txdb.h>
@@ -14,8 +13,10 @@
 #include <undo.h>
 #include <util/strencodings.h>
 
+#include <atomic>
 #include <map>
 #include <string>
+#include <thread>
 #include <variant>
 #include <vector>
 
@@ -84,7 +85,7 @@ public:
     void SelfTest(bool sanity_check = true) const
     {
         // Manually recompute the dynamic usage of the whole data, and compare it.
-        size_t ret = memusage::DynamicUsage(cacheCoins);
+        size_t ret = cacheCoins.DynamicMemoryUsage();
         size_t count = 0;
         for (const auto& entry : cacheCoins) {
             ret += entry.second.coin.DynamicMemoryUsage();
@@ -98,7 +99,6 @@ public:
     }
 
     CCoinsMap& map() const { return cacheCoins; }
-    CoinsCachePair& sentinel() const { return m_sentinel; }
     size_t& usage() const { return cachedCoinsUsage; }
 };
 
@@ -624,14 +624,14 @@ static void SetCoinsValue(const CAmount value, Coin& coin)
     }
 }
 
-static size_t InsertCoinsMapEntry(CCoinsMap& map, CoinsCachePair& sentinel, const CoinEntry& cache_coin)
+static size_t InsertCoinsMapEntry(CCoinsMap& map, const CoinEntry& cache_coin)
 {
     CCoinsCacheEntry entry;
     SetCoinsValue(cache_coin.value, entry.coin);
-    auto [iter, inserted] = map.emplace(OUTPOINT, std::move(entry));
+    auto [iter, inserted] = map.try_emplace(OUTPOINT, std::move(entry));
     assert(inserted);
-    if (cache_coin.IsDirty()) CCoinsCacheEntry::SetDirty(*iter, sentinel);
-    if (cache_coin.IsFresh()) CCoinsCacheEntry::SetFresh(*iter, sentinel);
+    if (cache_coin.IsDirty()) map.SetDirty(*iter);
+    if (cache_coin.IsFresh()) map.SetFresh(*iter);
     return iter->second.coin.DynamicMemoryUsage();
 }
 
@@ -647,12 +647,9 @@ static MaybeCoin GetCoinsMapEntry(const CCoinsMap& map, const COutPoint& outp =
 
 static void WriteCoinsViewEntry(CCoinsView& view, const MaybeCoin& cache_coin)
 {
-    CoinsCachePair sentinel{};
-    sentinel.second.SelfRef(sentinel);
-    CCoinsMapMemoryResource resource;
-    CCoinsMap map{0, CCoinsMap::hasher{}, CCoinsMap::key_equal{}, &resource};
-    auto usage{cache_coin ? InsertCoinsMapEntry(map, sentinel, *cache_coin) : 0};
-    auto cursor{CoinsViewCacheCursor(usage, sentinel, map, /*will_erase=*/true)};
+    CCoinsMap map;
+    auto usage{cache_coin ? InsertCoinsMapEntry(map, *cache_coin) : 0};
+    auto cursor{CoinsViewCacheCursor(usage, map, /*will_erase=*/true)};
     BOOST_CHECK(view.BatchWrite(cursor, {}));
 }
 
@@ -663,7 +660,7 @@ public:
     {
         auto base_cache_coin{base_value == ABSENT ? MISSING : CoinEntry{base_value, CoinEntry::State::DIRTY}};
         WriteCoinsViewEntry(base, base_cache_coin);
-        if (cache_coin) cache.usage() += InsertCoinsMapEntry(cache.map(), cache.sentinel(), *cache_coin);
+        if (cache_coin) cache.usage() += InsertCoinsMapEntry(cache.map(), *cache_coin);
     }
 
     CCoinsView root;
@@ -947,7 +944,7 @@ void TestFlushBehavior(
         //
         flush_all(/*erase=*/ true);
 
-        // Memory does not necessarily go down due to the map using a memory pool
+        // Memory goes down as the map's table is released
         BOOST_TEST(view->DynamicMemoryUsage() <= cache_usage);
         // Size of the cache must go down though
         BOOST_TEST(view->map().size() < cache_size);
@@ -1049,29 +1046,296 @@ BOOST_FIXTURE_TEST_CASE(ccoins_flush_behavior, FlushTest)
     }
 }
 
-BOOST_AUTO_TEST_CASE(coins_resource_is_used)
+BOOST_FIXTURE_TEST_CASE(ccoins_background_flush, FlushTest)
 {
-    CCoinsMapMemoryResource resource;
-    PoolResourceTester::CheckAllDataAccountedFor(resource);
+    CCoinsViewDB base{{.path = "test", .cache_bytes = 1 << 23, .memory_only = true}, {}};
+    CCoinsViewBackgroundFlush flush_view{&base};
+    CCoinsViewCacheTest cache{&flush_view};
 
-    {
-        CCoinsMap map{0, CCoinsMap::hasher{}, CCoinsMap::key_equal{}, &resource};
-        BOOST_TEST(memusage::DynamicUsage(map) >= resource.ChunkSizeBytes());
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    for (int i{0}; i < 1000; ++i) {
+        coins.emplace_back(COutPoint{Txid::FromUint256(m_rng.rand256()), 0}, MakeCoin());
+        cache.AddCoin(coins.back().first, Coin{coins.back().second}, /*possible_overwrite=*/false);
+    }
+    const uint256 best_block{m_rng.rand256()};
+    cache.SetBestBlock(best_block);
+
+    // A deferred flush returns before the coins are written, but they remain
+    // visible through the flush view while the write is in flight.
+    flush_view.DeferNextWrite();
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK(flush_view.GetBestBlock() == best_block);
+    for (const auto& [outpoint, coin] : coins) {
+        BOOST_CHECK(cache.AccessCoin(outpoint).out == coin.out);
+    }
+
+    // Spend half of the coins on top of the flushed state, and flush again
+    // synchronously, which first waits for the deferred write.
+    for (size_t i{0}; i < coins.size(); i += 2) {
+        BOOST_CHECK(cache.SpendCoin(coins[i].first));
+    }
+    const uint256 best_block2{m_rng.rand256()};
+    cache.SetBestBlock(best_block2);
+    BOOST_CHECK(cache.Sync());
+
+    BOOST_CHECK(flush_view.WaitForFlush());
+    BOOST_CHECK_EQUAL(flush_view.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK(base.GetBestBlock() == best_block2);
+    BOOST_CHECK(base.GetHeadBlocks().empty());
+    for (size_t i{0}; i < coins.size(); ++i) {
+        const auto coin{base.GetCoin(coins[i].first)};
+        BOOST_CHECK_EQUAL(coin.has_value(), i % 2 == 1);
+        if (coin) BOOST_CHECK(coin->out == coins[i].second.out);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(ccoins_sharded_cache, FlushTest)
+{
+    CCoinsViewDB base{{.path = "test", .cache_bytes = 1 << 23, .memory_only = true}, {}};
+    CCoinsViewShardedCache shared{&base, /*deterministic=*/true};
+    CCoinsViewCacheTest cache{&shared};
+
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    for (int i{0}; i < 1000; ++i) {
+        coins.emplace_back(COutPoint{Txid::FromUint256(m_rng.rand256()), 0}, MakeCoin());
+        cache.AddCoin(coins.back().first, Coin{coins.back().second}, /*possible_overwrite=*/false);
+    }
+    const uint256 best_block{m_rng.rand256()};
+    cache.SetBestBlock(best_block);
+
+    // Flushing the tip moves its coins into the shared cache only.
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK_EQUAL(shared.GetCacheSize(), coins.size());
+    BOOST_CHECK(shared.GetBestBlock() == best_block);
+    BOOST_CHECK(base.GetBestBlock().IsNull());
+    for (const auto& [outpoint, coin] : coins) {
+        BOOST_CHECK(shared.HaveCoinInCache(outpoint));
+        const auto [found, found_best]{shared.GetCoinAtBestBlock(outpoint)};
+        BOOST_CHECK(found && found->out == coin.out);
+        BOOST_CHECK(found_best == best_block);
+        BOOST_CHECK(!base.HaveCoin(outpoint));
+    }
+
+    // Spend half of the coins and write the rest to the base.
+    for (size_t i{0}; i < coins.size(); i += 2) {
+        BOOST_CHECK(cache.SpendCoin(coins[i].first));
+    }
+    const uint256 best_block2{m_rng.rand256()};
+    cache.SetBestBlock(best_block2);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(shared.Sync());
+    BOOST_CHECK(base.GetBestBlock() == best_block2);
+    BOOST_CHECK_EQUAL(shared.GetCacheSize(), coins.size() / 2);
+    for (size_t i{0}; i < coins.size(); ++i) {
+        const auto coin{base.GetCoin(coins[i].first)};
+        BOOST_CHECK_EQUAL(coin.has_value(), i % 2 == 1);
+        if (coin) BOOST_CHECK(coin->out == coins[i].second.out);
+        BOOST_CHECK_EQUAL(shared.HaveCoin(coins[i].first), i % 2 == 1);
+    }
+
+    // Clean coins can be uncached, and are read back from the base. Peeking
+    // does not cache them again.
+    shared.Uncache(coins[1].first);
+    BOOST_CHECK(!shared.HaveCoinInCache(coins[1].first));
+    BOOST_CHECK(shared.PeekCoin(coins[1].first)->out == coins[1].second.out);
+    BOOST_CHECK(!shared.HaveCoinInCache(coins[1].first));
+    BOOST_CHECK(shared.GetCoin(coins[1].first)->out == coins[1].second.out);
+    BOOST_CHECK(shared.HaveCoinInCache(coins[1].first));
+
+    // Modified coins are not uncached.
+    cache.AddCoin(coins[0].first, Coin{coins[0].second}, /*possible_overwrite=*/false);
+    BOOST_CHECK(cache.Flush());
+    shared.Uncache(coins[0].first);
+    BOOST_CHECK(shared.HaveCoinInCache(coins[0].first));
+
+    BOOST_CHECK(shared.Flush());
+    BOOST_CHECK_EQUAL(shared.GetCacheSize(), 0U);
+    BOOST_CHECK_EQUAL(shared.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK(base.GetCoin(coins[0].first)->out == coins[0].second.out);
+}
+
+//! Coins view whose writes fail without taking any coins.
+class CCoinsViewFailingWrite : public CCoinsViewBacked
+{
+public:
+    using CCoinsViewBacked::CCoinsViewBacked;
+    bool BatchWrite(CoinsViewCacheCursor&, const uint256&) override { return false; }
+};
+
+BOOST_FIXTURE_TEST_CASE(ccoins_sharded_cache_failed_flush, FlushTest)
+{
+    CCoinsViewDB base{{.path = "test", .cache_bytes = 1 << 23, .memory_only = true}, {}};
+    CCoinsViewFailingWrite failing{&base};
+    CCoinsViewShardedCache shared{&failing, /*deterministic=*/true};
+    CCoinsViewCacheTest cache{&shared};
+
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    for (int i{0}; i < 100; ++i) {
+        coins.emplace_back(COutPoint{Txid::FromUint256(m_rng.rand256()), 0}, MakeCoin());
+        cache.AddCoin(coins.back().first, Coin{coins.back().second}, /*possible_overwrite=*/false);
+    }
+    const uint256 best_block{m_rng.rand256()};
+    cache.SetBestBlock(best_block);
+    BOOST_CHECK(cache.Flush());
+
+    // Flush moves the coins out of the shards. When the write fails they are
+    // put back, still modified, so that a later flush writes them.
+    BOOST_CHECK(!shared.Flush());
+    BOOST_CHECK_EQUAL(shared.GetCacheSize(), coins.size());
+    for (const auto& [outpoint, coin] : coins) {
+        BOOST_CHECK(shared.GetCoin(outpoint)->out == coin.out);
+    }
+
+    shared.SetBackend(base);
+    BOOST_CHECK(shared.Flush());
+    BOOST_CHECK_EQUAL(shared.GetCacheSize(), 0U);
+    BOOST_CHECK(base.GetBestBlock() == best_block);
+    for (const auto& [outpoint, coin] : coins) {
+        BOOST_CHECK(base.GetCoin(outpoint)->out == coin.out);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(ccoins_sharded_cache_concurrent_reads, FlushTest)
+{
+    CCoinsViewDB base{{.path = "test", .cache_bytes = 1 << 23, .memory_only = true}, {}};
+    CCoinsViewShardedCache shared{&base, /*deterministic=*/true};
+    CCoinsViewCacheTest cache{&shared};
+
+    // Block i creates output i and spends output i - 1, so in the state after
+    // block i output i is the only unspent one.
+    constexpr int NUM_BLOCKS{500};
+    std::vector<COutPoint> outpoints;
+    std::map<uint256, int> heights{{uint256{}, -1}};
+    std::vector<uint256> hashes;
+    for (int i{0}; i < NUM_BLOCKS; ++i) {
+        outpoints.emplace_back(Txid::FromUint256(m_rng.rand256()), 0);
+        hashes.push_back(m_rng.rand256());
+        heights.emplace(hashes.back(), i);
+    }
+    const Coin coin{MakeCoin()};
+
+    // Readers must always see a coin state that matches the best block it
+    // was read at. Boost.Test checks are not thread-safe, so count failures.
+    std::atomic<bool> done{false};
+    std::atomic<int> failures{0};
+    std::vector<std::thread> readers;
+    for (int t{0}; t < 4; ++t) {
+        readers.emplace_back([&, seed = m_rng.rand256()] {
+            FastRandomContext rng{seed};
+            while (!done) {
+                const int n{static_cast<int>(rng.randrange(NUM_BLOCKS))};
+                const auto [found, best_block]{shared.GetCoinAtBestBlock(outpoints[n])};
+                const auto height{heights.find(best_block)};
+                if (height == heights.end() || found.has_value() != (n == height->second)) ++failures;
+                shared.GetCoin(outpoints[rng.randrange(NUM_BLOCKS)]);
+            }
+        });
+    }
+
+    for (int i{0}; i < NUM_BLOCKS; ++i) {
+        cache.AddCoin(outpoints[i], Coin{coin}, /*possible_overwrite=*/false);
+        if (i > 0) BOOST_CHECK(cache.SpendCoin(outpoints[i - 1]));
+        cache.SetBestBlock(hashes[i]);
+        BOOST_CHECK(cache.Flush());
+        if (i % 25 == 0) {
+            BOOST_CHECK(shared.Flush());
+        } else if (i % 10 == 0) {
+            BOOST_CHECK(shared.Sync());
+        }
+    }
+    done = true;
+    for (auto& reader : readers) reader.join();
+    BOOST_CHECK_EQUAL(failures.load(), 0);
+    BOOST_CHECK(shared.Sync());
+    BOOST_CHECK(base.GetBestBlock() == hashes.back());
+    BOOST_CHECK(base.HaveCoin(outpoints.back()));
+}
 
-        map.reserve(1000);
+BOOST_FIXTURE_TEST_CASE(ccoins_cache_fetched_coin, FlushTest)
+{
+    CCoinsView base;
+    CCoinsViewCacheTest cache{&base};
+    const COutPoint outpoint{Txid::FromUint256(m_rng.rand256()), 0};
+    const Coin coin{MakeCoin()};
+
+    // A fetched coin is cached clean, as if it had been read from the base.
+    cache.CacheFetchedCoin(outpoint, Coin{coin});
+    BOOST_CHECK(cache.HaveCoinInCache(outpoint));
+    BOOST_CHECK(cache.AccessCoin(outpoint).out == coin.out);
+    const auto it{cache.map().find(outpoint)};
+    BOOST_REQUIRE(it != cache.map().end());
+    BOOST_CHECK(!it->second.IsDirty() && !it->second.IsFresh());
+    cache.SelfTest();
+
+    // A coin that is already cached, even spent, is left untouched.
+    BOOST_CHECK(cache.SpendCoin(outpoint));
+    cache.CacheFetchedCoin(outpoint, Coin{coin});
+    BOOST_CHECK(!cache.HaveCoinInCache(outpoint));
+    cache.SelfTest();
+}
 
-        // The resource has preallocated a chunk, so we should have space for at several nodes without the need to allocate anything else.
-        const auto usage_before = memusage::DynamicUsage(map);
+BOOST_AUTO_TEST_CASE(block_undo_columns)
+{
+    const auto quantum_hash{[&] { return m_rng.randbytes(32); }};
+    const std::vector<CScript> scripts{
+        CScript() << OP_DUP << OP_QHASH << quantum_hash() << OP_EQUALVERIFY << OP_QCHECKSIG,
+        CScript() << OP_QHASH << quantum_hash() << OP_EQUAL,
+        CScript() << OP_2 << quantum_hash(),
+        GetScriptForDestination(PKHash{uint160{m_rng.randbytes(20)}}),
+        CScript() << OP_RETURN << m_rng.randbytes(40),
+    };
 
-        COutPoint out_point{};
-        for (size_t i = 0; i < 1000; ++i) {
-            out_point.n = i;
-            map[out_point];
+    // Every transaction spends one coin of each script, so all but the first
+    // transaction repeat scripts already seen in the block.
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(20);
+    for (CTxUndo& txundo : blockundo.vtxundo) {
+        for (const CScript& script : scripts) {
+            txundo.vprevout.emplace_back(CTxOut{int64_t(m_rng.randrange(MAX_MONEY)), script},
+                                         int(m_rng.randrange(1'000'000)), m_rng.randbool());
+        }
+    }
+    blockundo.vtxundo.emplace_back();
+
+    const CBlockUndoColumns columns{blockundo};
+    BOOST_CHECK_EQUAL(columns.size(), 100U);
+    BOOST_CHECK_EQUAL(columns.scripts.size(), scripts.size());
+
+    DataStream legacy{};
+    legacy << blockundo;
+    DataStream stream{};
+    stream << columns;
+    BOOST_CHECK_LT(stream.size(), legacy.size());
+
+    CBlockUndoColumns read;
+    stream >> read;
+    BOOST_CHECK(stream.empty());
+    BOOST_CHECK(read.scripts == scripts);
+    const CBlockUndo restored{read.ToBlockUndo()};
+    BOOST_REQUIRE_EQUAL(restored.vtxundo.size(), blockundo.vtxundo.size());
+    for (size_t tx{0}; tx < blockundo.vtxundo.size(); ++tx) {
+        const auto& expected{blockundo.vtxundo[tx].vprevout};
+        const auto& actual{restored.vtxundo[tx].vprevout};
+        BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+        for (size_t i{0}; i < expected.size(); ++i) {
+            BOOST_CHECK(actual[i].out == expected[i].out);
+            BOOST_CHECK_EQUAL(actual[i].nHeight, expected[i].nHeight);
+            BOOST_CHECK_EQUAL(actual[i].fCoinBase, expected[i].fCoinBase);
         }
-        BOOST_TEST(usage_before == memusage::DynamicUsage(map));
     }
 
-    PoolResourceTester::CheckAllDataAccountedFor(resource);
+    // Columns that do not describe the same coins are rejected.
+    CBlockUndoColumns bad{columns};
+    bad.amounts.pop_back();
+    stream << bad;
+    BOOST_CHECK_THROW(stream >> read, std::ios_base::failure);
+    stream.clear();
+    bad = columns;
+    bad.script_ids.back() = bad.scripts.size();
+    stream << bad;
+    BOOST_CHECK_THROW(stream >> read, std::ios_base::failure);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
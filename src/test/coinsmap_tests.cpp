@@ -0,0 +1,236 @@
+// Copyright (c) 2024-present The QTC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coins.h>
+#include <script/script.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(coinsmap_tests)
+
+static Coin UnspentCoin()
+{
+    return Coin{CTxOut{1, CScript{} << OP_TRUE}, /*nHeightIn=*/1, /*fCoinBaseIn=*/false};
+}
+
+static COutPoint OutPoint(uint32_t n)
+{
+    return COutPoint{Txid::FromUint256(uint256::ONE), n};
+}
+
+BOOST_AUTO_TEST_CASE(flagged_entry_state)
+{
+    CCoinsMap map{SaltedOutpointHasher{/*deterministic=*/true}};
+    auto& n1{*map.try_emplace(OutPoint(1)).first};
+    auto& n2{*map.try_emplace(OutPoint(2)).first};
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), 0U);
+
+    // Check that setting DIRTY adds it to the flagged entries and sets state
+    map.SetDirty(n1);
+    BOOST_CHECK(n1.second.IsDirty() && !n1.second.IsFresh());
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), 1U);
+
+    // Check that setting FRESH on another entry adds it too
+    map.SetFresh(n2);
+    BOOST_CHECK(n2.second.IsFresh() && !n2.second.IsDirty());
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), 2U);
+
+    // Check that we can set extra state without adding the entry twice
+    map.SetFresh(n1);
+    BOOST_CHECK(n1.second.IsDirty() && n1.second.IsFresh());
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), 2U);
+    map.SanityCheck();
+
+    // Check that we can clear state then re-set it
+    map.SetClean(n1);
+    BOOST_CHECK(!n1.second.IsDirty() && !n1.second.IsFresh());
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), 1U);
+    map.SanityCheck();
+
+    // Calling `SetClean` a second time has no effect
+    map.SetClean(n1);
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), 1U);
+
+    map.SetDirty(n1);
+    BOOST_CHECK(n1.second.IsDirty() && !n1.second.IsFresh());
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), 2U);
+    map.SanityCheck();
+
+    // Erasing a flagged entry removes it from the flagged entries
+    map.erase(map.find(OutPoint(2)));
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), 1U);
+    BOOST_CHECK(map.find(OutPoint(2)) == map.end());
+    map.SanityCheck();
+}
+
+BOOST_AUTO_TEST_CASE(flagged_entries_survive_rehash)
+{
+    CCoinsMap map{SaltedOutpointHasher{/*deterministic=*/true}};
+    constexpr uint32_t NUM_ENTRIES{10'000};
+    for (uint32_t i{0}; i < NUM_ENTRIES; ++i) {
+        auto& pair{*map.try_emplace(OutPoint(i), UnspentCoin()).first};
+        if (i % 3 == 0) map.SetDirty(pair);
+        if (i % 5 == 0) map.SetFresh(pair);
+    }
+    BOOST_CHECK_EQUAL(map.size(), NUM_ENTRIES);
+    map.SanityCheck();
+
+    size_t expected_flagged{0};
+    for (uint32_t i{0}; i < NUM_ENTRIES; ++i) {
+        const auto it{map.find(OutPoint(i))};
+        BOOST_REQUIRE(it != map.end());
+        BOOST_CHECK_EQUAL(it->second.IsDirty(), i % 3 == 0);
+        BOOST_CHECK_EQUAL(it->second.IsFresh(), i % 5 == 0);
+        if (i % 3 == 0 || i % 5 == 0) ++expected_flagged;
+    }
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), expected_flagged);
+
+    // The cursor visits exactly the flagged entries.
+    size_t usage{0};
+    size_t visited{0};
+    auto cursor{CoinsViewCacheCursor(usage, map, /*will_erase=*/true)};
+    for (auto it{cursor.Begin()}; it != cursor.End(); it = cursor.NextAndMaybeErase(*it)) {
+        BOOST_CHECK(it->second.IsDirty() || it->second.IsFresh());
+        ++visited;
+    }
+    BOOST_CHECK_EQUAL(visited, expected_flagged);
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), expected_flagged);
+}
+
+BOOST_AUTO_TEST_CASE(cursor_without_erase)
+{
+    CCoinsMap map{SaltedOutpointHasher{/*deterministic=*/true}};
+    size_t usage{0};
+    for (uint32_t i{0}; i < 100; ++i) {
+        auto& pair{*map.try_emplace(OutPoint(i), UnspentCoin()).first};
+        usage += pair.second.coin.DynamicMemoryUsage();
+        if (i % 2 == 0) {
+            map.SetDirty(pair);
+            // Spend every fourth entry
+            if (i % 4 == 0) pair.second.coin.Clear();
+        }
+    }
+
+    // Spent entries are erased and the others are unflagged, without
+    // disturbing the iteration.
+    size_t visited{0};
+    auto cursor{CoinsViewCacheCursor(usage, map, /*will_erase=*/false)};
+    for (auto it{cursor.Begin()}; it != cursor.End(); it = cursor.NextAndMaybeErase(*it)) {
+        BOOST_CHECK_EQUAL(it->first.n % 2, 0U);
+        ++visited;
+    }
+    BOOST_CHECK_EQUAL(visited, 50U);
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), 0U);
+    BOOST_CHECK_EQUAL(map.size(), 75U);
+    for (uint32_t i{0}; i < 100; ++i) {
+        const auto it{map.find(OutPoint(i))};
+        BOOST_CHECK_EQUAL(it == map.end(), i % 4 == 0);
+        if (it != map.end()) BOOST_CHECK(!it->second.IsDirty() && !it->second.IsFresh());
+    }
+    map.SanityCheck();
+}
+
+BOOST_AUTO_TEST_CASE(cursor_stopped_early)
+{
+    CCoinsMap map{SaltedOutpointHasher{/*deterministic=*/true}};
+    size_t usage{0};
+    for (uint32_t i{0}; i < 100; ++i) {
+        auto& pair{*map.try_emplace(OutPoint(i), UnspentCoin()).first};
+        usage += pair.second.coin.DynamicMemoryUsage();
+        map.SetDirty(pair);
+        if (i % 2 == 0) pair.second.coin.Clear();
+    }
+
+    // A receiver that stops after ten entries, as BatchWrite does when it throws, leaves the
+    // entries it did not get to flagged, and only those.
+    {
+        auto cursor{CoinsViewCacheCursor(usage, map, /*will_erase=*/false)};
+        auto it{cursor.Begin()};
+        for (int i{0}; i < 10; ++i) it = cursor.NextAndMaybeErase(*it);
+    }
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), 90U);
+    map.SanityCheck();
+
+    // The next write visits the remaining entries.
+    size_t visited{0};
+    {
+        auto cursor{CoinsViewCacheCursor(usage, map, /*will_erase=*/false)};
+        for (auto it{cursor.Begin()}; it != cursor.End(); it = cursor.NextAndMaybeErase(*it)) {
+            BOOST_CHECK(it->second.IsDirty());
+            ++visited;
+        }
+    }
+    BOOST_CHECK_EQUAL(visited, 90U);
+    BOOST_CHECK_EQUAL(map.FlaggedCount(), 0U);
+    BOOST_CHECK_EQUAL(map.size(), 50U);
+    map.SanityCheck();
+}
+
+BOOST_AUTO_TEST_CASE(growth_budget)
+{
+    CCoinsMap map{SaltedOutpointHasher{/*deterministic=*/true}};
+    constexpr size_t MAX_CAPACITY{1024};
+    map.SetMaxMemory(MAX_CAPACITY * (1 + sizeof(CoinsCachePair)));
+
+    // The table grows by about half its size at a time, and not past the budget while the load
+    // factor allows.
+    size_t capacity{0};
+    uint32_t n{0};
+    for (; n < MAX_CAPACITY - MAX_CAPACITY / 8; ++n) {
+        BOOST_REQUIRE(map.try_emplace(OutPoint(n)).second);
+        if (map.capacity() != capacity) {
+            if (capacity) BOOST_CHECK_LE(map.capacity(), capacity + capacity / 2 + 16);
+            capacity = map.capacity();
+        }
+    }
+    BOOST_CHECK_EQUAL(map.capacity(), MAX_CAPACITY);
+    map.SanityCheck();
+
+    // Once it is full at the budget, it still grows.
+    BOOST_REQUIRE(map.try_emplace(OutPoint(n)).second);
+    BOOST_CHECK_GT(map.capacity(), MAX_CAPACITY);
+    for (uint32_t i{0}; i <= n; ++i) BOOST_CHECK(map.find(OutPoint(i)) != map.end());
+    map.SanityCheck();
+}
+
+BOOST_AUTO_TEST_CASE(erase_reuses_slots)
+{
+    CCoinsMap map{SaltedOutpointHasher{/*deterministic=*/true}};
+    // Keep a sliding window of live entries; tombstones left behind by erase
+    // must be reclaimed instead of growing the table.
+    constexpr uint32_t WINDOW{100};
+    for (uint32_t i{0}; i < 100'000; ++i) {
+        BOOST_REQUIRE(map.try_emplace(OutPoint(i)).second);
+        if (i >= WINDOW) map.erase(map.find(OutPoint(i - WINDOW)));
+    }
+    BOOST_CHECK_EQUAL(map.size(), WINDOW);
+    BOOST_CHECK_LE(map.capacity(), WINDOW * 4);
+    map.SanityCheck();
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+    map.SanityCheck();
+}
+
+BOOST_AUTO_TEST_CASE(reserve)
+{
+    CCoinsMap map;
+    BOOST_CHECK_EQUAL(map.DynamicMemoryUsage(), 0U);
+    map.reserve(1000);
+
+    // Inserting up to the reserved count must not reallocate the table.
+    const auto usage_before{map.DynamicMemoryUsage()};
+    const auto capacity_before{map.capacity()};
+    for (uint32_t i{0}; i < 1000; ++i) {
+        map.try_emplace(OutPoint(i));
+    }
+    BOOST_CHECK_EQUAL(map.DynamicMemoryUsage(), usage_before);
+    BOOST_CHECK_EQUAL(map.capacity(), capacity_before);
+    map.SanityCheck();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
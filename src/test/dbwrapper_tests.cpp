@@ -2,13 +2,23 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <crypto/common.h>
+#include <dbmmap.h>
 #include <dbwrapper.h>
 #include <test/util/random.h>
 #include <test/util/setup_common.h>
 #include <uint256.h>
+#include <util/fs.h>
 #include <util/string.h>
 
+#include <atomic>
+#include <cstdio>
+#include <map>
 #include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 
@@ -386,6 +396,219 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
     }
 }
 
+BOOST_AUTO_TEST_CASE(backend_random_ops)
+{
+    // Check both engines against a std::map, in memory and on disk, across
+    // reopens and with values large enough to be stored out of line.
+    for (const DBBackend backend : {DBBackend::LEVELDB, DBBackend::MMAP}) {
+        for (const bool memory_only : {true, false}) {
+            const fs::path ph{m_args.GetDataDirBase() / fs::u8path(strprintf("backend_%s_%s", DBBackendToString(backend), memory_only ? "mem" : "disk"))};
+            const DBParams params{.path = ph, .cache_bytes = 1 << 20, .memory_only = memory_only, .wipe_data = true, .obfuscate = true, .options = {.backend = backend}};
+            auto dbw{std::make_unique<CDBWrapper>(params)};
+            std::map<uint32_t, std::string> expected;
+
+            for (int round{0}; round < 20; ++round) {
+                CDBBatch batch{*dbw};
+                for (int i{0}; i < 500; ++i) {
+                    const uint32_t key{m_rng.randrange(uint32_t{5000})};
+                    if (m_rng.randrange(4) == 0) {
+                        batch.Erase(key);
+                        expected.erase(key);
+                    } else {
+                        std::string value(m_rng.randrange(10) == 0 ? 3000 + m_rng.randrange(5000) : m_rng.randrange(100), 'v');
+                        value += ToString(m_rng.rand32());
+                        batch.Write(key, value);
+                        expected[key] = value;
+                    }
+                }
+                BOOST_REQUIRE(dbw->WriteBatch(batch));
+
+                if (!memory_only && round % 5 == 4) {
+                    dbw.reset();
+                    dbw = std::make_unique<CDBWrapper>(DBParams{.path = ph, .cache_bytes = 1 << 20, .obfuscate = true, .options = {.backend = backend}});
+                }
+
+                for (int i{0}; i < 200; ++i) {
+                    const uint32_t key{m_rng.randrange(uint32_t{5000})};
+                    std::string value;
+                    const auto it{expected.find(key)};
+                    BOOST_CHECK_EQUAL(dbw->Read(key, value), it != expected.end());
+                    BOOST_CHECK_EQUAL(dbw->Exists(key), it != expected.end());
+                    if (it != expected.end()) BOOST_CHECK_EQUAL(value, it->second);
+                }
+            }
+
+            // Keys are serialized little-endian, so compare the full contents
+            // regardless of order.
+            std::map<uint32_t, std::string> found;
+            std::unique_ptr<CDBIterator> it{dbw->NewIterator()};
+            for (it->SeekToFirst(); it->Valid(); it->Next()) {
+                uint32_t key;
+                std::string value;
+                BOOST_REQUIRE(it->GetKey(key));
+                BOOST_REQUIRE(it->GetValue(value));
+                BOOST_CHECK(found.emplace(key, value).second);
+            }
+            BOOST_CHECK(found == expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(backend_mismatch)
+{
+    const fs::path ph{m_args.GetDataDirBase() / "backend_mismatch"};
+    {
+        CDBWrapper dbw({.path = ph, .cache_bytes = 1 << 20, .options = {.backend = DBBackend::LEVELDB}});
+        BOOST_CHECK(dbw.Write(uint8_t{'k'}, uint256::ONE));
+    }
+    // A database can not be opened with a different engine than the one that
+    // created it, unless it is wiped.
+    BOOST_CHECK_THROW(CDBWrapper({.path = ph, .cache_bytes = 1 << 20, .options = {.backend = DBBackend::MMAP}}), dbwrapper_error);
+    {
+        CDBWrapper dbw({.path = ph, .cache_bytes = 1 << 20, .wipe_data = true, .options = {.backend = DBBackend::MMAP}});
+        uint256 res;
+        BOOST_CHECK(!dbw.Read(uint8_t{'k'}, res));
+        BOOST_CHECK(dbw.Write(uint8_t{'k'}, uint256::ONE));
+    }
+    BOOST_CHECK_THROW(CDBWrapper({.path = ph, .cache_bytes = 1 << 20, .options = {.backend = DBBackend::LEVELDB}}), dbwrapper_error);
+    CDBWrapper dbw({.path = ph, .cache_bytes = 1 << 20, .options = {.backend = DBBackend::MMAP}});
+    uint256 res;
+    BOOST_CHECK(dbw.Read(uint8_t{'k'}, res));
+    BOOST_CHECK(res == uint256::ONE);
+}
+
+BOOST_AUTO_TEST_CASE(mmap_torn_meta)
+{
+    const fs::path ph{m_args.GetDataDirBase() / "mmap_torn_meta"};
+    const DBParams params{.path = ph, .cache_bytes = 1 << 20, .obfuscate = true, .options = {.backend = DBBackend::MMAP}};
+    {
+        CDBWrapper dbw{params};
+        BOOST_REQUIRE(dbw.Write(uint8_t{'a'}, uint256::ONE, /*fSync=*/true));
+        BOOST_REQUIRE(dbw.Write(uint8_t{'b'}, uint256::ONE));
+    }
+
+    // Tear the meta page of the last write, as a crash while writing it
+    // would, by clearing all of it past the transaction number (at offset 16).
+    const auto tear_meta{[&](bool latest) {
+        FILE* file{fsbridge::fopen(ph / MMAPDB_FILENAME, "rb+")};
+        BOOST_REQUIRE(file);
+        unsigned char txn[2][8];
+        for (long page{0}; page < 2; ++page) {
+            BOOST_REQUIRE_EQUAL(std::fseek(file, page * MmapDBEngine::PAGE_SIZE + 16, SEEK_SET), 0);
+            BOOST_REQUIRE_EQUAL(std::fread(txn[page], 1, 8, file), 8U);
+        }
+        const bool page{(ReadLE64(txn[1]) > ReadLE64(txn[0])) == latest};
+        const std::vector<unsigned char> zeros(MmapDBEngine::PAGE_SIZE - 24);
+        BOOST_REQUIRE_EQUAL(std::fseek(file, page * MmapDBEngine::PAGE_SIZE + 24, SEEK_SET), 0);
+        BOOST_REQUIRE_EQUAL(std::fwrite(zeros.data(), 1, zeros.size(), file), zeros.size());
+        BOOST_REQUIRE_EQUAL(std::fclose(file), 0);
+    }};
+    tear_meta(/*latest=*/true);
+
+    // The database opens at the write before, whose pages are intact.
+    {
+        CDBWrapper dbw{params};
+        uint256 res;
+        BOOST_CHECK(dbw.Read(uint8_t{'a'}, res));
+        BOOST_CHECK(res == uint256::ONE);
+        BOOST_CHECK(!dbw.Exists(uint8_t{'b'}));
+        BOOST_REQUIRE(dbw.Write(uint8_t{'c'}, uint256::ONE));
+    }
+    {
+        CDBWrapper dbw{params};
+        BOOST_CHECK(dbw.Exists(uint8_t{'a'}));
+        BOOST_CHECK(!dbw.Exists(uint8_t{'b'}));
+        BOOST_CHECK(dbw.Exists(uint8_t{'c'}));
+    }
+
+    // Without any valid meta page, the database refuses to open.
+    tear_meta(/*latest=*/true);
+    tear_meta(/*latest=*/false);
+    BOOST_CHECK_THROW(CDBWrapper{params}, dbwrapper_error);
+}
+
+BOOST_AUTO_TEST_CASE(mmap_concurrent_readers)
+{
+    // Every write replaces all entries, freeing the pages of the previous
+    // tree, while readers iterate. Each iterator must see all entries of
+    // exactly one write, including iterators taken before any of the writes
+    // and held beyond the number of lock-free reader slots.
+    const fs::path ph{m_args.GetDataDirBase() / "mmap_concurrent_readers"};
+    CDBWrapper dbw{{.path = ph, .cache_bytes = 1 << 20, .wipe_data = true, .obfuscate = true, .options = {.backend = DBBackend::MMAP}}};
+    constexpr uint32_t NUM_KEYS{200};
+    const auto write{[&](int round) {
+        CDBBatch batch{dbw};
+        for (uint32_t key{0}; key < NUM_KEYS; ++key) {
+            // Some values are stored in runs of pages of their own.
+            batch.Write(key, std::string(key % 20 == 0 ? 5000 : 50, 'v') + ToString(round));
+        }
+        BOOST_REQUIRE(dbw.WriteBatch(batch));
+    }};
+    // Returns the write all entries are from, if there is one.
+    const auto check_iterator{[&](CDBIterator& it) -> std::optional<std::string> {
+        std::optional<std::string> round;
+        uint32_t count{0};
+        for (it.SeekToFirst(); it.Valid(); it.Next(), ++count) {
+            std::string value;
+            if (!it.GetValue(value)) return std::nullopt;
+            const std::string suffix{value.substr(value.find_last_of('v') + 1)};
+            if (round && suffix != *round) return std::nullopt;
+            round = suffix;
+        }
+        if (count != NUM_KEYS) return std::nullopt;
+        return round;
+    }};
+    write(0);
+
+    std::vector<std::unique_ptr<CDBIterator>> held;
+    for (int i{0}; i < 100; ++i) held.emplace_back(dbw.NewIterator());
+
+    std::atomic<bool> done{false};
+    std::atomic<int> failures{0};
+    std::vector<std::thread> readers;
+    for (int i{0}; i < 4; ++i) {
+        readers.emplace_back([&] {
+            while (!done) {
+                std::unique_ptr<CDBIterator> it{dbw.NewIterator()};
+                if (!check_iterator(*it)) ++failures;
+                std::string value;
+                if (!dbw.Read(uint32_t{1}, value)) ++failures;
+            }
+        });
+    }
+    for (int round{1}; round <= 100; ++round) write(round);
+    done = true;
+    for (auto& reader : readers) reader.join();
+    BOOST_CHECK_EQUAL(failures, 0);
+
+    for (const auto& it : held) BOOST_CHECK(check_iterator(*it) == "0");
+    held.clear();
+    std::unique_ptr<CDBIterator> it{dbw.NewIterator()};
+    BOOST_CHECK(check_iterator(*it) == "100");
+}
+
+BOOST_AUTO_TEST_CASE(bulk_load)
+{
+    const fs::path ph{m_args.GetDataDirBase() / "bulk_load"};
+    // Data written with bulk load settings is read back with steady-state
+    // settings, also after compacting part of it. The write buffers are sized
+    // to raise the level 0 triggers.
+    for (const bool bulk_load : {true, false}) {
+        CDBWrapper dbw({.path = ph, .cache_bytes = 1 << 20, .obfuscate = true,
+                        .options = {.bulk_load = bulk_load, .bulk_write_buffer_bytes = bulk_load ? size_t{128} << 20 : 0}});
+        for (uint32_t i{0}; bulk_load && i < 10'000; ++i) {
+            BOOST_CHECK(dbw.Write(std::make_pair(uint8_t{'C'}, i), uint256{uint8_t(i)}));
+        }
+        dbw.CompactRange(std::make_pair(uint8_t{'C'}, uint32_t{0}), std::make_pair(uint8_t{'C'}, uint32_t{5'000}));
+        for (uint32_t i{0}; i < 10'000; ++i) {
+            uint256 res;
+            BOOST_CHECK(dbw.Read(std::make_pair(uint8_t{'C'}, i), res));
+            BOOST_CHECK(res == uint256{uint8_t(i)});
+        }
+        BOOST_CHECK_EQUAL(dbw.WriteStalls().count > 0, dbw.WriteStalls().duration.count() > 0);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(unicodepath)
 {
     // Attempt to create a database with a UTF8 character in the path.
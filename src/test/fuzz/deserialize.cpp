@@ -34,6 +34,7 @@
 #include <optional>
 #include <stdexcept>
 
+using node::SnapshotManifest;
 using node::SnapshotMetadata;
 
 namespace {
@@ -230,6 +231,11 @@ FUZZ_TARGET_DESERIALIZE(blockundo_deserialize, {
     CBlockUndo bu;
     DeserializeFromFuzzingInput(buffer, bu);
 })
+FUZZ_TARGET_DESERIALIZE(blockundo_columns_deserialize, {
+    CBlockUndoColumns columns;
+    DeserializeFromFuzzingInput(buffer, columns);
+    (void)columns.ToBlockUndo();
+})
 FUZZ_TARGET_DESERIALIZE(coins_deserialize, {
     Coin coin;
     DeserializeFromFuzzingInput(buffer, coin);
@@ -320,6 +326,11 @@ FUZZ_TARGET_DESERIALIZE(snapshotmetadata_deserialize, {
     SnapshotMetadata snapshot_metadata{msg_start};
     DeserializeFromFuzzingInput(buffer, snapshot_metadata);
 })
+FUZZ_TARGET_DESERIALIZE(snapshotmanifest_deserialize, {
+    auto msg_start = Params().MessageStart();
+    SnapshotManifest snapshot_manifest{msg_start};
+    DeserializeFromFuzzingInput(buffer, snapshot_manifest);
+})
 FUZZ_TARGET_DESERIALIZE(uint160_deserialize, {
     uint160 u160;
     DeserializeFromFuzzingInput(buffer, u160);
@@ -230,14 +230,19 @@ FUZZ_TARGET(txdownloadman, .init = initialize)
                 GenTxid gtxid = fuzzed_data_provider.ConsumeBool() ?
                                 GenTxid::Txid(rand_tx->GetHash()) :
                                 GenTxid::Wtxid(rand_tx->GetWitnessHash());
-                txdownloadman.AddTxAnnouncement(rand_peer, gtxid, time);
+                std::optional<node::TxAnnouncementHint> hint;
+                if (fuzzed_data_provider.ConsumeBool()) {
+                    hint = node::TxAnnouncementHint{fuzzed_data_provider.ConsumeIntegral<uint32_t>(),
+                                                    fuzzed_data_provider.ConsumeIntegralInRange<CAmount>(0, MAX_MONEY)};
+                }
+                txdownloadman.AddTxAnnouncement(rand_peer, gtxid, time, hint);
             },
             [&] {
                 txdownloadman.GetRequestsToSend(rand_peer, time);
             },
             [&] {
-                txdownloadman.ReceivedTx(rand_peer, rand_tx);
-                const auto& [should_validate, maybe_package] = txdownloadman.ReceivedTx(rand_peer, rand_tx);
+                txdownloadman.ReceivedTx(rand_peer, rand_tx, time);
+                const auto& [should_validate, maybe_package] = txdownloadman.ReceivedTx(rand_peer, rand_tx, time);
                 // The only possible results should be:
                 // - Don't validate the tx, no package.
                 // - Don't validate the tx, package.
@@ -247,7 +252,7 @@ FUZZ_TARGET(txdownloadman, .init = initialize)
                 if (maybe_package.has_value()) CheckPackageToValidate(*maybe_package, rand_peer);
             },
             [&] {
-                txdownloadman.ReceivedNotFound(rand_peer, {rand_tx->GetWitnessHash()});
+                txdownloadman.ReceivedNotFound(rand_peer, {rand_tx->GetWitnessHash()}, time);
             },
             [&] {
                 const bool expect_work{txdownloadman.HaveMoreWork(rand_peer)};
@@ -376,7 +381,12 @@ FUZZ_TARGET(txdownloadman_impl, .init = initialize)
                 GenTxid gtxid = fuzzed_data_provider.ConsumeBool() ?
                                 GenTxid::Txid(rand_tx->GetHash()) :
                                 GenTxid::Wtxid(rand_tx->GetWitnessHash());
-                txdownload_impl.AddTxAnnouncement(rand_peer, gtxid, time);
+                std::optional<node::TxAnnouncementHint> hint;
+                if (fuzzed_data_provider.ConsumeBool()) {
+                    hint = node::TxAnnouncementHint{fuzzed_data_provider.ConsumeIntegral<uint32_t>(),
+                                                    fuzzed_data_provider.ConsumeIntegralInRange<CAmount>(0, MAX_MONEY)};
+                }
+                txdownload_impl.AddTxAnnouncement(rand_peer, gtxid, time, hint);
             },
             [&] {
                 const auto getdata_requests = txdownload_impl.GetRequestsToSend(rand_peer, time);
@@ -387,7 +397,7 @@ FUZZ_TARGET(txdownloadman_impl, .init = initialize)
                 }
             },
             [&] {
-                const auto& [should_validate, maybe_package] = txdownload_impl.ReceivedTx(rand_peer, rand_tx);
+                const auto& [should_validate, maybe_package] = txdownload_impl.ReceivedTx(rand_peer, rand_tx, time);
                 // The only possible results should be:
                 // - Don't validate the tx, no package.
                 // - Don't validate the tx, package.
@@ -412,7 +422,7 @@ FUZZ_TARGET(txdownloadman_impl, .init = initialize)
                 }
             },
             [&] {
-                txdownload_impl.ReceivedNotFound(rand_peer, {rand_tx->GetWitnessHash()});
+                txdownload_impl.ReceivedNotFound(rand_peer, {rand_tx->GetWitnessHash()}, time);
             },
             [&] {
                 const bool expect_work{txdownload_impl.HaveMoreWork(rand_peer)};
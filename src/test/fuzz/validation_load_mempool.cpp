@@ -58,5 +58,5 @@ FUZZ_TARGET(validation_load_mempool, .init = initialize_validation_load_mempool)
                           .mockable_fopen_function = fuzzed_fopen,
                       });
     pool.SetLoadTried(true);
-    (void)DumpMempool(pool, MempoolPath(g_setup->m_args), fuzzed_fopen, true);
+    (void)DumpMempool(pool, chainstate, MempoolPath(g_setup->m_args), fuzzed_fopen, true);
 }
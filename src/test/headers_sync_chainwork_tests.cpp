@@ -9,6 +9,8 @@
 #include <pow.h>
 #include <test/util/setup_common.h>
 #include <validation.h>
+
+#include <chrono>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
@@ -143,4 +145,78 @@ BOOST_AUTO_TEST_CASE(headers_sync_state)
     BOOST_CHECK(result.success);
 }
 
+// Download the headers between three anchors as two ranges from different
+// peers, and check that a range only completes with the chain that reaches
+// its upper anchor.
+BOOST_AUTO_TEST_CASE(headers_range_sync)
+{
+    std::vector<CBlockHeader> chain;
+    std::vector<CBlockHeader> other_chain;
+    const uint256 genesis_hash{Params().GenesisBlock().GetHash()};
+    GenerateHeaders(chain, 20, genesis_hash, Params().GenesisBlock().nVersion,
+            Params().GenesisBlock().nTime, ArithToUint256(0), Params().GenesisBlock().nBits);
+    GenerateHeaders(other_chain, 10, genesis_hash, Params().GenesisBlock().nVersion,
+            Params().GenesisBlock().nTime, ArithToUint256(1), Params().GenesisBlock().nBits);
+    const std::vector<HeadersRangeSync::Anchor> anchors{{20, chain[19].GetHash()}, {0, genesis_hash}, {10, chain[9].GetHash()}};
+    const std::vector<CBlockHeader> lower(chain.begin(), chain.begin() + 10);
+    const std::vector<CBlockHeader> upper(chain.begin() + 10, chain.end());
+    const auto have_genesis{[&](const uint256& hash) { return hash == genesis_hash; }};
+    const std::chrono::microseconds now{1s};
+
+    HeadersRangeSync ranges{Params().GetConsensus(), anchors};
+
+    // Peers are given the lowest range they can serve that we still need.
+    BOOST_CHECK(!ranges.AssignRange(/*peer=*/0, /*best_header_height=*/0, /*peer_height=*/5, now));
+    auto request{ranges.AssignRange(/*peer=*/0, /*best_header_height=*/0, /*peer_height=*/30, now)};
+    BOOST_REQUIRE(request);
+    BOOST_CHECK(request->locator.vHave == std::vector<uint256>{genesis_hash});
+    BOOST_CHECK(request->hash_stop == chain[9].GetHash());
+    BOOST_CHECK(!ranges.AssignRange(/*peer=*/0, /*best_header_height=*/0, /*peer_height=*/30, now));
+    request = ranges.AssignRange(/*peer=*/1, /*best_header_height=*/0, /*peer_height=*/30, now);
+    BOOST_REQUIRE(request);
+    BOOST_CHECK(request->locator.vHave == std::vector<uint256>{chain[9].GetHash()});
+    BOOST_CHECK(request->hash_stop == chain[19].GetHash());
+    BOOST_CHECK(!ranges.AssignRange(/*peer=*/2, /*best_header_height=*/0, /*peer_height=*/30, now));
+
+    // The upper range completes first, but has to wait for the lower one.
+    BOOST_CHECK(!ranges.IsRangeResponse(/*peer=*/1, lower));
+    BOOST_CHECK(ranges.IsRangeResponse(/*peer=*/1, upper));
+    auto result{ranges.ProcessNextHeaders(/*peer=*/1, upper, /*full_headers_message=*/false, now)};
+    BOOST_CHECK(result.success);
+    BOOST_CHECK(!result.next_request);
+    BOOST_CHECK(ranges.PopHeadersReadyForAcceptance(have_genesis).empty());
+
+    // A chain that does not reach the anchor is discarded, and the range is
+    // given out again.
+    BOOST_CHECK(ranges.IsRangeResponse(/*peer=*/0, other_chain));
+    result = ranges.ProcessNextHeaders(/*peer=*/0, other_chain, /*full_headers_message=*/false, now);
+    BOOST_CHECK(!result.success);
+    BOOST_CHECK(!ranges.IsRangeResponse(/*peer=*/0, lower));
+    BOOST_CHECK(ranges.AssignRange(/*peer=*/2, /*best_header_height=*/0, /*peer_height=*/30, now));
+
+    // A peer that stops sending its range loses it.
+    ranges.ReleaseStalledRanges(now + 2min, 1min);
+    BOOST_CHECK(!ranges.IsRangeResponse(/*peer=*/2, lower));
+    BOOST_CHECK(ranges.AssignRange(/*peer=*/3, /*best_header_height=*/0, /*peer_height=*/30, now));
+
+    // Receive the lower range in two parts.
+    result = ranges.ProcessNextHeaders(/*peer=*/3, {lower.begin(), lower.begin() + 5}, /*full_headers_message=*/true, now);
+    BOOST_CHECK(result.success);
+    BOOST_REQUIRE(result.next_request);
+    BOOST_CHECK(result.next_request->locator.vHave == std::vector<uint256>{chain[4].GetHash()});
+    BOOST_CHECK(ranges.IsRangeResponse(/*peer=*/3, {lower.begin() + 5, lower.end()}));
+    result = ranges.ProcessNextHeaders(/*peer=*/3, {lower.begin() + 5, lower.end()}, /*full_headers_message=*/true, now);
+    BOOST_CHECK(result.success);
+    BOOST_CHECK(!result.next_request);
+
+    // Both ranges now connect to genesis, and come out as one chain.
+    const std::vector<CBlockHeader> accepted{ranges.PopHeadersReadyForAcceptance(have_genesis)};
+    BOOST_REQUIRE_EQUAL(accepted.size(), chain.size());
+    for (size_t i = 0; i < chain.size(); ++i) {
+        BOOST_CHECK(accepted[i].GetHash() == chain[i].GetHash());
+    }
+    BOOST_CHECK(ranges.PopHeadersReadyForAcceptance(have_genesis).empty());
+    BOOST_CHECK(!ranges.AssignRange(/*peer=*/4, /*best_header_height=*/0, /*peer_height=*/30, now));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,7 @@
 #include <test/util/setup_common.h>
 
 #include <boost/test/unit_test.hpp>
+#include <optional>
 #include <vector>
 
 BOOST_FIXTURE_TEST_SUITE(mempool_tests, TestingSetup)
@@ -537,17 +538,20 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     AddToMempool(pool, entry.Fee(1100LL).FromTx(tx6));
     AddToMempool(pool, entry.Fee(9000LL).FromTx(tx7));
 
-    // we only require this to remove, at max, 2 txn, because it's not clear what we're really optimizing for aside from that
+    // The cluster linearizes into the chunks [tx4] and [tx5, tx6, tx7]; eviction removes the whole
+    // lower-feerate chunk, as tx7 only pays for tx5 and tx6 together.
     pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
     BOOST_CHECK(pool.exists(GenTxid::Txid(tx4.GetHash())));
-    BOOST_CHECK(pool.exists(GenTxid::Txid(tx6.GetHash())));
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(tx5.GetHash())));
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(tx6.GetHash())));
     BOOST_CHECK(!pool.exists(GenTxid::Txid(tx7.GetHash())));
 
-    if (!pool.exists(GenTxid::Txid(tx5.GetHash())))
-        AddToMempool(pool, entry.Fee(1000LL).FromTx(tx5));
+    // With a higher fee, tx6 forms a chunk of its own with tx4, so only tx5 and tx7 are evicted.
+    AddToMempool(pool, entry.Fee(1000LL).FromTx(tx5));
+    AddToMempool(pool, entry.Fee(8000LL).FromTx(tx6));
     AddToMempool(pool, entry.Fee(9000LL).FromTx(tx7));
 
-    pool.TrimToSize(pool.DynamicMemoryUsage() / 2); // should maximize mempool size by only removing 5/7
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
     BOOST_CHECK(pool.exists(GenTxid::Txid(tx4.GetHash())));
     BOOST_CHECK(!pool.exists(GenTxid::Txid(tx5.GetHash())));
     BOOST_CHECK(pool.exists(GenTxid::Txid(tx6.GetHash())));
@@ -804,4 +808,68 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTestsDiamond)
     BOOST_CHECK_EQUAL(descendants, 4ULL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolOversizedClusterTest)
+{
+    CTxMemPool& pool = *Assert(m_node.mempool);
+    LOCK2(::cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // A chain of MAX_CLUSTER_COUNT_LIMIT transactions fills a single cluster.
+    std::vector<CTransactionRef> chain{make_tx(/*output_values=*/{10 * COIN})};
+    while (chain.size() < MAX_CLUSTER_COUNT_LIMIT) {
+        chain.push_back(make_tx(/*output_values=*/{10 * COIN}, /*inputs=*/{chain.back()}));
+    }
+    for (const auto& tx : chain) {
+        AddToMempool(pool, entry.Fee(1000LL).FromTx(tx));
+    }
+    BOOST_CHECK_EQUAL(pool.size(), MAX_CLUSTER_COUNT_LIMIT);
+
+    // The block builder hands out the chain in topological order, in chunks of
+    // non-increasing feerate.
+    {
+        const auto block_builder{pool.GetBlockBuilder()};
+        BOOST_REQUIRE(block_builder);
+        std::vector<Txid> mined;
+        std::optional<FeePerWeight> last_feerate;
+        while (const auto chunk{block_builder->GetCurrentChunk()}) {
+            if (last_feerate) BOOST_CHECK(!(chunk->second >> *last_feerate));
+            last_feerate = chunk->second;
+            for (const TxGraph::Ref* ref : chunk->first) {
+                mined.push_back(pool.GetIterFromRef(*ref)->GetTx().GetHash());
+            }
+            block_builder->Include();
+        }
+        BOOST_REQUIRE_EQUAL(mined.size(), chain.size());
+        for (size_t i{0}; i < chain.size(); ++i) {
+            BOOST_CHECK(mined[i] == chain[i]->GetHash());
+        }
+    }
+
+    // No policy limits the cluster size, so extending the chain is accepted.
+    // The graph does not linearize the oversized cluster, so there is no
+    // block builder until it is gone.
+    const CTransactionRef extension{make_tx(/*output_values=*/{10 * COIN}, /*inputs=*/{chain.back()})};
+    AddToMempool(pool, entry.Fee(1000LL).FromTx(extension));
+    BOOST_CHECK_EQUAL(pool.size(), MAX_CLUSTER_COUNT_LIMIT + 1);
+    BOOST_CHECK(!pool.GetBlockBuilder());
+
+    // Replacement diagrams fall back to the ancestor and descendant state.
+    const CTransactionRef single{make_tx(/*output_values=*/{5 * COIN})};
+    AddToMempool(pool, entry.Fee(1000LL).FromTx(single));
+    {
+        auto changeset{pool.GetChangeSet()};
+        changeset->StageRemoval(*pool.GetIter(single->GetHash()));
+        changeset->StageAddition(make_tx(/*output_values=*/{4 * COIN}), 2000, 0, 1, 0, false, 4, LockPoints{});
+        const auto diagrams{changeset->CalculateChunksForRBF()};
+        BOOST_REQUIRE(diagrams);
+        BOOST_REQUIRE_EQUAL(diagrams->first.size(), 1U);
+        BOOST_REQUIRE_EQUAL(diagrams->second.size(), 1U);
+        BOOST_CHECK_EQUAL(diagrams->first[0].fee, 1000);
+        BOOST_CHECK_EQUAL(diagrams->second[0].fee, 2000);
+    }
+
+    pool.removeRecursive(*extension, REMOVAL_REASON_DUMMY);
+    BOOST_CHECK(pool.GetBlockBuilder());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
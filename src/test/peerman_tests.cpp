@@ -3,6 +3,7 @@
 // file COPYING or https://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <consensus/consensus.h>
 #include <node/miner.h>
 #include <net_processing.h>
 #include <pow.h>
@@ -73,4 +74,51 @@ BOOST_AUTO_TEST_CASE(connections_desirable_service_flags)
     BOOST_CHECK(peerman->GetDesirableServiceFlags(peer_flags) == ServiceFlags(NODE_NETWORK | NODE_WITNESS));
 }
 
+BOOST_AUTO_TEST_CASE(block_download_window)
+{
+    // Before any block is received, the window is the full 1024 blocks
+    BOOST_CHECK_EQUAL(BlockDownloadWindow(BLOCK_DOWNLOAD_SIZE_INITIAL), 1024U);
+    // Small blocks do not widen it further
+    BOOST_CHECK_EQUAL(BlockDownloadWindow(0), 1024U);
+    BOOST_CHECK_EQUAL(BlockDownloadWindow(100'000), 1024U);
+    // Larger blocks shrink it to fit 2 GiB, but not below 64 blocks
+    BOOST_CHECK_EQUAL(BlockDownloadWindow(8 << 20), 256U);
+    BOOST_CHECK_EQUAL(BlockDownloadWindow(MAX_BLOCK_SERIALIZED_SIZE), 64U);
+    BOOST_CHECK_EQUAL(BlockDownloadWindow(4.0 * MAX_BLOCK_SERIALIZED_SIZE), 64U);
+}
+
+BOOST_AUTO_TEST_CASE(block_download_slots)
+{
+    constexpr auto no_ping{std::chrono::microseconds::max()};
+    constexpr double MiB{1 << 20};
+
+    // A peer whose throughput is not measured yet gets the full 16 slots for blocks of the initial
+    // size, and 64 MiB worth of larger blocks
+    BOOST_CHECK_EQUAL(MaxBlocksInTransit(BLOCK_DOWNLOAD_SIZE_INITIAL, 0, no_ping), 16);
+    BOOST_CHECK_EQUAL(MaxBlocksInTransit(MAX_BLOCK_SERIALIZED_SIZE, 0, no_ping), 2);
+
+    // Measured peers get their bandwidth-delay product plus 4 seconds of transfer
+    BOOST_CHECK_EQUAL(MaxBlocksInTransit(4 * MiB, 10 * MiB, no_ping), 10);
+    BOOST_CHECK_EQUAL(MaxBlocksInTransit(4 * MiB, 10 * MiB, 2s), 15);
+    BOOST_CHECK_EQUAL(MaxBlocksInTransit(4 * MiB, 100 * MiB, 0s), 16);
+    // Slow peers always keep one slot
+    BOOST_CHECK_EQUAL(MaxBlocksInTransit(4 * MiB, 1 * MiB, 1s), 1);
+    BOOST_CHECK_EQUAL(MaxBlocksInTransit(4 * MiB, 1, 0s), 1);
+}
+
+BOOST_AUTO_TEST_CASE(block_stalling_timeout)
+{
+    constexpr double MiB{1 << 20};
+
+    // Without a measured throughput the configured timeout applies
+    BOOST_CHECK(BlockStallingTimeout(4 * MiB, 0, 2s) == 2s);
+    // Fast peers are not given longer
+    BOOST_CHECK(BlockStallingTimeout(4 * MiB, 100 * MiB, 2s) == 2s);
+    // Slow peers get the time they need for one block at their own pace
+    BOOST_CHECK(BlockStallingTimeout(4 * MiB, 1 * MiB, 2s) == 4s);
+    // ... up to the maximum stalling timeout
+    BOOST_CHECK(BlockStallingTimeout(4 * MiB, 1024, 2s) == 64s);
+    BOOST_CHECK(BlockStallingTimeout(4 * MiB, 0, 64s) == 64s);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -15,6 +15,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <optional>
+#include <vector>
+
 BOOST_FIXTURE_TEST_SUITE(policyestimator_tests, ChainTestingSetup)
 
 BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
@@ -263,6 +266,127 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     for (int i = 2; i < 9; i++) { // At 9, the original estimate was already at the bottom (b/c scale = 2)
         BOOST_CHECK(feeEst.estimateFee(i).GetFeePerK() < origFeeEst[i-1] - deltaFee);
     }
+
+    // All transactions were small, so estimates for their size class match those for all
+    // transactions and there is no data for large ones.
+    for (int i = 2; i < 9; i++) {
+        for (const bool conservative : {false, true}) {
+            const CFeeRate smartFee = feeEst.estimateSmartFee(i, nullptr, conservative);
+            BOOST_CHECK(smartFee != CFeeRate(0));
+            BOOST_CHECK(feeEst.estimateSmartFee(i, nullptr, conservative, FeeEstimateSizeClass::SMALL) == smartFee);
+            BOOST_CHECK(feeEst.estimateSmartFee(i, nullptr, conservative, FeeEstimateSizeClass::LARGE) == CFeeRate(0));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(FeeEstimatesLogReplay)
+{
+    const fs::path est_path{FeeestPath(*m_node.args)};
+    const fs::path log_path{fs::path{est_path}.replace_extension(".log")};
+    CBlockPolicyEstimator feeEst{est_path, DEFAULT_ACCEPT_STALE_FEE_ESTIMATES};
+    TestMemPoolEntryHelper entry;
+
+    // Small transactions, and ones in the LARGE size class
+    CMutableTransaction small_tx;
+    small_tx.vin.resize(1);
+    for (unsigned int i = 0; i < 128; i++)
+        small_tx.vin[0].scriptSig.push_back('X');
+    small_tx.vout.resize(1);
+    CMutableTransaction large_tx{small_tx};
+    for (unsigned int i = 0; i < LARGE_TX_VSIZE_THRESHOLD; i++)
+        large_tx.vin[0].scriptSig.push_back('X');
+    BOOST_REQUIRE(GetVirtualTransactionSize(CTransaction(large_tx)) >= LARGE_TX_VSIZE_THRESHOLD);
+
+    struct PendingTx {
+        CTransactionRef tx;
+        CAmount fee;
+        unsigned int height;
+        int fee_index;
+        bool fails;
+    };
+    std::vector<PendingTx> pending;
+
+    const auto add_txs{[&](unsigned int height) {
+        for (int j = 0; j < 10; j++) { // For each fee
+            for (int k = 0; k < 4; k++) { // add 3 small and 1 large tx
+                CMutableTransaction& tx{k < 3 ? small_tx : large_tx};
+                tx.vin[0].prevout.n = 10000 * height + 100 * j + k; // make transaction unique
+                const CTransactionRef ptx{MakeTransactionRef(tx)};
+                const CAmount fee{2000 * (j + 1) * GetVirtualTransactionSize(*ptx) / 100};
+                feeEst.processTransaction(NewMempoolTransactionInfo(ptx, fee, GetVirtualTransactionSize(*ptx), height,
+                                                                    /*mempool_limit_bypassed=*/false,
+                                                                    /*submitted_in_package=*/false,
+                                                                    /*chainstate_is_current=*/true,
+                                                                    /*has_no_mempool_parents=*/true));
+                pending.push_back({ptx, fee, height, j, /*fails=*/j == 0 && k % 2 == 1});
+            }
+        }
+    }};
+
+    // Higher feerates confirm sooner, and some of the lowest ones leave the
+    // mempool unconfirmed so that failures are recorded. The periodic flushes
+    // write fee_estimates.dat once and then only append to the log.
+    const unsigned int first_flush{20};
+    const unsigned int last_block{first_flush + 100};
+    static_assert(last_block - first_flush < FEE_LOG_MAX_BLOCKS);
+    add_txs(0);
+    for (unsigned int height = 1; height <= last_block; height++) {
+        std::vector<RemovedMempoolTransactionInfo> block;
+        std::vector<PendingTx> still_pending;
+        for (const PendingTx& p : pending) {
+            const unsigned int age{height - p.height};
+            if (height == last_block || (p.fails && age > 2)) {
+                // Nothing is left unconfirmed at the end, as that is not saved.
+                feeEst.removeTx(p.tx->GetHash());
+            } else if (!p.fails && age >= 1 + static_cast<unsigned int>(9 - p.fee_index) / 3) {
+                block.emplace_back(entry.Fee(p.fee).Height(p.height).FromTx(p.tx));
+            } else {
+                still_pending.push_back(p);
+            }
+        }
+        pending = std::move(still_pending);
+        feeEst.processBlock(block, height);
+        if (height < last_block) add_txs(height);
+        if (height >= first_flush && height % 10 == 0) feeEst.FlushFeeEstimates();
+    }
+    BOOST_CHECK(fs::file_size(log_path) > uint256::size());
+
+    // A new estimator reads fee_estimates.dat and replays the log, and must
+    // give the same answers as the one that wrote them.
+    CBlockPolicyEstimator restored{est_path, DEFAULT_ACCEPT_STALE_FEE_ESTIMATES};
+
+    for (const std::optional<FeeEstimateSizeClass> size_class : {std::optional<FeeEstimateSizeClass>{}, std::optional{FeeEstimateSizeClass::SMALL}, std::optional{FeeEstimateSizeClass::LARGE}}) {
+        for (const bool conservative : {false, true}) {
+            bool have_estimate{false};
+            for (unsigned int target = 1; target <= feeEst.HighestTargetTracked(FeeEstimateHorizon::LONG_HALFLIFE); target++) {
+                FeeCalculation calc, restored_calc;
+                const CFeeRate fee{feeEst.estimateSmartFee(target, &calc, conservative, size_class)};
+                BOOST_CHECK(fee == restored.estimateSmartFee(target, &restored_calc, conservative, size_class));
+                BOOST_CHECK_EQUAL(calc.returnedTarget, restored_calc.returnedTarget);
+                BOOST_CHECK(calc.reason == restored_calc.reason);
+                have_estimate |= fee != CFeeRate(0);
+            }
+            BOOST_CHECK(have_estimate);
+        }
+    }
+
+    for (const FeeEstimateHorizon horizon : ALL_FEE_ESTIMATE_HORIZONS) {
+        BOOST_CHECK_EQUAL(feeEst.HighestTargetTracked(horizon), restored.HighestTargetTracked(horizon));
+        for (const double threshold : {0.5, 0.85, 0.95}) {
+            for (unsigned int target = 1; target <= feeEst.HighestTargetTracked(horizon); target++) {
+                EstimationResult result, restored_result;
+                BOOST_CHECK(feeEst.estimateRawFee(target, threshold, horizon, &result) ==
+                            restored.estimateRawFee(target, threshold, horizon, &restored_result));
+                for (const auto& [bucket, restored_bucket] : {std::pair{result.pass, restored_result.pass}, std::pair{result.fail, restored_result.fail}}) {
+                    BOOST_CHECK_EQUAL(bucket.start, restored_bucket.start);
+                    BOOST_CHECK_EQUAL(bucket.withinTarget, restored_bucket.withinTarget);
+                    BOOST_CHECK_EQUAL(bucket.totalConfirmed, restored_bucket.totalConfirmed);
+                    BOOST_CHECK_EQUAL(bucket.inMempool, restored_bucket.inMempool);
+                    BOOST_CHECK_EQUAL(bucket.leftMempool, restored_bucket.leftMempool);
+                }
+            }
+        }
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()
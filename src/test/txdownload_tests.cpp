@@ -338,4 +338,80 @@ BOOST_FIXTURE_TEST_CASE(handle_missing_inputs, TestChain100Setup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(priority_hints, TestingSetup)
+{
+    CTxMemPool& pool = *Assert(m_node.mempool);
+    FastRandomContext det_rand{true};
+    node::TxDownloadOptions DEFAULT_OPTS{pool, det_rand, DEFAULT_MAX_ORPHAN_TRANSACTIONS, true};
+    node::TxDownloadManagerImpl txdownload_impl{DEFAULT_OPTS};
+
+    // Two preferred peers, one slow and one fast, and a non-preferred peer that is even faster.
+    const NodeId slow_peer{0};
+    const NodeId fast_peer{1};
+    const NodeId inbound_peer{2};
+    txdownload_impl.ConnectedPeer(slow_peer, {/*m_preferred=*/true, /*m_relay_permissions=*/false, /*m_wtxid_relay=*/true});
+    txdownload_impl.ConnectedPeer(fast_peer, {/*m_preferred=*/true, /*m_relay_permissions=*/false, /*m_wtxid_relay=*/true});
+    txdownload_impl.ConnectedPeer(inbound_peer, {/*m_preferred=*/false, /*m_relay_permissions=*/false, /*m_wtxid_relay=*/true});
+    BOOST_CHECK(!txdownload_impl.GetFetchLatency(slow_peer).has_value());
+
+    std::chrono::microseconds now{GetTime<std::chrono::microseconds>()};
+
+    // Measure each peer's fetch latency with a request it answers with a NOTFOUND.
+    for (const auto& [nodeid, latency] : {std::pair{slow_peer, 1500ms}, std::pair{fast_peer, 50ms}, std::pair{inbound_peer, 10ms}}) {
+        const auto gtxid{GenTxid::Wtxid(m_rng.rand256())};
+        txdownload_impl.AddTxAnnouncement(nodeid, gtxid, now);
+        now += node::NONPREF_PEER_TX_DELAY;
+        BOOST_CHECK_EQUAL(txdownload_impl.GetRequestsToSend(nodeid, now).size(), 1U);
+        now += latency;
+        txdownload_impl.ReceivedNotFound(nodeid, {gtxid.GetHash()}, now);
+        BOOST_CHECK(txdownload_impl.GetFetchLatency(nodeid) == std::chrono::microseconds{latency});
+    }
+
+    const CFeeRate min_feerate{std::max(pool.GetMinFee(), pool.m_opts.min_relay_feerate)};
+    const node::TxAnnouncementHint low_fee_hint{1000, min_feerate.GetFee(1000)};
+    const node::TxAnnouncementHint high_fee_hint{1000, 10 * min_feerate.GetFee(1000)};
+    BOOST_CHECK(!txdownload_impl.IsPriorityHint(low_fee_hint));
+    BOOST_CHECK(txdownload_impl.IsPriorityHint(high_fee_hint));
+
+    // A non-preferred peer can't skip NONPREF_PEER_TX_DELAY by hinting at a high fee.
+    const auto inbound_gtxid{GenTxid::Wtxid(m_rng.rand256())};
+    txdownload_impl.AddTxAnnouncement(inbound_peer, inbound_gtxid, now, high_fee_hint);
+    BOOST_CHECK(txdownload_impl.GetRequestsToSend(inbound_peer, now + node::NONPREF_PEER_TX_DELAY - 1us).empty());
+    now += node::NONPREF_PEER_TX_DELAY;
+    BOOST_CHECK_EQUAL(txdownload_impl.GetRequestsToSend(inbound_peer, now).size(), 1U);
+    txdownload_impl.ReceivedNotFound(inbound_peer, {inbound_gtxid.GetHash()}, now + 10ms);
+
+    // A priority transaction is requested from the fastest preferred announcer first, and its request
+    // times out after PRIORITY_TX_MIN_INTERVAL instead of GETDATA_TX_INTERVAL.
+    const auto priority_gtxid{GenTxid::Wtxid(m_rng.rand256())};
+    txdownload_impl.AddTxAnnouncement(slow_peer, priority_gtxid, now, high_fee_hint);
+    txdownload_impl.AddTxAnnouncement(fast_peer, priority_gtxid, now, high_fee_hint);
+    now += 100ms;
+    BOOST_CHECK(txdownload_impl.GetRequestsToSend(slow_peer, now).empty());
+    const auto fast_requests{txdownload_impl.GetRequestsToSend(fast_peer, now)};
+    BOOST_CHECK_EQUAL(fast_requests.size(), 1U);
+    BOOST_CHECK(fast_requests.front().GetHash() == priority_gtxid.GetHash());
+
+    now += node::PRIORITY_TX_MIN_INTERVAL - 1us;
+    BOOST_CHECK(txdownload_impl.GetRequestsToSend(slow_peer, now).empty());
+    now += 1us;
+    const auto slow_requests{txdownload_impl.GetRequestsToSend(slow_peer, now)};
+    BOOST_CHECK_EQUAL(slow_requests.size(), 1U);
+    BOOST_CHECK(slow_requests.front().GetHash() == priority_gtxid.GetHash());
+    txdownload_impl.ReceivedNotFound(slow_peer, {priority_gtxid.GetHash()}, now + 1500ms);
+
+    // The timeout counted against the fast peer's latency.
+    BOOST_CHECK(*txdownload_impl.GetFetchLatency(fast_peer) > 50ms);
+
+    // A hint only affects requests to the peer that sent it: the request to a peer that announced
+    // the same transaction without one keeps the full GETDATA_TX_INTERVAL.
+    const auto hinted_gtxid{GenTxid::Wtxid(m_rng.rand256())};
+    txdownload_impl.AddTxAnnouncement(inbound_peer, hinted_gtxid, now, high_fee_hint);
+    txdownload_impl.AddTxAnnouncement(slow_peer, hinted_gtxid, now);
+    now += 100ms;
+    BOOST_CHECK_EQUAL(txdownload_impl.GetRequestsToSend(slow_peer, now).size(), 1U);
+    BOOST_CHECK(txdownload_impl.GetRequestsToSend(inbound_peer, now + node::PRIORITY_TX_MIN_INTERVAL).empty());
+    BOOST_CHECK_EQUAL(txdownload_impl.GetRequestsToSend(inbound_peer, now + node::GETDATA_TX_INTERVAL).size(), 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
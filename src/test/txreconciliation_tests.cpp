@@ -8,6 +8,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <set>
+
 BOOST_FIXTURE_TEST_SUITE(txreconciliation_tests, BasicTestingSetup)
 
 BOOST_AUTO_TEST_CASE(RegisterPeerTest)
@@ -81,4 +84,151 @@ BOOST_AUTO_TEST_CASE(IsPeerRegisteredTest)
     BOOST_CHECK(!tracker.IsPeerRegistered(peer_id0));
 }
 
+BOOST_AUTO_TEST_CASE(AddToSetTest)
+{
+    TxReconciliationTracker tracker(TXRECONCILIATION_VERSION);
+    NodeId peer_id0 = 0;
+
+    // Unregistered peers get every transaction flooded.
+    BOOST_CHECK(!tracker.AddToSet(peer_id0, Wtxid::FromUint256(m_rng.rand256())));
+    tracker.PreRegisterPeer(peer_id0);
+    BOOST_CHECK(!tracker.AddToSet(peer_id0, Wtxid::FromUint256(m_rng.rand256())));
+
+    // Once registered, most transactions go into the set; only the fanout share is flooded.
+    BOOST_REQUIRE_EQUAL(tracker.RegisterPeer(peer_id0, true, 1, 1), ReconciliationRegisterResult::SUCCESS);
+    size_t added{0};
+    for (int i = 0; i < 100; ++i) {
+        if (tracker.AddToSet(peer_id0, Wtxid::FromUint256(m_rng.rand256()))) ++added;
+    }
+    BOOST_CHECK(added > 50);
+    BOOST_CHECK_EQUAL(tracker.GetStats().txs_reconciled, added);
+    BOOST_CHECK_EQUAL(tracker.GetStats().txs_flooded, 100 - added);
+
+    BOOST_CHECK(ComputeReconShortID(0, 0, Wtxid{}) != 0);
+}
+
+BOOST_AUTO_TEST_CASE(ReconciliationRoundTest)
+{
+    // Two trackers reconciling with each other: the initiator knows the responder as an outbound
+    // peer, the responder knows the initiator as an inbound peer.
+    TxReconciliationTracker initiator(TXRECONCILIATION_VERSION);
+    TxReconciliationTracker responder(TXRECONCILIATION_VERSION);
+    const NodeId peer{0};
+    const uint64_t initiator_salt{initiator.PreRegisterPeer(peer)};
+    const uint64_t responder_salt{responder.PreRegisterPeer(peer)};
+    BOOST_REQUIRE_EQUAL(initiator.RegisterPeer(peer, /*is_peer_inbound=*/false, 1, responder_salt), ReconciliationRegisterResult::SUCCESS);
+    BOOST_REQUIRE_EQUAL(responder.RegisterPeer(peer, /*is_peer_inbound=*/true, 1, initiator_salt), ReconciliationRegisterResult::SUCCESS);
+
+    // Only the initiator may request, and a sketch is only accepted in response to a request.
+    BOOST_CHECK(!initiator.HandleReconciliationRequest(peer, 0, 0, 0s));
+    BOOST_CHECK(!responder.InitiateReconciliationRequest(peer, 1s));
+    BOOST_CHECK(!initiator.HandleSketch(peer, {}));
+    BOOST_CHECK(!responder.HandleReconciliationDifference(peer, true, {}));
+
+    // The responder floods everything until the initiator starts requesting reconciliations.
+    for (int i = 0; i < 20; ++i) {
+        BOOST_CHECK(!responder.AddToSet(peer, Wtxid::FromUint256(m_rng.rand256())));
+    }
+    BOOST_CHECK_EQUAL(responder.GetStats().txs_reconciled, 0U);
+    BOOST_REQUIRE(responder.HandleReconciliationRequest(peer, 0, 0, 0s));
+
+    // Both sides share the same salt, so they agree on which transactions are flooded.
+    std::set<Wtxid> initiator_only, responder_only;
+    for (int i = 0; i < 40; ++i) {
+        const auto wtxid{Wtxid::FromUint256(m_rng.rand256())};
+        BOOST_CHECK_EQUAL(initiator.AddToSet(peer, wtxid), responder.AddToSet(peer, wtxid));
+    }
+    for (int i = 0; i < 3; ++i) {
+        const auto wtxid{Wtxid::FromUint256(m_rng.rand256())};
+        if (initiator.AddToSet(peer, wtxid)) initiator_only.insert(wtxid);
+    }
+    for (int i = 0; i < 4; ++i) {
+        const auto wtxid{Wtxid::FromUint256(m_rng.rand256())};
+        if (responder.AddToSet(peer, wtxid)) responder_only.insert(wtxid);
+    }
+
+    const auto request{initiator.InitiateReconciliationRequest(peer, 1s)};
+    BOOST_REQUIRE(request);
+    // No second round while this one is outstanding.
+    BOOST_CHECK(!initiator.InitiateReconciliationRequest(peer, 1s + RECON_REQUEST_INTERVAL));
+    // A new request replaces one that wasn't answered yet.
+    BOOST_REQUIRE(responder.HandleReconciliationRequest(peer, request->first, request->second, 1s));
+
+    const auto skdata{responder.RespondToReconciliationRequest(peer)};
+    BOOST_REQUIRE(skdata && !skdata->empty());
+    const auto result{initiator.HandleSketch(peer, *skdata)};
+    BOOST_REQUIRE(result);
+    BOOST_CHECK(result->success);
+    BOOST_CHECK(std::set<Wtxid>(result->announce.begin(), result->announce.end()) == initiator_only);
+    BOOST_CHECK_EQUAL(result->ask_shortids.size(), responder_only.size());
+
+    const auto announce{responder.HandleReconciliationDifference(peer, result->success, result->ask_shortids)};
+    BOOST_REQUIRE(announce);
+    BOOST_CHECK(std::set<Wtxid>(announce->begin(), announce->end()) == responder_only);
+    BOOST_CHECK_EQUAL(initiator.GetStats().reconciliations_succeeded, 1U);
+
+    // An empty set is answered with an empty sketch, and the initiator falls back to announcing
+    // everything it had.
+    const auto wtxid{Wtxid::FromUint256(m_rng.rand256())};
+    const bool added{initiator.AddToSet(peer, wtxid)};
+    const auto next_request{initiator.InitiateReconciliationRequest(peer, 1s + RECON_REQUEST_INTERVAL)};
+    BOOST_REQUIRE(next_request);
+    BOOST_REQUIRE(responder.HandleReconciliationRequest(peer, next_request->first, next_request->second, 1s + RECON_REQUEST_INTERVAL));
+    const auto empty_skdata{responder.RespondToReconciliationRequest(peer)};
+    BOOST_REQUIRE(empty_skdata && empty_skdata->empty());
+    const auto failed_result{initiator.HandleSketch(peer, *empty_skdata)};
+    BOOST_REQUIRE(failed_result);
+    BOOST_CHECK(!failed_result->success);
+    BOOST_CHECK_EQUAL(failed_result->announce.size(), added ? 1U : 0U);
+    BOOST_CHECK_EQUAL(initiator.GetStats().reconciliations_failed, 1U);
+    BOOST_CHECK(responder.HandleReconciliationDifference(peer, false, {}));
+}
+
+BOOST_AUTO_TEST_CASE(StaleSetTest)
+{
+    TxReconciliationTracker initiator(TXRECONCILIATION_VERSION);
+    TxReconciliationTracker responder(TXRECONCILIATION_VERSION);
+    const NodeId peer{0};
+    const uint64_t initiator_salt{initiator.PreRegisterPeer(peer)};
+    const uint64_t responder_salt{responder.PreRegisterPeer(peer)};
+    BOOST_REQUIRE_EQUAL(initiator.RegisterPeer(peer, /*is_peer_inbound=*/false, 1, responder_salt), ReconciliationRegisterResult::SUCCESS);
+    BOOST_REQUIRE_EQUAL(responder.RegisterPeer(peer, /*is_peer_inbound=*/true, 1, initiator_salt), ReconciliationRegisterResult::SUCCESS);
+
+    // A responder whose peer abandons a round reconciles the snapshot again in the next one.
+    BOOST_REQUIRE(responder.HandleReconciliationRequest(peer, 0, 0, 1s));
+    std::set<Wtxid> responder_set;
+    for (int i = 0; i < 20; ++i) {
+        const auto wtxid{Wtxid::FromUint256(m_rng.rand256())};
+        if (responder.AddToSet(peer, wtxid)) responder_set.insert(wtxid);
+    }
+    BOOST_REQUIRE(!responder_set.empty());
+    const auto skdata{responder.RespondToReconciliationRequest(peer)};
+    BOOST_REQUIRE(skdata && !skdata->empty());
+    BOOST_REQUIRE(responder.HandleReconciliationRequest(peer, 0, 0, 2s));
+    const auto next_skdata{responder.RespondToReconciliationRequest(peer)};
+    BOOST_CHECK(next_skdata && *next_skdata == *skdata);
+
+    // If the peer then stops requesting, the snapshot is flooded and so is everything after it.
+    BOOST_CHECK(responder.FlushStaleSet(peer, 2s + RECON_IDLE_TIMEOUT - 1us).empty());
+    const auto responder_flushed{responder.FlushStaleSet(peer, 2s + RECON_IDLE_TIMEOUT)};
+    BOOST_CHECK(std::set<Wtxid>(responder_flushed.begin(), responder_flushed.end()) == responder_set);
+    BOOST_CHECK(!responder.AddToSet(peer, *responder_set.begin()));
+    BOOST_CHECK(!responder.HandleReconciliationDifference(peer, true, {}));
+
+    // An initiator whose request times out floods its set, and starts a new round afterwards.
+    std::set<Wtxid> initiator_set;
+    for (int i = 0; i < 20; ++i) {
+        const auto wtxid{Wtxid::FromUint256(m_rng.rand256())};
+        if (initiator.AddToSet(peer, wtxid)) initiator_set.insert(wtxid);
+    }
+    BOOST_REQUIRE(initiator.InitiateReconciliationRequest(peer, 1s));
+    BOOST_CHECK(initiator.FlushStaleSet(peer, 1s + RECON_RESPONSE_TIMEOUT - 1us).empty());
+    const auto initiator_flushed{initiator.FlushStaleSet(peer, 1s + RECON_RESPONSE_TIMEOUT)};
+    BOOST_CHECK(std::set<Wtxid>(initiator_flushed.begin(), initiator_flushed.end()) == initiator_set);
+    BOOST_CHECK(!initiator.HandleSketch(peer, *skdata));
+    const auto request{initiator.InitiateReconciliationRequest(peer, 1s + RECON_RESPONSE_TIMEOUT)};
+    BOOST_REQUIRE(request);
+    BOOST_CHECK_EQUAL(request->first, 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -570,4 +570,109 @@ BOOST_FIXTURE_TEST_CASE(version3_tests, RegTestingSetup)
     // equivalent to the tx with multiple generations of ancestors.
 }
 
+/**
+ * Ensure that a batch of transactions is evaluated in order, each against the mempool as left by
+ * the ones before it.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_accept_batch, TestChain100Setup)
+{
+    // Mature the second coinbase output spent below.
+    mineBlocks(1);
+    CKey key = GenerateRandomKey();
+    CScript spk = GetScriptForDestination(PKHash(key.GetPubKey()));
+    CScript spk2 = GetScriptForDestination(PKHash(GenerateRandomKey().GetPubKey()));
+
+    auto tx_parent = MakeTransactionRef(CreateValidMempoolTransaction(m_coinbase_txns[0], 0, 0, coinbaseKey, spk,
+                                                                      CAmount(49 * COIN), /*submit=*/false));
+    auto tx_child = MakeTransactionRef(CreateValidMempoolTransaction(tx_parent, 0, 101, key, spk2,
+                                                                     CAmount(48 * COIN), /*submit=*/false));
+    // Spends the same coin as tx_parent at the same feerate, so it cannot replace it.
+    auto tx_conflict = MakeTransactionRef(CreateValidMempoolTransaction(m_coinbase_txns[0], 0, 0, coinbaseKey, spk2,
+                                                                        CAmount(49 * COIN), /*submit=*/false));
+    auto tx_unrelated = MakeTransactionRef(CreateValidMempoolTransaction(m_coinbase_txns[1], 0, 0, coinbaseKey, spk,
+                                                                         CAmount(49 * COIN), /*submit=*/false));
+
+    LOCK(cs_main);
+    const unsigned int initial_pool_size = m_node.mempool->size();
+
+    {
+        // A child ahead of its parent cannot find its inputs.
+        const std::vector<CTransactionRef> batch{tx_child, tx_parent};
+        const auto results{m_node.chainman->ProcessTransactions(batch, /*test_accept=*/true)};
+        BOOST_REQUIRE_EQUAL(results.size(), batch.size());
+        BOOST_CHECK(results[0].m_result_type == MempoolAcceptResult::ResultType::INVALID);
+        BOOST_CHECK(results[0].m_state.GetResult() == TxValidationResult::TX_MISSING_INPUTS);
+        BOOST_CHECK(results[1].m_result_type == MempoolAcceptResult::ResultType::VALID);
+        BOOST_CHECK_EQUAL(m_node.mempool->size(), initial_pool_size);
+    }
+
+    const std::vector<CTransactionRef> batch{tx_parent, tx_child, tx_conflict, tx_unrelated};
+    const auto results{m_node.chainman->ProcessTransactions(batch)};
+    BOOST_REQUIRE_EQUAL(results.size(), batch.size());
+    BOOST_CHECK(results[0].m_result_type == MempoolAcceptResult::ResultType::VALID);
+    BOOST_CHECK(results[1].m_result_type == MempoolAcceptResult::ResultType::VALID);
+    BOOST_CHECK(results[2].m_result_type == MempoolAcceptResult::ResultType::INVALID);
+    BOOST_CHECK(results[3].m_result_type == MempoolAcceptResult::ResultType::VALID);
+
+    BOOST_CHECK_EQUAL(m_node.mempool->size(), initial_pool_size + 3);
+    BOOST_CHECK(m_node.mempool->exists(GenTxid::Txid(tx_parent->GetHash())));
+    BOOST_CHECK(m_node.mempool->exists(GenTxid::Txid(tx_child->GetHash())));
+    BOOST_CHECK(!m_node.mempool->exists(GenTxid::Txid(tx_conflict->GetHash())));
+    BOOST_CHECK(m_node.mempool->exists(GenTxid::Txid(tx_unrelated->GetHash())));
+}
+
+struct NoScriptThreadsSetup : public TestChain100Setup {
+    NoScriptThreadsSetup() : TestChain100Setup{ChainType::REGTEST, {.worker_threads_num = 0}} {}
+};
+
+/**
+ * Submit a transaction spending three coinbase outputs whose second input has the signature of the
+ * first, alone and in a batch with a valid transaction, and check the reject reason of each.
+ */
+static void CheckBadSignatureRejectReason(TestChain100Setup& setup)
+{
+    // Mature the coinbase outputs spent below.
+    setup.mineBlocks(3);
+    const CScript spk{GetScriptForDestination(PKHash(GenerateRandomKey().GetPubKey()))};
+    std::vector<COutPoint> inputs;
+    for (size_t i{0}; i < 3; ++i) inputs.emplace_back(setup.m_coinbase_txns[i]->GetHash(), 0);
+    auto [mtx, fee]{setup.CreateValidTransaction(setup.m_coinbase_txns, inputs, /*input_height=*/0, {setup.coinbaseKey},
+                                                 {CTxOut{CAmount(145 * COIN), spk}}, /*feerate=*/std::nullopt, /*fee_output=*/std::nullopt)};
+    // A well-formed signature, but committing to the spend of another input.
+    mtx.vin[1].scriptSig = mtx.vin[0].scriptSig;
+    const auto tx_bad{MakeTransactionRef(mtx)};
+    const auto tx_valid{MakeTransactionRef(setup.CreateValidMempoolTransaction(setup.m_coinbase_txns[3], 0, 0, setup.coinbaseKey, spk,
+                                                                               CAmount(49 * COIN), /*submit=*/false))};
+    const std::string expected_reason{strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(SCRIPT_ERR_EVAL_FALSE))};
+
+    LOCK(cs_main);
+    const auto result{setup.m_node.chainman->ProcessTransaction(tx_bad, /*test_accept=*/true)};
+    BOOST_CHECK(result.m_result_type == MempoolAcceptResult::ResultType::INVALID);
+    BOOST_CHECK(result.m_state.GetResult() == TxValidationResult::TX_CONSENSUS);
+    BOOST_CHECK_EQUAL(result.m_state.GetRejectReason(), expected_reason);
+
+    const std::vector<CTransactionRef> batch{tx_bad, tx_valid};
+    const auto results{setup.m_node.chainman->ProcessTransactions(batch, /*test_accept=*/true)};
+    BOOST_REQUIRE_EQUAL(results.size(), batch.size());
+    BOOST_CHECK(results[0].m_result_type == MempoolAcceptResult::ResultType::INVALID);
+    BOOST_CHECK_EQUAL(results[0].m_state.GetRejectReason(), expected_reason);
+    BOOST_CHECK(results[1].m_result_type == MempoolAcceptResult::ResultType::VALID);
+}
+
+/**
+ * Ensure that a transaction failing the verification of one of its inputs is rejected for the same
+ * reason whether its inputs are verified on the script check threads or serially.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_bad_signature_script_threads, TestChain100Setup)
+{
+    BOOST_REQUIRE(m_node.chainman->GetCheckQueue().HasThreads());
+    CheckBadSignatureRejectReason(*this);
+}
+
+BOOST_FIXTURE_TEST_CASE(tx_mempool_bad_signature_no_script_threads, NoScriptThreadsSetup)
+{
+    BOOST_REQUIRE(!m_node.chainman->GetCheckQueue().HasThreads());
+    CheckBadSignatureRejectReason(*this);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,8 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <condition_variable>
+
 BOOST_FIXTURE_TEST_SUITE(validation_flush_tests, TestingSetup)
 
 //! Test utilities for detecting when we need to flush the coins cache based
@@ -36,100 +38,43 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
         BOOST_TEST_MESSAGE("CCoinsViewCache memory usage: " << view.DynamicMemoryUsage());
     };
 
-    // PoolResource defaults to 256 KiB that will be allocated, so we'll take that and make it a bit larger.
+    // Enough room for the coins map table and a few hundred coins.
     constexpr size_t MAX_COINS_CACHE_BYTES = 262144 + 512;
 
     // Without any coins in the cache, we shouldn't need to flush.
-    BOOST_TEST(
-        chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/ 0) != CoinsCacheSizeState::CRITICAL);
-
-    // If the initial memory allocations of cacheCoins don't match these common
-    // cases, we can't really continue to make assertions about memory usage.
-    // End the test early.
-    if (view.DynamicMemoryUsage() != 32 && view.DynamicMemoryUsage() != 16) {
-        // Add a bunch of coins to see that we at least flip over to CRITICAL.
-
-        for (int i{0}; i < 1000; ++i) {
-            const COutPoint res = AddTestCoin(m_rng, view);
-            BOOST_CHECK_EQUAL(view.AccessCoin(res).DynamicMemoryUsage(), COIN_SIZE);
-        }
-
-        BOOST_CHECK_EQUAL(
-            chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/0),
-            CoinsCacheSizeState::CRITICAL);
-
-        BOOST_TEST_MESSAGE("Exiting cache flush tests early due to unsupported arch");
-        return;
-    }
-
-    print_view_mem_usage(view);
-    BOOST_CHECK_EQUAL(view.DynamicMemoryUsage(), is_64_bit ? 32U : 16U);
-
-    // We should be able to add COINS_UNTIL_CRITICAL coins to the cache before going CRITICAL.
-    // This is contingent not only on the dynamic memory usage of the Coins
-    // that we're adding (COIN_SIZE bytes per), but also on how much memory the
-    // cacheCoins (unordered_map) preallocates.
-    constexpr int COINS_UNTIL_CRITICAL{3};
-
-    // no coin added, so we have plenty of space left.
     BOOST_CHECK_EQUAL(
-        chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes*/ 0),
+        chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/ 0),
         CoinsCacheSizeState::OK);
 
-    for (int i{0}; i < COINS_UNTIL_CRITICAL; ++i) {
+    // The coins map grows its table in steps rather than per coin, so instead
+    // of predicting when each state is reached, keep adding coins until we go
+    // CRITICAL and check that the state never improves on the way there.
+    CoinsCacheSizeState state{CoinsCacheSizeState::OK};
+    for (int coins_added{0}; state != CoinsCacheSizeState::CRITICAL; ++coins_added) {
+        BOOST_REQUIRE(coins_added < 10'000);
         const COutPoint res = AddTestCoin(m_rng, view);
-        print_view_mem_usage(view);
         BOOST_CHECK_EQUAL(view.AccessCoin(res).DynamicMemoryUsage(), COIN_SIZE);
 
-        // adding first coin causes the MemoryResource to allocate one 256 KiB chunk of memory,
-        // pushing us immediately over to LARGE
-        BOOST_CHECK_EQUAL(
-            chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/ 0),
-            CoinsCacheSizeState::LARGE);
-    }
-
-    // Adding some additional coins will push us over the edge to CRITICAL.
-    for (int i{0}; i < 4; ++i) {
-        AddTestCoin(m_rng, view);
-        print_view_mem_usage(view);
-        if (chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/0) ==
-            CoinsCacheSizeState::CRITICAL) {
-            break;
-        }
+        const auto new_state{chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/ 0)};
+        BOOST_CHECK(static_cast<int>(new_state) >= static_cast<int>(state));
+        state = new_state;
     }
+    print_view_mem_usage(view);
 
-    BOOST_CHECK_EQUAL(
-        chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/0),
-        CoinsCacheSizeState::CRITICAL);
+    const size_t usage{view.DynamicMemoryUsage()};
 
-    // Passing non-zero max mempool usage (512 KiB) should allow us more headroom.
+    // Passing non-zero max mempool usage should allow us more headroom.
     BOOST_CHECK_EQUAL(
-        chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/ 1 << 19),
+        chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/ 2 * usage),
         CoinsCacheSizeState::OK);
 
-    for (int i{0}; i < 3; ++i) {
-        AddTestCoin(m_rng, view);
-        print_view_mem_usage(view);
-        BOOST_CHECK_EQUAL(
-            chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes=*/ 1 << 19),
-            CoinsCacheSizeState::OK);
-    }
-
-    // Adding another coin with the additional mempool room will put us >90%
-    // but not yet critical.
-    AddTestCoin(m_rng, view);
-    print_view_mem_usage(view);
-
-    // Only perform these checks on 64 bit hosts; I haven't done the math for 32.
-    if (is_64_bit) {
-        float usage_percentage = (float)view.DynamicMemoryUsage() / (MAX_COINS_CACHE_BYTES + (1 << 10));
-        BOOST_TEST_MESSAGE("CoinsTip usage percentage: " << usage_percentage);
-        BOOST_CHECK(usage_percentage >= 0.9);
-        BOOST_CHECK(usage_percentage < 1);
-        BOOST_CHECK_EQUAL(
-            chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes*/ 1 << 10), // 1024
-            CoinsCacheSizeState::LARGE);
-    }
+    // Being within 10% of the limit is LARGE but not yet CRITICAL.
+    BOOST_CHECK_EQUAL(
+        chainstate.GetCoinsCacheSizeState(usage + usage / 20, /*max_mempool_size_bytes=*/ 0),
+        CoinsCacheSizeState::LARGE);
+    BOOST_CHECK_EQUAL(
+        chainstate.GetCoinsCacheSizeState(usage - 1, /*max_mempool_size_bytes=*/ 0),
+        CoinsCacheSizeState::CRITICAL);
 
     // Using the default max_* values permits way more coins to be added.
     for (int i{0}; i < 1000; ++i) {
@@ -139,7 +84,8 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
             CoinsCacheSizeState::OK);
     }
 
-    // Flushing the view does take us back to OK because ReallocateCache() is called
+    // Flushing the view and the shared cache below it does take us back to OK
+    // because ReallocateCache() is called
 
     BOOST_CHECK_EQUAL(
         chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, 0),
@@ -147,11 +93,78 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
 
     view.SetBestBlock(m_rng.rand256());
     BOOST_CHECK(view.Flush());
+    BOOST_CHECK(chainstate.CoinsShared().Flush());
     print_view_mem_usage(view);
+    BOOST_CHECK_EQUAL(view.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK_EQUAL(chainstate.CoinsShared().DynamicMemoryUsage(), 0U);
 
     BOOST_CHECK_EQUAL(
         chainstate.GetCoinsCacheSizeState(MAX_COINS_CACHE_BYTES, 0),
         CoinsCacheSizeState::OK);
 }
 
+//! Coins view that holds up writes until released.
+class BlockingCoinsView : public CCoinsViewBacked
+{
+public:
+    using CCoinsViewBacked::CCoinsViewBacked;
+
+    bool BatchWrite(CoinsViewCacheCursor& cursor, const uint256& hashBlock) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_released; });
+        }
+        return CCoinsViewBacked::BatchWrite(cursor, hashBlock);
+    }
+
+    void Release() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        WITH_LOCK(m_mutex, m_released = true);
+        m_cond.notify_all();
+    }
+
+private:
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_released GUARDED_BY(m_mutex){false};
+};
+
+//! Coins written to disk in the background are still held in memory, so they
+//! must count towards the cache size until the write completes.
+BOOST_AUTO_TEST_CASE(getcoinscachesizestate_background_flush)
+{
+    Chainstate& chainstate{m_node.chainman->ActiveChainstate()};
+
+    LOCK(::cs_main);
+    auto& view{chainstate.CoinsTip()};
+    auto& flushing{chainstate.CoinsFlushing()};
+    BlockingCoinsView blocking{&chainstate.CoinsDB()};
+    flushing.SetBackend(blocking);
+
+    for (int i{0}; i < 1000; ++i) {
+        AddTestCoin(m_rng, view);
+    }
+    view.SetBestBlock(m_rng.rand256());
+    BOOST_CHECK(view.Flush());
+    flushing.DeferNextWrite();
+    BOOST_CHECK(chainstate.CoinsShared().Flush());
+
+    // The coins have left both caches but are not on disk yet.
+    const size_t cached{view.DynamicMemoryUsage() + chainstate.CoinsShared().DynamicMemoryUsage()};
+    const size_t in_flight{flushing.DynamicMemoryUsage()};
+    BOOST_CHECK_GT(in_flight, 0U);
+    BOOST_CHECK_EQUAL(
+        chainstate.GetCoinsCacheSizeState(cached + in_flight / 2, 0),
+        CoinsCacheSizeState::CRITICAL);
+
+    blocking.Release();
+    BOOST_CHECK(flushing.WaitForFlush());
+    BOOST_CHECK_EQUAL(flushing.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK(chainstate.GetCoinsCacheSizeState(cached + in_flight / 2, 0) != CoinsCacheSizeState::CRITICAL);
+
+    // Point the flush view back at the database before the blocking view goes away.
+    flushing.SetBackend(chainstate.CoinsDB());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
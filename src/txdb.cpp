@@ -12,16 +12,20 @@
 #include <random.h>
 #include <serialize.h>
 #include <uint256.h>
+#include <util/thread.h>
 #include <util/vector.h>
 
 #include <cassert>
 #include <cstdlib>
 #include <iterator>
+#include <thread>
+#include <stdexcept>
 #include <utility>
 
 static constexpr uint8_t DB_COIN{'C'};
 static constexpr uint8_t DB_BEST_BLOCK{'B'};
 static constexpr uint8_t DB_HEAD_BLOCKS{'H'};
+static constexpr uint8_t DB_COMPACT_NEXT{'K'};
 // Keys used in previous version that might still be found in the DB:
 static constexpr uint8_t DB_COINS{'c'};
 
@@ -49,20 +53,100 @@ struct CoinEntry {
 CCoinsViewDB::CCoinsViewDB(DBParams db_params, CoinsViewOptions options) :
     m_db_params{std::move(db_params)},
     m_options{std::move(options)},
-    m_db{std::make_unique<CDBWrapper>(m_db_params)} { }
+    m_db{std::make_unique<CDBWrapper>(m_db_params)}
+{
+    // Resume a compaction that was interrupted by a shutdown.
+    if (uint16_t next; m_db->Read(DB_COMPACT_NEXT, next) && next < 256) {
+        LogPrintf("Resuming compaction of the coins database at range %d of 256\n", next);
+        m_compact_next = next;
+        StartCompaction();
+    }
+}
 
-void CCoinsViewDB::ResizeCache(size_t new_cache_size)
+CCoinsViewDB::~CCoinsViewDB()
+{
+    StopCompaction();
+}
+
+void CCoinsViewDB::Reopen()
 {
     // We can't do this operation with an in-memory DB since we'll lose all the coins upon
     // reset.
-    if (!m_db_params.memory_only) {
-        // Have to do a reset first to get the original `m_db` state to release its
-        // filesystem lock.
-        m_db.reset();
-        m_db_params.cache_bytes = new_cache_size;
-        m_db_params.wipe_data = false;
-        m_db = std::make_unique<CDBWrapper>(m_db_params);
+    if (m_db_params.memory_only) return;
+    StopCompaction();
+    const DBWriteStalls stalls{m_db->WriteStalls()};
+    m_prior_write_stalls.count += stalls.count;
+    m_prior_write_stalls.duration += stalls.duration;
+    // Have to do a reset first to get the original `m_db` state to release its
+    // filesystem lock.
+    m_db.reset();
+    m_db_params.wipe_data = false;
+    m_db = std::make_unique<CDBWrapper>(m_db_params);
+    // Resume a compaction that was interrupted by the reopen.
+    if (m_compact_next >= 0) StartCompaction();
+}
+
+void CCoinsViewDB::ResizeCache(size_t new_cache_size)
+{
+    m_db_params.cache_bytes = new_cache_size;
+    Reopen();
+}
+
+void CCoinsViewDB::SetBulkLoad(bool bulk_load, size_t write_buffer_bytes)
+{
+    if (!bulk_load) write_buffer_bytes = 0;
+    if (m_db_params.options.bulk_load == bulk_load &&
+        m_db_params.options.bulk_write_buffer_bytes == write_buffer_bytes) return;
+    StopCompaction();
+    if (m_db_params.options.bulk_load != bulk_load) {
+        // Bulk loading leaves a deep backlog of level 0 and level 1 files, which
+        // slows down reads until it has been compacted away. A compaction that
+        // is still pending is redone once bulk loading ends.
+        m_compact_next = bulk_load ? -1 : 0;
+    }
+    m_db_params.options.bulk_load = bulk_load;
+    m_db_params.options.bulk_write_buffer_bytes = write_buffer_bytes;
+    Reopen();
+    if (bulk_load) m_db->Erase(DB_COMPACT_NEXT);
+    if (m_compact_next >= 0 && !m_compact_thread.joinable()) StartCompaction();
+}
+
+DBWriteStalls CCoinsViewDB::WriteStalls() const
+{
+    const DBWriteStalls stalls{m_db->WriteStalls()};
+    return {.count = m_prior_write_stalls.count + stalls.count, .duration = m_prior_write_stalls.duration + stalls.duration};
+}
+
+void CCoinsViewDB::StartCompaction()
+{
+    assert(!m_compact_thread.joinable());
+    m_compact_stop = false;
+    m_compact_thread = std::thread(&util::TraceThread, "coinscompact", [this] { ThreadCompact(); });
+}
+
+void CCoinsViewDB::StopCompaction()
+{
+    if (!m_compact_thread.joinable()) return;
+    m_compact_stop = true;
+    m_compact_thread.join();
+}
+
+void CCoinsViewDB::ThreadCompact()
+{
+    // Compact the coins in 256 ranges by the first byte of their txid, so that
+    // a shutdown or reopen of the database need not wait for all of it.
+    if (m_compact_next == 0) LogPrintf("Compacting the coins database after initial block download\n");
+    for (int range{m_compact_next}; range < 256; m_compact_next = ++range) {
+        if (m_compact_stop) return;
+        // Record where to resume if the node is shut down meanwhile.
+        m_db->Write(DB_COMPACT_NEXT, uint16_t(range));
+        const auto begin{std::make_pair(DB_COIN, uint8_t(range))};
+        const auto end{range < 255 ? std::make_pair(DB_COIN, uint8_t(range + 1)) : std::make_pair(uint8_t(DB_COIN + 1), uint8_t{0})};
+        m_db->CompactRange(begin, end);
     }
+    m_db->Erase(DB_COMPACT_NEXT);
+    m_compact_next = -1;
+    LogPrintf("Finished compacting the coins database\n");
 }
 
 std::optional<Coin> CCoinsViewDB::GetCoin(const COutPoint& outpoint) const
@@ -179,6 +263,20 @@ private:
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, COutPoint> keyTmp;
 
+    template <typename K>
+    void Seek(const K& key)
+    {
+        pcursor->Seek(key);
+        // Cache key of first record
+        if (pcursor->Valid()) {
+            CoinEntry entry(&keyTmp.second);
+            pcursor->GetKey(entry);
+            keyTmp.first = entry.key;
+        } else {
+            keyTmp.first = 0; // Make sure Valid() and GetKey() return false
+        }
+    }
+
     friend class CCoinsViewDB;
 };
 
@@ -189,15 +287,15 @@ std::unique_ptr<CCoinsViewCursor> CCoinsViewDB::Cursor() const
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COIN);
-    // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
-    } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
-    }
+    i->Seek(DB_COIN);
+    return i;
+}
+
+std::unique_ptr<CCoinsViewCursor> CCoinsViewDB::Cursor(const COutPoint& start) const
+{
+    auto i = std::make_unique<CCoinsViewDBCursor>(
+        const_cast<CDBWrapper&>(*m_db).NewIterator(), GetBestBlock());
+    i->Seek(CoinEntry{&start});
     return i;
 }
 
@@ -231,3 +329,147 @@ void CCoinsViewDBCursor::Next()
         keyTmp.first = entry.key;
     }
 }
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    if (!m_thread.joinable()) return;
+    WITH_LOCK(m_mutex, m_stop = true);
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+std::optional<Coin> CCoinsViewBackgroundFlush::GetCoin(const COutPoint& outpoint) const
+{
+    {
+        LOCK(m_mutex);
+        if (m_generation) {
+            if (const auto it{m_generation->coins.find(outpoint)}; it != m_generation->coins.end()) {
+                if (it->second.coin.IsSpent()) return std::nullopt;
+                return it->second.coin;
+            }
+        }
+    }
+    // Coins that are not part of the generation in flight are not touched by
+    // its write, so the database has their current state.
+    return base->GetCoin(outpoint);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint& outpoint) const
+{
+    {
+        LOCK(m_mutex);
+        if (m_generation) {
+            if (const auto it{m_generation->coins.find(outpoint)}; it != m_generation->coins.end()) {
+                return !it->second.coin.IsSpent();
+            }
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const
+{
+    {
+        LOCK(m_mutex);
+        if (m_generation) return m_generation->best_block;
+    }
+    return base->GetBestBlock();
+}
+
+std::vector<uint256> CCoinsViewBackgroundFlush::GetHeadBlocks() const
+{
+    WaitForFlush();
+    return base->GetHeadBlocks();
+}
+
+std::unique_ptr<CCoinsViewCursor> CCoinsViewBackgroundFlush::Cursor() const
+{
+    WaitForFlush();
+    return base->Cursor();
+}
+
+bool CCoinsViewBackgroundFlush::WaitForFlush() const
+{
+    WAIT_LOCK(m_mutex, lock);
+    m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return !m_write_queued; });
+    return !m_write_failed;
+}
+
+size_t CCoinsViewBackgroundFlush::DynamicMemoryUsage() const
+{
+    LOCK(m_mutex);
+    if (!m_generation) return 0;
+    return m_generation->coins.DynamicMemoryUsage() + m_generation->coins_usage;
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CoinsViewCacheCursor& cursor, const uint256& hashBlock)
+{
+    const bool defer{std::exchange(m_defer_next_write, false)};
+    if (!WaitForFlush()) return false;
+    if (!defer) return base->BatchWrite(cursor, hashBlock);
+
+    // Only dirty entries need to reach the database. Copying them is cheap
+    // compared to writing them, and is all that happens on the caller's thread.
+    auto generation{std::make_unique<Generation>()};
+    generation->best_block = hashBlock;
+    for (auto it{cursor.Begin()}; it != cursor.End(); it = cursor.NextAndMaybeErase(*it)) {
+        if (!it->second.IsDirty()) continue;
+        auto& pair{*generation->coins.try_emplace(it->first).first};
+        if (cursor.WillErase(*it)) {
+            pair.second.coin = std::move(it->second.coin);
+        } else {
+            pair.second.coin = it->second.coin;
+        }
+        generation->coins_usage += pair.second.coin.DynamicMemoryUsage();
+        generation->coins.SetDirty(pair);
+    }
+
+    if (!m_thread.joinable()) {
+        m_thread = std::thread(&util::TraceThread, "coinsflush", [this] { ThreadWrite(); });
+    }
+    {
+        LOCK(m_mutex);
+        m_generation = std::move(generation);
+        m_write_queued = true;
+    }
+    m_cond.notify_all();
+    return true;
+}
+
+void CCoinsViewBackgroundFlush::ThreadWrite()
+{
+    while (true) {
+        Generation* generation;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || m_write_queued; });
+            // A generation still queued when stopping is written before exiting.
+            if (!m_write_queued) return;
+            generation = m_generation.get();
+        }
+
+        // The generation is not modified until the write is done, so it can
+        // be read without the lock, concurrently with lookups from GetCoin.
+        bool written{false};
+        try {
+            size_t usage{generation->coins_usage};
+            auto cursor{CoinsViewCacheCursor(usage, generation->coins, /*will_erase=*/true)};
+            written = base->BatchWrite(cursor, generation->best_block);
+        } catch (const std::runtime_error& e) {
+            LogError("Failed to write coins to database: %s\n", e.what());
+        }
+
+        {
+            LOCK(m_mutex);
+            // On failure, keep serving the generation so that the cache above
+            // stays consistent; the next flush reports the error.
+            if (written) {
+                m_generation.reset();
+            } else {
+                m_write_failed = true;
+            }
+            m_write_queued = false;
+        }
+        m_cond.notify_all();
+    }
+}
@@ -12,10 +12,13 @@
 #include <sync.h>
 #include <util/fs.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <thread>
 #include <vector>
 
 class COutPoint;
@@ -40,8 +43,22 @@ protected:
     DBParams m_db_params;
     CoinsViewOptions m_options;
     std::unique_ptr<CDBWrapper> m_db;
+    //! Write stalls of databases opened before m_db.
+    DBWriteStalls m_prior_write_stalls;
+    //! Next range of coins to compact, or -1 if no compaction is pending. It
+    //! is also stored in the database, so that a restart resumes from there.
+    std::atomic<int> m_compact_next{-1};
+    std::atomic<bool> m_compact_stop{false};
+    std::thread m_compact_thread;
+
+    //! Reopen the database with m_db_params.
+    void Reopen() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    void StartCompaction();
+    void StopCompaction();
+    void ThreadCompact();
 public:
     explicit CCoinsViewDB(DBParams db_params, CoinsViewOptions options);
+    ~CCoinsViewDB();
 
     std::optional<Coin> GetCoin(const COutPoint& outpoint) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
@@ -49,6 +66,8 @@ public:
     std::vector<uint256> GetHeadBlocks() const override;
     bool BatchWrite(CoinsViewCacheCursor& cursor, const uint256 &hashBlock) override;
     std::unique_ptr<CCoinsViewCursor> Cursor() const override;
+    //! Cursor over the coins at or after start, in key order.
+    std::unique_ptr<CCoinsViewCursor> Cursor(const COutPoint& start) const;
 
     //! Whether an unsupported database format is used.
     bool NeedsUpgrade();
@@ -57,8 +76,80 @@ public:
     //! Dynamically alter the underlying leveldb cache size.
     void ResizeCache(size_t new_cache_size) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    //! Switch the database to settings for bulk writes during initial block
+    //! download, with write buffers of up to write_buffer_bytes on top of the
+    //! cache, or back to steady-state settings. Leaving bulk load mode
+    //! compacts the database in the background, resuming after a restart.
+    void SetBulkLoad(bool bulk_load, size_t write_buffer_bytes = 0) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool IsBulkLoad() const EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return m_db_params.options.bulk_load; }
+
+    //! Writes that stalled since this view was created.
+    DBWriteStalls WriteStalls() const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     //! @returns filesystem path to on-disk storage or std::nullopt if in memory.
     std::optional<fs::path> StoragePath() { return m_db->StoragePath(); }
 };
 
+/**
+ * CCoinsView between the coins database and the in-memory coins cache, which
+ * can write a flushed set of coins to its base in the background.
+ *
+ * A deferred BatchWrite freezes the dirty entries it is given into a generation
+ * that is not modified again, and hands it to a writer thread. Until that write
+ * completes, lookups of coins in the generation are answered from it, so the
+ * cache on top can keep connecting blocks while the database catches up. At
+ * most one generation is in flight: any other write first waits for it.
+ *
+ * Crash consistency is unchanged, as the generation is written with
+ * CCoinsViewDB::BatchWrite, which marks the database as being in transition
+ * between the old and new best block until the last batch is committed.
+ *
+ * Lookups may come from any thread: the generation is guarded by m_mutex, and
+ * the base view is only read. Writes (BatchWrite, DeferNextWrite) must be
+ * serialized by the caller.
+ */
+class CCoinsViewBackgroundFlush final : public CCoinsViewBacked
+{
+public:
+    explicit CCoinsViewBackgroundFlush(CCoinsView* view) : CCoinsViewBacked(view) {}
+    ~CCoinsViewBackgroundFlush();
+
+    std::optional<Coin> GetCoin(const COutPoint& outpoint) const override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    bool HaveCoin(const COutPoint& outpoint) const override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    uint256 GetBestBlock() const override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    std::vector<uint256> GetHeadBlocks() const override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    bool BatchWrite(CoinsViewCacheCursor& cursor, const uint256& hashBlock) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    std::unique_ptr<CCoinsViewCursor> Cursor() const override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    //! Let the next BatchWrite return once the coins are frozen, and write them in the background.
+    void DeferNextWrite() { m_defer_next_write = true; }
+
+    //! Wait until the generation in flight, if any, has been written.
+    //! @returns false if writing it failed.
+    bool WaitForFlush() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    //! Memory held by the generation in flight.
+    size_t DynamicMemoryUsage() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    struct Generation {
+        CCoinsMap coins;
+        size_t coins_usage{0};
+        uint256 best_block;
+    };
+
+    mutable Mutex m_mutex;
+    mutable std::condition_variable m_cond;
+    //! Coins being written, readable until the write has succeeded.
+    std::unique_ptr<Generation> m_generation GUARDED_BY(m_mutex);
+    bool m_write_queued GUARDED_BY(m_mutex){false};
+    bool m_write_failed GUARDED_BY(m_mutex){false};
+    bool m_stop GUARDED_BY(m_mutex){false};
+    //! Only accessed by writers.
+    bool m_defer_next_write{false};
+    std::thread m_thread;
+
+    void ThreadWrite() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+};
+
 #endif // QTC_TXDB_H
@@ -145,6 +145,7 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256>& vHashes
                 if (!visited(childIter) && !setAlreadyIncluded.count(childHash)) {
                     UpdateChild(it, childIter, true);
                     UpdateParent(childIter, it, true);
+                    m_txgraph->AddDependency(*it, *childIter);
                 }
             }
         } // release epoch guard for UpdateForDescendants
@@ -414,6 +415,7 @@ static CTxMemPool::Options&& Flatten(CTxMemPool::Options&& opts, bilingual_str&
 CTxMemPool::CTxMemPool(Options opts, bilingual_str& error)
     : m_opts{Flatten(std::move(opts), error)}
 {
+    m_txgraph = MakeTxGraph(MAX_CLUSTER_COUNT_LIMIT);
 }
 
 bool CTxMemPool::isSpent(const COutPoint& outpoint) const
@@ -435,6 +437,7 @@ void CTxMemPool::AddTransactionsUpdated(unsigned int n)
 void CTxMemPool::Apply(ChangeSet* changeset)
 {
     AssertLockHeld(cs);
+    m_txgraph->CommitStaging();
     RemoveStaged(changeset->m_to_remove, false, MemPoolRemovalReason::REPLACED);
 
     for (size_t i=0; i<changeset->m_entry_vec.size(); ++i) {
@@ -508,6 +511,7 @@ void CTxMemPool::addNewTransaction(CTxMemPool::txiter newit, CTxMemPool::setEntr
     m_total_fee += entry.GetFee();
 
     txns_randomized.emplace_back(newit->GetSharedTx());
+    wtxids_randomized.emplace_back(newit->GetTx().GetWitnessHash());
     newit->idx_randomized = txns_randomized.size() - 1;
 
     TRACEPOINT(mempool, added,
@@ -549,15 +553,22 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
         // Remove entry from txns_randomized by replacing it with the back and deleting the back.
         txns_randomized[it->idx_randomized] = std::move(txns_randomized.back());
         txns_randomized.pop_back();
-        if (txns_randomized.size() * 2 < txns_randomized.capacity())
+        wtxids_randomized[it->idx_randomized] = wtxids_randomized.back();
+        wtxids_randomized.pop_back();
+        if (txns_randomized.size() * 2 < txns_randomized.capacity()) {
             txns_randomized.shrink_to_fit();
-    } else
+            wtxids_randomized.shrink_to_fit();
+        }
+    } else {
         txns_randomized.clear();
+        wtxids_randomized.clear();
+    }
 
     totalTxSize -= it->GetTxSize();
     m_total_fee -= it->GetFee();
     cachedInnerUsage -= it->DynamicMemoryUsage();
     cachedInnerUsage -= memusage::DynamicUsage(it->GetMemPoolParentsConst()) + memusage::DynamicUsage(it->GetMemPoolChildrenConst());
+    m_txgraph->RemoveTransaction(*it);
     mapTx.erase(it);
     nTransactionsUpdated++;
 }
@@ -792,6 +803,9 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
     assert(totalTxSize == checkTotal);
     assert(m_total_fee == check_total_fee);
     assert(innerUsage == cachedInnerUsage);
+
+    assert(m_txgraph->GetTransactionCount(/*main_only=*/true) == mapTx.size());
+    m_txgraph->SanityCheck();
 }
 
 bool CTxMemPool::CompareDepthAndScore(const uint256& hasha, const uint256& hashb, bool wtxid)
@@ -919,6 +933,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
             mapTx.modify(it, [&nFeeDelta](CTxMemPoolEntry& e) { e.UpdateModifiedFee(nFeeDelta); });
+            m_txgraph->SetTransactionFee(*it, it->GetModifiedFee());
             // Now update all ancestors' modified fees with descendants
             auto ancestors{AssumeCalculateMemPoolAncestors(__func__, *it, Limits::NoLimits(), /*fSearchForParents=*/false)};
             for (txiter ancestorIt : ancestors) {
@@ -984,6 +999,13 @@ const CTransaction* CTxMemPool::GetConflictTx(const COutPoint& prevout) const
     return it == mapNextTx.end() ? nullptr : it->second;
 }
 
+std::unique_ptr<TxGraph::BlockBuilder> CTxMemPool::GetBlockBuilder() const
+{
+    AssertLockHeld(cs);
+    if (m_txgraph->IsOversized(/*main_only=*/true)) return nullptr;
+    return m_txgraph->GetBlockBuilder();
+}
+
 std::optional<CTxMemPool::txiter> CTxMemPool::GetIter(const uint256& txid) const
 {
     auto it = mapTx.find(txid);
@@ -1063,7 +1085,7 @@ void CCoinsViewMemPool::Reset()
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 15 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(txns_randomized) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(txns_randomized) + memusage::DynamicUsage(wtxids_randomized) + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveUnbroadcastTx(const uint256& txid, const bool unchecked) {
@@ -1162,19 +1184,31 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
     while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
-        indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+        setEntries stage;
+        CFeeRate removed;
+        if (!m_txgraph->IsOversized(/*main_only=*/true)) {
+            // The last chunk of the linearization is the least valuable set of
+            // transactions to mine, and already contains all of its in-mempool
+            // descendants.
+            const auto [worst_chunk, worst_feerate]{m_txgraph->GetWorstMainChunk()};
+            for (const TxGraph::Ref* ref : worst_chunk) {
+                stage.insert(GetIterFromRef(*ref));
+            }
+            removed = CFeeRate(worst_feerate.fee, worst_feerate.size);
+        } else {
+            indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+            CalculateDescendants(mapTx.project<0>(it), stage);
+            removed = CFeeRate(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+        }
 
         // We set the new mempool min fee to the feerate of the removed set, plus the
         // "minimum reasonable fee rate" (ie some value under which we consider txn
         // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
         // equal to txn which were removed with no block in between.
-        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
         removed += m_opts.incremental_relay_feerate;
         trackPackageRemoved(removed);
         maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
 
-        setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
         nTxnRemoved += stage.size();
 
         std::vector<CTransaction> txn;
@@ -1315,17 +1349,32 @@ std::optional<std::string> CTxMemPool::CheckConflictTopology(const setEntries& d
 util::Result<std::pair<std::vector<FeeFrac>, std::vector<FeeFrac>>> CTxMemPool::ChangeSet::CalculateChunksForRBF()
 {
     LOCK(m_pool->cs);
-    FeeFrac replacement_feerate{0, 0};
-    for (auto it : m_entry_vec) {
-        replacement_feerate += {it->GetModifiedFee(), it->GetTxSize()};
-    }
 
+    // The topology restriction is RBF policy, and also what makes the fallback
+    // below exact.
     auto err_string{m_pool->CheckConflictTopology(m_to_remove)};
     if (err_string.has_value()) {
         // Unsupported topology for calculating a feerate diagram
         return util::Error{Untranslated(err_string.value())};
     }
 
+    // The staged additions and removals live in the graph's staging level, so
+    // the old and new diagrams are the chunks of the linearizations of all
+    // clusters that differ between the mempool and staging.
+    if (m_pool->m_txgraph->IsOversized(/*main_only=*/true) || m_pool->m_txgraph->IsOversized(/*main_only=*/false)) {
+        return CalculateChunksForRBFFromAggregates();
+    }
+    return m_pool->m_txgraph->GetMainStagingDiagrams();
+}
+
+std::pair<std::vector<FeeFrac>, std::vector<FeeFrac>> CTxMemPool::ChangeSet::CalculateChunksForRBFFromAggregates() const
+{
+    AssertLockHeld(m_pool->cs);
+    FeeFrac replacement_feerate{0, 0};
+    for (auto it : m_entry_vec) {
+        replacement_feerate += {it->GetModifiedFee(), it->GetTxSize()};
+    }
+
     // new diagram will have chunks that consist of each ancestor of
     // direct_conflicts that is at its own fee/size, along with the replacement
     // tx/package at its own fee/size
@@ -1412,10 +1461,30 @@ CTxMemPool::ChangeSet::TxHandle CTxMemPool::ChangeSet::StageAddition(const CTran
     m_pool->ApplyDelta(tx->GetHash(), delta);
     if (delta) m_to_add.modify(newit, [&delta](CTxMemPoolEntry& e) { e.UpdateModifiedFee(delta); });
 
+    // Sizes in the graph are virtual sizes, so that chunk feerates compare
+    // directly with CFeeRate-based policy.
+    m_to_add.modify(newit, [this](CTxMemPoolEntry& e) EXCLUSIVE_LOCKS_REQUIRED(m_pool->cs) {
+        static_cast<TxGraph::Ref&>(e) = m_pool->m_txgraph->AddTransaction(FeePerWeight{e.GetModifiedFee(), e.GetTxSize()});
+    });
+    for (const CTxIn& txin : tx->vin) {
+        if (const auto parent{m_pool->GetIter(txin.prevout.hash)}) {
+            m_pool->m_txgraph->AddDependency(**parent, *newit);
+        } else if (const auto staged_parent{m_to_add.find(txin.prevout.hash)}; staged_parent != m_to_add.end()) {
+            m_pool->m_txgraph->AddDependency(*staged_parent, *newit);
+        }
+    }
+
     m_entry_vec.push_back(newit);
     return newit;
 }
 
+void CTxMemPool::ChangeSet::StageRemoval(CTxMemPool::txiter it)
+{
+    LOCK(m_pool->cs);
+    m_pool->m_txgraph->RemoveTransaction(*it);
+    m_to_remove.insert(it);
+}
+
 void CTxMemPool::ChangeSet::Apply()
 {
     LOCK(m_pool->cs);
@@ -1424,4 +1493,7 @@ void CTxMemPool::ChangeSet::Apply()
     m_to_remove.clear();
     m_entry_vec.clear();
     m_ancestors.clear();
+    // Apply() committed the staged graph changes; stage anything further
+    // afresh until the changeset is destroyed.
+    m_pool->m_txgraph->StartStaging();
 }
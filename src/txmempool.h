@@ -18,6 +18,7 @@
 #include <policy/packages.h>
 #include <primitives/transaction.h>
 #include <sync.h>
+#include <txgraph.h>
 #include <util/epochguard.h>
 #include <util/hasher.h>
 #include <util/result.h>
@@ -33,6 +34,7 @@
 
 #include <atomic>
 #include <map>
+#include <memory>
 #include <optional>
 #include <set>
 #include <string>
@@ -299,6 +301,23 @@ struct TxMempoolInfo
  * CalculateMemPoolAncestors() takes configurable limits that are designed to
  * prevent these calculations from being too CPU intensive.
  *
+ * Clusters:
+ *
+ * m_txgraph holds the same transactions and dependencies, grouped into
+ * clusters with a linearization each. It is what block assembly (by chunk
+ * feerate), eviction in TrimToSize() (worst chunk first) and the feerate
+ * diagrams of replacements in ChangeSet::CalculateChunksForRBF() use. The
+ * ancestor and descendant state above is still maintained alongside it, as
+ * the ancestor/descendant limits, the other replacement rules and the RPCs
+ * are defined in its terms.
+ *
+ * No policy limits the size of a cluster: the ancestor and descendant limits
+ * do not bound it, so the graph can hold a cluster above
+ * MAX_CLUSTER_COUNT_LIMIT, which it does not linearize. While it does, the
+ * three users above fall back to the ancestor and descendant state: block
+ * assembly selects by ancestor score, TrimToSize() evicts by descendant score
+ * and CalculateChunksForRBF() derives the diagrams from the aggregates.
+ *
  */
 class CTxMemPool
 {
@@ -323,6 +342,12 @@ protected:
 
     bool m_load_tried GUARDED_BY(cs){false};
 
+    /** Clusters of the mempool and their linearizations. Every entry in mapTx
+     *  (and every entry staged in a ChangeSet) is a TxGraph::Ref into it. While
+     *  a ChangeSet is outstanding, its additions and removals live in the
+     *  graph's staging level. */
+    std::unique_ptr<TxGraph> m_txgraph GUARDED_BY(cs);
+
     CFeeRate GetMinFee(size_t sizelimit) const;
 
 public:
@@ -392,6 +417,7 @@ public:
 
     using txiter = indexed_transaction_set::nth_index<0>::type::const_iterator;
     std::vector<CTransactionRef> txns_randomized GUARDED_BY(cs); //!< All transactions in mapTx, in random order
+    std::vector<Wtxid> wtxids_randomized GUARDED_BY(cs); //!< Witness hashes of txns_randomized, in the same order, so they can be scanned without dereferencing every transaction
 
     typedef std::set<txiter, CompareIteratorByHash> setEntries;
 
@@ -500,6 +526,18 @@ public:
     /** Returns an iterator to the given hash, if found */
     std::optional<txiter> GetIter(const uint256& txid) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** Returns the iterator of an entry, given its Ref in the mempool's TxGraph */
+    txiter GetIterFromRef(const TxGraph::Ref& ref) const EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        return mapTx.iterator_to(static_cast<const CTxMemPoolEntry&>(ref));
+    }
+
+    /** Returns a builder yielding the mempool's chunks in decreasing feerate
+     *  order, or nullptr if some cluster exceeds the cluster count limit (which
+     *  only transactions added without a ChangeSet can cause). No transactions
+     *  may be added or removed while the builder exists. */
+    std::unique_ptr<TxGraph::BlockBuilder> GetBlockBuilder() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     /** Translate a set of hashes into a set of pool iterators to avoid repeated lookups.
      * Does not require that all of the hashes correspond to actual transactions in the mempool,
      * only returns the ones that exist. */
@@ -598,6 +636,7 @@ public:
     }
 
     /** Remove transactions from the mempool until its dynamic size is <= sizelimit.
+      *  The lowest-feerate chunk of the cluster linearization is evicted first.
       *  pvNoSpendsRemaining, if set, will be populated with the list of outpoints
       *  which are not in mempool which no longer have any spends in this mempool.
       */
@@ -821,8 +860,12 @@ public:
      */
     class ChangeSet {
     public:
-        explicit ChangeSet(CTxMemPool* pool) : m_pool(pool) {}
-        ~ChangeSet() EXCLUSIVE_LOCKS_REQUIRED(m_pool->cs) { m_pool->m_have_changeset = false; }
+        explicit ChangeSet(CTxMemPool* pool) EXCLUSIVE_LOCKS_REQUIRED(pool->cs) : m_pool(pool) { m_pool->m_txgraph->StartStaging(); }
+        ~ChangeSet() EXCLUSIVE_LOCKS_REQUIRED(m_pool->cs)
+        {
+            m_pool->m_txgraph->AbortStaging();
+            m_pool->m_have_changeset = false;
+        }
 
         ChangeSet(const ChangeSet&) = delete;
         ChangeSet& operator=(const ChangeSet&) = delete;
@@ -830,7 +873,7 @@ public:
         using TxHandle = CTxMemPool::txiter;
 
         TxHandle StageAddition(const CTransactionRef& tx, const CAmount fee, int64_t time, unsigned int entry_height, uint64_t entry_sequence, bool spends_coinbase, int64_t sigops_cost, LockPoints lp);
-        void StageRemoval(CTxMemPool::txiter it) { m_to_remove.insert(it); }
+        void StageRemoval(CTxMemPool::txiter it);
 
         const CTxMemPool::setEntries& GetRemovals() const { return m_to_remove; }
 
@@ -859,9 +902,14 @@ public:
 
         /**
          * Calculate the sorted chunks for the old and new mempool relating to the
-         * clusters that would be affected by a potential replacement transaction.
+         * clusters that would be affected by a potential replacement transaction,
+         * from the linearizations of the mempool's TxGraph and its staging level.
+         *
+         * While the graph holds an oversized cluster, the diagrams are derived from
+         * the cached ancestor and descendant state instead, which the topology
+         * restriction makes exact for the clusters of the conflicts.
          *
-         * @return old and new diagram pair respectively, or an error string if the conflicts don't match a calculable topology
+         * @return old and new diagram pair respectively, or an error string if the conflicts don't match a supported topology
          */
         util::Result<std::pair<std::vector<FeeFrac>, std::vector<FeeFrac>>> CalculateChunksForRBF();
 
@@ -878,6 +926,9 @@ public:
         std::map<CTxMemPool::txiter, CTxMemPool::setEntries, CompareIteratorByHash> m_ancestors;
         CTxMemPool::setEntries m_to_remove;
 
+        //! Feerate diagrams of CalculateChunksForRBF() while the graph is oversized.
+        std::pair<std::vector<FeeFrac>, std::vector<FeeFrac>> CalculateChunksForRBFFromAggregates() const EXCLUSIVE_LOCKS_REQUIRED(m_pool->cs);
+
         friend class CTxMemPool;
     };
 
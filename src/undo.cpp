@@ -0,0 +1,70 @@
+// Copyright (c) 2026-present The QTC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <undo.h>
+
+#include <util/hasher.h>
+
+#include <algorithm>
+#include <span>
+#include <unordered_map>
+
+namespace {
+struct ScriptBytesEqual {
+    bool operator()(std::span<const unsigned char> a, std::span<const unsigned char> b) const
+    {
+        return std::ranges::equal(a, b);
+    }
+};
+} // namespace
+
+CBlockUndoColumns::CBlockUndoColumns(const CBlockUndo& blockundo)
+{
+    size_t count{0};
+    for (const CTxUndo& txundo : blockundo.vtxundo) count += txundo.vprevout.size();
+    tx_coins.reserve(blockundo.vtxundo.size());
+    height_codes.reserve(count);
+    amounts.reserve(count);
+    script_ids.reserve(count);
+
+    // Keys point into the scripts of blockundo, which outlives the map.
+    std::unordered_map<std::span<const unsigned char>, uint32_t, SaltedSipHasher, ScriptBytesEqual> script_index;
+    for (const CTxUndo& txundo : blockundo.vtxundo) {
+        tx_coins.push_back(txundo.vprevout.size());
+        for (const Coin& coin : txundo.vprevout) {
+            height_codes.push_back(coin.nHeight * uint32_t{2} + coin.fCoinBase);
+            amounts.push_back(coin.out.nValue);
+            const auto [it, inserted]{script_index.try_emplace(std::span{coin.out.scriptPubKey}, scripts.size())};
+            if (inserted) scripts.push_back(coin.out.scriptPubKey);
+            script_ids.push_back(it->second);
+        }
+    }
+}
+
+CBlockUndo CBlockUndoColumns::ToBlockUndo() const
+{
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(tx_coins.size());
+    size_t pos{0};
+    for (size_t tx{0}; tx < tx_coins.size(); ++tx) {
+        auto& vprevout{blockundo.vtxundo[tx].vprevout};
+        vprevout.reserve(tx_coins[tx]);
+        for (uint32_t i{0}; i < tx_coins[tx]; ++i) {
+            vprevout.push_back(GetCoin(pos++));
+        }
+    }
+    return blockundo;
+}
+
+void CBlockUndoColumns::CheckColumns() const
+{
+    uint64_t count{0};
+    for (const uint32_t coins : tx_coins) count += coins;
+    if (count != height_codes.size() || count != amounts.size() || count != script_ids.size()) {
+        throw std::ios_base::failure("Block undo columns of different sizes");
+    }
+    if (std::ranges::any_of(script_ids, [&](uint32_t id) { return id >= scripts.size(); })) {
+        throw std::ios_base::failure("Block undo script index out of range");
+    }
+}
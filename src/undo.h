@@ -10,8 +10,15 @@
 #include <compressor.h>
 #include <consensus/consensus.h>
 #include <primitives/transaction.h>
+#include <script/script.h>
 #include <serialize.h>
 
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <span>
+#include <vector>
+
 /** Formatter for undo information for a CTxIn
  *
  *  Contains the prevout's CTxOut being spent, and its metadata as well
@@ -67,4 +74,130 @@ public:
     SERIALIZE_METHODS(CBlockUndo, obj) { READWRITE(obj.vtxundo); }
 };
 
+/** Formatter for the scripts of CBlockUndoColumns.
+ *
+ *  The quantum-safe output templates are stored as a tag and their 32-byte
+ *  hash. Other scripts are stored as a tag followed by their ScriptCompression.
+ */
+struct UndoScriptFormatter
+{
+    enum Tag : uint8_t {
+        OTHER = 0,
+        QUANTUM_KEYHASH = 1,    //!< OP_DUP OP_QHASH <32 bytes> OP_EQUALVERIFY OP_QCHECKSIG
+        QUANTUM_SCRIPTHASH = 2, //!< OP_QHASH <32 bytes> OP_EQUAL
+        WITNESS_V2_QKEYHASH = 3, //!< OP_2 <32 bytes>
+    };
+
+    static Tag GetTag(const CScript& script)
+    {
+        if (script.size() == 37 && script[0] == OP_DUP && script[1] == OP_QHASH && script[2] == 32 &&
+            script[35] == OP_EQUALVERIFY && script[36] == OP_QCHECKSIG) {
+            return QUANTUM_KEYHASH;
+        }
+        if (script.size() == 35 && script[0] == OP_QHASH && script[1] == 32 && script[34] == OP_EQUAL) {
+            return QUANTUM_SCRIPTHASH;
+        }
+        if (script.size() == 34 && script[0] == OP_2 && script[1] == 32) {
+            return WITNESS_V2_QKEYHASH;
+        }
+        return OTHER;
+    }
+
+    //! Position of the hash in a script with the given tag.
+    static size_t HashOffset(Tag tag) { return tag == QUANTUM_KEYHASH ? 3 : 2; }
+
+    template<typename Stream>
+    void Ser(Stream& s, const CScript& script)
+    {
+        const Tag tag{GetTag(script)};
+        s << uint8_t{tag};
+        if (tag == OTHER) {
+            s << Using<ScriptCompression>(script);
+        } else {
+            s << std::span{script}.subspan(HashOffset(tag), 32);
+        }
+    }
+
+    template<typename Stream>
+    void Unser(Stream& s, CScript& script)
+    {
+        uint8_t tag;
+        s >> tag;
+        switch (tag) {
+        case OTHER:
+            s >> Using<ScriptCompression>(script);
+            return;
+        case QUANTUM_KEYHASH:
+            script = CScript() << OP_DUP << OP_QHASH;
+            break;
+        case QUANTUM_SCRIPTHASH:
+            script = CScript() << OP_QHASH;
+            break;
+        case WITNESS_V2_QKEYHASH:
+            script = CScript() << OP_2;
+            break;
+        default:
+            throw std::ios_base::failure("Unknown undo script tag");
+        }
+        // Append the push of the hash, then the opcodes following it.
+        script.push_back(32);
+        script.resize(script.size() + 32);
+        s >> std::span{script}.last(32);
+        if (tag == QUANTUM_KEYHASH) script << OP_EQUALVERIFY << OP_QCHECKSIG;
+        if (tag == QUANTUM_SCRIPTHASH) script << OP_EQUAL;
+    }
+};
+
+/**
+ * Undo information for a CBlock, in the columnar format of blocks with
+ * BLOCK_UNDO_COLUMNAR set.
+ *
+ * Instead of a record per spent coin, the heights, amounts and scripts of all
+ * coins spent by the block are stored as separate columns, in the order of
+ * the transactions and their inputs. Each distinct script is stored once, and
+ * coins refer to it by index, so that a script paid to repeatedly is only
+ * decoded once when the block is disconnected.
+ */
+class CBlockUndoColumns
+{
+public:
+    //! Number of coins spent by each transaction but the coinbase.
+    std::vector<uint32_t> tx_coins;
+    //! Per coin, its height times two, plus one if it was created by a coinbase.
+    std::vector<uint32_t> height_codes;
+    std::vector<CAmount> amounts;
+    //! Per coin, the index of its scriptPubKey in scripts.
+    std::vector<uint32_t> script_ids;
+    //! The distinct scriptPubKeys of the spent coins.
+    std::vector<CScript> scripts;
+
+    CBlockUndoColumns() = default;
+    explicit CBlockUndoColumns(const CBlockUndo& blockundo);
+
+    //! Number of spent coins.
+    size_t size() const { return height_codes.size(); }
+
+    //! The i-th spent coin.
+    Coin GetCoin(size_t i) const
+    {
+        return Coin{CTxOut{amounts[i], scripts[script_ids[i]]}, int(height_codes[i] >> 1), bool(height_codes[i] & 1)};
+    }
+
+    CBlockUndo ToBlockUndo() const;
+
+    SERIALIZE_METHODS(CBlockUndoColumns, obj)
+    {
+        READWRITE(Using<VectorFormatter<VarIntFormatter<VarIntMode::DEFAULT>>>(obj.tx_coins),
+                  Using<VectorFormatter<VarIntFormatter<VarIntMode::DEFAULT>>>(obj.height_codes),
+                  Using<VectorFormatter<AmountCompression>>(obj.amounts),
+                  Using<VectorFormatter<UndoScriptFormatter>>(obj.scripts),
+                  Using<VectorFormatter<VarIntFormatter<VarIntMode::DEFAULT>>>(obj.script_ids));
+        SER_READ(obj, obj.CheckColumns());
+    }
+
+private:
+    //! Throw if the columns do not describe the same coins.
+    void CheckColumns() const;
+};
+
 #endif // QTC_UNDO_H
@@ -17,9 +17,11 @@
 #include <consensus/tx_check.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/muhash.h>
 #include <cuckoocache.h>
 #include <flatfile.h>
 #include <hash.h>
+#include <kernel/caches.h>
 #include <kernel/chain.h>
 #include <kernel/chainparams.h>
 #include <kernel/coinstats.h>
@@ -61,21 +63,29 @@
 #include <util/string.h>
 #include <util/time.h>
 #include <util/trace.h>
+#include <util/thread.h>
 #include <util/translation.h>
 #include <validationinterface.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <deque>
 #include <numeric>
 #include <optional>
 #include <ranges>
+#include <set>
 #include <span>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
+using kernel::ApplyCoinHash;
 using kernel::CCoinsStats;
 using kernel::CoinStatsHashType;
 using kernel::ComputeUTXOStats;
@@ -86,6 +96,7 @@ using node::BlockManager;
 using node::BlockMap;
 using node::CBlockIndexHeightOnlyComparator;
 using node::CBlockIndexWorkComparator;
+using node::SnapshotManifest;
 using node::SnapshotMetadata;
 
 /** Size threshold for warning about slow UTXO set flush to disk. */
@@ -265,7 +276,7 @@ bool CheckSequenceLocksAtTip(CBlockIndex* tip,
 // Returns the script flags which should be checked for a given block
 static unsigned int GetBlockScriptFlags(const CBlockIndex& block_index, const ChainstateManager& chainman);
 
-static void LimitMempoolSize(CTxMemPool& pool, CCoinsViewCache& coins_cache)
+static void LimitMempoolSize(CTxMemPool& pool, Chainstate& chainstate)
     EXCLUSIVE_LOCKS_REQUIRED(::cs_main, pool.cs)
 {
     AssertLockHeld(::cs_main);
@@ -278,7 +289,7 @@ static void LimitMempoolSize(CTxMemPool& pool, CCoinsViewCache& coins_cache)
     std::vector<COutPoint> vNoSpendsRemaining;
     pool.TrimToSize(pool.m_opts.max_size_bytes, &vNoSpendsRemaining);
     for (const COutPoint& removed : vNoSpendsRemaining)
-        coins_cache.Uncache(removed);
+        chainstate.UncacheCoin(removed);
 }
 
 static bool IsCurrentForFeeEstimation(Chainstate& active_chainstate) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
@@ -388,7 +399,7 @@ void Chainstate::MaybeUpdateMempoolForReorg(
     // We also need to remove any now-immature transactions
     m_mempool->removeForReorg(m_chain, filter_final_and_mature);
     // Re-limit mempool size, in case we added any transactions
-    LimitMempoolSize(*m_mempool, this->CoinsTip());
+    LimitMempoolSize(*m_mempool, *this);
 }
 
 /**
@@ -487,10 +498,14 @@ public:
         /** Whether CPFP carveout and RBF carveout are granted. */
         const bool m_allow_carveouts;
 
+        /** When true, the scripts are not verified. Only for transactions this node has verified
+         * the scripts of before, under the same rules. */
+        const bool m_trusted_scripts;
+
         /** Parameters for single transaction mempool validation. */
         static ATMPArgs SingleAccept(const CChainParams& chainparams, int64_t accept_time,
                                      bool bypass_limits, std::vector<COutPoint>& coins_to_uncache,
-                                     bool test_accept) {
+                                     bool test_accept, bool trusted_scripts = false) {
             return ATMPArgs{/* m_chainparams */ chainparams,
                             /* m_accept_time */ accept_time,
                             /* m_bypass_limits */ bypass_limits,
@@ -502,6 +517,7 @@ public:
                             /* m_package_feerates */ false,
                             /* m_client_maxfeerate */ {}, // checked by caller
                             /* m_allow_carveouts */ true,
+                            /* m_trusted_scripts */ trusted_scripts,
             };
         }
 
@@ -519,6 +535,7 @@ public:
                             /* m_package_feerates */ false,
                             /* m_client_maxfeerate */ {}, // checked by caller
                             /* m_allow_carveouts */ false,
+                            /* m_trusted_scripts */ false,
             };
         }
 
@@ -536,6 +553,7 @@ public:
                             /* m_package_feerates */ true,
                             /* m_client_maxfeerate */ client_maxfeerate,
                             /* m_allow_carveouts */ false,
+                            /* m_trusted_scripts */ false,
             };
         }
 
@@ -552,6 +570,7 @@ public:
                             /* m_package_feerates */ false, // only 1 transaction
                             /* m_client_maxfeerate */ package_args.m_client_maxfeerate,
                             /* m_allow_carveouts */ false,
+                            /* m_trusted_scripts */ false,
             };
         }
 
@@ -568,7 +587,8 @@ public:
                  bool package_submission,
                  bool package_feerates,
                  std::optional<CFeeRate> client_maxfeerate,
-                 bool allow_carveouts)
+                 bool allow_carveouts,
+                 bool trusted_scripts)
             : m_chainparams{chainparams},
               m_accept_time{accept_time},
               m_bypass_limits{bypass_limits},
@@ -579,7 +599,8 @@ public:
               m_package_submission{package_submission},
               m_package_feerates{package_feerates},
               m_client_maxfeerate{client_maxfeerate},
-              m_allow_carveouts{allow_carveouts}
+              m_allow_carveouts{allow_carveouts},
+              m_trusted_scripts{trusted_scripts}
         {
             // If we are using package feerates, we must be doing package submission.
             // It also means carveouts and sibling eviction are not permitted.
@@ -589,6 +610,8 @@ public:
                 Assume(!m_allow_sibling_eviction);
             }
             if (m_allow_sibling_eviction) Assume(m_allow_replacement);
+            // Scripts are only trusted when submitting transactions one by one.
+            if (m_trusted_scripts) Assume(!m_package_submission);
         }
     };
 
@@ -598,6 +621,15 @@ public:
     // Single transaction acceptance
     MempoolAcceptResult AcceptSingleTransaction(const CTransactionRef& ptx, ATMPArgs& args) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /**
+     * Acceptance of a batch of independently received transactions. Each transaction is evaluated
+     * and submitted on its own, in order, as if by AcceptSingleTransaction() with the corresponding
+     * args, so a transaction may spend the outputs of one accepted earlier in the batch. The mempool
+     * lock is held for the whole batch and the script checks are spread over the script check
+     * threads first (see PrevalidateScripts()). Returns one result per transaction.
+     */
+    std::vector<MempoolAcceptResult> AcceptTransactions(std::span<const CTransactionRef> txns, std::span<ATMPArgs> args) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     /**
     * Multiple transaction acceptance. Transactions may or may not be interdependent, but must not
     * conflict with each other, and the transactions cannot already be in the mempool. Parents must
@@ -685,12 +717,25 @@ private:
     // only invoke this on transactions that have otherwise passed policy checks.
     bool PolicyScriptChecks(const ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
+    // CheckInputScripts() against m_view, verifying the inputs of a transaction spending several
+    // of them on the script check threads. Only when one of them fails are they checked again
+    // serially, which finds the failing input and reports the same reject reason as without threads.
+    bool CheckInputScriptsParallel(const CTransaction& tx, TxValidationState& state, unsigned int flags,
+                                   PrecomputedTransactionData& txdata) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
     // Re-run the script checks, using consensus flags, and try to cache the
     // result in the scriptcache. This should be done after
     // PolicyScriptChecks(). This requires that all inputs either be in our
     // utxo set or in the mempool.
     bool ConsensusScriptChecks(const ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
+    // Run the inexpensive checks of each transaction against the current mempool and verify the
+    // scripts of those that pass them on the script check threads, storing the verified signatures
+    // in the signature cache so that the evaluation of each transaction that follows doesn't have to
+    // verify them again serially. Nothing is submitted. When all the checks pass, the transactions
+    // are recorded in m_prevalidated_scripts so that PolicyScriptChecks() does not queue them again.
+    void PrevalidateScripts(std::span<const CTransactionRef> txns, std::span<ATMPArgs> args) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
     // Try to add the transaction to the mempool, removing any conflicts first.
     void FinalizeSubpackage(const ATMPArgs& args) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
@@ -731,6 +776,10 @@ private:
 
     Chainstate& m_active_chainstate;
 
+    /** Transactions of the batch being accepted whose scripts PrevalidateScripts() verified under
+     * the standard script flags. Cleared once the batch has been evaluated. */
+    std::set<Wtxid> m_prevalidated_scripts;
+
     // Fields below are per *sub*package state and must be reset prior to subsequent
     // AcceptSingleTransaction and AcceptMultipleTransactions invocations
     struct SubPackageState {
@@ -831,21 +880,20 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
 
     m_view.SetBackend(m_viewmempool);
 
-    const CCoinsViewCache& coins_cache = m_active_chainstate.CoinsTip();
     // do all inputs exist?
     for (const CTxIn& txin : tx.vin) {
-        if (!coins_cache.HaveCoinInCache(txin.prevout)) {
+        if (!m_active_chainstate.HaveCoinInCache(txin.prevout)) {
             coins_to_uncache.push_back(txin.prevout);
         }
 
-        // Note: this call may add txin.prevout to the coins cache
-        // (coins_cache.cacheCoins) by way of FetchCoin(). It should be removed
+        // Note: this call may add txin.prevout to the coins caches by way of
+        // FetchCoin(). It should be removed
         // later (via coins_to_uncache) if this tx turns out to be invalid.
         if (!m_view.HaveCoin(txin.prevout)) {
             // Are inputs missing because we already have the tx?
             for (size_t out = 0; out < tx.vout.size(); out++) {
                 // Optimistically just do efficient check of cache for outputs
-                if (coins_cache.HaveCoinInCache(COutPoint(hash, out))) {
+                if (m_active_chainstate.HaveCoinInCache(COutPoint(hash, out))) {
                     return state.Invalid(TxValidationResult::TX_CONFLICT, "txn-already-known");
                 }
             }
@@ -1235,9 +1283,12 @@ bool MemPoolAccept::PolicyScriptChecks(const ATMPArgs& args, Workspace& ws)
 
     constexpr unsigned int scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
 
+    // The scripts were verified under the same flags with the rest of the batch.
+    if (m_prevalidated_scripts.contains(ws.m_ptx->GetWitnessHash())) return true;
+
     // Check input scripts and signatures.
     // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-    if (!CheckInputScripts(tx, state, m_view, scriptVerifyFlags, true, false, ws.m_precomputed_txdata, GetValidationCache())) {
+    if (!CheckInputScriptsParallel(tx, state, scriptVerifyFlags, ws.m_precomputed_txdata)) {
         // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
         // need to turn both off, and compare against just turning off CLEANSTACK
         // to see if the failure is specifically due to witness validation.
@@ -1254,6 +1305,28 @@ bool MemPoolAccept::PolicyScriptChecks(const ATMPArgs& args, Workspace& ws)
     return true;
 }
 
+bool MemPoolAccept::CheckInputScriptsParallel(const CTransaction& tx, TxValidationState& state, unsigned int flags,
+                                              PrecomputedTransactionData& txdata)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(m_pool.cs);
+
+    auto& queue{m_active_chainstate.m_chainman.GetCheckQueue()};
+    if (queue.HasThreads() && tx.vin.size() > 1) {
+        // With pvChecks given, the checks are only constructed here. None are if the script
+        // execution cache already has the transaction.
+        std::vector<CScriptCheck> checks;
+        CheckInputScripts(tx, state, m_view, flags, /*cacheSigStore=*/true, /*cacheFullScriptStore=*/false, txdata, GetValidationCache(), &checks);
+        if (checks.empty()) return true;
+        CCheckQueueControl<CScriptCheck> control(queue);
+        control.Add(std::move(checks));
+        if (!control.Complete().has_value()) return true;
+        // The signatures of the inputs that passed are cached, so this only verifies the
+        // failing ones again, to classify the failure as CheckInputScripts() would.
+    }
+    return CheckInputScripts(tx, state, m_view, flags, /*cacheSigStore=*/true, /*cacheFullScriptStore=*/false, txdata, GetValidationCache());
+}
+
 bool MemPoolAccept::ConsensusScriptChecks(const ATMPArgs& args, Workspace& ws)
 {
     AssertLockHeld(cs_main);
@@ -1277,7 +1350,7 @@ bool MemPoolAccept::ConsensusScriptChecks(const ATMPArgs& args, Workspace& ws)
     // There is a similar check in CreateNewBlock() to prevent creating
     // invalid blocks (using TestBlockValidity), however allowing such
     // transactions into the mempool can be exploited as a DoS attack.
-    unsigned int currentBlockScriptVerifyFlags{GetBlockScriptFlags(*m_active_chainstate.m_chain.Tip(), m_active_chainstate.m_chainman)};
+    unsigned int currentBlockScriptVerifyFlags{GetMempoolConsensusScriptFlags(m_active_chainstate)};
     if (!CheckInputsFromMempoolAndCache(tx, state, m_view, m_pool, currentBlockScriptVerifyFlags,
                                         ws.m_precomputed_txdata, m_active_chainstate.CoinsTip(), GetValidationCache())) {
         LogPrintf("BUG! PLEASE REPORT THIS! CheckInputScripts failed against latest-block but not STANDARD flags %s, %s\n", hash.ToString(), state.ToString());
@@ -1454,11 +1527,15 @@ MempoolAcceptResult MemPoolAccept::AcceptSingleTransaction(const CTransactionRef
         return MempoolAcceptResult::Failure(ws.m_state);
     }
 
-    // Perform the inexpensive checks first and avoid hashing and signature verification unless
-    // those checks pass, to mitigate CPU exhaustion denial-of-service attacks.
-    if (!PolicyScriptChecks(args, ws)) return MempoolAcceptResult::Failure(ws.m_state);
+    // Trusted scripts were verified by this node at the same tip under the same script flags,
+    // which LoadMempool() checks before trusting them.
+    if (!args.m_trusted_scripts) {
+        // Perform the inexpensive checks first and avoid hashing and signature verification unless
+        // those checks pass, to mitigate CPU exhaustion denial-of-service attacks.
+        if (!PolicyScriptChecks(args, ws)) return MempoolAcceptResult::Failure(ws.m_state);
 
-    if (!ConsensusScriptChecks(args, ws)) return MempoolAcceptResult::Failure(ws.m_state);
+        if (!ConsensusScriptChecks(args, ws)) return MempoolAcceptResult::Failure(ws.m_state);
+    }
 
     const CFeeRate effective_feerate{ws.m_modified_fees, static_cast<uint32_t>(ws.m_vsize)};
     // Tx was accepted, but not added
@@ -1471,7 +1548,7 @@ MempoolAcceptResult MemPoolAccept::AcceptSingleTransaction(const CTransactionRef
 
     // Limit the mempool, if appropriate.
     if (!args.m_package_submission && !args.m_bypass_limits) {
-        LimitMempoolSize(m_pool, m_active_chainstate.CoinsTip());
+        LimitMempoolSize(m_pool, m_active_chainstate);
         if (!m_pool.exists(GenTxid::Txid(ws.m_hash))) {
             // The tx no longer meets our (new) mempool minimum feerate but could be reconsidered in a package.
             ws.m_state.Invalid(TxValidationResult::TX_RECONSIDERABLE, "mempool full");
@@ -1632,6 +1709,67 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptMultipleTransactions(const std::
     return PackageMempoolAcceptResult(package_state, std::move(results));
 }
 
+std::vector<MempoolAcceptResult> MemPoolAccept::AcceptTransactions(std::span<const CTransactionRef> txns, std::span<ATMPArgs> args)
+{
+    AssertLockHeld(cs_main);
+    Assume(txns.size() == args.size());
+    LOCK(m_pool.cs);
+
+    PrevalidateScripts(txns, args);
+
+    std::vector<MempoolAcceptResult> results;
+    results.reserve(txns.size());
+    for (size_t i{0}; i < txns.size(); ++i) {
+        results.push_back(AcceptSingleTransaction(txns[i], args[i]));
+        // Clean up m_view and the rbf calculations so that the next transaction is evaluated
+        // against the mempool as left by this one.
+        ClearSubPackageState();
+    }
+    m_prevalidated_scripts.clear();
+    return results;
+}
+
+void MemPoolAccept::PrevalidateScripts(std::span<const CTransactionRef> txns, std::span<ATMPArgs> args)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(m_pool.cs);
+
+    auto& queue{m_active_chainstate.m_chainman.GetCheckQueue()};
+    if (!queue.HasThreads()) return;
+
+    // The queued checks point into the precomputed data of each workspace, so the workspaces must
+    // not be moved until the checks have completed.
+    std::vector<Workspace> workspaces;
+    workspaces.reserve(txns.size());
+    std::vector<CScriptCheck> checks;
+    std::vector<Wtxid> queued;
+    for (size_t i{0}; i < txns.size(); ++i) {
+        if (args[i].m_trusted_scripts) continue;
+        Workspace& ws{workspaces.emplace_back(txns[i])};
+        // Transactions spending the outputs of others in the batch that are not in the mempool yet
+        // fail here with missing inputs, and have their scripts verified when they are evaluated.
+        const bool passed{PreChecks(args[i], ws) && (!m_subpackage.m_rbf || ReplacementChecks(ws))};
+        if (passed) {
+            // With pvChecks given, the checks are only constructed here and the result is true
+            // unless the script execution cache already has the transaction.
+            const size_t prev_checks{checks.size()};
+            CheckInputScripts(*ws.m_ptx, ws.m_state, m_view, STANDARD_SCRIPT_VERIFY_FLAGS, /*cacheSigStore=*/true,
+                              /*cacheFullScriptStore=*/false, ws.m_precomputed_txdata, GetValidationCache(), &checks);
+            if (checks.size() > prev_checks) queued.push_back(ws.m_ptx->GetWitnessHash());
+        }
+        ClearSubPackageState();
+    }
+    if (checks.empty()) return;
+
+    // A failing check stops the remaining ones from being run and doesn't tell which transaction it
+    // belongs to, so all of them are then verified again when they are evaluated. Those whose inputs
+    // passed only hit the signature cache.
+    CCheckQueueControl<CScriptCheck> control(queue);
+    control.Add(std::move(checks));
+    if (control.Complete().has_value()) return;
+    m_prevalidated_scripts.insert(queued.begin(), queued.end());
+}
+
 void MemPoolAccept::CleanupTemporaryCoins()
 {
     // There are 3 kinds of coins in m_view:
@@ -1833,7 +1971,7 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptPackage(const Package& package,
 
     // Make sure we haven't exceeded max mempool size.
     // Package transactions that were submitted to mempool or already in mempool may be evicted.
-    LimitMempoolSize(m_pool, m_active_chainstate.CoinsTip());
+    LimitMempoolSize(m_pool, m_active_chainstate);
 
     for (const auto& tx : package) {
         const auto& wtxid = tx->GetWitnessHash();
@@ -1895,7 +2033,7 @@ MempoolAcceptResult AcceptToMemoryPool(Chainstate& active_chainstate, const CTra
         // (`CCoinsViewCache::cacheCoins`).
 
         for (const COutPoint& hashTx : coins_to_uncache)
-            active_chainstate.CoinsTip().Uncache(hashTx);
+            active_chainstate.UncacheCoin(hashTx);
         TRACEPOINT(mempool, rejected,
                 tx->GetHash().data(),
                 result.m_state.GetRejectReason().c_str()
@@ -1907,6 +2045,42 @@ MempoolAcceptResult AcceptToMemoryPool(Chainstate& active_chainstate, const CTra
     return result;
 }
 
+std::vector<MempoolAcceptResult> AcceptTransactionsToMemoryPool(Chainstate& active_chainstate, std::span<const CTransactionRef> txns,
+                                                                std::span<const int64_t> accept_times, bool test_accept, bool trusted_scripts)
+{
+    AssertLockHeld(::cs_main);
+    assert(accept_times.size() == txns.size());
+    const CChainParams& chainparams{active_chainstate.m_chainman.GetParams()};
+    assert(active_chainstate.GetMempool() != nullptr);
+    CTxMemPool& pool{*active_chainstate.GetMempool()};
+
+    // Each transaction gets its own list of coins to uncache, so that only the coins fetched on
+    // behalf of the rejected transactions are removed again.
+    std::vector<std::vector<COutPoint>> coins_to_uncache(txns.size());
+    std::vector<MemPoolAccept::ATMPArgs> args;
+    args.reserve(txns.size());
+    for (size_t i{0}; i < txns.size(); ++i) {
+        args.push_back(MemPoolAccept::ATMPArgs::SingleAccept(chainparams, accept_times[i], /*bypass_limits=*/false, coins_to_uncache[i],
+                                                             test_accept, trusted_scripts));
+    }
+    std::vector<MempoolAcceptResult> results{MemPoolAccept(pool, active_chainstate).AcceptTransactions(txns, args)};
+    for (size_t i{0}; i < txns.size(); ++i) {
+        if (results[i].m_result_type == MempoolAcceptResult::ResultType::VALID) continue;
+        // See AcceptToMemoryPool().
+        for (const COutPoint& outpoint : coins_to_uncache[i]) {
+            active_chainstate.UncacheCoin(outpoint);
+        }
+        TRACEPOINT(mempool, rejected,
+                txns[i]->GetHash().data(),
+                results[i].m_state.GetRejectReason().c_str()
+        );
+    }
+    // After we've (potentially) uncached entries, ensure our coins cache is still within its size limits
+    BlockValidationState state_dummy;
+    active_chainstate.FlushStateToDisk(state_dummy, FlushStateMode::PERIODIC);
+    return results;
+}
+
 PackageMempoolAcceptResult ProcessNewPackage(Chainstate& active_chainstate, CTxMemPool& pool,
                                                    const Package& package, bool test_accept, const std::optional<CFeeRate>& client_maxfeerate)
 {
@@ -1930,7 +2104,7 @@ PackageMempoolAcceptResult ProcessNewPackage(Chainstate& active_chainstate, CTxM
     // Uncache coins pertaining to transactions that were not submitted to the mempool.
     if (test_accept || result.m_state.IsInvalid()) {
         for (const COutPoint& hashTx : coins_to_uncache) {
-            active_chainstate.CoinsTip().Uncache(hashTx);
+            active_chainstate.UncacheCoin(hashTx);
         }
     }
     // Ensure the coins cache is still within limits.
@@ -1954,12 +2128,14 @@ CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 
 CoinsViews::CoinsViews(DBParams db_params, CoinsViewOptions options)
     : m_dbview{std::move(db_params), std::move(options)},
-      m_catcherview(&m_dbview) {}
+      m_catcherview(&m_dbview),
+      m_flushview(&m_catcherview),
+      m_sharedview(&m_flushview) {}
 
 void CoinsViews::InitCache()
 {
     AssertLockHeld(::cs_main);
-    m_cacheview = std::make_unique<CCoinsViewCache>(&m_catcherview);
+    m_cacheview = std::make_unique<CCoinsViewCache>(&m_sharedview);
 }
 
 Chainstate::Chainstate(
@@ -2008,6 +2184,9 @@ void Chainstate::InitCoinsCache(size_t cache_size_bytes)
     assert(m_coins_views != nullptr);
     m_coinstip_cache_size_bytes = cache_size_bytes;
     m_coins_views->InitCache();
+    // Keep the coins tables from outgrowing the cache budget in a single step.
+    CoinsTip().SetMaxMemory(cache_size_bytes);
+    CoinsShared().SetMaxMemory(cache_size_bytes);
 }
 
 // Note that though this is marked const, we may end up modifying `m_cached_finished_ibd`, which
@@ -2301,13 +2480,13 @@ DisconnectResult Chainstate::DisconnectBlock(const CBlock& block, const CBlockIn
     AssertLockHeld(::cs_main);
     bool fClean = true;
 
-    CBlockUndo blockUndo;
+    CBlockUndoColumns blockUndo;
     if (!m_blockman.ReadBlockUndo(blockUndo, *pindex)) {
         LogError("DisconnectBlock(): failure reading undo data\n");
         return DISCONNECT_FAILED;
     }
 
-    if (blockUndo.vtxundo.size() + 1 != block.vtx.size()) {
+    if (blockUndo.tx_coins.size() + 1 != block.vtx.size()) {
         LogError("DisconnectBlock(): block and undo data inconsistent\n");
         return DISCONNECT_FAILED;
     }
@@ -2321,6 +2500,11 @@ DisconnectResult Chainstate::DisconnectBlock(const CBlock& block, const CBlockIn
     bool fEnforceBIP30 = !((pindex->nHeight==91722 && pindex->GetBlockHash() == uint256{"00000000000271a2dc26e7667f8419f2e15416dc6955e5a6c6cdf3f2574dd08e"}) ||
                            (pindex->nHeight==91812 && pindex->GetBlockHash() == uint256{"00000000000af0aed4792b1acee3d966af36cf5def14935db8de83d6f9306f2f"}));
 
+    // Every spent coin is added back, so make room for all of them at once.
+    view.Reserve(blockUndo.size());
+    // Position just past the spent coins of the transaction being undone.
+    size_t undo_pos{blockUndo.size()};
+
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction &tx = *(block.vtx[i]);
@@ -2345,19 +2529,20 @@ DisconnectResult Chainstate::DisconnectBlock(const CBlock& block, const CBlockIn
 
         // restore inputs
         if (i > 0) { // not coinbases
-            CTxUndo &txundo = blockUndo.vtxundo[i-1];
-            if (txundo.vprevout.size() != tx.vin.size()) {
+            if (blockUndo.tx_coins[i-1] != tx.vin.size()) {
                 LogError("DisconnectBlock(): transaction and undo data inconsistent\n");
                 return DISCONNECT_FAILED;
             }
+            // The columns hold as many coins as all transactions together
+            // spend, so this does not underflow.
+            undo_pos -= tx.vin.size();
             for (unsigned int j = tx.vin.size(); j > 0;) {
                 --j;
                 const COutPoint& out = tx.vin[j].prevout;
-                int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
+                int res = ApplyTxInUndo(blockUndo.GetCoin(undo_pos + j), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
             }
-            // At this point, all of txundo.vprevout should have been moved out.
         }
     }
 
@@ -2408,6 +2593,45 @@ static unsigned int GetBlockScriptFlags(const CBlockIndex& block_index, const Ch
     return flags;
 }
 
+unsigned int GetMempoolConsensusScriptFlags(const Chainstate& active_chainstate)
+{
+    AssertLockHeld(::cs_main);
+    return GetBlockScriptFlags(*Assert(active_chainstate.m_chain.Tip()), active_chainstate.m_chainman);
+}
+
+
+bool ChainstateManager::IsAssumedValid(const CBlockIndex& index) const
+{
+    AssertLockHeld(::cs_main);
+    if (AssumedValidBlock().IsNull()) return false;
+    // We've been configured with the hash of a block which has been externally verified to have a valid history.
+    // A suitable default value is included with the software and updated from time to time.  Because validity
+    //  relative to a piece of software is an objective fact these defaults can be easily reviewed.
+    // This setting doesn't force the selection of any particular chain but makes validating some faster by
+    //  effectively caching the result of part of the verification.
+    const auto it{m_blockman.m_block_index.find(AssumedValidBlock())};
+    if (it == m_blockman.m_block_index.end() || !m_best_header) return false;
+    if (it->second.GetAncestor(index.nHeight) != &index ||
+        m_best_header->GetAncestor(index.nHeight) != &index ||
+        m_best_header->nChainWork < MinimumChainWork()) {
+        return false;
+    }
+    // This block is a member of the assumed verified chain and an ancestor of the best header.
+    // Script verification is skipped when connecting blocks under the
+    // assumevalid block. Assuming the assumevalid block is valid this
+    // is safe because block merkle hashes are still computed and checked,
+    // Of course, if an assumed valid block is invalid due to false scriptSigs
+    // this optimization would allow an invalid chain to be accepted.
+    // The equivalent time check discourages hash power from extorting the network via DOS attack
+    //  into accepting an invalid block through telling users they must manually set assumevalid.
+    //  Requiring a software change or burying the invalid block, regardless of the setting, makes
+    //  it hard to hide the implication of the demand.  This also avoids having release candidates
+    //  that are hardly doing any signature verification at all in testing without having to
+    //  artificially set the default assumed verified block further back.
+    // The test against the minimum chain work prevents the skipping when denied access to any chain at
+    //  least as good as the expected chain.
+    return GetBlockProofEquivalentTime(*m_best_header, index, *m_best_header, GetConsensus()) > 60 * 60 * 24 * 7 * 2;
+}
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
@@ -2462,36 +2686,7 @@ bool Chainstate::ConnectBlock(const CBlock& block, BlockValidationState& state,
         return true;
     }
 
-    bool fScriptChecks = true;
-    if (!m_chainman.AssumedValidBlock().IsNull()) {
-        // We've been configured with the hash of a block which has been externally verified to have a valid history.
-        // A suitable default value is included with the software and updated from time to time.  Because validity
-        //  relative to a piece of software is an objective fact these defaults can be easily reviewed.
-        // This setting doesn't force the selection of any particular chain but makes validating some faster by
-        //  effectively caching the result of part of the verification.
-        BlockMap::const_iterator it{m_blockman.m_block_index.find(m_chainman.AssumedValidBlock())};
-        if (it != m_blockman.m_block_index.end()) {
-            if (it->second.GetAncestor(pindex->nHeight) == pindex &&
-                m_chainman.m_best_header->GetAncestor(pindex->nHeight) == pindex &&
-                m_chainman.m_best_header->nChainWork >= m_chainman.MinimumChainWork()) {
-                // This block is a member of the assumed verified chain and an ancestor of the best header.
-                // Script verification is skipped when connecting blocks under the
-                // assumevalid block. Assuming the assumevalid block is valid this
-                // is safe because block merkle hashes are still computed and checked,
-                // Of course, if an assumed valid block is invalid due to false scriptSigs
-                // this optimization would allow an invalid chain to be accepted.
-                // The equivalent time check discourages hash power from extorting the network via DOS attack
-                //  into accepting an invalid block through telling users they must manually set assumevalid.
-                //  Requiring a software change or burying the invalid block, regardless of the setting, makes
-                //  it hard to hide the implication of the demand.  This also avoids having release candidates
-                //  that are hardly doing any signature verification at all in testing without having to
-                //  artificially set the default assumed verified block further back.
-                // The test against the minimum chain work prevents the skipping when denied access to any chain at
-                //  least as good as the expected chain.
-                fScriptChecks = (GetBlockProofEquivalentTime(*m_chainman.m_best_header, *pindex, *m_chainman.m_best_header, params.GetConsensus()) <= 60 * 60 * 24 * 7 * 2);
-            }
-        }
-    }
+    const bool fScriptChecks{!m_chainman.IsAssumedValid(*pindex)};
 
     const auto time_1{SteadyClock::now()};
     m_chainman.time_check += time_1 - time_start;
@@ -2773,8 +2968,10 @@ bool Chainstate::ConnectBlock(const CBlock& block, BlockValidationState& state,
 CoinsCacheSizeState Chainstate::GetCoinsCacheSizeState()
 {
     AssertLockHeld(::cs_main);
+    // The coins database write buffers are taken out of the coins cache. They
+    // are resized after the cache, so they may briefly exceed their share.
     return this->GetCoinsCacheSizeState(
-        m_coinstip_cache_size_bytes,
+        m_coinstip_cache_size_bytes - std::min(m_coinsdb_write_buffer_bytes, m_coinstip_cache_size_bytes / 8),
         m_mempool ? m_mempool->m_opts.max_size_bytes : 0);
 }
 
@@ -2784,7 +2981,10 @@ CoinsCacheSizeState Chainstate::GetCoinsCacheSizeState(
 {
     AssertLockHeld(::cs_main);
     const int64_t nMempoolUsage = m_mempool ? m_mempool->DynamicMemoryUsage() : 0;
-    int64_t cacheSize = CoinsTip().DynamicMemoryUsage();
+    // Coins handed to the background writer stay in memory until the write
+    // completes, so they count against the cache budget as well.
+    int64_t cacheSize = CoinsTip().DynamicMemoryUsage() + CoinsShared().DynamicMemoryUsage() +
+                        CoinsFlushing().DynamicMemoryUsage();
     int64_t nTotalSpace =
         max_coins_cache_size_bytes + std::max<int64_t>(int64_t(max_mempool_size_bytes) - nMempoolUsage, 0);
 
@@ -2812,8 +3012,8 @@ bool Chainstate::FlushStateToDisk(
     std::set<int> setFilesToPrune;
     bool full_flush_completed = false;
 
-    const size_t coins_count = CoinsTip().GetCacheSize();
-    const size_t coins_mem_usage = CoinsTip().DynamicMemoryUsage();
+    const size_t coins_count = CoinsTip().GetCacheSize() + CoinsShared().GetCacheSize();
+    const size_t coins_mem_usage = CoinsTip().DynamicMemoryUsage() + CoinsShared().DynamicMemoryUsage();
 
     try {
     {
@@ -2903,6 +3103,11 @@ bool Chainstate::FlushStateToDisk(
             if (fFlushForPrune) {
                 LOG_TIME_MILLIS_WITH_CATEGORY("unlink pruned files", BCLog::BENCH);
 
+                // Coins still being written in the background may need blocks
+                // from these files to be replayed after a crash.
+                if (!m_coins_views->m_flushview.WaitForFlush()) {
+                    return FatalError(m_chainman.GetNotifications(), state, _("Failed to write to coin database."));
+                }
                 m_blockman.UnlinkPrunedFiles(setFilesToPrune);
             }
 
@@ -2916,12 +3121,22 @@ bool Chainstate::FlushStateToDisk(
                 // twice (once in the log, and once in the tables). This is already
                 // an overestimation, as most will delete an existing entry or
                 // overwrite one. Still, use a conservative safety factor of 2.
-                if (!CheckDiskSpace(m_chainman.m_options.datadir, 48 * 2 * 2 * CoinsTip().GetCacheSize())) {
+                if (!CheckDiskSpace(m_chainman.m_options.datadir, 48 * 2 * 2 * coins_count)) {
                     return FatalError(m_chainman.GetNotifications(), state, _("Disk space is too low!"));
                 }
                 // Flush the chainstate (which may refer to block index entries).
                 const auto empty_cache{(mode == FlushStateMode::ALWAYS) || fCacheLarge || fCacheCritical};
-                if (empty_cache ? !CoinsTip().Flush() : !CoinsTip().Sync()) {
+                // Unless the caller needs the coins on disk before we return, or
+                // block files are about to be pruned, let the database write run
+                // in the background so that block connection is not held up.
+                // It is made crash safe by the head blocks marker it writes.
+                if (mode != FlushStateMode::ALWAYS && !fFlushForPrune) {
+                    m_coins_views->m_flushview.DeferNextWrite();
+                }
+                // The tip only holds changes made since the last block, so
+                // move them down before writing the shared cache.
+                CCoinsViewShardedCache& coins_shared{CoinsShared()};
+                if (!CoinsTip().Flush() || !(empty_cache ? coins_shared.Flush() : coins_shared.Sync())) {
                     return FatalError(m_chainman.GetNotifications(), state, _("Failed to write to coin database."));
                 }
                 full_flush_completed = true;
@@ -3061,6 +3276,7 @@ bool Chainstate::DisconnectTip(BlockValidationState& state, DisconnectedBlockTra
         bool flushed = view.Flush();
         assert(flushed);
     }
+    PublishCoinsTip();
     LogDebug(BCLog::BENCH, "- Disconnect block: %.2fms\n",
              Ticks<MillisecondsDouble>(SteadyClock::now() - time_start));
 
@@ -3139,6 +3355,166 @@ public:
     }
 };
 
+/**
+ * Threads looking up coins in a coins view in parallel.
+ *
+ * Reading the inputs of a block that are not in the coins cache is dominated
+ * by database latency, and ConnectBlock only issues one read at a time. The
+ * pool reads them concurrently before the block is connected instead.
+ */
+class CoinsPrefetchPool
+{
+    //! Number of outpoints a thread claims at a time.
+    static constexpr size_t BATCH_SIZE{16};
+
+    struct Job {
+        const CCoinsView& view;
+        std::span<const COutPoint> outpoints;
+        std::vector<std::optional<Coin>>& coins;
+        std::atomic<size_t> next{0};
+
+        void Run()
+        {
+            for (size_t begin; (begin = next.fetch_add(BATCH_SIZE, std::memory_order_relaxed)) < outpoints.size();) {
+                const size_t end{std::min(begin + BATCH_SIZE, outpoints.size())};
+                for (size_t i{begin}; i < end; ++i) {
+                    coins[i] = view.GetCoin(outpoints[i]);
+                }
+            }
+        }
+    };
+
+    Mutex m_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_done_cv;
+    //! The job being worked on, or nullptr once Fetch stopped handing it out.
+    Job* m_job GUARDED_BY(m_mutex){nullptr};
+    uint64_t m_job_id GUARDED_BY(m_mutex){0};
+    //! Number of worker threads still running the current job.
+    int m_running GUARDED_BY(m_mutex){0};
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::vector<std::thread> m_threads;
+
+    void ThreadFetch() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        uint64_t last_job_id{0};
+        while (true) {
+            Job* job;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_work_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || (m_job && m_job_id != last_job_id); });
+                if (m_stop) return;
+                job = m_job;
+                last_job_id = m_job_id;
+                ++m_running;
+            }
+            job->Run();
+            bool done;
+            {
+                LOCK(m_mutex);
+                done = --m_running == 0;
+            }
+            if (done) m_done_cv.notify_one();
+        }
+    }
+
+public:
+    explicit CoinsPrefetchPool(int num_threads)
+    {
+        m_threads.reserve(num_threads);
+        for (int n{0}; n < num_threads; ++n) {
+            m_threads.emplace_back(&util::TraceThread, strprintf("prefetch.%i", n), [this] { ThreadFetch(); });
+        }
+    }
+
+    ~CoinsPrefetchPool()
+    {
+        WITH_LOCK(m_mutex, m_stop = true);
+        m_work_cv.notify_all();
+        for (std::thread& t : m_threads) {
+            t.join();
+        }
+    }
+
+    /**
+     * Look up outpoints in view, using the calling thread as well as the
+     * workers. view must be safe to read from several threads at once. Not to
+     * be called concurrently.
+     *
+     * @returns the coin found for each outpoint, in the same order
+     */
+    std::vector<std::optional<Coin>> Fetch(const CCoinsView& view, std::span<const COutPoint> outpoints) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        std::vector<std::optional<Coin>> coins(outpoints.size());
+        Job job{view, outpoints, coins};
+        WITH_LOCK(m_mutex, m_job = &job; ++m_job_id);
+        m_work_cv.notify_all();
+        job.Run();
+        // All outpoints have been claimed. Stop handing out the job and wait for
+        // the threads that picked it up to finish their lookups.
+        WAIT_LOCK(m_mutex, lock);
+        m_job = nullptr;
+        m_done_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_running == 0; });
+        return coins;
+    }
+};
+
+void Chainstate::PrefetchBlockInputs(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    if (!m_chainman.m_coins_prefetch_pool) return;
+
+    const auto time_start{SteadyClock::now()};
+    CCoinsViewCache& coins_tip{CoinsTip()};
+    CCoinsViewShardedCache& coins_shared{CoinsShared()};
+    std::vector<COutPoint> missing;
+    std::unordered_set<Txid, SaltedTxidHasher> block_txids;
+    block_txids.reserve(block.vtx.size());
+    for (const auto& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn& txin : tx->vin) {
+                // Outputs created earlier in the block are not in the database.
+                if (block_txids.contains(txin.prevout.hash) || coins_tip.HaveCoinInCache(txin.prevout) ||
+                    coins_shared.HaveCoinInCache(txin.prevout)) continue;
+                missing.push_back(txin.prevout);
+            }
+        }
+        block_txids.insert(tx->GetHash());
+    }
+    if (missing.empty()) return;
+
+    // The shared cache may be read from several threads, and keeps the coins
+    // it reads from the database.
+    auto coins{m_chainman.m_coins_prefetch_pool->Fetch(coins_shared, missing)};
+    size_t found{0};
+    for (size_t i{0}; i < missing.size(); ++i) {
+        if (!coins[i]) continue;
+        coins_tip.CacheFetchedCoin(missing[i], std::move(*coins[i]));
+        ++found;
+    }
+    LogDebug(BCLog::BENCH, "  - Prefetch %u of %u inputs: %.2fms\n", found, missing.size(),
+             Ticks<MillisecondsDouble>(SteadyClock::now() - time_start));
+}
+
+void Chainstate::PublishCoinsTip()
+{
+    AssertLockHeld(cs_main);
+    bool flushed = CoinsTip().Flush();
+    assert(flushed);
+}
+
+void Chainstate::PrefetchInputs(const CTransaction& tx) const
+{
+    AssertLockNotHeld(::cs_main);
+    if (!m_coins_views) return;
+    const CCoinsViewShardedCache& coins_shared{m_coins_views->m_sharedview};
+    for (const CTxIn& txin : tx.vin) {
+        // The coin is read again while validating the transaction, and is
+        // then served from the database's cache or the OS page cache.
+        coins_shared.PeekCoin(txin.prevout);
+    }
+}
+
 /**
  * Connect a new block to m_chain. pblock is either nullptr or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
@@ -3173,6 +3549,7 @@ bool Chainstate::ConnectTip(BlockValidationState& state, CBlockIndex* pindexNew,
     LogDebug(BCLog::BENCH, "  - Load block from disk: %.2fms\n",
              Ticks<MillisecondsDouble>(time_2 - time_1));
     {
+        PrefetchBlockInputs(blockConnecting);
         CCoinsViewCache view(&CoinsTip());
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view);
         if (m_chainman.m_options.signals) {
@@ -3194,6 +3571,7 @@ bool Chainstate::ConnectTip(BlockValidationState& state, CBlockIndex* pindexNew,
         bool flushed = view.Flush();
         assert(flushed);
     }
+    PublishCoinsTip();
     const auto time_4{SteadyClock::now()};
     m_chainman.time_flush += time_4 - time_3;
     LogDebug(BCLog::BENCH, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n",
@@ -4600,6 +4978,21 @@ MempoolAcceptResult ChainstateManager::ProcessTransaction(const CTransactionRef&
     return result;
 }
 
+std::vector<MempoolAcceptResult> ChainstateManager::ProcessTransactions(std::span<const CTransactionRef> txns, bool test_accept)
+{
+    AssertLockHeld(cs_main);
+    Chainstate& active_chainstate = ActiveChainstate();
+    if (!active_chainstate.GetMempool()) {
+        TxValidationState state;
+        state.Invalid(TxValidationResult::TX_NO_MEMPOOL, "no-mempool");
+        return std::vector<MempoolAcceptResult>(txns.size(), MempoolAcceptResult::Failure(state));
+    }
+    const std::vector<int64_t> accept_times(txns.size(), GetTime());
+    auto results = AcceptTransactionsToMemoryPool(active_chainstate, txns, accept_times, test_accept);
+    active_chainstate.GetMempool()->check(active_chainstate.CoinsTip(), active_chainstate.m_chain.Height() + 1);
+    return results;
+}
+
 
 BlockValidationState TestBlockValidity(
     Chainstate& chainstate,
@@ -4795,7 +5188,7 @@ VerifyDBResult CVerifyDB::VerifyDB(
         }
         // check level 2: verify undo validity
         if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
+            CBlockUndoColumns undo;
             if (!pindex->GetUndoPos().IsNull()) {
                 if (!chainstate.m_blockman.ReadBlockUndo(undo, *pindex)) {
                     LogPrintf("Verification error: found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
@@ -4804,7 +5197,7 @@ VerifyDBResult CVerifyDB::VerifyDB(
             }
         }
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        size_t curr_coins_usage = coins.DynamicMemoryUsage() + chainstate.CoinsTip().DynamicMemoryUsage();
+        size_t curr_coins_usage = coins.DynamicMemoryUsage() + chainstate.CoinsTip().DynamicMemoryUsage() + chainstate.CoinsShared().DynamicMemoryUsage();
 
         if (nCheckLevel >= 3) {
             if (curr_coins_usage <= chainstate.m_coinstip_cache_size_bytes) {
@@ -5063,10 +5456,121 @@ bool Chainstate::LoadGenesisBlock()
     return true;
 }
 
+bool ChainstateManager::ProcessExternalBlock(
+    const CBlockHeader& header,
+    const std::function<std::shared_ptr<CBlock>()>& read_block,
+    FlatFilePos* dbp,
+    std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent,
+    int& loaded)
+{
+    const CChainParams& params{GetParams()};
+    const uint256 hash{header.GetHash()};
+
+    std::shared_ptr<CBlock> pblock{}; // needs to remain available after the cs_main lock is released to avoid duplicate reads from disk
+
+    {
+        LOCK(cs_main);
+        // detect out of order blocks, and store them for later
+        if (hash != params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(header.hashPrevBlock)) {
+            LogDebug(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                     header.hashPrevBlock.ToString());
+            if (dbp && blocks_with_unknown_parent) {
+                blocks_with_unknown_parent->emplace(header.hashPrevBlock, *dbp);
+            }
+            return true;
+        }
+
+        // process in case the block isn't known yet
+        const CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
+        if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
+            // This block can be processed immediately.
+            pblock = read_block();
+
+            BlockValidationState state;
+            if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr, true)) {
+                loaded++;
+            }
+            if (state.IsError()) {
+                return false;
+            }
+        } else if (hash != params.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
+            LogDebug(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
+        }
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    // During first -reindex, this will only connect Genesis since
+    // ActivateBestChain only connects blocks which are in the block tree db,
+    // which only contains blocks whose parents are in it.
+    // But do this only if genesis isn't activated yet, to avoid connecting many blocks
+    // without assumevalid in the case of a continuation of a reindex that
+    // was interrupted by the user.
+    if (hash == params.GetConsensus().hashGenesisBlock && WITH_LOCK(::cs_main, return ActiveHeight()) == -1) {
+        BlockValidationState state;
+        if (!ActiveChainstate().ActivateBestChain(state, nullptr)) {
+            return false;
+        }
+    }
+
+    if (m_blockman.IsPruneMode() && m_blockman.m_blockfiles_indexed && pblock) {
+        // must update the tip for pruning to work while importing with -loadblock.
+        // this is a tradeoff to conserve disk space at the expense of time
+        // spent updating the tip to be able to prune.
+        // otherwise, ActivateBestChain won't be called by the import process
+        // until after all of the block files are loaded. ActivateBestChain can be
+        // called by concurrent network message processing. but, that is not
+        // reliable for the purpose of pruning while importing.
+        bool activation_failure = false;
+        for (auto c : GetAll()) {
+            BlockValidationState state;
+            if (!c->ActivateBestChain(state, pblock)) {
+                LogDebug(BCLog::REINDEX, "failed to activate chain (%s)\n", state.ToString());
+                activation_failure = true;
+                break;
+            }
+        }
+        if (activation_failure) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    if (!blocks_with_unknown_parent) return true;
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        auto range = blocks_with_unknown_parent->equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, FlatFilePos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            if (m_blockman.ReadBlock(*pblockrecursive, it->second, {})) {
+                const auto& block_hash{pblockrecursive->GetHash()};
+                LogDebug(BCLog::REINDEX, "%s: Processing out of order child %s of %s", __func__, block_hash.ToString(), head.ToString());
+                LOCK(cs_main);
+                BlockValidationState dummy;
+                if (AcceptBlock(pblockrecursive, dummy, nullptr, true, &it->second, nullptr, true)) {
+                    loaded++;
+                    queue.push_back(block_hash);
+                }
+            }
+            range.first++;
+            blocks_with_unknown_parent->erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+
 void ChainstateManager::LoadExternalBlockFile(
     AutoFile& file_in,
     FlatFilePos* dbp,
-    std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent)
+    std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent,
+    std::span<const uint32_t> block_offsets)
 {
     // Either both should be specified (-reindex), or neither (-loadblock).
     assert(!dbp == !blocks_with_unknown_parent);
@@ -5080,9 +5584,17 @@ void ChainstateManager::LoadExternalBlockFile(
         // nRewind indicates where to resume scanning in case something goes wrong,
         // such as a block fails to deserialize.
         uint64_t nRewind = blkdat.GetPos();
+        size_t next_offset{0};
         while (!blkdat.eof()) {
             if (m_interrupt) return;
 
+            if (!block_offsets.empty()) {
+                // Jump straight to the next block listed in the index footer.
+                if (next_offset == block_offsets.size()) break;
+                nRewind = block_offsets[next_offset++];
+                blkdat.SetLimit();
+                if (nRewind > blkdat.GetPos()) blkdat.SkipTo(nRewind);
+            }
             blkdat.SetPos(nRewind);
             nRewind++; // start one byte further next time, in case of failure
             blkdat.SetLimit(); // remove former limit
@@ -5113,111 +5625,21 @@ void ChainstateManager::LoadExternalBlockFile(
                 blkdat.SetLimit(nBlockPos + nSize);
                 CBlockHeader header;
                 blkdat >> header;
-                const uint256 hash{header.GetHash()};
                 // Skip the rest of this block (this may read from disk into memory); position to the marker before the
                 // next block, but it's still possible to rewind to the start of the current block (without a disk read).
                 nRewind = nBlockPos + nSize;
                 blkdat.SkipTo(nRewind);
 
-                std::shared_ptr<CBlock> pblock{}; // needs to remain available after the cs_main lock is released to avoid duplicate reads from disk
-
-                {
-                    LOCK(cs_main);
-                    // detect out of order blocks, and store them for later
-                    if (hash != params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(header.hashPrevBlock)) {
-                        LogDebug(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                                 header.hashPrevBlock.ToString());
-                        if (dbp && blocks_with_unknown_parent) {
-                            blocks_with_unknown_parent->emplace(header.hashPrevBlock, *dbp);
-                        }
-                        continue;
-                    }
-
-                    // process in case the block isn't known yet
-                    const CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
-                    if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                        // This block can be processed immediately; rewind to its start, read and deserialize it.
-                        blkdat.SetPos(nBlockPos);
-                        pblock = std::make_shared<CBlock>();
-                        blkdat >> TX_WITH_WITNESS(*pblock);
-                        nRewind = blkdat.GetPos();
-
-                        BlockValidationState state;
-                        if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr, true)) {
-                            nLoaded++;
-                        }
-                        if (state.IsError()) {
-                            break;
-                        }
-                    } else if (hash != params.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
-                        LogDebug(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
-                    }
-                }
-
-                // Activate the genesis block so normal node progress can continue
-                // During first -reindex, this will only connect Genesis since
-                // ActivateBestChain only connects blocks which are in the block tree db,
-                // which only contains blocks whose parents are in it.
-                // But do this only if genesis isn't activated yet, to avoid connecting many blocks
-                // without assumevalid in the case of a continuation of a reindex that
-                // was interrupted by the user.
-                if (hash == params.GetConsensus().hashGenesisBlock && WITH_LOCK(::cs_main, return ActiveHeight()) == -1) {
-                    BlockValidationState state;
-                    if (!ActiveChainstate().ActivateBestChain(state, nullptr)) {
-                        break;
-                    }
-                }
-
-                if (m_blockman.IsPruneMode() && m_blockman.m_blockfiles_indexed && pblock) {
-                    // must update the tip for pruning to work while importing with -loadblock.
-                    // this is a tradeoff to conserve disk space at the expense of time
-                    // spent updating the tip to be able to prune.
-                    // otherwise, ActivateBestChain won't be called by the import process
-                    // until after all of the block files are loaded. ActivateBestChain can be
-                    // called by concurrent network message processing. but, that is not
-                    // reliable for the purpose of pruning while importing.
-                    bool activation_failure = false;
-                    for (auto c : GetAll()) {
-                        BlockValidationState state;
-                        if (!c->ActivateBestChain(state, pblock)) {
-                            LogDebug(BCLog::REINDEX, "failed to activate chain (%s)\n", state.ToString());
-                            activation_failure = true;
-                            break;
-                        }
-                    }
-                    if (activation_failure) {
-                        break;
-                    }
-                }
-
-                NotifyHeaderTip();
-
-                if (!blocks_with_unknown_parent) continue;
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    auto range = blocks_with_unknown_parent->equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, FlatFilePos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (m_blockman.ReadBlock(*pblockrecursive, it->second, {})) {
-                            const auto& block_hash{pblockrecursive->GetHash()};
-                            LogDebug(BCLog::REINDEX, "%s: Processing out of order child %s of %s", __func__, block_hash.ToString(), head.ToString());
-                            LOCK(cs_main);
-                            BlockValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, nullptr, true, &it->second, nullptr, true)) {
-                                nLoaded++;
-                                queue.push_back(block_hash);
-                            }
-                        }
-                        range.first++;
-                        blocks_with_unknown_parent->erase(it);
-                        NotifyHeaderTip();
-                    }
+                const auto read_block{[&] {
+                    // Rewind to the start of the block, read and deserialize it.
+                    blkdat.SetPos(nBlockPos);
+                    auto pblock{std::make_shared<CBlock>()};
+                    blkdat >> TX_WITH_WITNESS(*pblock);
+                    nRewind = blkdat.GetPos();
+                    return pblock;
+                }};
+                if (!ProcessExternalBlock(header, read_block, dbp, blocks_with_unknown_parent, nLoaded)) {
+                    break;
                 }
             } catch (const std::exception& e) {
                 // historical bugs added extra data to the block files that does not deserialize cleanly.
@@ -5240,6 +5662,27 @@ void ChainstateManager::LoadExternalBlockFile(
     LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, Ticks<std::chrono::milliseconds>(SteadyClock::now() - start));
 }
 
+void ChainstateManager::LoadExternalBlocks(
+    std::span<const std::pair<std::shared_ptr<CBlock>, FlatFilePos>> blocks,
+    std::multimap<uint256, FlatFilePos>& blocks_with_unknown_parent)
+{
+    const auto start{SteadyClock::now()};
+
+    int loaded{0};
+    try {
+        for (const auto& [block, pos] : blocks) {
+            if (m_interrupt) return;
+            FlatFilePos dbp{pos};
+            if (!ProcessExternalBlock(*block, [&] { return block; }, &dbp, &blocks_with_unknown_parent, loaded)) {
+                break;
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        GetNotifications().fatalError(strprintf(_("System error while loading external block file: %s"), e.what()));
+    }
+    LogPrintf("Loaded %i of %i blocks read ahead in %dms\n", loaded, blocks.size(), Ticks<std::chrono::milliseconds>(SteadyClock::now() - start));
+}
+
 bool ChainstateManager::ShouldCheckBlockIndex() const
 {
     // Assert to verify Flatten() has been called.
@@ -5585,7 +6028,14 @@ bool Chainstate::ResizeCoinsCaches(size_t coinstip_size, size_t coinsdb_size)
     size_t old_coinstip_size = m_coinstip_cache_size_bytes;
     m_coinstip_cache_size_bytes = coinstip_size;
     m_coinsdb_cache_size_bytes = coinsdb_size;
-    CoinsDB().ResizeCache(coinsdb_size);
+    CoinsTip().SetMaxMemory(coinstip_size);
+    CoinsShared().SetMaxMemory(coinstip_size);
+    {
+        // The database is reopened, so keep readers of the shared coins
+        // cache from reaching it meanwhile.
+        const auto base_lock{CoinsShared().LockBase()};
+        CoinsDB().ResizeCache(coinsdb_size);
+    }
 
     LogPrintf("[%s] resized coinsdb cache to %.1f MiB\n",
         this->ToString(), coinsdb_size * (1.0 / 1024 / 1024));
@@ -5605,6 +6055,27 @@ bool Chainstate::ResizeCoinsCaches(size_t coinstip_size, size_t coinsdb_size)
     return ret;
 }
 
+void Chainstate::SetCoinsDBBulkLoad(bool bulk_load)
+{
+    AssertLockHeld(::cs_main);
+    // The database cache is small and sized for reads, so the write buffers
+    // are given a share of the coins cache instead, which is usually most of
+    // -dbcache.
+    const size_t write_buffer_bytes{bulk_load ? std::min(m_coinstip_cache_size_bytes / 8, MAX_COINS_DB_WRITE_BUFFERS) : 0};
+    if (CoinsDB().IsBulkLoad() == bulk_load && m_coinsdb_write_buffer_bytes == write_buffer_bytes) return;
+    {
+        const auto base_lock{CoinsShared().LockBase()};
+        CoinsDB().SetBulkLoad(bulk_load, write_buffer_bytes);
+    }
+    m_coinsdb_write_buffer_bytes = write_buffer_bytes;
+    if (bulk_load) {
+        LogPrintf("[%s] switched coins database to initial block download settings with %.1f MiB of write buffers\n",
+            this->ToString(), write_buffer_bytes * (1.0 / 1024 / 1024));
+    } else {
+        LogPrintf("[%s] switched coins database to steady-state settings\n", this->ToString());
+    }
+}
+
 double ChainstateManager::GuessVerificationProgress(const CBlockIndex* pindex) const
 {
     AssertLockHeld(GetMutex());
@@ -5719,6 +6190,25 @@ util::Result<CBlockIndex*> ChainstateManager::ActivateSnapshot(
         AutoFile& coins_file,
         const SnapshotMetadata& metadata,
         bool in_memory)
+{
+    AutoFile* const file{&coins_file};
+    return ActivateSnapshotFiles(std::span{&file, 1}, metadata, /*manifest=*/nullptr, in_memory);
+}
+
+util::Result<CBlockIndex*> ChainstateManager::ActivateSnapshot(
+        std::span<AutoFile* const> chunk_files,
+        const SnapshotManifest& manifest,
+        bool in_memory)
+{
+    Assume(chunk_files.size() == manifest.m_chunks.size());
+    return ActivateSnapshotFiles(chunk_files, manifest.m_metadata, &manifest, in_memory);
+}
+
+util::Result<CBlockIndex*> ChainstateManager::ActivateSnapshotFiles(
+        std::span<AutoFile* const> coins_files,
+        const SnapshotMetadata& metadata,
+        const SnapshotManifest* manifest,
+        bool in_memory)
 {
     uint256 base_blockhash = metadata.m_base_blockhash;
 
@@ -5824,7 +6314,7 @@ util::Result<CBlockIndex*> ChainstateManager::ActivateSnapshot(
         return util::Error{std::move(reason)};
     };
 
-    if (auto res{this->PopulateAndValidateSnapshot(*snapshot_chainstate, coins_file, metadata)}; !res) {
+    if (auto res{this->PopulateAndValidateSnapshot(*snapshot_chainstate, coins_files, metadata, manifest)}; !res) {
         LOCK(::cs_main);
         return cleanup_bad_snapshot(Untranslated(strprintf("Population failed: %s", util::ErrorString(res).original)));
     }
@@ -5867,7 +6357,7 @@ util::Result<CBlockIndex*> ChainstateManager::ActivateSnapshot(
     return snapshot_start_block;
 }
 
-static void FlushSnapshotToDisk(CCoinsViewCache& coins_cache, bool snapshot_loaded)
+static void FlushSnapshotToDisk(CCoinsViewCache& coins_cache, CCoinsViewShardedCache& coins_shared, bool snapshot_loaded)
 {
     LOG_TIME_MILLIS_WITH_CATEGORY_MSG_ONCE(
         strprintf("%s (%.2f MB)",
@@ -5876,6 +6366,7 @@ static void FlushSnapshotToDisk(CCoinsViewCache& coins_cache, bool snapshot_load
         BCLog::LogFlags::ALL);
 
     coins_cache.Flush();
+    coins_shared.Flush();
 }
 
 struct StopHashingException : public std::exception
@@ -5891,10 +6382,253 @@ static void SnapshotUTXOHashBreakpoint(const util::SignalInterrupt& interrupt)
     if (interrupt) throw StopHashingException();
 }
 
+/**
+ * Deserialize the coins of a snapshot file, following its metadata, and pass
+ * them to add_coin, which may abort by returning an error. Fails unless the
+ * file holds exactly coins_count coins, grouped by txid in ascending order,
+ * with the first byte of every txid in [begin_byte, end_byte). No outpoint is
+ * passed to add_coin twice.
+ */
+template <typename Fn>
+static util::Result<void> ReadSnapshotCoins(AutoFile& coins_file, uint64_t coins_count, int base_height,
+                                            unsigned int begin_byte, unsigned int end_byte, Fn&& add_coin)
+{
+    uint64_t coins_left{coins_count};
+    std::optional<Txid> last_txid;
+    std::unordered_set<uint32_t> seen_n;
+    while (coins_left > 0) {
+        try {
+            Txid txid;
+            coins_file >> txid;
+            size_t coins_per_txid{0};
+            coins_per_txid = ReadCompactSize(coins_file);
+
+            if (coins_per_txid > coins_left) {
+                return util::Error{Untranslated("Mismatch in coins count in snapshot metadata and actual snapshot data")};
+            }
+            // Snapshots are written in coins database order, so a txid that is
+            // not above the previous one would repeat or overwrite coins.
+            const unsigned int first_byte{std::to_integer<unsigned int>(txid.begin()[0])};
+            if ((last_txid && !(*last_txid < txid)) || first_byte < begin_byte || first_byte >= end_byte) {
+                return util::Error{Untranslated(strprintf("Bad snapshot data after deserializing %d coins - txid %s out of order",
+                          coins_count - coins_left, txid.ToString()))};
+            }
+            last_txid = txid;
+            seen_n.clear();
+
+            for (size_t i = 0; i < coins_per_txid; i++) {
+                COutPoint outpoint;
+                Coin coin;
+                outpoint.n = static_cast<uint32_t>(ReadCompactSize(coins_file));
+                outpoint.hash = txid;
+                coins_file >> coin;
+                if (coin.nHeight > base_height ||
+                    outpoint.n >= std::numeric_limits<decltype(outpoint.n)>::max() || // Avoid integer wrap-around in coinstats.cpp:ApplyHash
+                    !seen_n.insert(outpoint.n).second
+                ) {
+                    return util::Error{Untranslated(strprintf("Bad snapshot data after deserializing %d coins",
+                              coins_count - coins_left))};
+                }
+                if (!MoneyRange(coin.out.nValue)) {
+                    return util::Error{Untranslated(strprintf("Bad snapshot data after deserializing %d coins - bad tx out value",
+                              coins_count - coins_left))};
+                }
+                if (auto res{add_coin(std::move(outpoint), std::move(coin))}; !res) {
+                    return res;
+                }
+                --coins_left;
+            }
+        } catch (const std::ios_base::failure&) {
+            return util::Error{Untranslated(strprintf("Bad snapshot format or truncated snapshot after deserializing %d coins",
+                      coins_count - coins_left))};
+        }
+    }
+
+    bool out_of_coins{false};
+    try {
+        std::byte left_over_byte;
+        coins_file >> left_over_byte;
+    } catch (const std::ios_base::failure&) {
+        // We expect an exception since we should be out of coins.
+        out_of_coins = true;
+    }
+    if (!out_of_coins) {
+        return util::Error{Untranslated(strprintf("Bad snapshot - coins left over after deserializing %d coins",
+            coins_count))};
+    }
+    return {};
+}
+
+/**
+ * Deserializes the chunk files of a snapshot on worker threads and hands their
+ * coins to a single consumer in batches. Each chunk may only hold txids in its
+ * range from the manifest, and the manifest ranges do not overlap, so no coin
+ * is handed out twice. Each worker hashes the coins it reads
+ * into its own MuHash3072, and the results are combined and checked against
+ * the manifest once all chunks are read.
+ */
+class SnapshotChunkReader
+{
+    using Batch = std::vector<std::pair<COutPoint, Coin>>;
+    static constexpr size_t BATCH_SIZE{10'000};
+
+    const std::span<AutoFile* const> m_files;
+    const SnapshotManifest& m_manifest;
+    const MessageStartChars m_message_start;
+    const int m_base_height;
+    //! Next chunk for a worker to read.
+    std::atomic<size_t> m_next_chunk{0};
+    //! MuHash of the coins read by each worker, only accessed by it until joined.
+    std::vector<MuHash3072> m_muhashes;
+    size_t m_max_batches;
+    std::vector<std::thread> m_threads;
+
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Batch> m_batches GUARDED_BY(m_mutex);
+    //! Number of worker threads still reading.
+    int m_running GUARDED_BY(m_mutex){0};
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::optional<std::string> m_error GUARDED_BY(m_mutex);
+
+    void Stop(std::optional<std::string> error) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        {
+            LOCK(m_mutex);
+            if (!m_stop) m_error = std::move(error);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+    }
+
+    //! Queue a batch, waiting for room. Returns false if reading was stopped.
+    bool Push(Batch&& batch) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || m_batches.size() < m_max_batches; });
+            if (m_stop) return false;
+            m_batches.push_back(std::move(batch));
+        }
+        m_cond.notify_all();
+        return true;
+    }
+
+    util::Result<void> ReadChunk(size_t index, MuHash3072& muhash) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        const SnapshotManifest::Chunk& chunk{m_manifest.m_chunks[index]};
+        AutoFile& file{*m_files[index]};
+        SnapshotMetadata metadata{m_message_start};
+        try {
+            file >> metadata;
+        } catch (const std::ios_base::failure& e) {
+            return util::Error{Untranslated(strprintf("Unable to parse metadata: %s", e.what()))};
+        }
+        if (metadata.m_base_blockhash != m_manifest.m_metadata.m_base_blockhash || metadata.m_coins_count != chunk.coins_count) {
+            return util::Error{Untranslated("Metadata does not match the snapshot manifest")};
+        }
+
+        Batch batch;
+        batch.reserve(BATCH_SIZE);
+        auto res{ReadSnapshotCoins(file, chunk.coins_count, m_base_height, chunk.begin_byte, chunk.end_byte, [&](COutPoint&& outpoint, Coin&& coin) -> util::Result<void> {
+            ApplyCoinHash(muhash, outpoint, coin);
+            batch.emplace_back(std::move(outpoint), std::move(coin));
+            if (batch.size() == BATCH_SIZE) {
+                if (!Push(std::move(batch))) return util::Error{Untranslated("Aborted")};
+                batch.clear();
+                batch.reserve(BATCH_SIZE);
+            }
+            return {};
+        })};
+        if (res && !batch.empty() && !Push(std::move(batch))) {
+            return util::Error{Untranslated("Aborted")};
+        }
+        return res;
+    }
+
+    void ThreadRead(size_t worker) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        for (size_t index{m_next_chunk++}; index < m_files.size(); index = m_next_chunk++) {
+            if (auto res{ReadChunk(index, m_muhashes[worker])}; !res) {
+                Stop(strprintf("Bad snapshot chunk %s: %s", m_manifest.m_chunks[index].filename, util::ErrorString(res).original));
+                break;
+            }
+        }
+        WITH_LOCK(m_mutex, --m_running);
+        m_cond.notify_all();
+    }
+
+public:
+    SnapshotChunkReader(std::span<AutoFile* const> files, const SnapshotManifest& manifest, const MessageStartChars& message_start,
+                        int base_height, int num_threads)
+        : m_files{files}, m_manifest{manifest}, m_message_start{message_start}, m_base_height{base_height}
+    {
+        num_threads = std::clamp<int>(num_threads, 1, files.size());
+        m_muhashes.resize(num_threads);
+        m_max_batches = 2 * num_threads;
+        WITH_LOCK(m_mutex, m_running = num_threads);
+        m_threads.reserve(num_threads);
+        for (int n{0}; n < num_threads; ++n) {
+            m_threads.emplace_back(&util::TraceThread, strprintf("snapload.%i", n), [this, n] { ThreadRead(n); });
+        }
+    }
+
+    ~SnapshotChunkReader()
+    {
+        Stop(std::nullopt);
+        for (std::thread& t : m_threads) {
+            if (t.joinable()) t.join();
+        }
+    }
+
+    //! Wait for the next batch of coins. Returns std::nullopt once all chunks
+    //! have been read, or reading stopped.
+    std::optional<Batch> Next() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        std::optional<Batch> batch;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || !m_batches.empty() || m_running == 0; });
+            if (m_stop || m_batches.empty()) return std::nullopt;
+            batch = std::move(m_batches.front());
+            m_batches.pop_front();
+        }
+        m_cond.notify_all();
+        return batch;
+    }
+
+    //! Stop reading because the consumer failed.
+    void Abort() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) { Stop(std::nullopt); }
+
+    //! Once Next() returned std::nullopt, check that all chunks were read and
+    //! that their coins hash to the MuHash of the manifest.
+    util::Result<void> Finish() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        for (std::thread& t : m_threads) {
+            t.join();
+        }
+        if (auto error{WITH_LOCK(m_mutex, return m_error)}) {
+            return util::Error{Untranslated(*error)};
+        }
+        MuHash3072 muhash;
+        for (const MuHash3072& partial : m_muhashes) {
+            muhash *= partial;
+        }
+        uint256 hash;
+        muhash.Finalize(hash);
+        if (hash != m_manifest.m_muhash) {
+            return util::Error{Untranslated(strprintf("Bad snapshot content MuHash: expected %s, got %s",
+                m_manifest.m_muhash.ToString(), hash.ToString()))};
+        }
+        return {};
+    }
+};
+
 util::Result<void> ChainstateManager::PopulateAndValidateSnapshot(
     Chainstate& snapshot_chainstate,
-    AutoFile& coins_file,
-    const SnapshotMetadata& metadata)
+    std::span<AutoFile* const> coins_files,
+    const SnapshotMetadata& metadata,
+    const SnapshotManifest* manifest)
 {
     // It's okay to release cs_main before we're done using `coins_cache` because we know
     // that nothing else will be referencing the newly created snapshot_chainstate yet.
@@ -5929,76 +6663,65 @@ util::Result<void> ChainstateManager::PopulateAndValidateSnapshot(
     }
 
     const uint64_t coins_count = metadata.m_coins_count;
-    uint64_t coins_left = metadata.m_coins_count;
 
-    LogPrintf("[snapshot] loading %d coins from snapshot %s\n", coins_left, base_blockhash.ToString());
+    LogPrintf("[snapshot] loading %d coins from snapshot %s\n", coins_count, base_blockhash.ToString());
     int64_t coins_processed{0};
 
-    while (coins_left > 0) {
-        try {
-            Txid txid;
-            coins_file >> txid;
-            size_t coins_per_txid{0};
-            coins_per_txid = ReadCompactSize(coins_file);
+    const auto add_coin{[&](COutPoint&& outpoint, Coin&& coin) -> util::Result<void> {
+        coins_cache.EmplaceCoinInternalDANGER(std::move(outpoint), std::move(coin));
+        ++coins_processed;
 
-            if (coins_per_txid > coins_left) {
-                return util::Error{Untranslated("Mismatch in coins count in snapshot metadata and actual snapshot data")};
-            }
-
-            for (size_t i = 0; i < coins_per_txid; i++) {
-                COutPoint outpoint;
-                Coin coin;
-                outpoint.n = static_cast<uint32_t>(ReadCompactSize(coins_file));
-                outpoint.hash = txid;
-                coins_file >> coin;
-                if (coin.nHeight > base_height ||
-                    outpoint.n >= std::numeric_limits<decltype(outpoint.n)>::max() // Avoid integer wrap-around in coinstats.cpp:ApplyHash
-                ) {
-                    return util::Error{Untranslated(strprintf("Bad snapshot data after deserializing %d coins",
-                              coins_count - coins_left))};
-                }
-                if (!MoneyRange(coin.out.nValue)) {
-                    return util::Error{Untranslated(strprintf("Bad snapshot data after deserializing %d coins - bad tx out value",
-                              coins_count - coins_left))};
-                }
-                coins_cache.EmplaceCoinInternalDANGER(std::move(outpoint), std::move(coin));
-
-                --coins_left;
-                ++coins_processed;
+        if (coins_processed % 1000000 == 0) {
+            LogPrintf("[snapshot] %d coins loaded (%.2f%%, %.2f MB)\n",
+                coins_processed,
+                static_cast<float>(coins_processed) * 100 / static_cast<float>(coins_count),
+                coins_cache.DynamicMemoryUsage() / (1000 * 1000));
+        }
 
-                if (coins_processed % 1000000 == 0) {
-                    LogPrintf("[snapshot] %d coins loaded (%.2f%%, %.2f MB)\n",
-                        coins_processed,
-                        static_cast<float>(coins_processed) * 100 / static_cast<float>(coins_count),
-                        coins_cache.DynamicMemoryUsage() / (1000 * 1000));
-                }
+        // Batch write and flush (if we need to) every so often.
+        //
+        // If our average Coin size is roughly 41 bytes, checking every 120,000 coins
+        // means <5MB of memory imprecision.
+        if (coins_processed % 120000 == 0) {
+            if (m_interrupt) {
+                return util::Error{Untranslated("Aborting after an interrupt was requested")};
+            }
 
-                // Batch write and flush (if we need to) every so often.
-                //
-                // If our average Coin size is roughly 41 bytes, checking every 120,000 coins
-                // means <5MB of memory imprecision.
-                if (coins_processed % 120000 == 0) {
-                    if (m_interrupt) {
-                        return util::Error{Untranslated("Aborting after an interrupt was requested")};
-                    }
+            const auto snapshot_cache_state = WITH_LOCK(::cs_main,
+                return snapshot_chainstate.GetCoinsCacheSizeState());
 
-                    const auto snapshot_cache_state = WITH_LOCK(::cs_main,
-                        return snapshot_chainstate.GetCoinsCacheSizeState());
+            if (snapshot_cache_state >= CoinsCacheSizeState::CRITICAL) {
+                // This is a hack - we don't know what the actual best block is, but that
+                // doesn't matter for the purposes of flushing the cache here. We'll set this
+                // to its correct value (`base_blockhash`) below after the coins are loaded.
+                coins_cache.SetBestBlock(GetRandHash());
 
-                    if (snapshot_cache_state >= CoinsCacheSizeState::CRITICAL) {
-                        // This is a hack - we don't know what the actual best block is, but that
-                        // doesn't matter for the purposes of flushing the cache here. We'll set this
-                        // to its correct value (`base_blockhash`) below after the coins are loaded.
-                        coins_cache.SetBestBlock(GetRandHash());
+                // No need to acquire cs_main since this chainstate isn't being used yet.
+                FlushSnapshotToDisk(coins_cache, snapshot_chainstate.CoinsShared(), /*snapshot_loaded=*/false);
+            }
+        }
+        return {};
+    }};
 
-                        // No need to acquire cs_main since this chainstate isn't being used yet.
-                        FlushSnapshotToDisk(coins_cache, /*snapshot_loaded=*/false);
-                    }
+    if (!manifest) {
+        if (auto res{ReadSnapshotCoins(*coins_files[0], coins_count, base_height, /*begin_byte=*/0, /*end_byte=*/256, add_coin)}; !res) {
+            return res;
+        }
+    } else {
+        // Only deserialization and hashing run on the workers: coins_cache is
+        // filled from this thread.
+        LogPrintf("[snapshot] reading %d chunk files\n", coins_files.size());
+        SnapshotChunkReader reader{coins_files, *manifest, GetParams().MessageStart(), base_height, m_options.worker_threads_num};
+        while (auto batch{reader.Next()}) {
+            for (auto& [outpoint, coin] : *batch) {
+                if (auto res{add_coin(std::move(outpoint), std::move(coin))}; !res) {
+                    reader.Abort();
+                    return res;
                 }
             }
-        } catch (const std::ios_base::failure&) {
-            return util::Error{Untranslated(strprintf("Bad snapshot format or truncated snapshot after deserializing %d coins",
-                      coins_processed))};
+        }
+        if (auto res{reader.Finish()}; !res) {
+            return res;
         }
     }
 
@@ -6009,26 +6732,13 @@ util::Result<void> ChainstateManager::PopulateAndValidateSnapshot(
     // method.
     coins_cache.SetBestBlock(base_blockhash);
 
-    bool out_of_coins{false};
-    try {
-        std::byte left_over_byte;
-        coins_file >> left_over_byte;
-    } catch (const std::ios_base::failure&) {
-        // We expect an exception since we should be out of coins.
-        out_of_coins = true;
-    }
-    if (!out_of_coins) {
-        return util::Error{Untranslated(strprintf("Bad snapshot - coins left over after deserializing %d coins",
-            coins_count))};
-    }
-
     LogPrintf("[snapshot] loaded %d (%.2f MB) coins from snapshot %s\n",
         coins_count,
         coins_cache.DynamicMemoryUsage() / (1000 * 1000),
         base_blockhash.ToString());
 
     // No need to acquire cs_main since this chainstate isn't being used yet.
-    FlushSnapshotToDisk(coins_cache, /*snapshot_loaded=*/true);
+    FlushSnapshotToDisk(coins_cache, snapshot_chainstate.CoinsShared(), /*snapshot_loaded=*/true);
 
     assert(coins_cache.GetBestBlock() == base_blockhash);
 
@@ -6286,6 +6996,12 @@ void ChainstateManager::MaybeRebalanceCaches()
                 m_total_coinstip_cache * 0.95, m_total_coinsdb_cache * 0.95);
         }
     }
+
+    // A background chainstate is always catching up, the active one only
+    // until it leaves initial block download.
+    for (Chainstate* chainstate : GetAll()) {
+        chainstate->SetCoinsDBBulkLoad(chainstate != m_active_chainstate || IsInitialBlockDownload());
+    }
 }
 
 void ChainstateManager::ResetChainstates()
@@ -6315,6 +7031,9 @@ ChainstateManager::ChainstateManager(const util::SignalInterrupt& interrupt, Opt
       m_blockman{interrupt, std::move(blockman_options)},
       m_validation_cache{m_options.script_execution_cache_bytes, m_options.signature_cache_bytes}
 {
+    if (m_options.coins_prefetch_threads > 0) {
+        m_coins_prefetch_pool = std::make_unique<CoinsPrefetchPool>(m_options.coins_prefetch_threads);
+    }
 }
 
 ChainstateManager::~ChainstateManager()
@@ -37,6 +37,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
 #include <optional>
@@ -48,6 +49,7 @@
 #include <vector>
 
 class Chainstate;
+class CoinsPrefetchPool;
 class CTxMemPool;
 class ChainstateManager;
 struct ChainTxData;
@@ -56,6 +58,7 @@ struct PrecomputedTransactionData;
 struct LockPoints;
 struct AssumeutxoData;
 namespace node {
+class SnapshotManifest;
 class SnapshotMetadata;
 } // namespace node
 namespace Consensus {
@@ -76,11 +79,15 @@ static constexpr int DEFAULT_CHECKLEVEL{3};
 // We want the low water mark after pruning to be at least 397 MB and since we prune in
 // full block file chunks, we need the high water mark which triggers the prune to be
 // one 128MB block file + added 15% undo data = 147MB greater for a total of 545MB
+// (block files of pruned nodes are capped at MAX_PRUNED_BLOCKFILE_SIZE for this reason;
+// unpruned nodes use larger ones)
 // Setting the target to >= 550 MiB will make it likely we can respect the target.
 static const uint64_t MIN_DISK_SPACE_FOR_BLOCK_FILES = 550 * 1024 * 1024;
 
 /** Maximum number of dedicated script-checking threads allowed */
 static constexpr int MAX_SCRIPTCHECK_THREADS{15};
+/** Maximum number of threads reading the inputs of a block from the coins database before it is connected */
+static constexpr int MAX_COINS_PREFETCH_THREADS{16};
 
 /** Current sync state passed to tip changed callbacks. */
 enum class SynchronizationState {
@@ -268,6 +275,29 @@ MempoolAcceptResult AcceptToMemoryPool(Chainstate& active_chainstate, const CTra
                                        int64_t accept_time, bool bypass_limits, bool test_accept)
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Try to add a batch of independently received transactions to the mempool, in order, as if each
+ * had been passed to AcceptToMemoryPool() with bypass_limits=false. The mempool is locked once for
+ * the whole batch and the script checks of all transactions are run on the script check threads.
+ * Client code should use ChainstateManager::ProcessTransactions(), except for reloading the mempool.
+ *
+ * @param[in]  accept_times     The time each transaction entered the mempool, in the order of txns.
+ * @param[in]  trusted_scripts  When true, the scripts of the transactions are not verified. Only for
+ *                              transactions whose scripts this node has verified before, under the
+ *                              same rules, such as those in a mempool.dat it wrote itself.
+ * @returns a MempoolAcceptResult for each transaction, in the order of txns.
+ */
+std::vector<MempoolAcceptResult> AcceptTransactionsToMemoryPool(Chainstate& active_chainstate, std::span<const CTransactionRef> txns,
+                                                                std::span<const int64_t> accept_times, bool test_accept,
+                                                                bool trusted_scripts = false)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/**
+ * The consensus script verification flags the scripts of mempool transactions are checked against,
+ * those of the active chain's tip. They are also checked against STANDARD_SCRIPT_VERIFY_FLAGS.
+ */
+unsigned int GetMempoolConsensusScriptFlags(const Chainstate& active_chainstate) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /**
 * Validate (and maybe submit) a package to the mempool. See doc/policy/packages.md for full details
 * on package validation rules.
@@ -478,12 +508,25 @@ public:
     //! This view wraps access to the leveldb instance and handles read errors gracefully.
     CCoinsViewErrorCatcher m_catcherview GUARDED_BY(cs_main);
 
-    //! This is the top layer of the cache hierarchy - it keeps as many coins in memory as
-    //! can fit per the dbcache setting.
+    //! This view holds coins that are being written to the database in the background,
+    //! so that flushing the cache does not have to wait for the write to finish.
+    //! It is not guarded by cs_main: m_sharedview reads through it without cs_main on a
+    //! cache miss. The generation in flight is protected by the view's own mutex, and
+    //! reads below it only touch the database, which may be read concurrently. Writes
+    //! to it (BatchWrite, DeferNextWrite) still only come from flushes under cs_main.
+    CCoinsViewBackgroundFlush m_flushview;
+
+    //! This view keeps as many coins in memory as can fit per the dbcache setting. It
+    //! receives the changes of m_cacheview after every block, and may be read without
+    //! cs_main.
+    CCoinsViewShardedCache m_sharedview;
+
+    //! This is the top layer of the cache hierarchy - it holds the changes made since
+    //! they were last moved to m_sharedview.
     std::unique_ptr<CCoinsViewCache> m_cacheview GUARDED_BY(cs_main);
 
-    //! This constructor initializes CCoinsViewDB and CCoinsViewErrorCatcher instances, but it
-    //! *does not* create a CCoinsViewCache instance by default. This is done separately because the
+    //! This constructor initializes CCoinsViewDB, CCoinsViewErrorCatcher, CCoinsViewBackgroundFlush
+    //! and CCoinsViewShardedCache instances, but it *does not* create a CCoinsViewCache instance by default. This is done separately because the
     //! presence of the cache has implications on whether or not we're allowed to flush the cache's
     //! state to disk, which should not be done until the health of the database is verified.
     //!
@@ -631,11 +674,52 @@ public:
         return *Assert(m_coins_views->m_cacheview);
     }
 
+    //! @returns A reference to the in-memory cache below CoinsTip(), which may
+    //!     be read from any thread without holding cs_main. It reflects the
+    //!     UTXO set as of the last block connected or disconnected.
+    CCoinsViewShardedCache& CoinsShared()
+    {
+        return Assert(m_coins_views)->m_sharedview;
+    }
+
+    //! @returns A reference to the view below CoinsShared() that holds the
+    //!     coins of a flush while they are written to disk in the background.
+    CCoinsViewBackgroundFlush& CoinsFlushing()
+    {
+        return Assert(m_coins_views)->m_flushview;
+    }
+
+    //! Check whether the coin is in CoinsTip() or CoinsShared(), without
+    //! reading from the database.
+    bool HaveCoinInCache(const COutPoint& outpoint) EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
+    {
+        return CoinsTip().HaveCoinInCache(outpoint) || CoinsShared().HaveCoinInCache(outpoint);
+    }
+
+    //! Remove an unmodified coin from CoinsTip() and CoinsShared().
+    void UncacheCoin(const COutPoint& outpoint) EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
+    {
+        CoinsTip().Uncache(outpoint);
+        CoinsShared().Uncache(outpoint);
+    }
+
+    /**
+     * Read the coins spent by a transaction that is about to be validated,
+     * before taking cs_main, so that validating it does not wait on the disk
+     * while holding the lock. Nothing is added to the coins caches, so that
+     * invalid transactions can not fill them.
+     */
+    void PrefetchInputs(const CTransaction& tx) const EXCLUSIVE_LOCKS_REQUIRED(!::cs_main);
+
     //! @returns A reference to the on-disk UTXO set database.
     CCoinsViewDB& CoinsDB() EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
     {
         AssertLockHeld(::cs_main);
-        return Assert(m_coins_views)->m_dbview;
+        // Callers read or modify the database directly, so let any background
+        // write of flushed coins complete first. A failed write is reported by
+        // the next flush.
+        Assert(m_coins_views)->m_flushview.WaitForFlush();
+        return m_coins_views->m_dbview;
     }
 
     //! @returns A pointer to the mempool.
@@ -664,11 +748,18 @@ public:
     //! The cache size of the in-memory coins view.
     size_t m_coinstip_cache_size_bytes{0};
 
+    //! The part of m_coinstip_cache_size_bytes given to the write buffers of
+    //! the on-disk coins view while it is tuned for bulk loading.
+    size_t m_coinsdb_write_buffer_bytes{0};
+
     //! Resize the CoinsViews caches dynamically and flush state to disk.
     //! @returns true unless an error occurred during the flush.
     bool ResizeCoinsCaches(size_t coinstip_size, size_t coinsdb_size)
         EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
+    //! Tune the coins database for initial block download, or for steady state.
+    void SetCoinsDBBulkLoad(bool bulk_load) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
     /**
      * Update the on-disk chain state.
      * The caches and indexes are flushed depending on the mode we're called with
@@ -788,6 +879,11 @@ public:
 private:
     bool ActivateBestChainStep(BlockValidationState& state, CBlockIndex* pindexMostWork, const std::shared_ptr<const CBlock>& pblock, bool& fInvalidFound, ConnectTrace& connectTrace) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mempool->cs);
     bool ConnectTip(BlockValidationState& state, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, ConnectTrace& connectTrace, DisconnectedBlockTransactions& disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mempool->cs);
+    //! Load the inputs of block that are missing from the coins caches, reading them
+    //! from the coins database in parallel, so ConnectBlock does not fetch them one by one.
+    void PrefetchBlockInputs(const CBlock& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    //! Move the changes in CoinsTip() to CoinsShared(), once the tip has changed.
+    void PublishCoinsTip() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     void InvalidBlockFound(CBlockIndex* pindex, const BlockValidationState& state) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     CBlockIndex* FindMostWorkChain() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -921,6 +1017,19 @@ private:
 
     bool NotifyHeaderTip() LOCKS_EXCLUDED(GetMutex());
 
+    //! Internal helper for LoadExternalBlockFile() and LoadExternalBlocks().
+    //!
+    //! Accepts the block with the given header unless it is known already or its
+    //! parent is not, in which case it is remembered in blocks_with_unknown_parent.
+    //! read_block is only called if the full block is needed. Returns false if
+    //! importing should stop.
+    bool ProcessExternalBlock(
+        const CBlockHeader& header,
+        const std::function<std::shared_ptr<CBlock>()>& read_block,
+        FlatFilePos* dbp,
+        std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent,
+        int& loaded) LOCKS_EXCLUDED(::cs_main);
+
     //! Internal helper for ActivateSnapshot().
     //!
     //! De-serialization of a snapshot that is created with
@@ -928,10 +1037,21 @@ private:
     //! To reduce space the serialization format of the snapshot avoids
     //! duplication of tx hashes. The code takes advantage of the guarantee by
     //! leveldb that keys are lexicographically sorted.
+    //!
+    //! If manifest is set, coins_files are its chunk files, which are
+    //! deserialized in parallel. Otherwise coins_files is the single file
+    //! described by metadata.
     [[nodiscard]] util::Result<void> PopulateAndValidateSnapshot(
         Chainstate& snapshot_chainstate,
-        AutoFile& coins_file,
-        const node::SnapshotMetadata& metadata);
+        std::span<AutoFile* const> coins_files,
+        const node::SnapshotMetadata& metadata,
+        const node::SnapshotManifest* manifest);
+
+    //! Internal helper for ActivateSnapshot(), see PopulateAndValidateSnapshot()
+    //! for the arguments.
+    [[nodiscard]] util::Result<CBlockIndex*> ActivateSnapshotFiles(
+        std::span<AutoFile* const> coins_files, const node::SnapshotMetadata& metadata,
+        const node::SnapshotManifest* manifest, bool in_memory);
 
     /**
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
@@ -962,6 +1082,10 @@ private:
     //! A queue for script verifications that have to be performed by worker threads.
     CCheckQueue<CScriptCheck> m_script_check_queue;
 
+    //! Threads reading block inputs from the coins database ahead of ConnectBlock.
+    //! Null if disabled.
+    std::unique_ptr<CoinsPrefetchPool> m_coins_prefetch_pool;
+
     //! Timers and counters used for benchmarking validation in both background
     //! and active chainstates.
     SteadyClock::duration GUARDED_BY(::cs_main) time_check{};
@@ -993,6 +1117,14 @@ public:
     const uint256& AssumedValidBlock() const { return *Assert(m_options.assumed_valid_block); }
     kernel::Notifications& GetNotifications() const { return m_options.notifications; };
 
+    /**
+     * Whether the scripts of a block can be skipped under -assumevalid: it is an
+     * ancestor of both the assumed valid block and the best header, the best
+     * header has the minimum chain work, and the block is buried under more than
+     * two weeks worth of work.
+     */
+    bool IsAssumedValid(const CBlockIndex& index) const EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
     /**
      * Make various assertions about the state of the block index.
      *
@@ -1089,6 +1221,12 @@ public:
     [[nodiscard]] util::Result<CBlockIndex*> ActivateSnapshot(
         AutoFile& coins_file, const node::SnapshotMetadata& metadata, bool in_memory);
 
+    //! Construct and activate a Chainstate from a UTXO snapshot split into the
+    //! chunk files listed by manifest, in the same order. The chunks are
+    //! deserialized in parallel.
+    [[nodiscard]] util::Result<CBlockIndex*> ActivateSnapshot(
+        std::span<AutoFile* const> chunk_files, const node::SnapshotManifest& manifest, bool in_memory);
+
     //! Once the background validation chainstate has reached the height which
     //! is the base of the UTXO snapshot in use, compare its coins to ensure
     //! they match those expected by the snapshot.
@@ -1171,11 +1309,30 @@ public:
      * @param[in,out] blocks_with_unknown_parent    (optional) Map of disk positions for blocks with
      *                                              unknown parent, key is parent block hash
      *                                              (only used for reindex)
+     * @param[in]     block_offsets                 (optional) Ascending offsets of the storage headers
+     *                                              of all blocks in the file, as read from its index
+     *                                              footer. If given, only these positions are read
+     *                                              instead of scanning the file for the message start.
      * */
     void LoadExternalBlockFile(
         AutoFile& file_in,
         FlatFilePos* dbp = nullptr,
-        std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent = nullptr);
+        std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent = nullptr,
+        std::span<const uint32_t> block_offsets = {});
+
+    /**
+     * Import blocks that were already read from a block file during -reindex, in the
+     * order they are stored in the file. Behaves like LoadExternalBlockFile() with a
+     * disk position, but leaves reading and deserializing the blocks to the caller, so
+     * that later files can be read ahead while these are processed.
+     *
+     * @param[in]     blocks                        Blocks with their disk positions
+     * @param[in,out] blocks_with_unknown_parent    Map of disk positions for blocks with
+     *                                              unknown parent, key is parent block hash
+     */
+    void LoadExternalBlocks(
+        std::span<const std::pair<std::shared_ptr<CBlock>, FlatFilePos>> blocks,
+        std::multimap<uint256, FlatFilePos>& blocks_with_unknown_parent);
 
     /**
      * Process an incoming block. This only returns after the best known valid
@@ -1249,11 +1406,23 @@ public:
     [[nodiscard]] MempoolAcceptResult ProcessTransaction(const CTransactionRef& tx, bool test_accept=false)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /**
+     * Try to add a batch of independently received transactions to the memory pool. Cheaper than
+     * calling ProcessTransaction() for each of them when they arrive in a burst.
+     *
+     * @param[in]  txns            The transactions to submit, evaluated in this order.
+     * @param[in]  test_accept     When true, run validation checks but don't submit to mempool.
+     * @returns a MempoolAcceptResult for each transaction, in the order of txns.
+     */
+    [[nodiscard]] std::vector<MempoolAcceptResult> ProcessTransactions(std::span<const CTransactionRef> txns, bool test_accept=false)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     //! Load the block tree and coins database from disk, initializing state if we're running with -reindex
     bool LoadBlockIndex() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     //! Check to see if caches are out of balance and if so, call
-    //! ResizeCoinsCaches() as needed.
+    //! ResizeCoinsCaches() as needed. Also tunes the coins databases for
+    //! whether their chainstate is still catching up.
     void MaybeRebalanceCaches() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
     /** Update uncommitted block structures (currently: only the witness reserved value). This is safe for submitted blocks. */
@@ -10,6 +10,7 @@ The assumeutxo value generated and used here is committed to in
 `CRegTestParams::m_assumeutxo_data` in `src/kernel/chainparams.cpp`.
 """
 import contextlib
+import os
 from shutil import rmtree
 
 from dataclasses import dataclass
@@ -140,7 +141,7 @@ class AssumeutxoTest(Quantum CoinTestFramework):
         self.log.info("  - snapshot file with alternated but parsable UTXO data results in different hash")
         cases = [
             # (content, offset, wrong_hash, custom_message)
-            [b"\xff" * 32, 0, "77874d48d932a5cb7a7f770696f5224ff05746fdcf732a58270b45da0f665934", None],  # wrong outpoint hash
+            [b"\xff" * 32, 0, None, "Bad snapshot data after deserializing 1 coins - txid"],  # wrong outpoint hash, out of order
             [(2).to_bytes(1, "little"), 32, None, "Bad snapshot format or truncated snapshot after deserializing 1 coins."],  # wrong txid coins count
             [b"\xfd\xff\xff", 32, None, "Mismatch in coins count in snapshot metadata and actual snapshot data"],  # txid coins count exceeds coins left
             [b"\x01", 33, "9f562925721e4f97e6fde5b590dbfede51e2204a68639525062ad064545dd0ea", None],  # wrong outpoint index
@@ -167,6 +168,28 @@ class AssumeutxoTest(Quantum CoinTestFramework):
             msg = custom_message if custom_message is not None else f"Bad snapshot content hash: expected d2b051ff5e8eef46520350776f4100dd710a63447a8e01d917e92e79751a63e2, got {wrong_hash}."
             expected_error(msg)
 
+    def test_invalid_manifest_scenarios(self, valid_manifest_path):
+        self.log.info("Test loading snapshot manifests whose chunks overlap")
+        with open(valid_manifest_path, 'rb') as f:
+            valid_manifest_contents = f.read()
+        bad_manifest_path = valid_manifest_path + '.mod'
+        node = self.nodes[1]
+
+        # Manifest magic, manifest version, snapshot metadata, MuHash, number of chunks
+        offset = 5 + 2 + (5 + 2 + 4 + 32 + 8) + 32 + 1
+        chunk_offsets = []
+        for _ in range(valid_manifest_contents[offset - 1]):
+            # File name, coins count, then the txid range of the chunk
+            offset += 1 + valid_manifest_contents[offset] + 8
+            chunk_offsets.append(offset)
+            offset += 2 + 2
+        for chunk, begin_byte in [(1, 0), (0, 1), (1, 255)]:
+            with open(bad_manifest_path, 'wb') as f:
+                f.write(valid_manifest_contents[:chunk_offsets[chunk]])
+                f.write(begin_byte.to_bytes(2, "little"))
+                f.write(valid_manifest_contents[chunk_offsets[chunk] + 2:])
+            assert_raises_rpc_error(-22, "Unable to parse manifest: Invalid txid ranges of snapshot chunks.", node.loadtxoutset, bad_manifest_path)
+
     def test_headers_not_synced(self, valid_snapshot_path):
         for node in self.nodes[1:]:
             msg = "Unable to load UTXO snapshot: The base block header (7cc695046fec709f8c9394b6f928f81e81fd3ac20977bb68760fa1faa7916ea2) must appear in the headers chain. Make sure all headers are syncing, and call loadtxoutset again."
@@ -484,12 +507,22 @@ class AssumeutxoTest(Quantum CoinTestFramework):
         dump_output5 = n0.dumptxoutset('utxos5.dat', rollback=prev_snap_hash)
         assert_equal(sha256sum_file(dump_output4['path']), sha256sum_file(dump_output5['path']))
 
+        self.log.info("Check that dumptxoutset can split the snapshot into chunks")
+        chunked_output = n0.dumptxoutset('utxos_chunked.dat', rollback=SNAPSHOT_BASE_HEIGHT, chunks=4)
+        assert_equal(chunked_output['chunks'], 4)
+        assert_equal(chunked_output['coins_written'], dump_output['coins_written'])
+        assert_equal(chunked_output['txoutset_hash'], dump_output['txoutset_hash'])
+        for i in range(4):
+            assert os.path.exists(f"{chunked_output['path']}.{i}")
+        assert_raises_rpc_error(-8, "Invalid number of chunks 257, must be between 1 and 256", n0.dumptxoutset, 'utxos_chunked2.dat', "latest", chunks=257)
+
         # Ensure n0 is back at the tip
         assert_equal(n0.getblockchaininfo()["blocks"], FINAL_HEIGHT)
 
         self.test_snapshot_with_less_work(dump_output['path'])
         self.test_invalid_mempool_state(dump_output['path'])
         self.test_invalid_snapshot_scenarios(dump_output['path'])
+        self.test_invalid_manifest_scenarios(chunked_output['path'])
         self.test_invalid_chainstate_scenarios()
         self.test_invalid_file_path()
         self.test_snapshot_block_invalidated(dump_output['path'])
@@ -689,8 +722,8 @@ class AssumeutxoTest(Quantum CoinTestFramework):
         assert_equal(n2.getblockcount(), START_HEIGHT)
         assert 'NETWORK' in n2.getnetworkinfo()['localservicesnames']  # sanity check
 
-        self.log.info(f"Loading snapshot into third node from {dump_output['path']}")
-        loaded = n2.loadtxoutset(dump_output['path'])
+        self.log.info(f"Loading snapshot into third node from the chunks of {chunked_output['path']}")
+        loaded = n2.loadtxoutset(chunked_output['path'])
         assert_equal(loaded['coins_loaded'], SNAPSHOT_BASE_HEIGHT)
         assert_equal(loaded['base_height'], SNAPSHOT_BASE_HEIGHT)
 
@@ -324,6 +324,7 @@ class EstimateFeeTest(Quantum CoinTestFramework):
 
     def test_estimate_dat_is_flushed_periodically(self):
         fee_dat = self.nodes[0].chain_path / "fee_estimates.dat"
+        fee_log = self.nodes[0].chain_path / "fee_estimates.log"
         os.remove(fee_dat) if os.path.exists(fee_dat) else None
 
         # Verify that fee_estimates.dat does not exist
@@ -337,12 +338,14 @@ class EstimateFeeTest(Quantum CoinTestFramework):
 
         # Verify that fee estimates were flushed and fee_estimates.dat file is created
         assert_equal(os.path.isfile(fee_dat), True)
+        assert_equal(os.path.isfile(fee_log), True)
 
-        # Verify that the estimates remain the same if there are no blocks in the flush interval
+        # Verify that the estimates remain the same if there are no blocks in the flush interval.
+        # Later flushes only append the updates since the last one to fee_estimates.log.
         block_hash_before = self.nodes[0].getbestblockhash()
         fee_dat_initial_content = open(fee_dat, "rb").read()
-        with self.nodes[0].assert_debug_log(expected_msgs=["Flushed fee estimates to fee_estimates.dat."], timeout=1):
-            # Mock the scheduler for an hour to flush fee estimates to fee_estimates.dat
+        fee_log_initial_content = open(fee_log, "rb").read()
+        with self.nodes[0].assert_debug_log(expected_msgs=["Flushed fee estimate updates to fee_estimates.log."], timeout=1):
             self.nodes[0].mockscheduler(SECONDS_PER_HOUR)
 
         # Verify that there were no blocks in between the flush interval
@@ -350,24 +353,27 @@ class EstimateFeeTest(Quantum CoinTestFramework):
 
         fee_dat_current_content = open(fee_dat, "rb").read()
         assert_equal(fee_dat_current_content, fee_dat_initial_content)
+        assert_equal(open(fee_log, "rb").read(), fee_log_initial_content)
 
         # Verify that the estimates remain the same after shutdown with no blocks before shutdown
         self.restart_node(0)
         fee_dat_current_content = open(fee_dat, "rb").read()
         assert_equal(fee_dat_current_content, fee_dat_initial_content)
 
-        # Verify that the estimates are not the same if new blocks were produced in the flush interval
-        with self.nodes[0].assert_debug_log(expected_msgs=["Flushed fee estimates to fee_estimates.dat."], timeout=1):
-            # Mock the scheduler for an hour to flush fee estimates to fee_estimates.dat
+        # Verify that the updates are logged if new blocks were produced in the flush interval
+        fee_log_initial_content = open(fee_log, "rb").read()
+        with self.nodes[0].assert_debug_log(expected_msgs=["Flushed fee estimate updates to fee_estimates.log."], timeout=1):
             self.generate(self.nodes[0], 5, sync_fun=self.no_op)
             self.nodes[0].mockscheduler(SECONDS_PER_HOUR)
 
         fee_dat_current_content = open(fee_dat, "rb").read()
-        assert_not_equal(fee_dat_current_content, fee_dat_initial_content)
-
-        fee_dat_initial_content = fee_dat_current_content
+        assert_equal(fee_dat_current_content, fee_dat_initial_content)
+        fee_log_current_content = open(fee_log, "rb").read()
+        assert_not_equal(fee_log_current_content, fee_log_initial_content)
+        assert fee_log_current_content.startswith(fee_log_initial_content)
 
-        # Generate blocks before shutdown and verify that the fee estimates are not the same
+        # Generate blocks before shutdown and verify that the fee estimates are not the same.
+        # The logged updates are replayed on startup and written out in full on shutdown.
         self.generate(self.nodes[0], 5, sync_fun=self.no_op)
         self.restart_node(0)
         fee_dat_current_content = open(fee_dat, "rb").read()
@@ -23,11 +23,13 @@ class ReindexTest(Quantum CoinTestFramework):
         self.setup_clean_chain = True
         self.num_nodes = 1
 
-    def reindex(self, justchainstate=False):
+    def reindex(self, justchainstate=False, reindex_threads=None):
         self.generatetoaddress(self.nodes[0], 3, self.nodes[0].get_deterministic_priv_key().address)
         blockcount = self.nodes[0].getblockcount()
         self.stop_nodes()
         extra_args = [["-reindex-chainstate" if justchainstate else "-reindex"]]
+        if reindex_threads is not None:
+            extra_args[0].append(f"-reindexthreads={reindex_threads}")
         self.start_nodes(extra_args)
         assert_equal(self.nodes[0].getblockcount(), blockcount)  # start_node is blocking on reindex
         self.log.info("Success")
@@ -69,8 +71,8 @@ class ReindexTest(Quantum CoinTestFramework):
 
         # The reindexing code should detect and accommodate out of order blocks.
         with self.nodes[0].assert_debug_log([
-            'LoadExternalBlockFile: Out of order block',
-            'LoadExternalBlockFile: Processing out of order child',
+            'ProcessExternalBlock: Out of order block',
+            'ProcessExternalBlock: Processing out of order child',
         ]):
             extra_args = [["-reindex"]]
             self.start_nodes(extra_args)
@@ -100,7 +102,7 @@ class ReindexTest(Quantum CoinTestFramework):
     def run_test(self):
         self.reindex(False)
         self.reindex(True)
-        self.reindex(False)
+        self.reindex(False, reindex_threads=0)
         self.reindex(True)
 
         self.out_of_order()
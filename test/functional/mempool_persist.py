@@ -31,12 +31,16 @@ Test is as follows:
   - Remove node0 mempool.dat and verify savemempool RPC recreates it
     and verify that node1 can load it and has 5 transactions in its
     mempool.
+  - Restart node0 with -persistmempooltrusted. Verify that it trusts
+    the mempool.dat it wrote, but verifies the scripts again once the
+    file was tampered with or written at another tip.
   - Verify that savemempool throws when the RPC is called if
     node1 can't write to disk.
 
 """
 from decimal import Decimal
 import os
+import shutil
 import time
 
 from test_framework.p2p import P2PTxInvStore
@@ -172,17 +176,26 @@ class MempoolPersistTest(Quantum CoinTestFramework):
         assert self.nodes[0].getmempoolinfo()["loaded"]
         assert_equal(len(self.nodes[0].getrawmempool()), 7)
 
+        self.log.debug("Stop-start node0 with -persistmempooltrusted. Verify that it trusts the mempool.dat it wrote.")
+        self.stop_nodes()
+        with self.nodes[0].assert_debug_log(expected_msgs=["Mempool file was written by this node"]):
+            self.start_node(0, extra_args=["-persistmempooltrusted"])
+            assert self.nodes[0].getmempoolinfo()["loaded"]
+        assert_equal(len(self.nodes[0].getrawmempool()), 7)
+        self.test_persist_trusted_fallback(mempooldat0)
+
         self.log.debug("Remove the mempool.dat file. Verify that savemempool to disk via RPC re-creates it")
         os.remove(mempooldat0)
         result0 = self.nodes[0].savemempool()
         assert os.path.isfile(mempooldat0)
         assert_equal(result0['filename'], mempooldat0)
 
-        self.log.debug("Stop nodes, make node1 use mempool.dat from node0. Verify it has 7 transactions")
+        self.log.debug("Stop nodes, make node1 use mempool.dat from node0. Verify it has 7 transactions, whose scripts it verifies")
         os.rename(mempooldat0, mempooldat1)
         self.stop_nodes()
-        self.start_node(1, extra_args=["-persistmempool"])
-        assert self.nodes[1].getmempoolinfo()["loaded"]
+        with self.nodes[1].assert_debug_log(expected_msgs=[], unexpected_msgs=["Mempool file was written by this node"]):
+            self.start_node(1, extra_args=["-persistmempool", "-persistmempooltrusted"])
+            assert self.nodes[1].getmempoolinfo()["loaded"]
         assert_equal(len(self.nodes[1].getrawmempool()), 7)
 
         self.log.debug("Prevent qtcd from writing mempool.dat to disk. Verify that `savemempool` fails")
@@ -196,6 +209,39 @@ class MempoolPersistTest(Quantum CoinTestFramework):
         self.test_importmempool_union()
         self.test_persist_unbroadcast()
 
+    def test_persist_trusted_fallback(self, mempooldat0):
+        node0 = self.nodes[0]
+        untrusted_msg = "Mempool file was not written by this node under the current tip and script flags"
+        trusted_msg = "Mempool file was written by this node"
+
+        self.log.debug("Tamper with the mempool.dat node0 wrote. Verify that it verifies the scripts of its transactions again.")
+        # The last bytes ahead of the tip hash, script flags and checksum ending the file are those of
+        # the last unbroadcast txid. Changing it keeps the file readable.
+        assert_greater_than_or_equal(node0.getmempoolinfo()["unbroadcastcount"], 1)
+        self.stop_nodes()
+        with open(mempooldat0, "r+b") as f:
+            f.seek(-(32 + 4 + 4 + 32 + 1), os.SEEK_END)
+            byte = f.read(1)[0]
+            f.seek(-1, os.SEEK_CUR)
+            f.write(bytes([byte ^ 1]))
+        with node0.assert_debug_log(expected_msgs=[untrusted_msg], unexpected_msgs=[trusted_msg]):
+            self.start_node(0, extra_args=["-persistmempooltrusted"])
+            assert node0.getmempoolinfo()["loaded"]
+        assert_equal(len(node0.getrawmempool()), 7)
+
+        self.log.debug("Restore a mempool.dat node0 wrote at an earlier tip. Verify that it verifies the scripts of its transactions again.")
+        node0.savemempool()
+        mempooldat0_old = mempooldat0 + ".old"
+        shutil.copyfile(mempooldat0, mempooldat0_old)
+        self.generateblock(node0, output=self.mini_wallet.get_address(), transactions=[], sync_fun=self.no_op)
+        assert_equal(len(node0.getrawmempool()), 7)
+        self.stop_nodes()
+        os.replace(mempooldat0_old, mempooldat0)
+        with node0.assert_debug_log(expected_msgs=[untrusted_msg], unexpected_msgs=[trusted_msg]):
+            self.start_node(0, extra_args=["-persistmempooltrusted"])
+            assert node0.getmempoolinfo()["loaded"]
+        assert_equal(len(node0.getrawmempool()), 7)
+
     def test_persist_unbroadcast(self):
         node0 = self.nodes[0]
         self.start_node(0)
@@ -792,6 +792,51 @@ class CompactBlocksTest(Quantum CoinTestFramework):
         stalling_peer.send_and_ping(msg)
         assert_equal(int(node.getbestblockhash(), 16), block.sha256)
 
+    def test_fast_relay_before_reconstruction(self, sender, receiver):
+        node = self.nodes[0]
+        assert len(self.utxos)
+
+        # A compact block whose transactions the node is missing, so it can't be reconstructed yet.
+        utxo = self.utxos.pop(0)
+        block = self.build_block_with_transactions(node, utxo, 5)
+        cmpct_block = HeaderAndShortIDs()
+        cmpct_block.initialize_from_block(block)
+        receiver.clear_block_announcement()
+        sender.clear_getblocktxn()
+        sender.send_and_ping(msg_cmpctblock(cmpct_block.to_p2p()))
+        with p2p_lock:
+            assert "getblocktxn" in sender.last_message
+        assert_not_equal(int(node.getbestblockhash(), 16), block.sha256)
+
+        # The header's proof of work is valid, so the high-bandwidth receiver gets the compact block
+        # right away.
+        receiver.wait_for_block_announcement(block.sha256)
+        with p2p_lock:
+            assert_equal(receiver.last_message["cmpctblock"].header_and_shortids.header.sha256, block.sha256)
+
+        # Its getblocktxn is held until the node has the block, then answered.
+        msg = msg_getblocktxn()
+        msg.block_txn_request = BlockTransactionsRequest(block.sha256, [])
+        msg.block_txn_request.from_absolute(list(range(1, len(block.vtx))))
+        with p2p_lock:
+            receiver.last_message.pop("blocktxn", None)
+        receiver.send_and_ping(msg)
+        with p2p_lock:
+            assert "blocktxn" not in receiver.last_message
+
+        blocktxn = msg_blocktxn()
+        blocktxn.block_transactions.blockhash = block.sha256
+        blocktxn.block_transactions.transactions = block.vtx[1:]
+        sender.send_and_ping(blocktxn)
+        assert_equal(int(node.getbestblockhash(), 16), block.sha256)
+
+        receiver.wait_until(lambda: "blocktxn" in receiver.last_message)
+        with p2p_lock:
+            assert_equal(receiver.last_message["blocktxn"].block_transactions.blockhash, block.sha256)
+            assert_equal([tx.wtxid_hex for tx in receiver.last_message["blocktxn"].block_transactions.transactions],
+                         [tx.wtxid_hex for tx in block.vtx[1:]])
+        self.utxos.append([block.vtx[-1].txid_int, 0, block.vtx[-1].vout[0].nValue])
+
     def test_highbandwidth_mode_states_via_getpeerinfo(self):
         # create new p2p connection for a fresh state w/o any prior sendcmpct messages sent
         hb_test_node = self.nodes[0].add_p2p_connection(TestP2PConn())
@@ -947,6 +992,9 @@ class CompactBlocksTest(Quantum CoinTestFramework):
         self.request_cb_announcements(self.additional_segwit_node)
         self.test_end_to_end_block_relay([self.segwit_node, self.additional_segwit_node])
 
+        self.log.info("Testing compact block relay before reconstruction...")
+        self.test_fast_relay_before_reconstruction(sender=self.segwit_node, receiver=self.additional_segwit_node)
+
         self.log.info("Testing handling of invalid compact blocks...")
         self.test_invalid_tx_in_compactblock(self.segwit_node)
 
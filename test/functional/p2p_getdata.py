@@ -7,7 +7,9 @@ from collections import defaultdict
 
 from test_framework.messages import (
     CInv,
+    MSG_BLOCK,
     msg_getdata,
+    msg_ping,
 )
 from test_framework.p2p import P2PInterface
 from test_framework.test_framework import Quantum CoinTestFramework
@@ -17,10 +19,16 @@ class P2PStoreBlock(P2PInterface):
     def __init__(self):
         super().__init__()
         self.blocks = defaultdict(int)
+        # The blocks and pongs received, in order
+        self.replies = []
 
     def on_block(self, message):
         message.block.calc_sha256()
         self.blocks[message.block.sha256] += 1
+        self.replies.append(("block", message.block.sha256))
+
+    def on_pong(self, message):
+        self.replies.append(("pong", message.nonce))
 
 
 class GetdataTest(Quantum CoinTestFramework):
@@ -44,6 +52,17 @@ class GetdataTest(Quantum CoinTestFramework):
         p2p_block_store.send_and_ping(good_getdata)
         p2p_block_store.wait_until(lambda: p2p_block_store.blocks[best_block] == 1)
 
+        self.log.info("test that messages sent after a GETDATA for an old block are answered after the block")
+        # Blocks other than the most recent one are read from disk on a block read thread.
+        old_block = int(self.nodes[0].getblockhash(1), 16)
+        p2p_block_store.replies.clear()
+        old_getdata = msg_getdata()
+        old_getdata.inv.append(CInv(t=MSG_BLOCK, h=old_block))
+        p2p_block_store.send_without_ping(old_getdata)
+        p2p_block_store.send_without_ping(msg_ping(nonce=1))
+        p2p_block_store.wait_until(lambda: ("pong", 1) in p2p_block_store.replies)
+        assert p2p_block_store.replies == [("block", old_block), ("pong", 1)]
+
 
 if __name__ == '__main__':
     GetdataTest(__file__).main()
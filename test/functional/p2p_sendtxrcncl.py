@@ -6,7 +6,10 @@
 """
 
 from test_framework.messages import (
+    msg_reconcildiff,
+    msg_reqrecon,
     msg_sendtxrcncl,
+    msg_sketch,
     msg_verack,
     msg_version,
     msg_wtxidrelay,
@@ -45,6 +48,15 @@ class SendTxrcnclReceiver(P2PInterface):
         self.sendtxrcncl_msg_received = message
 
 
+class ReconciliationResponder(PeerNoVerack):
+    def __init__(self):
+        super().__init__()
+        self.sketch_msg_received = None
+
+    def on_sketch(self, message):
+        self.sketch_msg_received = message
+
+
 class P2PFeelerReceiver(SendTxrcnclReceiver):
     def on_version(self, message):
         # feeler connections can not send any message other than their own version
@@ -151,8 +163,8 @@ class SendTxRcnclTest(Quantum CoinTestFramework):
         assert not peer.sendtxrcncl_msg_received
         self.nodes[0].disconnect_p2ps()
 
-        self.log.info('SENDTXRCNCL not sent if -txreconciliation flag is not set')
-        self.restart_node(0, [])
+        self.log.info('SENDTXRCNCL not sent if -txreconciliation is disabled')
+        self.restart_node(0, ["-txreconciliation=0"])
         peer = self.nodes[0].add_p2p_connection(SendTxrcnclReceiver(), send_version=True, wait_for_verack=True)
         assert not peer.sendtxrcncl_msg_received
         self.nodes[0].disconnect_p2ps()
@@ -175,7 +187,7 @@ class SendTxRcnclTest(Quantum CoinTestFramework):
             peer.send_without_ping(create_sendtxrcncl_msg())
             peer.wait_for_disconnect()
 
-        self.restart_node(0, [])
+        self.restart_node(0, ["-txreconciliation=0"])
         self.log.info('SENDTXRCNCL if no txreconciliation supported is ignored')
         peer = self.nodes[0].add_p2p_connection(PeerNoVerack(), send_version=True, wait_for_verack=False)
         with self.nodes[0].assert_debug_log(['ignored, as our node does not have txreconciliation enabled']):
@@ -225,11 +237,43 @@ class SendTxRcnclTest(Quantum CoinTestFramework):
             peer.send_without_ping(msg_verack())
         self.nodes[0].disconnect_p2ps()
 
+        self.log.info('REQRECON from a registered inbound peer is answered with a SKETCH')
+        peer = self.nodes[0].add_p2p_connection(ReconciliationResponder(), send_version=True, wait_for_verack=False)
+        peer.send_without_ping(create_sendtxrcncl_msg())
+        peer.send_and_ping(msg_verack())
+        reqrecon = msg_reqrecon()
+        reqrecon.set_size = 0
+        reqrecon.q = 8191
+        peer.send_and_ping(reqrecon)
+        peer.wait_until(lambda: peer.sketch_msg_received is not None)
+        # Our reconciliation set is empty, so the sketch is too.
+        assert_equal(peer.sketch_msg_received.skdata, b"")
+        reconcildiff = msg_reconcildiff()
+        reconcildiff.success = 0
+        peer.send_and_ping(reconcildiff)
+
+        self.log.info('REQRECON replaces a round the peer abandoned')
+        peer.sketch_msg_received = None
+        peer.send_and_ping(reqrecon)
+        peer.wait_until(lambda: peer.sketch_msg_received is not None)
+        # No reconcildiff for that round; the next request starts over instead of being a violation.
+        peer.sketch_msg_received = None
+        peer.send_and_ping(reqrecon)
+        peer.wait_until(lambda: peer.sketch_msg_received is not None)
+        assert peer.is_connected
+        peer.send_and_ping(reconcildiff)
+
+        self.log.info('unsolicited SKETCH triggers a disconnect')
+        with self.nodes[0].assert_debug_log(["txreconciliation protocol violation (unexpected or oversized sketch)"]):
+            peer.send_without_ping(msg_sketch())
+            peer.wait_for_disconnect()
+        self.nodes[0].disconnect_p2ps()
+
         # Now, *receiving* from *outbound*.
         self.log.info('SENDTXRCNCL if block-relay-only triggers a disconnect')
         peer = self.nodes[0].add_outbound_p2p_connection(
             PeerNoVerack(), wait_for_verack=False, p2p_idx=0, connection_type="block-relay-only")
-        with self.nodes[0].assert_debug_log(["we indicated no tx relay, disconnecting peer=5"]):
+        with self.nodes[0].assert_debug_log(["we indicated no tx relay, disconnecting peer=6"]):
             peer.send_without_ping(create_sendtxrcncl_msg())
             peer.wait_for_disconnect()
 
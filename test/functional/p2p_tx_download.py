@@ -14,16 +14,21 @@ from test_framework.mempool_util import (
 )
 from test_framework.messages import (
     CInv,
+    COIN,
     MSG_TX,
     MSG_TYPE_MASK,
     MSG_WTX,
+    TxInvHint,
     msg_inv,
+    msg_invhints,
     msg_notfound,
+    msg_sendinvhints,
     msg_tx,
 )
 from test_framework.p2p import (
     P2PInterface,
     p2p_lock,
+    DEFAULT_TX_FETCH_LATENCY,
     NONPREF_PEER_TX_DELAY,
     GETDATA_TX_INTERVAL,
     TXID_RELAY_DELAY,
@@ -47,6 +52,20 @@ class TestP2PConn(P2PInterface):
                 self.tx_getdata_count += 1
 
 
+class InvHintsConn(TestP2PConn):
+    """Peer that negotiates size and fee hints for wtxid announcements."""
+    def __init__(self):
+        super().__init__(wtxidrelay=True)
+        self.hints_received = []
+
+    def on_version(self, message):
+        self.send_without_ping(msg_sendinvhints())
+        super().on_version(message)
+
+    def on_invhints(self, message):
+        self.hints_received.extend(message.hints)
+
+
 # Constants from txdownloadman
 MAX_PEER_TX_REQUEST_IN_FLIGHT = 100
 MAX_PEER_TX_ANNOUNCEMENTS = 5000
@@ -322,6 +341,44 @@ class TxDownloadTest(Quantum CoinTestFramework):
         self.log.info('Check that spurious notfound is ignored')
         self.nodes[0].p2ps[0].send_without_ping(msg_notfound(vec=[CInv(MSG_TX, 1)]))
 
+    def test_inv_hints(self):
+        self.log.info('Check that announcements hinting at a high feerate are requested before plain ones')
+        self.restart_node(0)
+        node = self.nodes[0]
+        mock_time = int(time.time() + 1)
+        node.setmocktime(mock_time)
+        peer = node.add_p2p_connection(InvHintsConn())
+        priority_wtxid = 0xfeed0001
+        plain_wtxid = 0xfeed0002
+        # 100 sat/vB is well above twice the minimum relay feerate
+        peer.send_without_ping(msg_invhints([TxInvHint(wtxid=priority_wtxid, vsize=1000, fee=100000)]))
+        peer.send_and_ping(msg_inv([CInv(t=MSG_WTX, h=plain_wtxid)]))
+        with p2p_lock:
+            assert_equal(peer.tx_getdata_count, 0)
+        # The priority announcement only waits for the peer's (default) fetch latency, rather than NONPREF_PEER_TX_DELAY.
+        node.setmocktime(mock_time + DEFAULT_TX_FETCH_LATENCY)
+        peer.wait_for_getdata([priority_wtxid])
+        peer.sync_with_ping()
+        with p2p_lock:
+            assert_equal(peer.tx_getdata_count, 1)
+        node.setmocktime(mock_time + NONPREF_PEER_TX_DELAY)
+        peer.wait_for_getdata([plain_wtxid])
+
+        self.log.info('Check that peers which sent sendinvhints get their announcements with size and fee')
+        node.setmocktime(0)
+        tx = self.wallet.send_self_transfer(from_node=node)
+        entry = node.getmempoolentry(tx['txid'])
+        peer.wait_until(lambda: len(peer.hints_received) > 0)
+        with p2p_lock:
+            hint = peer.hints_received[0]
+            assert_equal(hint.wtxid, int(tx['wtxid'], 16))
+            assert_equal(hint.vsize, entry['vsize'])
+            assert_equal(hint.fee, int(entry['fees']['base'] * COIN))
+
+        self.log.info('Check that sendinvhints after verack leads to disconnection')
+        peer.send_without_ping(msg_sendinvhints())
+        peer.wait_for_disconnect()
+
     def test_rejects_filter_reset(self):
         self.log.info('Check that rejected tx is not requested again')
         node = self.nodes[0]
@@ -390,6 +447,7 @@ class TxDownloadTest(Quantum CoinTestFramework):
         self.test_txid_inv_delay(True)
         self.test_large_inv_batch()
         self.test_spurious_notfound()
+        self.test_inv_hints()
 
         # Run each test against new qtcd instances, as setting mocktimes has long-term effects on when
         # the next trickle relay event happens.